@@ -2,6 +2,10 @@
 #include "misc.h"
 #include "basic_data_structures.h"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
 float
 Anim::GetLocalSampleTime(const Anim::animation_player* Player, int AnimationIndex,
                          float GlobalTimeSec)
@@ -62,23 +66,36 @@ Anim::LinearMirroredAnimationSample(Anim::animation_player* Player, int AnimInde
   assert(0 <= AnimIndex && AnimIndex < Player->AnimStateCount);
   assert(0 <= ResultIndex && ResultIndex < ANIM_PLAYER_OUTPUT_BLOCK_COUNT);
   const Anim::animation* Animation = Player->Animations[AnimIndex];
+  // The final poses are only computed after the blend, until then they are free
   LinearMirroredAnimationSample(&Player->OutputTransforms[Animation->ChannelCount * ResultIndex],
-                                Player->ModelSpaceMatrices, Player->Skeleton, Animation, Time,
-                                MirrorInfo);
+                                Player->HierarchicalModelSpaceMatrices, Player->Skeleton,
+                                Animation, Time, MirrorInfo,
+                                &Player->States[AnimIndex].KeyframeCursor);
 }
 
 void
 Anim::LinearMirroredAnimationSample(transform* OutputTransforms, mat4* TempMatrices,
                                     const skeleton* Skeleton, const Anim::animation* Animation,
-                                    float Time, const Anim::skeleton_mirror_info* MirrorInfo)
+                                    float Time, const Anim::skeleton_mirror_info* MirrorInfo,
+                                    int32_t* KeyframeCursor)
 {
   assert(OutputTransforms);
   assert(TempMatrices);
   assert(Skeleton);
-  Anim::LinearAnimationSample(OutputTransforms, Animation, Time);
+  Anim::LinearAnimationSample(OutputTransforms, Animation, Time, KeyframeCursor);
+  MirrorTransforms(OutputTransforms, TempMatrices, Skeleton, MirrorInfo);
+}
+
+void
+Anim::MirrorTransforms(transform* Transforms, mat4* TempMatrices, const skeleton* Skeleton,
+                       const Anim::skeleton_mirror_info* MirrorInfo)
+{
+  assert(Transforms);
+  assert(TempMatrices);
+  assert(Skeleton);
 
   // Compute the skeleton skinning matrices
-  ComputeBoneSpacePoses(TempMatrices, OutputTransforms, Skeleton->BoneCount);
+  ComputeBoneSpacePoses(TempMatrices, Transforms, Skeleton->BoneCount);
   ComputeModelSpacePoses(TempMatrices, TempMatrices, Skeleton);
 
 #if 1
@@ -119,24 +136,41 @@ Anim::LinearMirroredAnimationSample(transform* OutputTransforms, mat4* TempMatri
 #endif
 
   InverseComputeModelSpacePoses(TempMatrices, TempMatrices, Skeleton);
-  InverseComputeBoneSpacePoses(OutputTransforms, TempMatrices, Animation->ChannelCount);
+  InverseComputeBoneSpacePoses(Transforms, TempMatrices, Skeleton->BoneCount);
+}
+
+void
+Anim::BakeMirroredAnimation(animation* OutAnimation, mat4* TempMatrices, const skeleton* Skeleton,
+                            const animation* Animation, const skeleton_mirror_info* MirrorInfo)
+{
+  assert(OutAnimation && OutAnimation->Transforms && OutAnimation->SampleTimes);
+  assert(Animation && Animation->ChannelCount == Skeleton->BoneCount);
+  OutAnimation->KeyframeCount = Animation->KeyframeCount;
+  OutAnimation->ChannelCount  = Animation->ChannelCount;
+  memcpy(OutAnimation->SampleTimes, Animation->SampleTimes,
+         Animation->KeyframeCount * sizeof(float));
+  memcpy(OutAnimation->Transforms, Animation->Transforms,
+         Animation->KeyframeCount * Animation->ChannelCount * sizeof(transform));
+  for(int k = 0; k < Animation->KeyframeCount; k++)
+  {
+    MirrorTransforms(&OutAnimation->Transforms[k * Animation->ChannelCount], TempMatrices,
+                     Skeleton, MirrorInfo);
+  }
 }
 
 void
 Anim::UpdatePlayer(Anim::animation_player* Player, float dt,
                    void BlendFunc(animation_player*, void*), void* UserData)
 {
-  if(0 < Player->AnimStateCount)
+  // Blend functions may evaluate animations kept outside of the player
+  if(BlendFunc)
   {
-    if(BlendFunc == NULL)
-    {
-      Player->GlobalTimeSec += dt;
-      SampleAtGlobalTime(Player, 0, 0);
-    }
-    else
-    {
-      BlendFunc(Player, UserData);
-    }
+    BlendFunc(Player, UserData);
+  }
+  else if(0 < Player->AnimStateCount)
+  {
+    Player->GlobalTimeSec += dt;
+    SampleAtGlobalTime(Player, 0, 0);
   }
   else
   {
@@ -147,11 +181,34 @@ Anim::UpdatePlayer(Anim::animation_player* Player, float dt,
       Player->OutputTransforms[i].S = { 1, 1, 1 };
     }
   }
-  ComputeBoneSpacePoses(Player->BoneSpaceMatrices, Player->OutputTransforms,
-                        Player->Skeleton->BoneCount);
-  ComputeModelSpacePoses(Player->ModelSpaceMatrices, Player->BoneSpaceMatrices, Player->Skeleton);
-  ComputeFinalHierarchicalPoses(Player->HierarchicalModelSpaceMatrices, Player->ModelSpaceMatrices,
-                                Player->Skeleton);
+  ComputePlayerPoses(Player);
+}
+
+void
+Anim::ComputePlayerPoses(Anim::animation_player* Player)
+{
+  if(Player->FlatSkeleton)
+  {
+    assert(Player->FlatSkeleton->BoneCount == Player->Skeleton->BoneCount);
+    ComputeFinalHierarchicalPoses(Player->HierarchicalModelSpaceMatrices,
+                                  Player->OutputTransforms, Player->FlatSkeleton,
+                                  Player->LODState.LOD, Player->SkinningMatrices);
+  }
+  else
+  {
+    assert(Player->BoneSpaceMatrices && Player->ModelSpaceMatrices);
+    ComputeBoneSpacePoses(Player->BoneSpaceMatrices, Player->OutputTransforms,
+                          Player->Skeleton->BoneCount);
+    ComputeModelSpacePoses(Player->ModelSpaceMatrices, Player->BoneSpaceMatrices,
+                           Player->Skeleton);
+    ComputeFinalHierarchicalPoses(Player->HierarchicalModelSpaceMatrices,
+                                  Player->ModelSpaceMatrices, Player->Skeleton);
+    if(Player->SkinningMatrices)
+    {
+      ComputeSkinningMatrices(Player->SkinningMatrices, Player->HierarchicalModelSpaceMatrices,
+                              Player->Skeleton->BoneCount);
+    }
+  }
 }
 
 void
@@ -198,6 +255,24 @@ Anim::LerpTransforms(const transform* InA, const transform* InB, int TransformCo
 {
   float KoefA = (1.0f - T);
   float KoefB = T;
+#if defined(__AVX__)
+  if(SOA_POSE_LANE_COUNT <= TransformCount)
+  {
+    // Transposing only pays off when the kernels are vectorized. Out may alias an input, every
+    // chunk is transposed before any of it is written
+    soa_pose PoseA;
+    soa_pose PoseB;
+    for(int First = 0; First < TransformCount; First += SOA_POSE_MAX_BONE_COUNT)
+    {
+      int32_t Count = MinInt32(SOA_POSE_MAX_BONE_COUNT, TransformCount - First);
+      TransformsToSoAPose(&PoseA, &InA[First], Count);
+      TransformsToSoAPose(&PoseB, &InB[First], Count);
+      LerpSoAPoses(&PoseA, &PoseA, &PoseB, Count, T);
+      SoAPoseToTransforms(&Out[First], &PoseA, Count);
+    }
+    return;
+  }
+#endif
   for(int i = 0; i < TransformCount; i++)
   {
     Out[i].T = KoefA * InA[i].T + KoefB * InB[i].T;
@@ -210,11 +285,213 @@ void
 Anim::AddTransforms(const transform* InA, const transform* InB, int TransformCount, float T,
                     transform* Out)
 {
+#if defined(__AVX__)
+  if(SOA_POSE_LANE_COUNT <= TransformCount)
+  {
+    soa_pose PoseA;
+    soa_pose PoseB;
+    for(int First = 0; First < TransformCount; First += SOA_POSE_MAX_BONE_COUNT)
+    {
+      int32_t Count = MinInt32(SOA_POSE_MAX_BONE_COUNT, TransformCount - First);
+      TransformsToSoAPose(&PoseA, &InA[First], Count);
+      TransformsToSoAPose(&PoseB, &InB[First], Count);
+      AddSoAPoses(&PoseA, &PoseA, &PoseB, Count, T);
+      SoAPoseToTransforms(&Out[First], &PoseA, Count);
+    }
+    return;
+  }
+#endif
   for(int i = 0; i < TransformCount; i++)
   {
     Out[i].T = InA[i].T + InB[i].T * T;
     Out[i].R = InA[i].R + InB[i].R * T;
-    // Out[i].S       = InA[i].S + InB[i].S * T;
+    Out[i].S = InA[i].S;
+  }
+}
+
+static inline int32_t
+GetSoAPosePaddedCount(int32_t Count)
+{
+  return (Count + SOA_POSE_LANE_COUNT - 1) / SOA_POSE_LANE_COUNT * SOA_POSE_LANE_COUNT;
+}
+
+void
+Anim::TransformsToSoAPose(soa_pose* OutPose, const transform* Transforms, int32_t Count)
+{
+  assert(0 <= Count && Count <= SOA_POSE_MAX_BONE_COUNT);
+  for(int i = 0; i < Count; i++)
+  {
+    OutPose->RS[i] = Transforms[i].R.S;
+    OutPose->RI[i] = Transforms[i].R.i;
+    OutPose->RJ[i] = Transforms[i].R.j;
+    OutPose->RK[i] = Transforms[i].R.k;
+    OutPose->TX[i] = Transforms[i].T.X;
+    OutPose->TY[i] = Transforms[i].T.Y;
+    OutPose->TZ[i] = Transforms[i].T.Z;
+    OutPose->SX[i] = Transforms[i].S.X;
+    OutPose->SY[i] = Transforms[i].S.Y;
+    OutPose->SZ[i] = Transforms[i].S.Z;
+  }
+  // Identity padding, the kernels always process whole lane groups
+  for(int i = Count; i < GetSoAPosePaddedCount(Count); i++)
+  {
+    OutPose->RS[i] = 1;
+    OutPose->RI[i] = 0;
+    OutPose->RJ[i] = 0;
+    OutPose->RK[i] = 0;
+    OutPose->TX[i] = 0;
+    OutPose->TY[i] = 0;
+    OutPose->TZ[i] = 0;
+    OutPose->SX[i] = 1;
+    OutPose->SY[i] = 1;
+    OutPose->SZ[i] = 1;
+  }
+}
+
+void
+Anim::SoAPoseToTransforms(transform* OutTransforms, const soa_pose* Pose, int32_t Count)
+{
+  assert(0 <= Count && Count <= SOA_POSE_MAX_BONE_COUNT);
+  for(int i = 0; i < Count; i++)
+  {
+    OutTransforms[i].R.S = Pose->RS[i];
+    OutTransforms[i].R.i = Pose->RI[i];
+    OutTransforms[i].R.j = Pose->RJ[i];
+    OutTransforms[i].R.k = Pose->RK[i];
+    OutTransforms[i].T.X = Pose->TX[i];
+    OutTransforms[i].T.Y = Pose->TY[i];
+    OutTransforms[i].T.Z = Pose->TZ[i];
+    OutTransforms[i].S.X = Pose->SX[i];
+    OutTransforms[i].S.Y = Pose->SY[i];
+    OutTransforms[i].S.Z = Pose->SZ[i];
+  }
+}
+
+// Same operation order as QuatLerp and the vec3 operators so that both paths agree bit for bit
+void
+Anim::LerpSoAPoses(soa_pose* OutPose, const soa_pose* A, const soa_pose* B, int32_t Count,
+                   float T)
+{
+  assert(0 <= Count && Count <= SOA_POSE_MAX_BONE_COUNT);
+  const float KoefA = (1.0f - T);
+  const float KoefB = T;
+  int32_t     i     = 0;
+#if defined(__AVX__)
+  const __m256 KoefA8   = _mm256_set1_ps(KoefA);
+  const __m256 KoefB8   = _mm256_set1_ps(KoefB);
+  const __m256 SignMask = _mm256_set1_ps(-0.0f);
+  for(; i < Count; i += SOA_POSE_LANE_COUNT)
+  {
+    __m256 AS = _mm256_loadu_ps(&A->RS[i]);
+    __m256 AI = _mm256_loadu_ps(&A->RI[i]);
+    __m256 AJ = _mm256_loadu_ps(&A->RJ[i]);
+    __m256 AK = _mm256_loadu_ps(&A->RK[i]);
+    __m256 BS = _mm256_loadu_ps(&B->RS[i]);
+    __m256 BI = _mm256_loadu_ps(&B->RI[i]);
+    __m256 BJ = _mm256_loadu_ps(&B->RJ[i]);
+    __m256 BK = _mm256_loadu_ps(&B->RK[i]);
+
+    __m256 Dot = _mm256_add_ps(_mm256_mul_ps(AI, BI), _mm256_mul_ps(AJ, BJ));
+    Dot        = _mm256_add_ps(Dot, _mm256_mul_ps(AK, BK));
+    Dot        = _mm256_add_ps(Dot, _mm256_mul_ps(AS, BS));
+
+    // Flip B where it is on the far hemisphere so that the shorter arc is taken
+    __m256 Flip =
+      _mm256_and_ps(_mm256_cmp_ps(Dot, _mm256_setzero_ps(), _CMP_LT_OQ), SignMask);
+    BS = _mm256_xor_ps(BS, Flip);
+    BI = _mm256_xor_ps(BI, Flip);
+    BJ = _mm256_xor_ps(BJ, Flip);
+    BK = _mm256_xor_ps(BK, Flip);
+
+    __m256 RS = _mm256_add_ps(_mm256_mul_ps(KoefA8, AS), _mm256_mul_ps(KoefB8, BS));
+    __m256 RI = _mm256_add_ps(_mm256_mul_ps(KoefA8, AI), _mm256_mul_ps(KoefB8, BI));
+    __m256 RJ = _mm256_add_ps(_mm256_mul_ps(KoefA8, AJ), _mm256_mul_ps(KoefB8, BJ));
+    __m256 RK = _mm256_add_ps(_mm256_mul_ps(KoefA8, AK), _mm256_mul_ps(KoefB8, BK));
+
+    __m256 Length = _mm256_add_ps(_mm256_mul_ps(RS, RS), _mm256_mul_ps(RI, RI));
+    Length        = _mm256_add_ps(Length, _mm256_mul_ps(RJ, RJ));
+    Length        = _mm256_sqrt_ps(_mm256_add_ps(Length, _mm256_mul_ps(RK, RK)));
+    _mm256_storeu_ps(&OutPose->RS[i], _mm256_div_ps(RS, Length));
+    _mm256_storeu_ps(&OutPose->RI[i], _mm256_div_ps(RI, Length));
+    _mm256_storeu_ps(&OutPose->RJ[i], _mm256_div_ps(RJ, Length));
+    _mm256_storeu_ps(&OutPose->RK[i], _mm256_div_ps(RK, Length));
+
+#define LERP_SOA_COMPONENT(Component)                                                              \
+  _mm256_storeu_ps(&OutPose->Component[i],                                                         \
+                   _mm256_add_ps(_mm256_mul_ps(KoefA8, _mm256_loadu_ps(&A->Component[i])),         \
+                                 _mm256_mul_ps(KoefB8, _mm256_loadu_ps(&B->Component[i]))))
+    LERP_SOA_COMPONENT(TX);
+    LERP_SOA_COMPONENT(TY);
+    LERP_SOA_COMPONENT(TZ);
+    LERP_SOA_COMPONENT(SX);
+    LERP_SOA_COMPONENT(SY);
+    LERP_SOA_COMPONENT(SZ);
+#undef LERP_SOA_COMPONENT
+  }
+#endif
+  for(; i < Count; i++)
+  {
+    quat RA;
+    RA.S = A->RS[i];
+    RA.V = { A->RI[i], A->RJ[i], A->RK[i] };
+    quat RB;
+    RB.S   = B->RS[i];
+    RB.V   = { B->RI[i], B->RJ[i], B->RK[i] };
+    quat R = Math::QuatLerp(RA, RB, T);
+
+    OutPose->RS[i] = R.S;
+    OutPose->RI[i] = R.i;
+    OutPose->RJ[i] = R.j;
+    OutPose->RK[i] = R.k;
+    OutPose->TX[i] = KoefA * A->TX[i] + KoefB * B->TX[i];
+    OutPose->TY[i] = KoefA * A->TY[i] + KoefB * B->TY[i];
+    OutPose->TZ[i] = KoefA * A->TZ[i] + KoefB * B->TZ[i];
+    OutPose->SX[i] = KoefA * A->SX[i] + KoefB * B->SX[i];
+    OutPose->SY[i] = KoefA * A->SY[i] + KoefB * B->SY[i];
+    OutPose->SZ[i] = KoefA * A->SZ[i] + KoefB * B->SZ[i];
+  }
+}
+
+// Rotations and translations are offset by the scaled additive pose, scales are kept from A
+void
+Anim::AddSoAPoses(soa_pose* OutPose, const soa_pose* A, const soa_pose* B, int32_t Count,
+                  float T)
+{
+  assert(0 <= Count && Count <= SOA_POSE_MAX_BONE_COUNT);
+  int32_t i = 0;
+#if defined(__AVX__)
+  const __m256 T8 = _mm256_set1_ps(T);
+  for(; i < Count; i += SOA_POSE_LANE_COUNT)
+  {
+#define ADD_SOA_COMPONENT(Component)                                                               \
+  _mm256_storeu_ps(&OutPose->Component[i],                                                         \
+                   _mm256_add_ps(_mm256_loadu_ps(&A->Component[i]),                                \
+                                 _mm256_mul_ps(_mm256_loadu_ps(&B->Component[i]), T8)))
+    ADD_SOA_COMPONENT(RS);
+    ADD_SOA_COMPONENT(RI);
+    ADD_SOA_COMPONENT(RJ);
+    ADD_SOA_COMPONENT(RK);
+    ADD_SOA_COMPONENT(TX);
+    ADD_SOA_COMPONENT(TY);
+    ADD_SOA_COMPONENT(TZ);
+#undef ADD_SOA_COMPONENT
+    _mm256_storeu_ps(&OutPose->SX[i], _mm256_loadu_ps(&A->SX[i]));
+    _mm256_storeu_ps(&OutPose->SY[i], _mm256_loadu_ps(&A->SY[i]));
+    _mm256_storeu_ps(&OutPose->SZ[i], _mm256_loadu_ps(&A->SZ[i]));
+  }
+#endif
+  for(; i < Count; i++)
+  {
+    OutPose->RS[i] = A->RS[i] + B->RS[i] * T;
+    OutPose->RI[i] = A->RI[i] + B->RI[i] * T;
+    OutPose->RJ[i] = A->RJ[i] + B->RJ[i] * T;
+    OutPose->RK[i] = A->RK[i] + B->RK[i] * T;
+    OutPose->TX[i] = A->TX[i] + B->TX[i] * T;
+    OutPose->TY[i] = A->TY[i] + B->TY[i] * T;
+    OutPose->TZ[i] = A->TZ[i] + B->TZ[i] * T;
+    OutPose->SX[i] = A->SX[i];
+    OutPose->SY[i] = A->SY[i];
+    OutPose->SZ[i] = A->SZ[i];
   }
 }
 
@@ -242,29 +519,90 @@ Anim::AdditiveBlend(animation_player* Player, int AnimAInd, int AnimBInd, float
                 &Player->OutputTransforms[ResultIndex * ChannelCount]);
 }
 
+// Smallest k with Time <= SampleTimes[k + 1], the pair the linear scan used to stop at
+static inline bool
+IsKeyframePairAt(const float* SampleTimes, int K, float Time)
+{
+  return (K == 0 || SampleTimes[K] < Time) && Time <= SampleTimes[K + 1];
+}
+
+// Playback mostly stays within the pair of the previous call or moves to the next one, so the
+// cursor is tried first. Uniformly sampled clips are then indexed arithmetically and seeks and loop
+// wraps of the rest fall back to a binary search
 void
 GetKeyframeIndexAndInterpolant(int* K, float* T, const float* SampleTimes, int SampleCount,
-                               float Time)
+                               float Time, int32_t* KeyframeCursor = NULL)
 {
-  Time = ClampFloat(SampleTimes[0], Time, SampleTimes[SampleCount - 1]);
-  for(int k = 0; k < SampleCount - 1; k++)
+  Time                    = ClampFloat(SampleTimes[0], Time, SampleTimes[SampleCount - 1]);
+  const int LastPairIndex = SampleCount - 2;
+
+  int k = -1;
+  if(KeyframeCursor)
   {
-    if(Time <= SampleTimes[k + 1])
+    int Cursor = ClampInt32InIn(0, *KeyframeCursor, LastPairIndex);
+    for(int Step = 0; Step < ANIM_KEYFRAME_CURSOR_STEP_COUNT && Cursor + Step <= LastPairIndex;
+        Step++)
     {
-      *K = k;
-      *T = (Time - SampleTimes[k]) / (SampleTimes[k + 1] - SampleTimes[k]);
-      return;
+      if(IsKeyframePairAt(SampleTimes, Cursor + Step, Time))
+      {
+        k = Cursor + Step;
+        break;
+      }
     }
   }
+  if(k < 0)
+  {
+    const float Duration = SampleTimes[SampleCount - 1] - SampleTimes[0];
+    int         Guess =
+      (0 < Duration)
+        ? (int)((Time - SampleTimes[0]) / Duration * (float)(SampleCount - 1))
+        : 0;
+    Guess = ClampInt32InIn(0, Guess, LastPairIndex);
+    // Rounding can put Time on the boundary of a neighbouring pair
+    for(int g = MaxInt32(0, Guess - 1); g <= MinInt32(Guess + 1, LastPairIndex); g++)
+    {
+      if(IsKeyframePairAt(SampleTimes, g, Time))
+      {
+        k = g;
+        break;
+      }
+    }
+  }
+  if(k < 0)
+  {
+    int Low  = 0;
+    int High = LastPairIndex;
+    while(Low < High)
+    {
+      int Mid = (Low + High) / 2;
+      if(Time <= SampleTimes[Mid + 1])
+      {
+        High = Mid;
+      }
+      else
+      {
+        Low = Mid + 1;
+      }
+    }
+    k = Low;
+  }
+
+  *K = k;
+  *T = (Time - SampleTimes[k]) / (SampleTimes[k + 1] - SampleTimes[k]);
+  if(KeyframeCursor)
+  {
+    *KeyframeCursor = k;
+  }
 }
 
 void
 Anim::LinearAnimationSample(transform* OutputTransforms, const Anim::animation* Animation,
-                            float Time)
+                            float Time, int32_t* KeyframeCursor)
 {
   int   k;
   float t;
-  GetKeyframeIndexAndInterpolant(&k, &t, Animation->SampleTimes, Animation->KeyframeCount, Time);
+  GetKeyframeIndexAndInterpolant(&k, &t, Animation->SampleTimes, Animation->KeyframeCount, Time,
+                                 KeyframeCursor);
   LerpTransforms(&Animation->Transforms[k * Animation->ChannelCount],
                  &Animation->Transforms[(k + 1) * Animation->ChannelCount], Animation->ChannelCount,
                  t, OutputTransforms);
@@ -278,17 +616,58 @@ Anim::LinearAnimationSample(Anim::animation_player* Player, int AnimIndex, float
   assert(0 <= ResultIndex && ResultIndex < ANIM_PLAYER_OUTPUT_BLOCK_COUNT);
   const Anim::animation* Animation = Player->Animations[AnimIndex];
   LinearAnimationSample(&Player->OutputTransforms[Animation->ChannelCount * ResultIndex], Animation,
-                        Time);
+                        Time, &Player->States[AnimIndex].KeyframeCursor);
+}
+
+void
+Anim::LinearAnimationSample(soa_pose* OutPose, const Anim::animation* Animation, float Time,
+                            int32_t* KeyframeCursor)
+{
+  int   k;
+  float t;
+  GetKeyframeIndexAndInterpolant(&k, &t, Animation->SampleTimes, Animation->KeyframeCount, Time,
+                                 KeyframeCursor);
+  soa_pose NextPose;
+  TransformsToSoAPose(OutPose, &Animation->Transforms[k * Animation->ChannelCount],
+                      Animation->ChannelCount);
+  TransformsToSoAPose(&NextPose, &Animation->Transforms[(k + 1) * Animation->ChannelCount],
+                      Animation->ChannelCount);
+  LerpSoAPoses(OutPose, OutPose, &NextPose, Animation->ChannelCount, t);
+}
+
+void
+Anim::SampleAtGlobalTime(soa_pose* OutPose, Anim::animation_player* Player, int AnimationIndex,
+                         const Anim::skeleton_mirror_info* MirrorInfo)
+{
+  assert(0 <= AnimationIndex && AnimationIndex < Player->AnimStateCount);
+  const Anim::animation* Animation = Player->Animations[AnimationIndex];
+  float SampleTime = Anim::GetLocalSampleTime(Player, AnimationIndex, Player->GlobalTimeSec);
+  if(MirrorInfo)
+  {
+    const int ScratchBlockIndex = ANIM_PLAYER_OUTPUT_BLOCK_COUNT - 1;
+    LinearMirroredAnimationSample(Player, AnimationIndex, SampleTime, ScratchBlockIndex,
+                                  MirrorInfo);
+    TransformsToSoAPose(OutPose,
+                        &Player->OutputTransforms[Animation->ChannelCount * ScratchBlockIndex],
+                        Animation->ChannelCount);
+  }
+  else
+  {
+    LinearAnimationSample(OutPose, Animation, SampleTime,
+                          &Player->States[AnimationIndex].KeyframeCursor);
+  }
 }
 
 transform
-Anim::LinearAnimationBoneSample(const Anim::animation* Animation, int BoneIndex, float Time)
+Anim::LinearAnimationBoneSample(const Anim::animation* Animation, int BoneIndex, float Time,
+                                int32_t* KeyframeCursor)
 {
   transform Result;
   int       k;
   float     t;
   int       ChannelCount = 1;
-  GetKeyframeIndexAndInterpolant(&k, &t, Animation->SampleTimes, Animation->KeyframeCount, Time);
+  GetKeyframeIndexAndInterpolant(&k, &t, Animation->SampleTimes, Animation->KeyframeCount, Time,
+                                 KeyframeCursor);
   LerpTransforms(&Animation->Transforms[k * Animation->ChannelCount + BoneIndex],
                  &Animation->Transforms[(k + 1) * Animation->ChannelCount + BoneIndex],
                  ChannelCount, t, &Result);
@@ -326,6 +705,71 @@ Anim::GetRootAndInvRootMatrices(mat4* OutRootMatrix, mat4* OutInvRootMatrix, mat
   }
 }
 
+void
+Anim::ComputeRootMotionKeys(root_motion_key* OutKeys, const skeleton* Skeleton,
+                            const animation* Animation)
+{
+  const int HipBoneIndex = 0;
+  for(int k = 0; k < Animation->KeyframeCount; k++)
+  {
+    mat4 HipMatrix =
+      Math::MulMat4(Skeleton->Bones[HipBoneIndex].BindPose,
+                    TransformToMat4(Animation->Transforms[k * Animation->ChannelCount +
+                                                          HipBoneIndex]));
+    float Yaw = atan2f(HipMatrix.Z.X, HipMatrix.Z.Z);
+    if(0 < k)
+    {
+      const float PrevYaw = OutKeys[k - 1].Yaw;
+      Yaw += 2 * LINEAR_MATH_PI * roundf((PrevYaw - Yaw) / (2 * LINEAR_MATH_PI));
+    }
+    OutKeys[k].X   = HipMatrix.T.X;
+    OutKeys[k].Z   = HipMatrix.T.Z;
+    OutKeys[k].Yaw = Yaw;
+  }
+}
+
+static inline Anim::root_motion_key
+SampleRootMotionKey(const Anim::root_motion_key* Keys, const Anim::animation* Animation,
+                    float Time)
+{
+  int   k;
+  float t;
+  GetKeyframeIndexAndInterpolant(&k, &t, Animation->SampleTimes, Animation->KeyframeCount, Time);
+  const Anim::root_motion_key& A = Keys[k];
+  const Anim::root_motion_key& B = Keys[k + 1];
+
+  Anim::root_motion_key Result;
+  Result.X   = A.X + t * (B.X - A.X);
+  Result.Z   = A.Z + t * (B.Z - A.Z);
+  Result.Yaw = A.Yaw + t * (B.Yaw - A.Yaw);
+  return Result;
+}
+
+transform
+Anim::SampleRootMotionDelta(const root_motion_key* Keys, const animation* Animation, float Time,
+                            float dt, bool MirrorInX)
+{
+  root_motion_key Current = SampleRootMotionKey(Keys, Animation, Time);
+  root_motion_key Next    = SampleRootMotionKey(Keys, Animation, Time + dt);
+
+  // The delta in the root's frame, whose left is (cos, 0, -sin) and forward (sin, 0, cos) of Yaw
+  float DeltaX   = Next.X - Current.X;
+  float DeltaZ   = Next.Z - Current.Z;
+  float DeltaYaw = Next.Yaw - Current.Yaw;
+  float Cos      = cosf(Current.Yaw);
+  float Sin      = sinf(Current.Yaw);
+
+  transform Result = IdentityTransform();
+  Result.T         = { Cos * DeltaX - Sin * DeltaZ, 0, Sin * DeltaX + Cos * DeltaZ };
+  if(MirrorInX)
+  {
+    Result.T.X = -Result.T.X;
+    DeltaYaw   = -DeltaYaw;
+  }
+  Result.R = Math::QuatAxisAngle({ 0, 1, 0 }, DeltaYaw);
+  return Result;
+}
+
 void
 Anim::ComputeBoneSpacePoses(mat4* BoneSpaceMatrices, const transform* Transforms, int Count)
 {
@@ -385,6 +829,315 @@ Anim::ComputeFinalHierarchicalPoses(mat4* FinalPoseMatrices, const mat4* ModelSp
   }
 }
 
+void
+Anim::ComputeBoneLODs(uint8_t* OutBoneLODs, const Anim::skeleton* Skeleton)
+{
+  // Children come after their parents, so the subtree depths are final once the loop reaches a bone
+  for(int i = 0; i < Skeleton->BoneCount; i++)
+  {
+    OutBoneLODs[i] = 0;
+  }
+  for(int i = Skeleton->BoneCount - 1; 1 <= i; i--)
+  {
+    uint8_t* ParentLOD = &OutBoneLODs[Skeleton->Bones[i].ParentIndex];
+    if(*ParentLOD <= OutBoneLODs[i] && OutBoneLODs[i] < UINT8_MAX)
+    {
+      *ParentLOD = OutBoneLODs[i] + 1;
+    }
+  }
+  // The root carries the whole pose
+  OutBoneLODs[0] = UINT8_MAX;
+}
+
+static inline void
+PackSkinningMatrix(Anim::skinning_matrix* Result, const mat4& Matrix)
+{
+  for(int r = 0; r < 3; r++)
+  {
+    Result->Rows[r] = { Matrix.e[r], Matrix.e[r + 4], Matrix.e[r + 8], Matrix.e[r + 12] };
+  }
+}
+
+void
+Anim::ComputeSkinningMatrices(Anim::skinning_matrix* SkinningMatrices,
+                              const mat4* FinalPoseMatrices, int32_t Count)
+{
+  for(int i = 0; i < Count; i++)
+  {
+    PackSkinningMatrix(&SkinningMatrices[i], FinalPoseMatrices[i]);
+  }
+}
+
+void
+Anim::BuildFlatSkeleton(Anim::flat_skeleton* OutFlatSkeleton, const Anim::skeleton* Skeleton)
+{
+  assert(OutFlatSkeleton && Skeleton);
+  assert(0 < Skeleton->BoneCount && Skeleton->BoneCount <= SKELETON_MAX_BONE_COUNT);
+  *OutFlatSkeleton = {};
+
+  OutFlatSkeleton->BoneCount = Skeleton->BoneCount;
+  int32_t LevelBoneCounts[SKELETON_MAX_BONE_COUNT] = {};
+  for(int i = 0; i < Skeleton->BoneCount; i++)
+  {
+    const Anim::bone* Bone   = &Skeleton->Bones[i];
+    const int32_t     Parent = Bone->ParentIndex;
+    assert(Parent < i && (0 < i || Parent < 0));
+
+    OutFlatSkeleton->ParentIndices[i]    = Parent;
+    OutFlatSkeleton->Depths[i]           = (Parent < 0) ? 0 : OutFlatSkeleton->Depths[Parent] + 1;
+    OutFlatSkeleton->BindPoses[i]        = Bone->BindPose;
+    OutFlatSkeleton->InverseBindPoses[i] = Bone->InverseBindPose;
+
+    const int32_t Depth = OutFlatSkeleton->Depths[i];
+    LevelBoneCounts[Depth]++;
+    OutFlatSkeleton->LevelCount = MaxInt32(OutFlatSkeleton->LevelCount, Depth + 1);
+  }
+
+  // Counting sort, bones of a level keep their skeleton order
+  for(int l = 0; l < OutFlatSkeleton->LevelCount; l++)
+  {
+    OutFlatSkeleton->LevelStarts[l + 1] = OutFlatSkeleton->LevelStarts[l] + LevelBoneCounts[l];
+    LevelBoneCounts[l]                  = OutFlatSkeleton->LevelStarts[l];
+  }
+  for(int i = 0; i < Skeleton->BoneCount; i++)
+  {
+    OutFlatSkeleton->LevelOrder[LevelBoneCounts[OutFlatSkeleton->Depths[i]]++] = i;
+  }
+
+  ComputeBoneLODs(OutFlatSkeleton->BoneLODs, Skeleton);
+}
+
+// Same operation order as Math::MulMat4, so both give the same result
+static inline mat4
+MulMat4Columns(const mat4& A, const mat4& B)
+{
+#if defined(__AVX__)
+  mat4         Result;
+  const __m128 A0 = _mm_loadu_ps(&A.e[0]);
+  const __m128 A1 = _mm_loadu_ps(&A.e[4]);
+  const __m128 A2 = _mm_loadu_ps(&A.e[8]);
+  const __m128 A3 = _mm_loadu_ps(&A.e[12]);
+  for(int c = 0; c < 4; c++)
+  {
+    __m128 Column = _mm_add_ps(_mm_mul_ps(A0, _mm_set1_ps(B.e[4 * c])),
+                               _mm_mul_ps(A1, _mm_set1_ps(B.e[4 * c + 1])));
+    Column        = _mm_add_ps(Column, _mm_mul_ps(A2, _mm_set1_ps(B.e[4 * c + 2])));
+    Column        = _mm_add_ps(Column, _mm_mul_ps(A3, _mm_set1_ps(B.e[4 * c + 3])));
+    _mm_storeu_ps(&Result.e[4 * c], Column);
+  }
+  return Result;
+#else
+  return Math::MulMat4(A, B);
+#endif
+}
+
+#if defined(__AVX__)
+// Rows[k] receives element k of every input row
+static inline void
+Transpose8x8(__m256* Rows)
+{
+  const __m256 A0 = _mm256_unpacklo_ps(Rows[0], Rows[1]);
+  const __m256 A1 = _mm256_unpackhi_ps(Rows[0], Rows[1]);
+  const __m256 A2 = _mm256_unpacklo_ps(Rows[2], Rows[3]);
+  const __m256 A3 = _mm256_unpackhi_ps(Rows[2], Rows[3]);
+  const __m256 A4 = _mm256_unpacklo_ps(Rows[4], Rows[5]);
+  const __m256 A5 = _mm256_unpackhi_ps(Rows[4], Rows[5]);
+  const __m256 A6 = _mm256_unpacklo_ps(Rows[6], Rows[7]);
+  const __m256 A7 = _mm256_unpackhi_ps(Rows[6], Rows[7]);
+  const __m256 B0 = _mm256_shuffle_ps(A0, A2, _MM_SHUFFLE(1, 0, 1, 0));
+  const __m256 B1 = _mm256_shuffle_ps(A0, A2, _MM_SHUFFLE(3, 2, 3, 2));
+  const __m256 B2 = _mm256_shuffle_ps(A1, A3, _MM_SHUFFLE(1, 0, 1, 0));
+  const __m256 B3 = _mm256_shuffle_ps(A1, A3, _MM_SHUFFLE(3, 2, 3, 2));
+  const __m256 B4 = _mm256_shuffle_ps(A4, A6, _MM_SHUFFLE(1, 0, 1, 0));
+  const __m256 B5 = _mm256_shuffle_ps(A4, A6, _MM_SHUFFLE(3, 2, 3, 2));
+  const __m256 B6 = _mm256_shuffle_ps(A5, A7, _MM_SHUFFLE(1, 0, 1, 0));
+  const __m256 B7 = _mm256_shuffle_ps(A5, A7, _MM_SHUFFLE(3, 2, 3, 2));
+  Rows[0]         = _mm256_permute2f128_ps(B0, B4, 0x20);
+  Rows[1]         = _mm256_permute2f128_ps(B1, B5, 0x20);
+  Rows[2]         = _mm256_permute2f128_ps(B2, B6, 0x20);
+  Rows[3]         = _mm256_permute2f128_ps(B3, B7, 0x20);
+  Rows[4]         = _mm256_permute2f128_ps(B0, B4, 0x31);
+  Rows[5]         = _mm256_permute2f128_ps(B1, B5, 0x31);
+  Rows[6]         = _mm256_permute2f128_ps(B2, B6, 0x31);
+  Rows[7]         = _mm256_permute2f128_ps(B3, B7, 0x31);
+}
+
+// Lanes[e] receives element e of every matrix
+static inline void
+LoadMat4Lanes(__m256* Lanes, const mat4* const* Matrices)
+{
+  for(int k = 0; k < SOA_POSE_LANE_COUNT; k++)
+  {
+    Lanes[k]     = _mm256_loadu_ps(&Matrices[k]->e[0]);
+    Lanes[8 + k] = _mm256_loadu_ps(&Matrices[k]->e[8]);
+  }
+  Transpose8x8(&Lanes[0]);
+  Transpose8x8(&Lanes[8]);
+}
+
+// Same operation order as MulMat4Columns, Result may not alias the inputs
+static inline void
+MulMat4Lanes(__m256* Result, const __m256* A, const __m256* B)
+{
+  for(int c = 0; c < 4; c++)
+  {
+    for(int r = 0; r < 4; r++)
+    {
+      __m256 Element = _mm256_add_ps(_mm256_mul_ps(A[r], B[4 * c]),
+                                     _mm256_mul_ps(A[4 + r], B[4 * c + 1]));
+      Element = _mm256_add_ps(Element, _mm256_mul_ps(A[8 + r], B[4 * c + 2]));
+      Element = _mm256_add_ps(Element, _mm256_mul_ps(A[12 + r], B[4 * c + 3]));
+      Result[4 * c + r] = Element;
+    }
+  }
+}
+
+// Translate(T) * Rotate(R) of every lane with the operations of Math::Mat4Rotate, the first
+// eight floats of a transform are R.S, R.V, T
+static inline void
+LoadBoneSpaceMatrixLanes(__m256* Result, const transform* const* Transforms)
+{
+  __m256 Lanes[8];
+  for(int k = 0; k < SOA_POSE_LANE_COUNT; k++)
+  {
+    Lanes[k] = _mm256_loadu_ps(&Transforms[k]->R.S);
+  }
+  Transpose8x8(Lanes);
+  const __m256 S   = Lanes[0];
+  const __m256 X   = Lanes[1];
+  const __m256 Y   = Lanes[2];
+  const __m256 Z   = Lanes[3];
+  const __m256 One = _mm256_set1_ps(1.0f);
+  const __m256 Two = _mm256_set1_ps(2.0f);
+
+  Result[0]  = _mm256_sub_ps(One, _mm256_mul_ps(Two, _mm256_add_ps(_mm256_mul_ps(Y, Y),
+                                                                   _mm256_mul_ps(Z, Z))));
+  Result[1]  = _mm256_mul_ps(Two, _mm256_add_ps(_mm256_mul_ps(X, Y), _mm256_mul_ps(S, Z)));
+  Result[2]  = _mm256_mul_ps(Two, _mm256_sub_ps(_mm256_mul_ps(X, Z), _mm256_mul_ps(S, Y)));
+  Result[3]  = _mm256_setzero_ps();
+  Result[4]  = _mm256_mul_ps(Two, _mm256_sub_ps(_mm256_mul_ps(X, Y), _mm256_mul_ps(S, Z)));
+  Result[5]  = _mm256_sub_ps(One, _mm256_mul_ps(Two, _mm256_add_ps(_mm256_mul_ps(X, X),
+                                                                   _mm256_mul_ps(Z, Z))));
+  Result[6]  = _mm256_mul_ps(Two, _mm256_add_ps(_mm256_mul_ps(Y, Z), _mm256_mul_ps(S, X)));
+  Result[7]  = _mm256_setzero_ps();
+  Result[8]  = _mm256_mul_ps(Two, _mm256_add_ps(_mm256_mul_ps(X, Z), _mm256_mul_ps(S, Y)));
+  Result[9]  = _mm256_mul_ps(Two, _mm256_sub_ps(_mm256_mul_ps(Y, Z), _mm256_mul_ps(S, X)));
+  Result[10] = _mm256_sub_ps(One, _mm256_mul_ps(Two, _mm256_add_ps(_mm256_mul_ps(X, X),
+                                                                   _mm256_mul_ps(Y, Y))));
+  Result[11] = _mm256_setzero_ps();
+  Result[12] = Lanes[4];
+  Result[13] = Lanes[5];
+  Result[14] = Lanes[6];
+  Result[15] = One;
+}
+#endif // __AVX__
+
+void
+Anim::ComputeFinalHierarchicalPoses(mat4* FinalPoseMatrices, const transform* Transforms,
+                                    const Anim::flat_skeleton* Skeleton, int32_t LOD,
+                                    Anim::skinning_matrix* SkinningMatrices)
+{
+#if defined(__AVX__)
+  // The bones of a level are processed SOA_POSE_LANE_COUNT at a time, their matrices are
+  // transposed into lanes on the way in and out. Lanes past the level's end read zeros
+  static const mat4      s_ZeroMatrix    = {};
+  static const transform s_ZeroTransform = {};
+  const int32_t          LaneCount       = SOA_POSE_LANE_COUNT;
+  for(int l = 0; l < Skeleton->LevelCount; l++)
+  {
+    for(int First = Skeleton->LevelStarts[l]; First < Skeleton->LevelStarts[l + 1];
+        First += LaneCount)
+    {
+      const int32_t    BoneCount = MinInt32(LaneCount, Skeleton->LevelStarts[l + 1] - First);
+      const int32_t*   Bones     = &Skeleton->LevelOrder[First];
+      const transform* BoneTransforms[SOA_POSE_LANE_COUNT];
+      const mat4*      BindPoses[SOA_POSE_LANE_COUNT];
+      const mat4*      InverseBindPoses[SOA_POSE_LANE_COUNT];
+      const mat4*      Parents[SOA_POSE_LANE_COUNT];
+      for(int k = 0; k < LaneCount; k++)
+      {
+        const bool IsBone   = (k < BoneCount);
+        BoneTransforms[k]   = IsBone ? &Transforms[Bones[k]] : &s_ZeroTransform;
+        BindPoses[k]        = IsBone ? &Skeleton->BindPoses[Bones[k]] : &s_ZeroMatrix;
+        InverseBindPoses[k] = IsBone ? &Skeleton->InverseBindPoses[Bones[k]] : &s_ZeroMatrix;
+        // Only the roots are on level 0
+        Parents[k] = (IsBone && 0 < l) ? &FinalPoseMatrices[Skeleton->ParentIndices[Bones[k]]]
+                                       : &s_ZeroMatrix;
+      }
+
+      __m256 BoneSpace[16];
+      __m256 Matrix[16];
+      __m256 Temp[16];
+      __m256 ModelSpace[16];
+      LoadBoneSpaceMatrixLanes(BoneSpace, BoneTransforms);
+      LoadMat4Lanes(Matrix, InverseBindPoses);
+      MulMat4Lanes(Temp, BoneSpace, Matrix);
+      LoadMat4Lanes(Matrix, BindPoses);
+      MulMat4Lanes(ModelSpace, Matrix, Temp);
+      __m256* Final = ModelSpace;
+      if(0 < l)
+      {
+        LoadMat4Lanes(Matrix, Parents);
+        MulMat4Lanes(Temp, Matrix, ModelSpace);
+        Final = Temp;
+      }
+      Transpose8x8(&Final[0]);
+      Transpose8x8(&Final[8]);
+
+      for(int k = 0; k < BoneCount; k++)
+      {
+        const int32_t i = Bones[k];
+        if(Skeleton->BoneLODs[i] < LOD)
+        {
+          // Roots are always evaluated
+          FinalPoseMatrices[i] = FinalPoseMatrices[Skeleton->ParentIndices[i]];
+        }
+        else
+        {
+          _mm256_storeu_ps(&FinalPoseMatrices[i].e[0], Final[k]);
+          _mm256_storeu_ps(&FinalPoseMatrices[i].e[8], Final[8 + k]);
+        }
+        if(SkinningMatrices)
+        {
+          PackSkinningMatrix(&SkinningMatrices[i], FinalPoseMatrices[i]);
+        }
+      }
+    }
+  }
+#else
+  for(int l = 0; l < Skeleton->LevelCount; l++)
+  {
+    for(int j = Skeleton->LevelStarts[l]; j < Skeleton->LevelStarts[l + 1]; j++)
+    {
+      const int32_t i      = Skeleton->LevelOrder[j];
+      const int32_t Parent = Skeleton->ParentIndices[i];
+      if(Skeleton->BoneLODs[i] < LOD)
+      {
+        // Roots are always evaluated
+        FinalPoseMatrices[i] = FinalPoseMatrices[Parent];
+      }
+      else
+      {
+        // Translate(T) * Rotate(R) without the multiplication
+        mat4 BoneSpaceMatrix = Math::Mat4Rotate(Transforms[i].R);
+        BoneSpaceMatrix.T    = Transforms[i].T;
+
+        mat4 ModelSpaceMatrix =
+          MulMat4Columns(Skeleton->BindPoses[i],
+                         MulMat4Columns(BoneSpaceMatrix, Skeleton->InverseBindPoses[i]));
+        FinalPoseMatrices[i] = (Parent < 0)
+                                 ? ModelSpaceMatrix
+                                 : MulMat4Columns(FinalPoseMatrices[Parent], ModelSpaceMatrix);
+      }
+      if(SkinningMatrices)
+      {
+        PackSkinningMatrix(&SkinningMatrices[i], FinalPoseMatrices[i]);
+      }
+    }
+  }
+#endif
+}
+
 /*
 void
 Anim::InverseComputeFinalHierarchicalPoses(mat4* ModelSpaceMatrices, const mat4* FinalPoseMatrices,
@@ -480,8 +1233,9 @@ Anim::PreviewBlendFunc(animation_player* AnimPlayer, void* UserData)
 {
   float dt = *(float*)UserData;
   AnimPlayer->GlobalTimeSec += dt;
-  static skeleton*            LastUsedSkeleton = NULL;
-  static skeleton_mirror_info MirrorInfo       = {};
+  // Players can be updated on any job thread
+  static thread_local skeleton*            LastUsedSkeleton = NULL;
+  static thread_local skeleton_mirror_info MirrorInfo       = {};
   if(AnimPlayer->Skeleton != LastUsedSkeleton)
   {
     Anim::GenerateSkeletonMirroringInfo(&MirrorInfo, AnimPlayer->Skeleton);
@@ -11,6 +11,15 @@
 
 static const int ANIM_PLAYER_MAX_ANIM_COUNT     = 5;
 static const int ANIM_PLAYER_OUTPUT_BLOCK_COUNT = 3;
+// Keyframe pairs tried from the cursor before the sample time is searched for
+static const int ANIM_KEYFRAME_CURSOR_STEP_COUNT = 2;
+
+// Levels of detail of animation players, 0 evaluates every bone
+#define ANIM_LOD_COUNT 3
+
+#define SOA_POSE_LANE_COUNT 8
+#define SOA_POSE_MAX_BONE_COUNT                                                                    \
+  ((SKELETON_MAX_BONE_COUNT + SOA_POSE_LANE_COUNT - 1) / SOA_POSE_LANE_COUNT * SOA_POSE_LANE_COUNT)
 
 namespace Anim
 {
@@ -22,12 +31,39 @@ namespace Anim
     int32_t    ChannelCount;
   };
 
+  // Planar position and heading of the root under the hip (see GetRootAndInvRootMatrices) at a
+  // keyframe, root motion is sampled from these instead of from the hip transforms
+  struct root_motion_key
+  {
+    float X;
+    float Z;
+    float Yaw; // Of the root's forward around Y, unwrapped so that consecutive keys stay close
+  };
+
+  // Pose stored component by component so that the kernels process SOA_POSE_LANE_COUNT bones at
+  // once, lanes between the bone count and the next multiple of the lane count are padding
+  struct soa_pose
+  {
+    float RS[SOA_POSE_MAX_BONE_COUNT];
+    float RI[SOA_POSE_MAX_BONE_COUNT];
+    float RJ[SOA_POSE_MAX_BONE_COUNT];
+    float RK[SOA_POSE_MAX_BONE_COUNT];
+    float TX[SOA_POSE_MAX_BONE_COUNT];
+    float TY[SOA_POSE_MAX_BONE_COUNT];
+    float TZ[SOA_POSE_MAX_BONE_COUNT];
+    float SX[SOA_POSE_MAX_BONE_COUNT];
+    float SY[SOA_POSE_MAX_BONE_COUNT];
+    float SZ[SOA_POSE_MAX_BONE_COUNT];
+  };
+
   struct animation_state
   {
     float StartTimeSec;
     float PlaybackRateSec;
     bool  Loop;
     bool  Mirror;
+
+    int32_t KeyframeCursor; // Keyframe pair of the last sample, only a hint
   };
 
   // TODO(Lukas): Move this to the asset/serialization system
@@ -50,6 +86,41 @@ namespace Anim
     vec3       MirrorBasisScales;
   };
 
+  // Top three rows of an affine bone matrix. The skinning shaders read them as a mat3x4 whose
+  // columns are these rows and transform with vec4(P, 1) * Matrix
+  struct skinning_matrix
+  {
+    vec4 Rows[3];
+  };
+
+  // Skeleton rearranged for the palette passes when a player is created. The bones of a level only
+  // depend on the levels above them, so each level can be processed as one batch
+  struct flat_skeleton
+  {
+    int32_t BoneCount;
+    int32_t LevelCount;
+    int32_t LevelStarts[SKELETON_MAX_BONE_COUNT + 1]; // Into LevelOrder, one past the end last
+    int32_t LevelOrder[SKELETON_MAX_BONE_COUNT];      // Bone indices sorted by depth
+    int32_t ParentIndices[SKELETON_MAX_BONE_COUNT];
+    uint8_t Depths[SKELETON_MAX_BONE_COUNT];
+    uint8_t BoneLODs[SKELETON_MAX_BONE_COUNT]; // Highest LOD each bone is evaluated at
+    mat4    BindPoses[SKELETON_MAX_BONE_COUNT];
+    mat4    InverseBindPoses[SKELETON_MAX_BONE_COUNT];
+  };
+
+  // At LOD l bones whose subtree is less than l bones deep are left in their bind pose, the
+  // poses let the animation system update the player less often (see anim_system.h)
+  struct player_lod_state
+  {
+    int32_t LOD; // Needs the player's flat skeleton, ignored without one
+
+    transform* Poses; // The last two evaluated local poses, 2 * BoneCount, NULL disables rate LOD
+    int32_t    PoseCount;
+    int32_t    CurrentPoseIndex;
+    int32_t    FramesSinceEvaluation;
+    float      SkippedTime; // Passed to the next evaluation
+  };
+
   struct animation_player
   {
     skeleton*       Skeleton;
@@ -57,14 +128,19 @@ namespace Anim
     rid             AnimationIDs[ANIM_PLAYER_MAX_ANIM_COUNT];
     animation*      Animations[ANIM_PLAYER_MAX_ANIM_COUNT];
 
-    transform* OutputTransforms;
-    mat4*      BoneSpaceMatrices;
-    mat4*      ModelSpaceMatrices;
-    mat4*      HierarchicalModelSpaceMatrices;
+    transform*       OutputTransforms;
+    mat4*            BoneSpaceMatrices;  // Only used by players without a flat skeleton
+    mat4*            ModelSpaceMatrices; // Only used by players without a flat skeleton
+    mat4*            HierarchicalModelSpaceMatrices; // Also scratch for mirrored sampling
+    // Written by the palette pass, code that rewrites the final poses later has to repack them
+    skinning_matrix* SkinningMatrices;
     float      GlobalTimeSec;
     int32_t    AnimStateCount;
 
     void (*BlendFunc)(animation_player*, void* UserData);
+
+    const flat_skeleton* FlatSkeleton; // Optional, built from Skeleton
+    player_lod_state     LODState;
   };
 
   // Sampling / Blending
@@ -75,6 +151,9 @@ namespace Anim
   void UpdatePlayer(animation_player*, float dt,
                     void  BlendFunction(animation_player*, void* UserData) = NULL,
                     void* UserData                                             = NULL);
+  // Rebuilds the matrices and skinning matrices from the first output block, the last step of
+  // UpdatePlayer
+  void ComputePlayerPoses(animation_player*);
 
   // Animation controller interface
   void AppendAnimation(animation_player*, rid AnimationID);
@@ -91,16 +170,40 @@ namespace Anim
                            transform* Out);
   void      AddTransforms(const transform* InA, const transform* InB, int TransformCount, float T,
                           transform* Out);
+  // The optional cursor speeds up sequential sampling, it is read and updated by every call
   void      LinearAnimationSample(transform* OutputTransforms, const Anim::animation* Animation,
-                                  float Time);
+                                  float Time, int32_t* KeyframeCursor = NULL);
   void      LinearAnimationSample(animation_player*, int AnimAInd, float Time, int ResultIndex);
   void      LinearMirroredAnimationSample(transform* OutputTransforms, mat4* TempMatrices,
                                           const skeleton* Skeleton, const Anim::animation* Animation,
-                                          float Time, const Anim::skeleton_mirror_info* MirrorInfo);
+                                          float Time, const Anim::skeleton_mirror_info* MirrorInfo,
+                                          int32_t* KeyframeCursor = NULL);
   void      LinearMirroredAnimationSample(Anim::animation_player* Player, int AnimIndex,
                                           float Time, int ResultIndex,
                                           const skeleton_mirror_info* MirrorInfo);
-  transform LinearAnimationBoneSample(const Anim::animation* Animation, int BoneIndex, float Time);
+  // Swaps the left and right sides of the pose in place, TempMatrices holds BoneCount matrices
+  void      MirrorTransforms(transform* Transforms, mat4* TempMatrices, const skeleton* Skeleton,
+                             const skeleton_mirror_info* MirrorInfo);
+  // Writes Animation with every keyframe mirrored to OutAnimation, whose arrays have to hold as
+  // many keyframes. Sampling the result costs the same as sampling any other clip
+  void      BakeMirroredAnimation(animation* OutAnimation, mat4* TempMatrices,
+                                  const skeleton* Skeleton, const animation* Animation,
+                                  const skeleton_mirror_info* MirrorInfo);
+  transform LinearAnimationBoneSample(const Anim::animation* Animation, int BoneIndex, float Time,
+                                      int32_t* KeyframeCursor = NULL);
+
+  // Structure of arrays poses, the results match the transform versions above exactly
+  void TransformsToSoAPose(soa_pose* OutPose, const transform* Transforms, int32_t Count);
+  void SoAPoseToTransforms(transform* OutTransforms, const soa_pose* Pose, int32_t Count);
+  void LerpSoAPoses(soa_pose* OutPose, const soa_pose* A, const soa_pose* B, int32_t Count,
+                    float T);
+  void AddSoAPoses(soa_pose* OutPose, const soa_pose* A, const soa_pose* B, int32_t Count,
+                   float T);
+  void LinearAnimationSample(soa_pose* OutPose, const Anim::animation* Animation, float Time,
+                             int32_t* KeyframeCursor = NULL);
+  // Mirrored clips are sampled as transforms in the player's last output block
+  void SampleAtGlobalTime(soa_pose* OutPose, Anim::animation_player* Player, int AnimationIndex,
+                          const skeleton_mirror_info* MirrorInfo = NULL);
 
   // Matrix palette generation
   void ComputeBoneSpacePoses(mat4* BoneSpaceMatrices, const transform* Transforms, int32_t Count);
@@ -112,6 +215,16 @@ namespace Anim
                                     int Count);
   void InverseComputeModelSpacePoses(mat4* BoneSpaceMatrices, const mat4* ModelSpaceMatrices,
                                      const Anim::skeleton* Skeleton);
+  void ComputeBoneLODs(uint8_t* OutBoneLODs, const Anim::skeleton* Skeleton);
+  void ComputeSkinningMatrices(skinning_matrix* SkinningMatrices, const mat4* FinalPoseMatrices,
+                               int32_t Count);
+  void BuildFlatSkeleton(flat_skeleton* OutFlatSkeleton, const Anim::skeleton* Skeleton);
+  // All three passes above in one, bones with a BoneLOD under LOD copy their parent's matrix.
+  // With AVX each level's bones go through the passes SOA_POSE_LANE_COUNT at a time, one per
+  // lane. The optional SkinningMatrices receive the same palette packed for the renderer
+  void ComputeFinalHierarchicalPoses(mat4* FinalPoseMatrices, const transform* Transforms,
+                                     const flat_skeleton* Skeleton, int32_t LOD = 0,
+                                     skinning_matrix* SkinningMatrices = NULL);
 
   // Helper functions
   float GetLocalSampleTime(const Anim::animation* Animation, float SampleTime, float StartTime = 0,
@@ -121,6 +234,13 @@ namespace Anim
   float GetLocalSampleTime(const Anim::animation* Animation, const Anim::animation_state* AnimState,
                            float GlobalSampleTime);
   void  GetRootAndInvRootMatrices(mat4* OutRootMatrix, mat4* OutInvRoot, mat4 HipMatrix);
+  // Writes the key of each of Animation's keyframes to OutKeys
+  void      ComputeRootMotionKeys(root_motion_key* OutKeys, const skeleton* Skeleton,
+                                  const animation* Animation);
+  // Root motion from Time to Time + dt in the space of the root at Time, Keys belong to Animation.
+  // Equal to sampling the hip at both times up to the heading, which is interpolated linearly
+  transform SampleRootMotionDelta(const root_motion_key* Keys, const animation* Animation,
+                                  float Time, float dt, bool MirrorInX = false);
   float GetAnimDuration(const Anim::animation* Animation);
   void  GenerateSkeletonMirroringInfo(Anim::skeleton_mirror_info* OutMirrorInfo,
                                       const Anim::skeleton*       Skeleton);
@@ -0,0 +1,516 @@
+#include "anim_compression.h"
+#include "misc.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define SMALLEST_THREE_MAX_VALUE 0.70710678f
+#define SMALLEST_THREE_MAX_QUANTIZED 32767
+#define RANGE_MAX_QUANTIZED 65535
+
+// Track values are kept in the transform field matching the component
+static transform
+GetSourceValue(const Anim::animation* Animation, int Channel, int Component, int Keyframe)
+{
+  transform Value = Animation->Transforms[Keyframe * Animation->ChannelCount + Channel];
+  if(Component == Anim::TRACK_Rotation)
+  {
+    Math::Normalize(&Value.R);
+  }
+  return Value;
+}
+
+static float
+GetValueError(int Component, const transform& A, const transform& B)
+{
+  switch(Component)
+  {
+    case Anim::TRACK_Rotation:
+    {
+      // Angle of the rotation between the two, acosf of their dot product is too coarse near 1
+      vec3  RelativeV = A.R.S * B.R.V - B.R.S * A.R.V - Math::Cross(A.R.V, B.R.V);
+      float RelativeS = A.R.S * B.R.S + Math::Dot(A.R.V, B.R.V);
+      return 2.0f * atan2f(Math::Length(RelativeV), AbsFloat(RelativeS));
+    }
+    case Anim::TRACK_Translation:
+      return Math::Length(A.T - B.T);
+    case Anim::TRACK_Scale:
+      return Math::Length(A.S - B.S);
+  }
+  assert(0 && "Invalid track component");
+  return 0;
+}
+
+static float
+GetTolerance(int Component, const Anim::compression_settings& Settings)
+{
+  switch(Component)
+  {
+    case Anim::TRACK_Rotation:
+      return Settings.RotationTolerance;
+    case Anim::TRACK_Translation:
+      return Settings.TranslationTolerance;
+    case Anim::TRACK_Scale:
+      return Settings.ScaleTolerance;
+  }
+  assert(0 && "Invalid track component");
+  return 0;
+}
+
+static void
+LerpValues(transform* Out, int Component, const transform& A, const transform& B, float t)
+{
+  switch(Component)
+  {
+    case Anim::TRACK_Rotation:
+      Out->R = Math::QuatLerp(A.R, B.R, t);
+      break;
+    case Anim::TRACK_Translation:
+      Out->T = (1.0f - t) * A.T + t * B.T;
+      break;
+    case Anim::TRACK_Scale:
+      Out->S = (1.0f - t) * A.S + t * B.S;
+      break;
+  }
+}
+
+static uint16_t
+QuantizeFraction(float Fraction, int32_t MaxQuantized)
+{
+  return (uint16_t)(ClampFloat(0.0f, Fraction, 1.0f) * (float)MaxQuantized + 0.5f);
+}
+
+// 2 bits for the index of the dropped largest component, 15 bits for each of the others
+static void
+QuantizeRotation(uint16_t* OutKey, quat Q)
+{
+  float Components[4] = { Q.S, Q.i, Q.j, Q.k };
+
+  int Largest = 0;
+  for(int i = 1; i < 4; i++)
+  {
+    if(AbsFloat(Components[Largest]) < AbsFloat(Components[i]))
+    {
+      Largest = i;
+    }
+  }
+  // q and -q are the same rotation, so the dropped component can always be positive
+  float Sign = (Components[Largest] < 0.0f) ? -1.0f : 1.0f;
+
+  uint64_t Packed = (uint64_t)Largest;
+  for(int i = 0; i < 4; i++)
+  {
+    if(i != Largest)
+    {
+      float Fraction = 0.5f * (Sign * Components[i] / SMALLEST_THREE_MAX_VALUE + 1.0f);
+      Packed = (Packed << 15) | QuantizeFraction(Fraction, SMALLEST_THREE_MAX_QUANTIZED);
+    }
+  }
+  OutKey[0] = (uint16_t)(Packed >> 32);
+  OutKey[1] = (uint16_t)(Packed >> 16);
+  OutKey[2] = (uint16_t)Packed;
+}
+
+static quat
+DequantizeRotation(const uint16_t* Key)
+{
+  uint64_t Packed = ((uint64_t)Key[0] << 32) | ((uint64_t)Key[1] << 16) | (uint64_t)Key[2];
+
+  const int Largest       = (int)((Packed >> 45) & 3);
+  float     Components[4] = {};
+  float     SquaredSum    = 0.0f;
+  for(int i = 3; 0 <= i; i--)
+  {
+    if(i != Largest)
+    {
+      float Fraction = (float)(Packed & SMALLEST_THREE_MAX_QUANTIZED) /
+                       (float)SMALLEST_THREE_MAX_QUANTIZED;
+      Components[i] = (2.0f * Fraction - 1.0f) * SMALLEST_THREE_MAX_VALUE;
+      SquaredSum += Components[i] * Components[i];
+      Packed >>= 15;
+    }
+  }
+  Components[Largest] = sqrtf(MaxFloat(0.0f, 1.0f - SquaredSum));
+
+  quat Result;
+  Result.S = Components[0];
+  Result.V = { Components[1], Components[2], Components[3] };
+  return Result;
+}
+
+static void
+QuantizeRangeValue(uint16_t* OutKey, vec3 Value, const Anim::compressed_track& Track)
+{
+  for(int i = 0; i < 3; i++)
+  {
+    float Fraction = (0.0f < Track.RangeExtent.e[i])
+                       ? (Value.e[i] - Track.RangeMin.e[i]) / Track.RangeExtent.e[i]
+                       : 0.0f;
+    OutKey[i] = QuantizeFraction(Fraction, RANGE_MAX_QUANTIZED);
+  }
+}
+
+static vec3
+DequantizeRangeValue(const uint16_t* Key, const Anim::compressed_track& Track)
+{
+  vec3 Result;
+  for(int i = 0; i < 3; i++)
+  {
+    Result.e[i] = Track.RangeMin.e[i] +
+                  Track.RangeExtent.e[i] * ((float)Key[i] / (float)RANGE_MAX_QUANTIZED);
+  }
+  return Result;
+}
+
+static void
+QuantizeKey(uint16_t* OutKey, int Component, const Anim::compressed_track& Track,
+            const transform& Value)
+{
+  switch(Component)
+  {
+    case Anim::TRACK_Rotation:
+      QuantizeRotation(OutKey, Value.R);
+      break;
+    case Anim::TRACK_Translation:
+      QuantizeRangeValue(OutKey, Value.T, Track);
+      break;
+    case Anim::TRACK_Scale:
+      QuantizeRangeValue(OutKey, Value.S, Track);
+      break;
+  }
+}
+
+static void
+DequantizeKey(transform* Out, int Component, const Anim::compressed_track& Track,
+              const uint16_t* Key)
+{
+  switch(Component)
+  {
+    case Anim::TRACK_Rotation:
+      Out->R = DequantizeRotation(Key);
+      break;
+    case Anim::TRACK_Translation:
+      Out->T = DequantizeRangeValue(Key, Track);
+      break;
+    case Anim::TRACK_Scale:
+      Out->S = DequantizeRangeValue(Key, Track);
+      break;
+  }
+}
+
+static void
+SetConstantValue(transform* Out, int Component, const Anim::compressed_track& Track)
+{
+  switch(Component)
+  {
+    case Anim::TRACK_Rotation:
+      Out->R = Track.ConstantRotation;
+      break;
+    case Anim::TRACK_Translation:
+      Out->T = Track.ConstantValue;
+      break;
+    case Anim::TRACK_Scale:
+      Out->S = Track.ConstantValue;
+      break;
+  }
+}
+
+// Makes the track constant when no keyframe strays further than Tolerance from the first one,
+// otherwise sets the quantization range
+static void
+InitTrack(Anim::compressed_track* OutTrack, const Anim::animation* Animation, int Channel,
+          int Component, float Tolerance)
+{
+  *OutTrack = {};
+
+  const transform FirstValue = GetSourceValue(Animation, Channel, Component, 0);
+
+  bool IsConstant = true;
+  vec3 Min        = (Component == Anim::TRACK_Scale) ? FirstValue.S : FirstValue.T;
+  vec3 Max        = Min;
+  for(int k = 1; k < Animation->KeyframeCount; k++)
+  {
+    const transform Value = GetSourceValue(Animation, Channel, Component, k);
+    if(Tolerance < GetValueError(Component, FirstValue, Value))
+    {
+      IsConstant = false;
+    }
+
+    const vec3 RangeValue = (Component == Anim::TRACK_Scale) ? Value.S : Value.T;
+    for(int i = 0; i < 3; i++)
+    {
+      Min.e[i] = MinFloat(Min.e[i], RangeValue.e[i]);
+      Max.e[i] = MaxFloat(Max.e[i], RangeValue.e[i]);
+    }
+  }
+
+  if(IsConstant)
+  {
+    if(Component == Anim::TRACK_Rotation)
+    {
+      OutTrack->ConstantRotation = FirstValue.R;
+    }
+    else
+    {
+      OutTrack->ConstantValue = (Component == Anim::TRACK_Scale) ? FirstValue.S : FirstValue.T;
+    }
+  }
+  else
+  {
+    // Marks the track as animated until the keys are counted
+    OutTrack->KeyCount = -1;
+    if(Component != Anim::TRACK_Rotation)
+    {
+      OutTrack->RangeMin    = Min;
+      OutTrack->RangeExtent = Max - Min;
+    }
+  }
+}
+
+static transform
+GetQuantizedSourceValue(const Anim::animation* Animation, int Channel, int Component,
+                        const Anim::compressed_track& Track, int Keyframe)
+{
+  uint16_t  Key[3];
+  transform Result = {};
+  QuantizeKey(Key, Component, Track, GetSourceValue(Animation, Channel, Component, Keyframe));
+  DequantizeKey(&Result, Component, Track, Key);
+  return Result;
+}
+
+// Checks the keyframes strictly between Start and End against the interpolation of the two
+// quantized keys, so the tolerance also covers the quantization error
+static bool
+IsSegmentWithinTolerance(const Anim::animation* Animation, int Channel, int Component,
+                         const Anim::compressed_track& Track, float Tolerance, int Start,
+                         int End)
+{
+  const transform StartValue =
+    GetQuantizedSourceValue(Animation, Channel, Component, Track, Start);
+  const transform EndValue = GetQuantizedSourceValue(Animation, Channel, Component, Track, End);
+
+  const float* SampleTimes = Animation->SampleTimes;
+  for(int k = Start + 1; k < End; k++)
+  {
+    float t = (SampleTimes[k] - SampleTimes[Start]) / (SampleTimes[End] - SampleTimes[Start]);
+
+    transform Interpolated = {};
+    LerpValues(&Interpolated, Component, StartValue, EndValue, t);
+    if(Tolerance < GetValueError(Component, Interpolated,
+                                 GetSourceValue(Animation, Channel, Component, k)))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Greedily extends each segment for as long as it stays within the tolerance. Returns the key
+// count, writing the kept keyframe indices when OutKeyframeIndices is not NULL
+static int32_t
+FindTrackKeys(uint16_t* OutKeyframeIndices, const Anim::animation* Animation, int Channel,
+              int Component, const Anim::compressed_track& Track,
+              const Anim::compression_settings& Settings)
+{
+  const int32_t KeyframeCount = Animation->KeyframeCount;
+  const float   Tolerance     = GetTolerance(Component, Settings);
+
+  int32_t KeyCount = 0;
+  if(OutKeyframeIndices)
+  {
+    OutKeyframeIndices[KeyCount] = 0;
+  }
+  KeyCount++;
+
+  int32_t Start = 0;
+  while(Start < KeyframeCount - 1)
+  {
+    int32_t End = Start + 1;
+    if(Settings.ReduceKeys)
+    {
+      while(End + 1 < KeyframeCount && End + 1 - Start <= COMPRESSED_ANIMATION_MAX_KEY_GAP &&
+            IsSegmentWithinTolerance(Animation, Channel, Component, Track, Tolerance, Start,
+                                     End + 1))
+      {
+        End++;
+      }
+    }
+    if(OutKeyframeIndices)
+    {
+      OutKeyframeIndices[KeyCount] = (uint16_t)End;
+    }
+    KeyCount++;
+    Start = End;
+  }
+  return KeyCount;
+}
+
+int32_t
+Anim::GetMaxCompressedAnimationSize(const animation* Animation)
+{
+  const int32_t TrackCount  = Animation->ChannelCount * TRACK_ComponentCount;
+  const int32_t MaxKeyCount = TrackCount * Animation->KeyframeCount;
+  return sizeof(compressed_animation) + Animation->KeyframeCount * sizeof(float) +
+         TrackCount * sizeof(compressed_track) + MaxKeyCount * 4 * sizeof(uint16_t);
+}
+
+Anim::compressed_animation*
+Anim::CompressAnimation(Memory::stack_allocator* Alloc, const animation* Animation,
+                        const compression_settings& Settings)
+{
+  assert(Alloc && Animation);
+  assert(0 < Animation->KeyframeCount);
+  if(UINT16_MAX + 1 < Animation->KeyframeCount)
+  {
+    printf("error: cannot compress animation with %d keyframes, the limit is %d\n",
+           Animation->KeyframeCount, UINT16_MAX + 1);
+    return NULL;
+  }
+
+  const int32_t KeyframeCount = Animation->KeyframeCount;
+  const int32_t ChannelCount  = Animation->ChannelCount;
+  const int32_t TrackCount    = ChannelCount * TRACK_ComponentCount;
+
+  compressed_animation* Result = PushStruct(Alloc, compressed_animation);
+  Result->Checksum             = COMPRESSED_ANIMATION_CHECKSUM;
+  Result->KeyframeCount        = KeyframeCount;
+  Result->ChannelCount         = ChannelCount;
+
+  Result->SampleTimes = PushArray(Alloc, KeyframeCount, float);
+  memcpy(Result->SampleTimes, Animation->SampleTimes, KeyframeCount * sizeof(float));
+
+  // Count the keys first so that they can be pushed as single arrays. A single keyframe makes
+  // every track constant, so no keys are pushed at all
+  Result->Tracks        = PushArray(Alloc, TrackCount, compressed_track);
+  int32_t TotalKeyCount = 0;
+  for(int c = 0; c < ChannelCount; c++)
+  {
+    for(int Component = 0; Component < TRACK_ComponentCount; Component++)
+    {
+      compressed_track* Track = &Result->Tracks[c * TRACK_ComponentCount + Component];
+      InitTrack(Track, Animation, c, Component, GetTolerance(Component, Settings));
+      if(Track->KeyCount != 0)
+      {
+        Track->FirstKeyIndex = TotalKeyCount;
+        Track->KeyCount = FindTrackKeys(NULL, Animation, c, Component, *Track, Settings);
+        TotalKeyCount += Track->KeyCount;
+      }
+    }
+  }
+  Result->TotalKeyCount = TotalKeyCount;
+
+  Result->KeyframeIndices = PushArray(Alloc, TotalKeyCount, uint16_t);
+  Result->Keys            = PushArray(Alloc, 3 * TotalKeyCount, uint16_t);
+  for(int c = 0; c < ChannelCount; c++)
+  {
+    for(int Component = 0; Component < TRACK_ComponentCount; Component++)
+    {
+      const compressed_track& Track = Result->Tracks[c * TRACK_ComponentCount + Component];
+      if(Track.KeyCount == 0)
+      {
+        continue;
+      }
+      uint16_t* KeyframeIndices = &Result->KeyframeIndices[Track.FirstKeyIndex];
+      FindTrackKeys(KeyframeIndices, Animation, c, Component, Track, Settings);
+      for(int i = 0; i < Track.KeyCount; i++)
+      {
+        QuantizeKey(&Result->Keys[3 * (Track.FirstKeyIndex + i)], Component, Track,
+                    GetSourceValue(Animation, c, Component, KeyframeIndices[i]));
+      }
+    }
+  }
+
+  return Result;
+}
+
+// Interpolates the two keys around Time, picking the same keyframes as LinearAnimationSample
+// when no keys were dropped
+static void
+DecodeTrack(transform* Out, int Component, const Anim::compressed_animation* Animation,
+            const Anim::compressed_track& Track, float Time)
+{
+  if(Track.KeyCount == 0)
+  {
+    SetConstantValue(Out, Component, Track);
+    return;
+  }
+
+  const float*    SampleTimes     = Animation->SampleTimes;
+  const uint16_t* KeyframeIndices = &Animation->KeyframeIndices[Track.FirstKeyIndex];
+
+  // First key at or after Time, but never the first one
+  int32_t Low  = 1;
+  int32_t High = Track.KeyCount - 1;
+  while(Low < High)
+  {
+    int32_t Middle = (Low + High) / 2;
+    if(Time <= SampleTimes[KeyframeIndices[Middle]])
+    {
+      High = Middle;
+    }
+    else
+    {
+      Low = Middle + 1;
+    }
+  }
+
+  const float StartTime = SampleTimes[KeyframeIndices[Low - 1]];
+  const float EndTime   = SampleTimes[KeyframeIndices[Low]];
+  const float t         = (Time - StartTime) / (EndTime - StartTime);
+
+  transform StartValue;
+  transform EndValue;
+  const uint16_t* Keys = &Animation->Keys[3 * Track.FirstKeyIndex];
+  DequantizeKey(&StartValue, Component, Track, &Keys[3 * (Low - 1)]);
+  DequantizeKey(&EndValue, Component, Track, &Keys[3 * Low]);
+  LerpValues(Out, Component, StartValue, EndValue, t);
+}
+
+void
+Anim::CompressedAnimationSample(transform* OutputTransforms,
+                                const compressed_animation* Animation, float Time)
+{
+  assert(OutputTransforms && Animation);
+  Time = ClampFloat(Animation->SampleTimes[0], Time,
+                    Animation->SampleTimes[Animation->KeyframeCount - 1]);
+
+  const compressed_track* Tracks = Animation->Tracks;
+  for(int c = 0; c < Animation->ChannelCount; c++)
+  {
+    for(int Component = 0; Component < TRACK_ComponentCount; Component++)
+    {
+      DecodeTrack(&OutputTransforms[c], Component, Animation,
+                  Tracks[c * TRACK_ComponentCount + Component], Time);
+    }
+  }
+}
+
+transform
+Anim::CompressedAnimationBoneSample(const compressed_animation* Animation, int BoneIndex,
+                                    float Time)
+{
+  assert(Animation);
+  assert(0 <= BoneIndex && BoneIndex < Animation->ChannelCount);
+  Time = ClampFloat(Animation->SampleTimes[0], Time,
+                    Animation->SampleTimes[Animation->KeyframeCount - 1]);
+
+  transform Result;
+  for(int Component = 0; Component < TRACK_ComponentCount; Component++)
+  {
+    DecodeTrack(&Result, Component, Animation,
+                Animation->Tracks[BoneIndex * TRACK_ComponentCount + Component], Time);
+  }
+  return Result;
+}
+
+void
+Anim::DecompressAnimation(transform* OutTransforms, const compressed_animation* Animation)
+{
+  for(int k = 0; k < Animation->KeyframeCount; k++)
+  {
+    CompressedAnimationSample(&OutTransforms[k * Animation->ChannelCount], Animation,
+                              Animation->SampleTimes[k]);
+  }
+}
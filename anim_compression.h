@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "anim.h"
+#include "stack_alloc.h"
+
+// First field of a compressed clip, raw .anim files start with the group's array offset instead
+#define COMPRESSED_ANIMATION_CHECKSUM 654321
+// Kept keys of a reduced track are at most this many keyframes apart
+#define COMPRESSED_ANIMATION_MAX_KEY_GAP 128
+
+namespace Anim
+{
+  enum compressed_track_component
+  {
+    TRACK_Rotation,
+    TRACK_Translation,
+    TRACK_Scale,
+    TRACK_ComponentCount,
+  };
+
+  // Tracks varying less than the tolerance become constant. With ReduceKeys the keys that linear
+  // interpolation of the kept ones reproduces within the tolerance are dropped, the tolerance
+  // holds at the source keyframes and includes the quantization error
+  struct compression_settings
+  {
+    float RotationTolerance; // Radians
+    float TranslationTolerance;
+    float ScaleTolerance;
+    bool  ReduceKeys;
+  };
+
+  // Constant tracks store their value, animated ones store 3 uint16_t per key: smallest three
+  // quaternion components for rotations, fractions of [RangeMin, RangeMin + RangeExtent] otherwise
+  struct compressed_track
+  {
+    int32_t KeyCount; // 0 for constant tracks
+    int32_t FirstKeyIndex;
+    union {
+      struct
+      {
+        vec3 RangeMin;
+        vec3 RangeExtent;
+      };
+      quat ConstantRotation;
+      vec3 ConstantValue;
+    };
+  };
+
+  struct compressed_animation
+  {
+    int32_t Checksum;
+    int32_t KeyframeCount;
+    int32_t ChannelCount;
+    int32_t TotalKeyCount;
+
+    float*            SampleTimes; // Of every source keyframe
+    compressed_track* Tracks;      // TRACK_ComponentCount per channel
+    uint16_t*         KeyframeIndices; // Source keyframe of each stored key
+    uint16_t*         Keys;
+  };
+
+  inline compression_settings
+  GetDefaultCompressionSettings()
+  {
+    compression_settings Result = {};
+    Result.RotationTolerance    = 0.001f;
+    Result.TranslationTolerance = 0.0005f;
+    Result.ScaleTolerance       = 0.0001f;
+    Result.ReduceKeys           = true;
+    return Result;
+  }
+
+  // Bytes CompressAnimation pushes when no track is constant and no key is dropped. Constant
+  // tracks still cost a header, so small clips can end up larger than their raw keyframes
+  int32_t GetMaxCompressedAnimationSize(const animation* Animation);
+  // Pushes the whole clip onto Alloc, returns NULL if it has more than UINT16_MAX + 1 keyframes
+  // to be indexed. The caller should keep such clips raw
+  compressed_animation* CompressAnimation(Memory::stack_allocator* Alloc,
+                                          const animation* Animation,
+                                          const compression_settings& Settings);
+
+  // Decode straight into the pose, same time handling as LinearAnimationSample
+  void      CompressedAnimationSample(transform* OutputTransforms,
+                                      const compressed_animation* Animation, float Time);
+  transform CompressedAnimationBoneSample(const compressed_animation* Animation, int BoneIndex,
+                                          float Time);
+  // Writes KeyframeCount * ChannelCount transforms in the layout of animation::Transforms
+  void DecompressAnimation(transform* OutTransforms, const compressed_animation* Animation);
+}
@@ -0,0 +1,243 @@
+#include "anim_system.h"
+#include "job_system.h"
+#include "common.h"
+#include "misc.h"
+
+#include <assert.h>
+#include <string.h>
+
+// Only written by the job thread with the same index
+struct anim_thread_counters
+{
+  int32_t EvaluatedPlayerCount;
+  int32_t InterpolatedPlayerCount;
+  int32_t EvaluatedBoneCount;
+  int32_t SkippedBoneCount;
+  int32_t FullDetailBoneCount;
+  int64_t EvaluationCounter;
+  int64_t FullDetailEvaluationCounter;
+  int64_t InterpolationCounter;
+  uint8_t CacheLinePadding[64]; // Keeps threads from sharing a line
+};
+
+struct anim_player_batch
+{
+  const anim_player_update* Updates;
+  int32_t                   FirstIndex;
+  int32_t                   Count;
+  float                     dt;
+  anim_thread_counters*     ThreadCounters;
+};
+
+int32_t
+SelectAnimLOD(const anim_lod_settings& Settings, int32_t CurrentLOD, float CameraDistance)
+{
+  if(!Settings.Enabled)
+  {
+    return 0;
+  }
+  int32_t LOD = 0;
+  for(int l = 1; l < ANIM_LOD_COUNT; l++)
+  {
+    float Distance = Settings.Distances[l - 1];
+    if(l <= CurrentLOD)
+    {
+      Distance *= 1.0f - ANIM_LOD_HYSTERESIS;
+    }
+    if(Distance <= CameraDistance)
+    {
+      LOD = l;
+    }
+  }
+  return LOD;
+}
+
+float
+GetAnimLODSavedMicroseconds(const anim_lod_counters& Counters)
+{
+  const int32_t BoneCount = Counters.EvaluatedBoneCount + Counters.SkippedBoneCount;
+  return Counters.FullDetailBoneMicroseconds * (float)BoneCount -
+         (Counters.EvaluationMicroseconds + Counters.InterpolationMicroseconds);
+}
+
+static int32_t
+GetEvaluatedBoneCount(const Anim::animation_player* Player)
+{
+  const Anim::flat_skeleton* FlatSkeleton = Player->FlatSkeleton;
+  const int32_t              LOD          = Player->LODState.LOD;
+  if(LOD == 0 || !FlatSkeleton)
+  {
+    return Player->Skeleton->BoneCount;
+  }
+  int32_t BoneCount = 0;
+  for(int i = 0; i < FlatSkeleton->BoneCount; i++)
+  {
+    if(LOD <= FlatSkeleton->BoneLODs[i])
+    {
+      BoneCount++;
+    }
+  }
+  return BoneCount;
+}
+
+static void
+EvaluatePlayer(anim_thread_counters* Counters, const anim_player_update& Update, float dt)
+{
+  Anim::animation_player* Player = Update.Player;
+  int64_t                 Start  = Platform::GetCurrentCounter();
+  Anim::UpdatePlayer(Player, dt + Player->LODState.SkippedTime, Player->BlendFunc,
+                     Update.BlendFuncUserData);
+  const int64_t Elapsed = Platform::GetCurrentCounter() - Start;
+  Counters->EvaluationCounter += Elapsed;
+
+  const int32_t BoneCount      = Player->Skeleton->BoneCount;
+  const int32_t EvaluatedCount = GetEvaluatedBoneCount(Player);
+  if(Player->LODState.LOD == 0)
+  {
+    Counters->FullDetailEvaluationCounter += Elapsed;
+    Counters->FullDetailBoneCount += BoneCount;
+  }
+  Counters->EvaluatedPlayerCount++;
+  Counters->EvaluatedBoneCount += EvaluatedCount;
+  Counters->SkippedBoneCount += BoneCount - EvaluatedCount;
+  Player->LODState.SkippedTime           = 0;
+  Player->LODState.FramesSinceEvaluation = 0;
+}
+
+static void
+UpdatePlayerAtRate(anim_thread_counters* Counters, const anim_player_update& Update, float dt,
+                   int32_t StaggerIndex)
+{
+  Anim::animation_player* Player   = Update.Player;
+  Anim::player_lod_state* LODState = &Player->LODState;
+  if(Update.UpdatePeriod <= 1 || !LODState->Poses)
+  {
+    EvaluatePlayer(Counters, Update, dt);
+    LODState->PoseCount = 0;
+    return;
+  }
+
+  const int32_t BoneCount = Player->Skeleton->BoneCount;
+  const size_t  PoseSize  = sizeof(transform) * BoneCount;
+  if(LODState->PoseCount == 0 || Update.UpdatePeriod <= LODState->FramesSinceEvaluation + 1)
+  {
+    EvaluatePlayer(Counters, Update, dt);
+
+    int64_t Start = Platform::GetCurrentCounter();
+    LODState->CurrentPoseIndex ^= 1;
+    memcpy(&LODState->Poses[LODState->CurrentPoseIndex * BoneCount], Player->OutputTransforms,
+           PoseSize);
+    if(LODState->PoseCount == 0)
+    {
+      memcpy(&LODState->Poses[(LODState->CurrentPoseIndex ^ 1) * BoneCount],
+             Player->OutputTransforms, PoseSize);
+      LODState->PoseCount = 2;
+      // Spread the players over the period so that their evaluations land on different frames,
+      // both poses are the same until the next evaluation
+      LODState->FramesSinceEvaluation = StaggerIndex % Update.UpdatePeriod;
+    }
+    Counters->InterpolationCounter += Platform::GetCurrentCounter() - Start;
+  }
+  else
+  {
+    LODState->FramesSinceEvaluation++;
+    LODState->SkippedTime += dt;
+    Counters->InterpolatedPlayerCount++;
+    Counters->SkippedBoneCount += BoneCount;
+  }
+
+  // Blending the local poses keeps the bone lengths and rotations intact where blending the
+  // matrices would shear them, the palette is rebuilt from the result
+  int64_t          Start = Platform::GetCurrentCounter();
+  const transform* Last  = &LODState->Poses[(LODState->CurrentPoseIndex ^ 1) * BoneCount];
+  const transform* Next  = &LODState->Poses[LODState->CurrentPoseIndex * BoneCount];
+  const float      t =
+    MinFloat(1.0f, (float)(LODState->FramesSinceEvaluation + 1) / (float)Update.UpdatePeriod);
+  Anim::LerpTransforms(Last, Next, BoneCount, t, Player->OutputTransforms);
+  Anim::ComputePlayerPoses(Player);
+  Counters->InterpolationCounter += Platform::GetCurrentCounter() - Start;
+}
+
+JOB_FUNCTION(UpdateAnimPlayerBatchJob)
+{
+  const anim_player_batch* Batch    = (const anim_player_batch*)Data;
+  anim_thread_counters*    Counters = &Batch->ThreadCounters[GetJobThreadIndex()];
+  for(int i = 0; i < Batch->Count; i++)
+  {
+    UpdatePlayerAtRate(Counters, Batch->Updates[i], Batch->dt, Batch->FirstIndex + i);
+  }
+}
+
+void
+UpdateAnimPlayers(Memory::stack_allocator* TempAlloc, anim_lod_counters* OutCounters,
+                  const anim_player_update* Updates, int32_t Count, float dt)
+{
+  assert(OutCounters);
+  assert(0 <= Count);
+  const float FullDetailBoneMicroseconds  = OutCounters->FullDetailBoneMicroseconds;
+  *OutCounters                            = {};
+  OutCounters->FullDetailBoneMicroseconds = FullDetailBoneMicroseconds;
+  if(Count == 0)
+  {
+    return;
+  }
+
+  const int32_t BatchCount =
+    (Count + ANIM_SYSTEM_BATCH_PLAYER_COUNT - 1) / ANIM_SYSTEM_BATCH_PLAYER_COUNT;
+  Memory::marker        StartMarker = TempAlloc->GetMarker();
+  anim_player_batch*    Batches     = PushArray(TempAlloc, BatchCount, anim_player_batch);
+  job*                  Jobs        = PushArray(TempAlloc, BatchCount, job);
+  anim_thread_counters* ThreadCounters =
+    PushArray(TempAlloc, GetJobThreadCount(), anim_thread_counters);
+  memset(ThreadCounters, 0, GetJobThreadCount() * sizeof(anim_thread_counters));
+  for(int b = 0; b < BatchCount; b++)
+  {
+    const int32_t FirstIndex  = b * ANIM_SYSTEM_BATCH_PLAYER_COUNT;
+    Batches[b].Updates        = &Updates[FirstIndex];
+    Batches[b].FirstIndex     = FirstIndex;
+    Batches[b].Count          = MinInt32(ANIM_SYSTEM_BATCH_PLAYER_COUNT, Count - FirstIndex);
+    Batches[b].dt             = dt;
+    Batches[b].ThreadCounters = ThreadCounters;
+    Jobs[b]                   = { UpdateAnimPlayerBatchJob, &Batches[b] };
+  }
+
+  job_counter Counter = {};
+  KickJobs(&Counter, Jobs, BatchCount);
+  WaitForCounter(&Counter);
+
+  int64_t EvaluationCounter           = 0;
+  int64_t FullDetailEvaluationCounter = 0;
+  int32_t FullDetailBoneCount         = 0;
+  int64_t InterpolationCounter        = 0;
+  for(int t = 0; t < GetJobThreadCount(); t++)
+  {
+    const anim_thread_counters& Thread = ThreadCounters[t];
+    OutCounters->EvaluatedPlayerCount += Thread.EvaluatedPlayerCount;
+    OutCounters->InterpolatedPlayerCount += Thread.InterpolatedPlayerCount;
+    OutCounters->EvaluatedBoneCount += Thread.EvaluatedBoneCount;
+    OutCounters->SkippedBoneCount += Thread.SkippedBoneCount;
+    EvaluationCounter += Thread.EvaluationCounter;
+    FullDetailEvaluationCounter += Thread.FullDetailEvaluationCounter;
+    FullDetailBoneCount += Thread.FullDetailBoneCount;
+    InterpolationCounter += Thread.InterpolationCounter;
+  }
+  if(0 < FullDetailBoneCount)
+  {
+    float BoneMicroseconds =
+      1e6f * Platform::GetTimeInSeconds(0, FullDetailEvaluationCounter) / FullDetailBoneCount;
+    OutCounters->FullDetailBoneMicroseconds =
+      (OutCounters->FullDetailBoneMicroseconds == 0)
+        ? BoneMicroseconds
+        : OutCounters->FullDetailBoneMicroseconds +
+            ANIM_LOD_COST_AVERAGE_WEIGHT *
+              (BoneMicroseconds - OutCounters->FullDetailBoneMicroseconds);
+  }
+  OutCounters->EvaluationMicroseconds    = 1e6f * Platform::GetTimeInSeconds(0, EvaluationCounter);
+  OutCounters->InterpolationMicroseconds =
+    1e6f * Platform::GetTimeInSeconds(0, InterpolationCounter);
+  for(int i = 0; i < Count; i++)
+  {
+    OutCounters->PlayerCounts[Updates[i].Player->LODState.LOD]++;
+  }
+  TempAlloc->FreeToMarker(StartMarker);
+}
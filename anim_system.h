@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "anim.h"
+#include "stack_alloc.h"
+
+// Players updated by one job, keeps the threads balanced when the players' costs differ
+#define ANIM_SYSTEM_BATCH_PLAYER_COUNT 4
+// Fraction of a LOD distance a player has to come closer by before it gets its detail back
+#define ANIM_LOD_HYSTERESIS 0.05f
+#define ANIM_LOD_COST_AVERAGE_WEIGHT 0.1f
+
+struct anim_lod_settings
+{
+  bool    Enabled;
+  float   Distances[ANIM_LOD_COUNT - 1]; // Camera distance at which LOD l + 1 starts
+  int32_t UpdatePeriods[ANIM_LOD_COUNT]; // In frames
+};
+
+struct anim_player_update
+{
+  Anim::animation_player* Player;
+  void*                   BlendFuncUserData; // Passed to the player's BlendFunc
+  // Frames between evaluations. In between the local poses of the last two evaluations are
+  // interpolated and the palette is rebuilt from them, so the displayed pose trails the evaluated
+  // one by up to a full period. Blend functions that advance the player's time on their own need
+  // a period of 1
+  int32_t UpdatePeriod;
+};
+
+// Of the last call to UpdateAnimPlayers
+struct anim_lod_counters
+{
+  int32_t PlayerCounts[ANIM_LOD_COUNT];
+  int32_t EvaluatedPlayerCount;
+  int32_t InterpolatedPlayerCount;
+  int32_t EvaluatedBoneCount;
+  int32_t SkippedBoneCount; // Masked by the LOD or not evaluated this frame
+  float   EvaluationMicroseconds;
+  float   InterpolationMicroseconds;
+  // Moving average over the frames with LOD 0 players, kept between calls
+  float FullDetailBoneMicroseconds;
+};
+
+inline anim_lod_settings
+GetDefaultAnimLODSettings()
+{
+  anim_lod_settings Result = {};
+  Result.Enabled           = true;
+  Result.Distances[0]      = 15.0f;
+  Result.Distances[1]      = 40.0f;
+  Result.UpdatePeriods[0]  = 1;
+  Result.UpdatePeriods[1]  = 2;
+  Result.UpdatePeriods[2]  = 4;
+  return Result;
+}
+
+int32_t SelectAnimLOD(const anim_lod_settings& Settings, int32_t CurrentLOD, float CameraDistance);
+
+// Cost all players would have had at LOD 0 less the cost they had
+float GetAnimLODSavedMicroseconds(const anim_lod_counters& Counters);
+
+// Calls Anim::UpdatePlayer with the player's BlendFunc for every entry on the job threads and
+// returns once all of them are done. A player only writes its own transforms and matrices, the
+// blend functions must not write anything else that is shared
+void UpdateAnimPlayers(Memory::stack_allocator* TempAlloc, anim_lod_counters* OutCounters,
+                       const anim_player_update* Updates, int32_t Count, float dt);
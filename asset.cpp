@@ -60,6 +60,66 @@ Asset::UnpackAnimation(Anim::animation* Animation)
   Animation->SampleTimes = (float*)((uint64_t)Animation->SampleTimes + Base);
 }
 
+void
+Asset::PackCompressedAnimation(Anim::compressed_animation* Animation)
+{
+  uint64_t Base              = (uint64_t)Animation;
+  Animation->SampleTimes     = (float*)((uint64_t)Animation->SampleTimes - Base);
+  Animation->Tracks          = (Anim::compressed_track*)((uint64_t)Animation->Tracks - Base);
+  Animation->KeyframeIndices = (uint16_t*)((uint64_t)Animation->KeyframeIndices - Base);
+  Animation->Keys            = (uint16_t*)((uint64_t)Animation->Keys - Base);
+}
+
+void
+Asset::UnpackCompressedAnimation(Anim::compressed_animation* Animation)
+{
+  uint64_t Base              = (uint64_t)Animation;
+  Animation->SampleTimes     = (float*)((uint64_t)Animation->SampleTimes + Base);
+  Animation->Tracks          = (Anim::compressed_track*)((uint64_t)Animation->Tracks + Base);
+  Animation->KeyframeIndices = (uint16_t*)((uint64_t)Animation->KeyframeIndices + Base);
+  Animation->Keys            = (uint16_t*)((uint64_t)Animation->Keys + Base);
+}
+
+bool
+Asset::IsCompressedAnimationFile(const void* Contents, uint32_t ContentsSize)
+{
+  return sizeof(Anim::compressed_animation) <= ContentsSize &&
+         ((const Anim::compressed_animation*)Contents)->Checksum == COMPRESSED_ANIMATION_CHECKSUM;
+}
+
+int32_t
+Asset::GetDecompressedAnimationGroupSize(const Anim::compressed_animation* Animation)
+{
+  int32_t KeyframeCount = Animation->KeyframeCount;
+  return (int32_t)(sizeof(Anim::animation_group) + sizeof(Anim::animation*) +
+                   sizeof(Anim::animation) +
+                   KeyframeCount * Animation->ChannelCount * sizeof(transform) +
+                   KeyframeCount * sizeof(float));
+}
+
+Anim::animation_group*
+Asset::DecompressAnimationGroup(void* Storage, const Anim::compressed_animation* Animation)
+{
+  Memory::stack_allocator Alloc = {};
+  Alloc.Create(Storage, GetDecompressedAnimationGroupSize(Animation));
+
+  Anim::animation_group* AnimGroup = PushStruct(&Alloc, Anim::animation_group);
+  AnimGroup->AnimationCount        = 1;
+  AnimGroup->Animations            = PushArray(&Alloc, 1, Anim::animation*);
+
+  Anim::animation* Result = PushStruct(&Alloc, Anim::animation);
+  AnimGroup->Animations[0] = Result;
+  Result->KeyframeCount    = Animation->KeyframeCount;
+  Result->ChannelCount     = Animation->ChannelCount;
+  Result->Transforms =
+    PushArray(&Alloc, Animation->KeyframeCount * Animation->ChannelCount, transform);
+  Result->SampleTimes = PushArray(&Alloc, Animation->KeyframeCount, float);
+
+  memcpy(Result->SampleTimes, Animation->SampleTimes, Animation->KeyframeCount * sizeof(float));
+  Anim::DecompressAnimation(Result->Transforms, Animation);
+  return AnimGroup;
+}
+
 void
 Asset::PackAnimationGroup(Anim::animation_group* AnimationGroup)
 {
@@ -90,16 +150,82 @@ void
 Asset::PackMMController(mm_controller_data* Controller)
 {
   uint64_t Base = (uint64_t)Controller;
-  Controller->FrameInfos.Elements =
-    (mm_frame_info*)(((uint64_t)Controller->FrameInfos.Elements) - Base);
+  Controller->Params.AnimRIDs.Elements =
+    (rid*)(((uint64_t)Controller->Params.AnimRIDs.Elements) - Base);
+  Controller->Params.AnimPaths.Elements =
+    (path*)(((uint64_t)Controller->Params.AnimPaths.Elements) - Base);
+  Controller->Animations.Elements =
+    (Anim::animation**)(((uint64_t)Controller->Animations.Elements) - Base);
+  Controller->AnimFrameInfoRanges.Elements =
+    (mm_frame_info_range*)(((uint64_t)Controller->AnimFrameInfoRanges.Elements) - Base);
+  for(int a = 0; a < Controller->MirroredAnimations.Count; a++)
+  {
+    PackAnimation(&Controller->MirroredAnimations[a]);
+  }
+  Controller->MirroredAnimations.Elements =
+    (Anim::animation*)(((uint64_t)Controller->MirroredAnimations.Elements) - Base);
+  for(int a = 0; a < Controller->RootMotionTracks.Count; a++)
+  {
+    Controller->RootMotionTracks[a].Elements =
+      (Anim::root_motion_key*)(((uint64_t)Controller->RootMotionTracks[a].Elements) - Base);
+  }
+  Controller->RootMotionTracks.Elements =
+    (array_handle<Anim::root_motion_key>*)(((uint64_t)Controller->RootMotionTracks.Elements) -
+                                           Base);
+  Controller->FeatureBlocks.Elements =
+    (float*)(((uint64_t)Controller->FeatureBlocks.Elements) - Base);
+  Controller->QuantizedBlocks.Elements =
+    (uint16_t*)(((uint64_t)Controller->QuantizedBlocks.Elements) - Base);
+  Controller->ExactFeatures.Elements =
+    (float*)(((uint64_t)Controller->ExactFeatures.Elements) - Base);
+  Controller->SearchNodes.Elements =
+    (mm_search_node*)(((uint64_t)Controller->SearchNodes.Elements) - Base);
+  Controller->SearchNodeBounds.Elements =
+    (float*)(((uint64_t)Controller->SearchNodeBounds.Elements) - Base);
 }
 
-void
+bool
 Asset::UnpackMMController(mm_controller_data* Controller)
 {
+  if(Controller->Version != MM_CONTROLLER_DATA_VERSION)
+  {
+    return false;
+  }
+
   uint64_t Base = (uint64_t)Controller;
-  Controller->FrameInfos.Elements =
-    (mm_frame_info*)(((uint64_t)Controller->FrameInfos.Elements) + Base);
+  Controller->Params.AnimRIDs.Elements =
+    (rid*)(((uint64_t)Controller->Params.AnimRIDs.Elements) + Base);
+  Controller->Params.AnimPaths.Elements =
+    (path*)(((uint64_t)Controller->Params.AnimPaths.Elements) + Base);
+  Controller->Animations.Elements =
+    (Anim::animation**)(((uint64_t)Controller->Animations.Elements) + Base);
+  Controller->AnimFrameInfoRanges.Elements =
+    (mm_frame_info_range*)(((uint64_t)Controller->AnimFrameInfoRanges.Elements) + Base);
+  Controller->MirroredAnimations.Elements =
+    (Anim::animation*)(((uint64_t)Controller->MirroredAnimations.Elements) + Base);
+  for(int a = 0; a < Controller->MirroredAnimations.Count; a++)
+  {
+    UnpackAnimation(&Controller->MirroredAnimations[a]);
+  }
+  Controller->RootMotionTracks.Elements =
+    (array_handle<Anim::root_motion_key>*)(((uint64_t)Controller->RootMotionTracks.Elements) +
+                                           Base);
+  for(int a = 0; a < Controller->RootMotionTracks.Count; a++)
+  {
+    Controller->RootMotionTracks[a].Elements =
+      (Anim::root_motion_key*)(((uint64_t)Controller->RootMotionTracks[a].Elements) + Base);
+  }
+  Controller->FeatureBlocks.Elements =
+    (float*)(((uint64_t)Controller->FeatureBlocks.Elements) + Base);
+  Controller->QuantizedBlocks.Elements =
+    (uint16_t*)(((uint64_t)Controller->QuantizedBlocks.Elements) + Base);
+  Controller->ExactFeatures.Elements =
+    (float*)(((uint64_t)Controller->ExactFeatures.Elements) + Base);
+  Controller->SearchNodes.Elements =
+    (mm_search_node*)(((uint64_t)Controller->SearchNodes.Elements) + Base);
+  Controller->SearchNodeBounds.Elements =
+    (float*)(((uint64_t)Controller->SearchNodeBounds.Elements) + Base);
+  return true;
 }
 
 void
@@ -148,22 +274,72 @@ Asset::ExportAnimationGroup(Memory::stack_allocator*               Alloc,
   Platform::WriteEntireFile(FileName, TotalSize, AnimGroup);
 }
 
+// The file holds the mm_params header followed by its animation paths
+// Start of a .template file, followed by the Params.AnimPaths.Count animation paths
+struct mm_params_file_header
+{
+  uint32_t  Magic;
+  uint32_t  Version;
+  mm_params Params;
+};
+
 void
-Asset::ExportMMParams(const mm_params* Params, const char* FileName)
+Asset::ExportMMParams(Memory::stack_allocator* Alloc, const mm_params* Params,
+                      const char* FileName)
 {
-  Platform::WriteEntireFile(FileName, sizeof(mm_params), Params);
+  Memory::marker Marker = Alloc->GetMarker();
+
+  mm_params_file_header* Header = PushStruct(Alloc, mm_params_file_header);
+  Header->Magic                 = MM_PARAMS_FILE_MAGIC;
+  Header->Version               = MM_PARAMS_FILE_VERSION;
+  Header->Params                = *Params;
+  // The animations are resolved from the paths when the file is imported
+  Header->Params.AnimRIDs.Elements  = NULL;
+  Header->Params.AnimRIDs.Count     = 0;
+  Header->Params.AnimPaths.Elements = NULL;
+  if(0 < Params->AnimPaths.Count)
+  {
+    path* Paths = PushArray(Alloc, Params->AnimPaths.Count, path);
+    memcpy(Paths, Params->AnimPaths.Elements, Params->AnimPaths.Count * sizeof(path));
+  }
+
+  int32_t TotalSize =
+    Memory::SafeTruncate_size_t_To_uint32_t(Alloc->GetByteCountAboveMarker(Marker));
+  Platform::WriteEntireFile(FileName, TotalSize, Header);
+
+  Alloc->FreeToMarker(Marker);
 }
 
-void
+bool
 Asset::ImportMMParams(Memory::stack_allocator* Alloc, mm_params* OutParams, const char* FileName)
 {
   Memory::marker MemoryStart = Alloc->GetMarker();
 
   debug_read_file_result ReadFile = Platform::ReadEntireFile(Alloc, FileName);
-  assert(ReadFile.Contents && ReadFile.ContentsSize == sizeof(mm_params));
-  memcpy(OutParams, ReadFile.Contents, sizeof(mm_params));
+  assert(ReadFile.Contents);
+
+  // Also rejects the bare mm_params written by older builds
+  const mm_params_file_header* Header = (const mm_params_file_header*)ReadFile.Contents;
+  bool IsValid = sizeof(mm_params_file_header) <= ReadFile.ContentsSize &&
+                 Header->Magic == MM_PARAMS_FILE_MAGIC && Header->Version == MM_PARAMS_FILE_VERSION;
+  if(IsValid)
+  {
+    mm_params FileParams = Header->Params;
+    IsValid = 0 <= FileParams.AnimPaths.Count &&
+              FileParams.AnimPaths.Count <= OutParams->AnimPaths.Capacity &&
+              ReadFile.ContentsSize ==
+                sizeof(mm_params_file_header) + FileParams.AnimPaths.Count * sizeof(path);
+    if(IsValid)
+    {
+      FileParams.AnimRIDs.Elements  = NULL;
+      FileParams.AnimRIDs.Count     = 0;
+      FileParams.AnimPaths.Elements = (path*)(Header + 1);
+      CopyMMParams(OutParams, FileParams);
+    }
+  }
 
   Alloc->FreeToMarker(MemoryStart);
+  return IsValid;
 }
 
 #if 0
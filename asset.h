@@ -5,6 +5,7 @@
 
 #include "model.h"
 #include "anim.h"
+#include "anim_compression.h"
 #include "edit_animation.h"
 #include "stack_alloc.h"
 #include "render_data.h"
@@ -23,6 +24,15 @@ namespace Asset
   void PackAnimationGroup(Anim::animation_group* AnimationGroup);
   void UnpackAnimationGroup(Anim::animation_group* AnimationGroup);
 
+  void PackCompressedAnimation(Anim::compressed_animation* Animation);
+  void UnpackCompressedAnimation(Anim::compressed_animation* Animation);
+  // Compressed .anim files hold a single compressed_animation instead of an animation_group
+  bool IsCompressedAnimationFile(const void* Contents, uint32_t ContentsSize);
+  // Bytes an animation_group holding the decompressed clip takes, laid out like a raw .anim
+  int32_t GetDecompressedAnimationGroupSize(const Anim::compressed_animation* Animation);
+  Anim::animation_group* DecompressAnimationGroup(void*                             Storage,
+                                                  const Anim::compressed_animation* Animation);
+
   void ExportAnimationGroup(Memory::stack_allocator*               Alloc,
                             const EditAnimation::animation_editor* AnimEditor,
                             const char*                            FileName);
@@ -30,8 +40,12 @@ namespace Asset
   // OutputAnimGroup,  const char* FileName);
 
   void PackMMController(mm_controller_data* Controller);
-  void UnpackMMController(mm_controller_data* Controller);
-
-  void ExportMMParams(const mm_params* Params, const char* FileName);
-  void ImportMMParams(Memory::stack_allocator* Alloc, mm_params* OutParams, const char* FileName);
+  // Returns false when the controller was exported with a different MM_CONTROLLER_DATA_VERSION
+  bool UnpackMMController(mm_controller_data* Controller);
+
+  void ExportMMParams(Memory::stack_allocator* Alloc, const mm_params* Params,
+                      const char* FileName);
+  // Returns false and leaves OutParams untouched when the file has no MM_PARAMS_FILE_MAGIC or a
+  // different MM_PARAMS_FILE_VERSION, e.g. the bare mm_params written by older builds
+  bool ImportMMParams(Memory::stack_allocator* Alloc, mm_params* OutParams, const char* FileName);
 }
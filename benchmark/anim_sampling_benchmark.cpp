@@ -0,0 +1,607 @@
+// Times the animation sampling, blending and pose passes on synthetic clips of growing bone and
+// keyframe counts, or on the built .anim files passed as arguments. Prints one CSV row per kernel
+// and clip with the time per call, per bone and the bone throughput, so runs can be diffed.
+// Before timing a clip the compiled blend graph is checked against a direct evaluation of the
+// same nodes, any mismatch makes the run fail.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "anim.h"
+#include "asset.h"
+#include "blend_graph.h"
+#include "file_io.h"
+
+// Every kernel is repeated until a run takes this long, the fastest of the runs is reported
+#define BENCHMARK_MIN_RUN_SECONDS 0.01f
+#define BENCHMARK_RUN_COUNT 5
+#define BENCHMARK_SAMPLE_RATE 30.0f
+#define BENCHMARK_BLEND_GRAPH_TOLERANCE 0.0001f
+
+float
+RandomFloat(float Min, float Max)
+{
+  return Min + (Max - Min) * (float(rand()) / float(RAND_MAX));
+}
+
+vec3
+RandomVec3(float Range)
+{
+  return { RandomFloat(-Range, Range), RandomFloat(-Range, Range), RandomFloat(-Range, Range) };
+}
+
+// Mocap-like data: every channel rotates smoothly around its own axis
+Anim::animation*
+CreateSyntheticAnimation(Memory::stack_allocator* Alloc, int32_t BoneCount,
+                         int32_t KeyframeCount)
+{
+  Anim::animation* Animation = PushStruct(Alloc, Anim::animation);
+  Animation->ChannelCount    = BoneCount;
+  Animation->KeyframeCount   = KeyframeCount;
+  Animation->SampleTimes     = PushArray(Alloc, KeyframeCount, float);
+  Animation->Transforms      = PushArray(Alloc, KeyframeCount * BoneCount, transform);
+
+  for(int k = 0; k < KeyframeCount; k++)
+  {
+    Animation->SampleTimes[k] = float(k) / BENCHMARK_SAMPLE_RATE;
+  }
+  for(int b = 0; b < BoneCount; b++)
+  {
+    vec3  Axis     = Math::Normalized(RandomVec3(1.0f) + vec3{ 0, 0, 0.1f });
+    vec3  Offset   = RandomVec3(0.2f);
+    float Phase    = RandomFloat(0, 6.28f);
+    float Velocity = RandomFloat(0.5f, 3.0f);
+    for(int k = 0; k < KeyframeCount; k++)
+    {
+      float      Angle     = 0.5f * sinf(Phase + Velocity * Animation->SampleTimes[k]);
+      transform* Transform = &Animation->Transforms[k * BoneCount + b];
+      Transform->R         = Math::QuatAxisAngle(Axis, Angle);
+      Transform->T         = Offset;
+      Transform->S         = { 1, 1, 1 };
+    }
+  }
+  return Animation;
+}
+
+// Limb chains hanging off the root, the first two chains are each other's mirrors
+void
+CreateSyntheticSkeleton(Anim::skeleton* OutSkeleton, Anim::skeleton_mirror_info* OutMirrorInfo,
+                        int32_t BoneCount)
+{
+  const int32_t ChainCount = 5;
+  assert(0 < BoneCount && BoneCount <= SKELETON_MAX_BONE_COUNT);
+
+  memset(OutSkeleton, 0, sizeof(Anim::skeleton));
+  OutSkeleton->BoneCount = BoneCount;
+  for(int i = 0; i < BoneCount; i++)
+  {
+    Anim::bone* Bone = &OutSkeleton->Bones[i];
+    snprintf(Bone->Name, sizeof(Bone->Name), "bone_%d", i);
+    Bone->ParentIndex = (i == 0) ? -1 : ((i <= ChainCount) ? 0 : i - ChainCount);
+
+    mat4 ParentBindPose =
+      (i == 0) ? Math::Mat4Ident() : OutSkeleton->Bones[Bone->ParentIndex].BindPose;
+    Bone->BindPose        = Math::MulMat4(ParentBindPose, Math::Mat4Translate(RandomVec3(0.2f)));
+    Bone->InverseBindPose = Math::InvMat4(Bone->BindPose);
+  }
+
+  memset(OutMirrorInfo, 0, sizeof(Anim::skeleton_mirror_info));
+  OutMirrorInfo->MirrorBasisScales = { -1, 1, 1 };
+  for(int i = 1; i + 1 < BoneCount; i += ChainCount)
+  {
+    OutMirrorInfo->BoneMirrorIndices[OutMirrorInfo->PairCount++] = { i, i + 1 };
+  }
+}
+
+struct benchmark_state
+{
+  Anim::skeleton             Skeleton;
+  Anim::flat_skeleton        FlatSkeleton;
+  Anim::skeleton_mirror_info MirrorInfo;
+  const Anim::animation*     Animation;
+  Anim::animation_player     Player;
+
+  transform* TransformsA;
+  transform* TransformsB;
+  transform* LerpedTransforms;
+  mat4*      BoneSpaceMatrices;
+  mat4*      ModelSpaceMatrices;
+  mat4*      FinalMatrices;
+
+  blend_graph          Graph;
+  blend_program        Program;
+  pose_pool            Pool;
+  blend_graph_instance GraphInstance;
+
+  float   Time;
+  float   Duration;
+  int32_t KeyframeCursor;
+};
+
+typedef void benchmark_func(benchmark_state* State);
+
+// Steps through the clip at the game's frame rate, so the keyframe cursors see real access patterns
+inline float
+AdvanceTime(benchmark_state* State)
+{
+  State->Time += 1.0f / 60.0f;
+  if(State->Duration < State->Time)
+  {
+    State->Time           = 0;
+    State->KeyframeCursor = 0;
+  }
+  return State->Time;
+}
+
+void
+Sample(benchmark_state* State)
+{
+  Anim::LinearAnimationSample(State->TransformsA, State->Animation, AdvanceTime(State),
+                              &State->KeyframeCursor);
+}
+
+void
+MirroredSample(benchmark_state* State)
+{
+  Anim::LinearMirroredAnimationSample(State->TransformsA, State->ModelSpaceMatrices,
+                                      &State->Skeleton, State->Animation, AdvanceTime(State),
+                                      &State->MirrorInfo, &State->KeyframeCursor);
+}
+
+void
+Lerp(benchmark_state* State)
+{
+  Anim::LerpTransforms(State->TransformsA, State->TransformsB, State->Skeleton.BoneCount, 0.3f,
+                       State->LerpedTransforms);
+}
+
+void
+BoneSpacePass(benchmark_state* State)
+{
+  Anim::ComputeBoneSpacePoses(State->BoneSpaceMatrices, State->TransformsA,
+                              State->Skeleton.BoneCount);
+}
+
+void
+ModelSpacePass(benchmark_state* State)
+{
+  Anim::ComputeModelSpacePoses(State->ModelSpaceMatrices, State->BoneSpaceMatrices,
+                               &State->Skeleton);
+}
+
+void
+FinalPass(benchmark_state* State)
+{
+  Anim::ComputeFinalHierarchicalPoses(State->FinalMatrices, State->ModelSpaceMatrices,
+                                      &State->Skeleton);
+}
+
+void
+FlatHierarchicalPass(benchmark_state* State)
+{
+  Anim::ComputeFinalHierarchicalPoses(State->FinalMatrices, State->TransformsA,
+                                      &State->FlatSkeleton);
+}
+
+void
+UpdatePlayer(benchmark_state* State)
+{
+  Anim::UpdatePlayer(&State->Player, 1.0f / 60.0f);
+}
+
+void
+BlendGraph(benchmark_state* State)
+{
+  EvaluateBlendGraph(State->LerpedTransforms, &State->GraphInstance, &State->Skeleton,
+                     AdvanceTime(State));
+}
+
+struct benchmark_kernel
+{
+  const char*     Name;
+  benchmark_func* Func;
+};
+
+const benchmark_kernel g_Kernels[] = {
+  { "sample", Sample },
+  { "mirrored_sample", MirroredSample },
+  { "lerp", Lerp },
+  { "bone_space_pass", BoneSpacePass },
+  { "model_space_pass", ModelSpacePass },
+  { "final_pass", FinalPass },
+  { "flat_hierarchical_pass", FlatHierarchicalPass },
+  { "update_player", UpdatePlayer },
+  { "blend_graph", BlendGraph },
+};
+
+// Every node type over clips of the same animation that start at different times:
+// blend space 2D of (blend space 1D of (clip, clip, mirror of (additive of (lerp, clip))), clip,
+// clip), with parameters 0 to 3 as the lerp t, the additive weight and the blend space position
+void
+BuildBenchmarkBlendGraph(blend_graph* OutGraph, const Anim::animation* Animation, float Duration)
+{
+  Anim::animation* Clip = (Anim::animation*)Animation;
+  memset(OutGraph, 0, sizeof(blend_graph));
+  int32_t LerpT          = AddBlendParameter(OutGraph);
+  int32_t AdditiveWeight = AddBlendParameter(OutGraph);
+  int32_t X              = AddBlendParameter(OutGraph);
+  int32_t Y              = AddBlendParameter(OutGraph);
+
+  int32_t Clips[6];
+  for(int i = 0; i < 6; i++)
+  {
+    Clips[i] = AddClipNode(OutGraph, Clip, true, -0.17f * (float)i * Duration,
+                           1.0f + 0.1f * (float)i);
+  }
+  int32_t Lerp     = AddLerpNode(OutGraph, Clips[0], Clips[1], LerpT);
+  int32_t Additive = AddAdditiveNode(OutGraph, Lerp, Clips[2], AdditiveWeight);
+  int32_t Mirror   = AddMirrorNode(OutGraph, Additive);
+
+  const int32_t Nodes1D[]     = { Clips[3], Clips[4], Mirror };
+  const float   Positions1D[] = { 0.0f, 1.0f, 2.0f };
+  int32_t       BlendSpace1D  = AddBlendSpace1DNode(OutGraph, X, Nodes1D, Positions1D, 3);
+
+  const int32_t Nodes2D[]     = { BlendSpace1D, Clips[5], Clips[0] };
+  const vec2    Positions2D[] = { { 0, 0 }, { 1, 0 }, { 0, 1 } };
+  AddBlendSpace2DNode(OutGraph, X, Y, Nodes2D, Positions2D, 3);
+}
+
+// The node's pose evaluated recursively on transforms with the blend functions the player uses,
+// independent of the compiled program's registers and skips
+void
+EvaluateReferenceNode(transform* OutTransforms, Memory::stack_allocator* Alloc,
+                      const benchmark_state* State, const float* Parameters, int32_t NodeIndex,
+                      float GlobalTime)
+{
+  const blend_node* Node      = &State->Graph.Nodes[NodeIndex];
+  const int32_t     BoneCount = State->Skeleton.BoneCount;
+  Memory::marker    Marker    = Alloc->GetMarker();
+  switch(Node->Type)
+  {
+    case BLEND_NODE_Clip:
+    {
+      const blend_clip* Clip = &State->Graph.Clips[Node->ClipIndex];
+      float LocalTime = Anim::GetLocalSampleTime(Clip->Animation, GlobalTime, Clip->GlobalStartTime,
+                                                 Clip->Loop, Clip->PlaybackRate);
+      Anim::LinearAnimationSample(OutTransforms, Clip->Animation, LocalTime);
+    }
+    break;
+    case BLEND_NODE_Lerp:
+    {
+      transform* B = PushArray(Alloc, BoneCount, transform);
+      EvaluateReferenceNode(OutTransforms, Alloc, State, Parameters, Node->Inputs[0], GlobalTime);
+      EvaluateReferenceNode(B, Alloc, State, Parameters, Node->Inputs[1], GlobalTime);
+      float t = ClampFloat(0.0f, Parameters[Node->ParameterIndices[0]], 1.0f);
+      Anim::LerpTransforms(OutTransforms, B, BoneCount, t, OutTransforms);
+    }
+    break;
+    case BLEND_NODE_Additive:
+    {
+      EvaluateReferenceNode(OutTransforms, Alloc, State, Parameters, Node->Inputs[0], GlobalTime);
+      float Weight = Parameters[Node->ParameterIndices[0]];
+      if(0 < Weight)
+      {
+        transform* Additive = PushArray(Alloc, BoneCount, transform);
+        EvaluateReferenceNode(Additive, Alloc, State, Parameters, Node->Inputs[1], GlobalTime);
+        Anim::AddTransforms(OutTransforms, Additive, BoneCount, Weight, OutTransforms);
+      }
+    }
+    break;
+    case BLEND_NODE_Mirror:
+    {
+      EvaluateReferenceNode(OutTransforms, Alloc, State, Parameters, Node->Inputs[0], GlobalTime);
+      mat4* TempMatrices = PushArray(Alloc, BoneCount, mat4);
+      Anim::MirrorTransforms(OutTransforms, TempMatrices, &State->Skeleton, &State->MirrorInfo);
+    }
+    break;
+    case BLEND_NODE_BlendSpace1D:
+    case BLEND_NODE_BlendSpace2D:
+    {
+      float Weights[BLEND_NODE_MAX_INPUT_COUNT] = {};
+      if(Node->Type == BLEND_NODE_BlendSpace1D)
+      {
+        float X = Parameters[Node->ParameterIndices[0]];
+        for(int i = 0; i + 1 < Node->InputCount; i++)
+        {
+          float Start = Node->Positions[i].X;
+          float End   = Node->Positions[i + 1].X;
+          if((i == 0 || Start < X) && (X <= End || i + 2 == Node->InputCount))
+          {
+            float t        = ClampFloat(0.0f, (X - Start) / (End - Start), 1.0f);
+            Weights[i]     = 1.0f - t;
+            Weights[i + 1] = t;
+            break;
+          }
+        }
+      }
+      else
+      {
+        // Inverse distance weights, only the sample itself counts on a sample
+        vec2 P = { Parameters[Node->ParameterIndices[0]], Parameters[Node->ParameterIndices[1]] };
+        for(int i = 0; i < Node->InputCount; i++)
+        {
+          vec2  Delta           = P - Node->Positions[i];
+          float DistanceSquared = Delta.X * Delta.X + Delta.Y * Delta.Y;
+          if(DistanceSquared < 0.000001f)
+          {
+            memset(Weights, 0, sizeof(Weights));
+            Weights[i] = 1.0f;
+            break;
+          }
+          Weights[i] = 1.0f / DistanceSquared;
+        }
+      }
+
+      // Each weighted input is lerped in by its share of the weights so far
+      transform* Input     = PushArray(Alloc, BoneCount, transform);
+      float      WeightSum = 0;
+      for(int i = 0; i < Node->InputCount; i++)
+      {
+        if(Weights[i] <= 0)
+        {
+          continue;
+        }
+        WeightSum += Weights[i];
+        EvaluateReferenceNode(Input, Alloc, State, Parameters, Node->Inputs[i], GlobalTime);
+        if(WeightSum == Weights[i])
+        {
+          memcpy(OutTransforms, Input, BoneCount * sizeof(transform));
+        }
+        else
+        {
+          Anim::LerpTransforms(OutTransforms, Input, BoneCount, Weights[i] / WeightSum,
+                               OutTransforms);
+        }
+      }
+    }
+    break;
+  }
+  Alloc->FreeToMarker(Marker);
+}
+
+inline bool
+AreTransformsClose(const transform& A, const transform& B, float Tolerance)
+{
+  // q and -q are the same rotation
+  float Sign = (Math::Dot(A.R.V, B.R.V) + A.R.S * B.R.S < 0) ? -1.0f : 1.0f;
+  float Differences[] = {
+    A.T.X - B.T.X,
+    A.T.Y - B.T.Y,
+    A.T.Z - B.T.Z,
+    A.R.V.X - Sign * B.R.V.X,
+    A.R.V.Y - Sign * B.R.V.Y,
+    A.R.V.Z - Sign * B.R.V.Z,
+    A.R.S - Sign * B.R.S,
+    A.S.X - B.S.X,
+    A.S.Y - B.S.Y,
+    A.S.Z - B.S.Z,
+  };
+  for(int i = 0; i < (int)(sizeof(Differences) / sizeof(Differences[0])); i++)
+  {
+    if(Tolerance < fabsf(Differences[i]))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Evaluates the compiled graph through a player at parameters that select, skip and mix every
+// node's inputs and compares it with the reference, returns the number of mismatching bones
+int32_t
+CheckBlendGraph(Memory::stack_allocator* Alloc, benchmark_state* State)
+{
+  const float Parameters[][4] = {
+    { 0.0f, 0.0f, 0.0f, 0.0f },   { 1.0f, 1.0f, 2.0f, 0.0f }, { 0.3f, 0.5f, 1.5f, 0.0f },
+    { 0.7f, 0.2f, 0.5f, 0.5f },   { 0.5f, 1.0f, 2.0f, 1.0f }, { 0.25f, 0.8f, 1.0f, 0.0f },
+    { -1.0f, 0.0f, -1.0f, 0.3f }, { 2.0f, 0.6f, 3.0f, 2.0f },
+  };
+  const float Times[] = { 0.0f, 0.37f, 0.8f * State->Duration, 2.3f * State->Duration };
+
+  Memory::marker          Marker    = Alloc->GetMarker();
+  const int32_t           BoneCount = State->Skeleton.BoneCount;
+  transform*              Expected  = PushArray(Alloc, BoneCount, transform);
+  Anim::animation_player* Player    = PushStruct(Alloc, Anim::animation_player);
+  *Player                           = State->Player;
+
+  int32_t MismatchCount = 0;
+  for(int p = 0; p < (int)(sizeof(Parameters) / sizeof(Parameters[0])); p++)
+  {
+    for(int t = 0; t < (int)(sizeof(Times) / sizeof(Times[0])); t++)
+    {
+      memcpy(State->GraphInstance.Parameters, Parameters[p], sizeof(Parameters[p]));
+      Player->GlobalTimeSec = Times[t];
+      Anim::UpdatePlayer(Player, 0, BlendGraphBlendFunc, &State->GraphInstance);
+
+      EvaluateReferenceNode(Expected, Alloc, State, Parameters[p], State->Graph.RootIndex,
+                            Times[t]);
+      for(int b = 0; b < BoneCount; b++)
+      {
+        if(!AreTransformsClose(Player->OutputTransforms[b], Expected[b],
+                               BENCHMARK_BLEND_GRAPH_TOLERANCE))
+        {
+          MismatchCount++;
+        }
+      }
+    }
+  }
+  Alloc->FreeToMarker(Marker);
+  return MismatchCount;
+}
+
+// Returns the fastest run's time per call in nanoseconds
+double
+TimeKernel(benchmark_func* Func, benchmark_state* State)
+{
+  int32_t IterationCount = 1;
+  for(;;)
+  {
+    int64_t Start = Platform::GetCurrentCounter();
+    for(int i = 0; i < IterationCount; i++)
+    {
+      Func(State);
+    }
+    int64_t End = Platform::GetCurrentCounter();
+    if(BENCHMARK_MIN_RUN_SECONDS <= Platform::GetTimeInSeconds(Start, End))
+    {
+      break;
+    }
+    IterationCount *= 2;
+  }
+
+  double BestNs = 0;
+  for(int r = 0; r < BENCHMARK_RUN_COUNT; r++)
+  {
+    int64_t Start = Platform::GetCurrentCounter();
+    for(int i = 0; i < IterationCount; i++)
+    {
+      Func(State);
+    }
+    int64_t End = Platform::GetCurrentCounter();
+    double  Ns  = 1e9 * double(Platform::GetTimeInSeconds(Start, End)) / double(IterationCount);
+    if(r == 0 || Ns < BestNs)
+    {
+      BestNs = Ns;
+    }
+  }
+  return BestNs;
+}
+
+// Returns false if the blend graph check failed, the clip is timed either way
+bool
+BenchmarkAnimation(Memory::stack_allocator* Alloc, const char* SourceName,
+                   const Anim::animation* Animation)
+{
+  Memory::marker   Marker    = Alloc->GetMarker();
+  const int32_t    BoneCount = Animation->ChannelCount;
+  benchmark_state* State     = PushStruct(Alloc, benchmark_state);
+  memset(State, 0, sizeof(benchmark_state));
+
+  CreateSyntheticSkeleton(&State->Skeleton, &State->MirrorInfo, BoneCount);
+  Anim::BuildFlatSkeleton(&State->FlatSkeleton, &State->Skeleton);
+  State->Animation          = Animation;
+  State->Duration           = Anim::GetAnimDuration(Animation);
+  State->TransformsA        = PushArray(Alloc, BoneCount, transform);
+  State->TransformsB        = PushArray(Alloc, BoneCount, transform);
+  State->LerpedTransforms   = PushArray(Alloc, BoneCount, transform);
+  State->BoneSpaceMatrices  = PushArray(Alloc, BoneCount, mat4);
+  State->ModelSpaceMatrices = PushArray(Alloc, BoneCount, mat4);
+  State->FinalMatrices      = PushArray(Alloc, BoneCount, mat4);
+  Anim::LinearAnimationSample(State->TransformsA, Animation, 0);
+  Anim::LinearAnimationSample(State->TransformsB, Animation, 0.5f * State->Duration);
+  Anim::ComputeBoneSpacePoses(State->BoneSpaceMatrices, State->TransformsA, BoneCount);
+  Anim::ComputeModelSpacePoses(State->ModelSpaceMatrices, State->BoneSpaceMatrices,
+                               &State->Skeleton);
+
+  // Plays the clip in a loop like an entity with a single animation
+  Anim::animation_player* Player         = &State->Player;
+  Player->Skeleton                       = &State->Skeleton;
+  Player->FlatSkeleton                   = &State->FlatSkeleton;
+  Player->Animations[0]                  = (Anim::animation*)Animation;
+  Player->AnimStateCount                 = 1;
+  Player->States[0].PlaybackRateSec      = 1.0f;
+  Player->States[0].Loop                 = true;
+  Player->OutputTransforms =
+    PushArray(Alloc, ANIM_PLAYER_OUTPUT_BLOCK_COUNT * BoneCount, transform);
+  Player->ModelSpaceMatrices             = PushArray(Alloc, BoneCount, mat4);
+  Player->HierarchicalModelSpaceMatrices = PushArray(Alloc, BoneCount, mat4);
+
+  BuildBenchmarkBlendGraph(&State->Graph, Animation, State->Duration);
+  bool Compiled = CompileBlendGraph(&State->Program, &State->Graph);
+  assert(Compiled);
+  InitPosePool(&State->Pool, Alloc, State->Program.PoseCount);
+  InitBlendGraphInstance(&State->GraphInstance, &State->Program, &State->Pool,
+                         &State->MirrorInfo);
+  int32_t MismatchCount = CheckBlendGraph(Alloc, State);
+  if(0 < MismatchCount)
+  {
+    fprintf(stderr, "%s: %d bones of the blend graph differ from the reference\n", SourceName,
+            MismatchCount);
+  }
+  State->GraphInstance.Parameters[0] = 0.3f;
+  State->GraphInstance.Parameters[1] = 0.5f;
+  State->GraphInstance.Parameters[2] = 1.5f;
+  State->GraphInstance.Parameters[3] = 0.2f;
+
+  for(int k = 0; k < (int)(sizeof(g_Kernels) / sizeof(g_Kernels[0])); k++)
+  {
+    State->Time           = 0;
+    State->KeyframeCursor = 0;
+    double Ns             = TimeKernel(g_Kernels[k].Func, State);
+    printf("%s,%s,%d,%d,%.1f,%.3f,%.0f\n", SourceName, g_Kernels[k].Name, BoneCount,
+           Animation->KeyframeCount, Ns, Ns / double(BoneCount), 1e9 * double(BoneCount) / Ns);
+  }
+  Alloc->FreeToMarker(Marker);
+  return MismatchCount == 0;
+}
+
+int
+main(int ArgCount, char** Args)
+{
+  const uint32_t MemorySize = Mibibytes(256);
+  void*          Memory     = malloc(MemorySize);
+
+  Memory::stack_allocator Alloc;
+  Alloc.Create(Memory, MemorySize);
+
+  Platform::InitPerformanceFrequency();
+  bool Passed = true;
+  printf("source,kernel,bone_count,keyframe_count,ns_per_call,ns_per_bone,bones_per_sec\n");
+  if(ArgCount <= 1)
+  {
+    const int32_t BoneCounts[]     = { 16, 32, 64, SKELETON_MAX_BONE_COUNT };
+    const int32_t KeyframeCounts[] = { 30, 300, 3000 };
+    for(int b = 0; b < (int)(sizeof(BoneCounts) / sizeof(BoneCounts[0])); b++)
+    {
+      for(int k = 0; k < (int)(sizeof(KeyframeCounts) / sizeof(KeyframeCounts[0])); k++)
+      {
+        Alloc.Clear();
+        srand(1234);
+        Anim::animation* Animation =
+          CreateSyntheticAnimation(&Alloc, BoneCounts[b], KeyframeCounts[k]);
+        Passed &= BenchmarkAnimation(&Alloc, "synthetic", Animation);
+      }
+    }
+  }
+
+  // Built clips, the raw and the compressed format are both loaded the way the engine loads them
+  for(int a = 1; a < ArgCount; a++)
+  {
+    Alloc.Clear();
+    srand(1234);
+    debug_read_file_result ReadResult = Platform::ReadEntireFile(&Alloc, Args[a]);
+    if(!ReadResult.Contents || ReadResult.ContentsSize == 0)
+    {
+      fprintf(stderr, "could not read %s\n", Args[a]);
+      continue;
+    }
+    Anim::animation_group* AnimationGroup;
+    if(Asset::IsCompressedAnimationFile(ReadResult.Contents, ReadResult.ContentsSize))
+    {
+      Anim::compressed_animation* CompressedAnimation =
+        (Anim::compressed_animation*)ReadResult.Contents;
+      Asset::UnpackCompressedAnimation(CompressedAnimation);
+      void* GroupMemory =
+        PushArray(&Alloc, Asset::GetDecompressedAnimationGroupSize(CompressedAnimation), uint8_t);
+      AnimationGroup = Asset::DecompressAnimationGroup(GroupMemory, CompressedAnimation);
+    }
+    else
+    {
+      AnimationGroup = (Anim::animation_group*)ReadResult.Contents;
+      Asset::UnpackAnimationGroup(AnimationGroup);
+    }
+
+    const Anim::animation* Animation = AnimationGroup->Animations[0];
+    if(SKELETON_MAX_BONE_COUNT < Animation->ChannelCount)
+    {
+      fprintf(stderr, "%s has more than %d channels\n", Args[a], SKELETON_MAX_BONE_COUNT);
+      continue;
+    }
+    Passed &= BenchmarkAnimation(&Alloc, Args[a], Animation);
+  }
+
+  free(Memory);
+  return Passed ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+// Compares the brute force motion matching search with the search tree accelerated one on
+// synthetic motion sets of growing size, both on one thread and split across the job system.
+// Prints one CSV row per motion set size, including the bytes of feature data read per frame.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cfloat>
+
+#include "common.h"
+#include "motion_matching.h"
+#include "job_system.h"
+#include "thread_primitives.h"
+
+#define BENCHMARK_QUERY_COUNT 200
+#define BENCHMARK_ANIM_FRAME_COUNT 600
+
+float
+RandomFloat(float Min, float Max)
+{
+  return Min + (Max - Min) * (float(rand()) / float(RAND_MAX));
+}
+
+vec3
+RandomVec3(float Range)
+{
+  return { RandomFloat(-Range, Range), RandomFloat(-Range, Range), RandomFloat(-Range, Range) };
+}
+
+#define BENCHMARK_BONE_COUNT 2
+
+// Mocap-like data: every "animation" is a smooth random walk through the feature space
+void
+GenerateFrameInfos(mm_frame_info* OutFrameInfos, int32_t Count, const mm_feature_layout& Layout)
+{
+  mm_frame_info Current = {};
+  for(int i = 0; i < Count; i++)
+  {
+    if(i % BENCHMARK_ANIM_FRAME_COUNT == 0)
+    {
+      for(int b = 0; b < Layout.BoneCount; b++)
+      {
+        Current.BonePs[b] = RandomVec3(0.5f) + vec3{ 0, 1, 0 };
+        Current.BoneVs[b] = RandomVec3(2.0f);
+      }
+      for(int p = 0; p < Layout.PointCount; p++)
+      {
+        Current.TrajectoryPs[p]     = RandomVec3(float(p + 1) * 0.5f);
+        Current.TrajectoryPs[p].Y   = 0;
+        Current.TrajectoryAngles[p] = RandomFloat(-3.14f, 3.14f);
+      }
+    }
+    for(int b = 0; b < Layout.BoneCount; b++)
+    {
+      Current.BonePs[b] += RandomVec3(0.01f);
+      Current.BoneVs[b] += RandomVec3(0.05f);
+    }
+    for(int p = 0; p < Layout.PointCount; p++)
+    {
+      Current.TrajectoryPs[p] += RandomVec3(0.02f);
+      Current.TrajectoryPs[p].Y = 0;
+      Current.TrajectoryAngles[p] += RandomFloat(-0.02f, 0.02f);
+    }
+    OutFrameInfos[i] = Current;
+  }
+}
+
+mm_controller_data*
+CreateSyntheticController(Memory::stack_allocator* Alloc, int32_t FrameCount)
+{
+  mm_controller_data* MMData = PushAlignedStruct(Alloc, mm_controller_data);
+  memset(MMData, 0, sizeof(mm_controller_data));
+  ResetMMParamsToDefault(&MMData->Params);
+  for(int b = 0; b < BENCHMARK_BONE_COUNT; b++)
+  {
+    MMData->Params.FixedParams.ComparisonBoneIndices.Push(b);
+  }
+  MMData->Layout     = GetFeatureLayout(MMData->Params.FixedParams);
+  MMData->FrameCount = FrameCount;
+
+  MMData->AnimFrameInfoRanges.Init(PushArray(Alloc, 1, mm_frame_info_range), 1);
+  MMData->AnimFrameInfoRanges[0]       = {};
+  MMData->AnimFrameInfoRanges[0].Start = 0;
+  MMData->AnimFrameInfoRanges[0].End   = FrameCount;
+
+  // Like PrecomputeRuntimeMMData the float features are freed once the search data is built
+  PushSearchData(Alloc, MMData);
+  Memory::marker FeaturesStart = Alloc->GetMarker();
+  const int32_t  RowCount      = MMData->Layout.RowCount;
+  float*         Features      = PushAlignedArray(Alloc, FrameCount * RowCount, float);
+  mm_frame_info* FrameInfos    = PushAlignedArray(Alloc, FrameCount, mm_frame_info);
+  GenerateFrameInfos(FrameInfos, FrameCount, MMData->Layout);
+  for(int i = 0; i < FrameCount; i++)
+  {
+    GetFrameInfoFeatures(Features + i * RowCount, FrameInfos[i], MMData->Layout);
+  }
+  BuildSearchData(MMData, Features);
+  Alloc->FreeToMarker(FeaturesStart);
+  return MMData;
+}
+
+// Returns the average query time in microseconds
+float
+TimeQueries(int32_t* OutAnimIndices, float* OutLocalTimes, const mm_controller_data* MMData,
+            const mm_frame_info* Goals)
+{
+  int64_t Start = Platform::GetCurrentCounter();
+  for(int q = 0; q < BENCHMARK_QUERY_COUNT; q++)
+  {
+    mm_frame_info BestMatch;
+    MotionMatch(&OutAnimIndices[q], &OutLocalTimes[q], &BestMatch, MMData, Goals[q]);
+  }
+  int64_t End = Platform::GetCurrentCounter();
+  return 1e6f * Platform::GetTimeInSeconds(Start, End) / float(BENCHMARK_QUERY_COUNT);
+}
+
+int32_t
+CountMismatches(const int32_t* AnimIndices, const float* LocalTimes,
+                const int32_t* ReferenceAnimIndices, const float* ReferenceLocalTimes)
+{
+  int32_t MismatchCount = 0;
+  for(int q = 0; q < BENCHMARK_QUERY_COUNT; q++)
+  {
+    if(AnimIndices[q] != ReferenceAnimIndices[q] || LocalTimes[q] != ReferenceLocalTimes[q])
+    {
+      MismatchCount++;
+    }
+  }
+  return MismatchCount;
+}
+
+int
+main(int ArgCount, char** Args)
+{
+  const uint32_t MemorySize = Mibibytes(512);
+  void*          Memory     = malloc(MemorySize);
+
+  Memory::stack_allocator Alloc;
+  Alloc.Create(Memory, MemorySize);
+
+  const int32_t WorkerCount = Platform::GetLogicalCoreCount() - 1;
+
+  Platform::InitPerformanceFrequency();
+  printf("frame_count,brute_force_us,tree_us,speedup,thread_count,parallel_brute_force_us,"
+         "parallel_tree_us,mismatches,bytes_per_frame\n");
+  for(int32_t FrameCount = 1024; FrameCount <= 256 * 1024; FrameCount *= 2)
+  {
+    Alloc.Clear();
+    srand(1234);
+    Memory::marker      ControllerStart = Alloc.GetMarker();
+    mm_controller_data* TreeMMData      = CreateSyntheticController(&Alloc, FrameCount);
+    // Everything the controller keeps: the feature store, the exact features of quantized sets,
+    // the search tree and the fixed size parts
+    const float BytesPerFrame =
+      (float)Alloc.GetByteCountAboveMarker(ControllerStart) / (float)FrameCount;
+
+    // Same data searched without the tree
+    mm_controller_data* BruteMMData = PushAlignedStruct(&Alloc, mm_controller_data);
+    *BruteMMData                    = *TreeMMData;
+    BruteMMData->SearchNodes        = {};
+
+    mm_frame_info* Goals = PushArray(&Alloc, BENCHMARK_QUERY_COUNT, mm_frame_info);
+    for(int q = 0; q < BENCHMARK_QUERY_COUNT; q++)
+    {
+      // Start the queries from existing frames so they resemble the runtime goals
+      const int32_t FrameIndex = rand() % FrameCount;
+      Goals[q] = GetFrameInfo(TreeMMData, FrameIndex);
+      Goals[q].BonePs[0] += RandomVec3(0.05f);
+    }
+
+    int32_t* BruteIndices = PushArray(&Alloc, BENCHMARK_QUERY_COUNT, int32_t);
+    float*   BruteTimes   = PushArray(&Alloc, BENCHMARK_QUERY_COUNT, float);
+    int32_t* AnimIndices  = PushArray(&Alloc, BENCHMARK_QUERY_COUNT, int32_t);
+    float*   LocalTimes   = PushArray(&Alloc, BENCHMARK_QUERY_COUNT, float);
+
+    int32_t MismatchCount = 0;
+
+    InitJobSystem(0);
+    float BruteUs = TimeQueries(BruteIndices, BruteTimes, BruteMMData, Goals);
+    float TreeUs  = TimeQueries(AnimIndices, LocalTimes, TreeMMData, Goals);
+    MismatchCount += CountMismatches(AnimIndices, LocalTimes, BruteIndices, BruteTimes);
+    ShutdownJobSystem();
+
+    InitJobSystem(WorkerCount);
+    float ParallelBruteUs = TimeQueries(AnimIndices, LocalTimes, BruteMMData, Goals);
+    MismatchCount += CountMismatches(AnimIndices, LocalTimes, BruteIndices, BruteTimes);
+    float ParallelTreeUs = TimeQueries(AnimIndices, LocalTimes, TreeMMData, Goals);
+    MismatchCount += CountMismatches(AnimIndices, LocalTimes, BruteIndices, BruteTimes);
+    ShutdownJobSystem();
+
+    printf("%d,%.2f,%.2f,%.2f,%d,%.2f,%.2f,%d,%.1f\n", FrameCount, BruteUs, TreeUs,
+           BruteUs / TreeUs, WorkerCount + 1, ParallelBruteUs, ParallelTreeUs, MismatchCount,
+           BytesPerFrame);
+  }
+
+  free(Memory);
+  return 0;
+}
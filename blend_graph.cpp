@@ -0,0 +1,454 @@
+#include "blend_graph.h"
+#include "job_system.h"
+#include "misc.h"
+
+#include <assert.h>
+#include <math.h>
+
+static blend_node*
+AddNode(blend_graph* Graph, blend_node_type Type)
+{
+  assert(0 <= Graph->NodeCount && Graph->NodeCount < BLEND_GRAPH_MAX_NODE_COUNT);
+  blend_node* Node = &Graph->Nodes[Graph->NodeCount];
+  *Node            = {};
+  Node->Type       = Type;
+  Graph->RootIndex = Graph->NodeCount++;
+  return Node;
+}
+
+static void
+AddInput(blend_graph* Graph, blend_node* Node, int32_t InputNode, vec2 Position = {})
+{
+  assert(0 <= InputNode && InputNode < Graph->NodeCount - 1);
+  assert(Node->InputCount < BLEND_NODE_MAX_INPUT_COUNT);
+  Node->Positions[Node->InputCount] = Position;
+  Node->Inputs[Node->InputCount++]  = InputNode;
+}
+
+int32_t
+AddBlendParameter(blend_graph* Graph)
+{
+  assert(Graph->ParameterCount < BLEND_GRAPH_MAX_PARAMETER_COUNT);
+  return Graph->ParameterCount++;
+}
+
+int32_t
+AddClipNode(blend_graph* Graph, Anim::animation* Animation, bool Loop, float GlobalStartTime,
+            float PlaybackRate)
+{
+  assert(Animation);
+  assert(Graph->ClipCount < BLEND_GRAPH_MAX_CLIP_COUNT);
+  blend_clip* Clip      = &Graph->Clips[Graph->ClipCount];
+  Clip->Animation       = Animation;
+  Clip->GlobalStartTime = GlobalStartTime;
+  Clip->PlaybackRate    = PlaybackRate;
+  Clip->Loop            = Loop;
+
+  blend_node* Node = AddNode(Graph, BLEND_NODE_Clip);
+  Node->ClipIndex  = Graph->ClipCount++;
+  return Graph->RootIndex;
+}
+
+int32_t
+AddLerpNode(blend_graph* Graph, int32_t NodeA, int32_t NodeB, int32_t ParameterIndex)
+{
+  assert(0 <= ParameterIndex && ParameterIndex < Graph->ParameterCount);
+  blend_node* Node          = AddNode(Graph, BLEND_NODE_Lerp);
+  Node->ParameterIndices[0] = ParameterIndex;
+  AddInput(Graph, Node, NodeA);
+  AddInput(Graph, Node, NodeB);
+  return Graph->RootIndex;
+}
+
+int32_t
+AddAdditiveNode(blend_graph* Graph, int32_t BaseNode, int32_t AdditiveNode, int32_t ParameterIndex)
+{
+  assert(0 <= ParameterIndex && ParameterIndex < Graph->ParameterCount);
+  blend_node* Node          = AddNode(Graph, BLEND_NODE_Additive);
+  Node->ParameterIndices[0] = ParameterIndex;
+  AddInput(Graph, Node, BaseNode);
+  AddInput(Graph, Node, AdditiveNode);
+  return Graph->RootIndex;
+}
+
+int32_t
+AddMirrorNode(blend_graph* Graph, int32_t InputNode)
+{
+  blend_node* Node = AddNode(Graph, BLEND_NODE_Mirror);
+  AddInput(Graph, Node, InputNode);
+  return Graph->RootIndex;
+}
+
+int32_t
+AddBlendSpace1DNode(blend_graph* Graph, int32_t ParameterIndex, const int32_t* Nodes,
+                    const float* Positions, int32_t NodeCount)
+{
+  assert(0 <= ParameterIndex && ParameterIndex < Graph->ParameterCount);
+  assert(0 < NodeCount);
+  blend_node* Node          = AddNode(Graph, BLEND_NODE_BlendSpace1D);
+  Node->ParameterIndices[0] = ParameterIndex;
+  for(int i = 0; i < NodeCount; i++)
+  {
+    assert(i == 0 || Positions[i - 1] < Positions[i]);
+    AddInput(Graph, Node, Nodes[i], { Positions[i], 0 });
+  }
+  return Graph->RootIndex;
+}
+
+int32_t
+AddBlendSpace2DNode(blend_graph* Graph, int32_t ParameterIndexX, int32_t ParameterIndexY,
+                    const int32_t* Nodes, const vec2* Positions, int32_t NodeCount)
+{
+  assert(0 <= ParameterIndexX && ParameterIndexX < Graph->ParameterCount);
+  assert(0 <= ParameterIndexY && ParameterIndexY < Graph->ParameterCount);
+  assert(0 < NodeCount);
+  blend_node* Node          = AddNode(Graph, BLEND_NODE_BlendSpace2D);
+  Node->ParameterIndices[0] = ParameterIndexX;
+  Node->ParameterIndices[1] = ParameterIndexY;
+  for(int i = 0; i < NodeCount; i++)
+  {
+    AddInput(Graph, Node, Nodes[i], Positions[i]);
+  }
+  return Graph->RootIndex;
+}
+
+struct blend_compiler
+{
+  blend_program* Program;
+  int32_t        FreePoses[BLEND_PROGRAM_MAX_POSE_COUNT];
+  int32_t        FreePoseCount;
+  bool           Overflowed;
+};
+
+static int32_t
+AcquirePose(blend_compiler* Compiler)
+{
+  if(0 < Compiler->FreePoseCount)
+  {
+    return Compiler->FreePoses[--Compiler->FreePoseCount];
+  }
+  if(Compiler->Program->PoseCount < BLEND_PROGRAM_MAX_POSE_COUNT)
+  {
+    return Compiler->Program->PoseCount++;
+  }
+  Compiler->Overflowed = true;
+  return 0;
+}
+
+static void
+ReleasePose(blend_compiler* Compiler, int32_t Pose)
+{
+  assert(Compiler->FreePoseCount < BLEND_PROGRAM_MAX_POSE_COUNT);
+  Compiler->FreePoses[Compiler->FreePoseCount++] = Pose;
+}
+
+static blend_instruction*
+PushInstruction(blend_compiler* Compiler, blend_op Op)
+{
+  static blend_instruction s_OverflowInstruction;
+  blend_program*           Program = Compiler->Program;
+  if(Program->InstructionCount == BLEND_PROGRAM_MAX_INSTRUCTION_COUNT)
+  {
+    Compiler->Overflowed = true;
+    return &s_OverflowInstruction;
+  }
+  blend_instruction* Instruction = &Program->Instructions[Program->InstructionCount++];
+  *Instruction                   = {};
+  Instruction->Op                = Op;
+  return Instruction;
+}
+
+static int32_t
+PushValues(blend_compiler* Compiler, int32_t Count)
+{
+  blend_program* Program = Compiler->Program;
+  if(BLEND_PROGRAM_MAX_VALUE_COUNT < Program->ValueCount + Count)
+  {
+    Compiler->Overflowed = true;
+    return 0;
+  }
+  Program->ValueCount += Count;
+  return Program->ValueCount - Count;
+}
+
+// Emits the instructions of the node's subtree, returns the register holding its pose
+static int32_t
+CompileNode(blend_compiler* Compiler, int32_t NodeIndex)
+{
+  const blend_node* Node = &Compiler->Program->Graph->Nodes[NodeIndex];
+  if(Compiler->Overflowed)
+  {
+    return 0;
+  }
+
+  switch(Node->Type)
+  {
+    case BLEND_NODE_Clip:
+    {
+      int32_t            Dest        = AcquirePose(Compiler);
+      blend_instruction* Instruction = PushInstruction(Compiler, BLEND_OP_SampleClip);
+      Instruction->Dest              = Dest;
+      Instruction->Operand           = Node->ClipIndex;
+      return Dest;
+    }
+    case BLEND_NODE_Mirror:
+    {
+      int32_t            Dest        = CompileNode(Compiler, Node->Inputs[0]);
+      blend_instruction* Instruction = PushInstruction(Compiler, BLEND_OP_Mirror);
+      Instruction->Dest              = Dest;
+      return Dest;
+    }
+    case BLEND_NODE_Additive:
+    {
+      int32_t            Dest = CompileNode(Compiler, Node->Inputs[0]);
+      blend_instruction* Skip = PushInstruction(Compiler, BLEND_OP_SkipIfZero);
+      Skip->ValueIndex        = Node->ParameterIndices[0];
+      int32_t SkipStart       = Compiler->Program->InstructionCount;
+
+      int32_t            Additive = CompileNode(Compiler, Node->Inputs[1]);
+      blend_instruction* Add      = PushInstruction(Compiler, BLEND_OP_Add);
+      Add->Dest                   = Dest;
+      Add->Input                  = Additive;
+      Add->ValueIndex             = Node->ParameterIndices[0];
+      Skip->Operand               = Compiler->Program->InstructionCount - SkipStart;
+      ReleasePose(Compiler, Additive);
+      return Dest;
+    }
+    case BLEND_NODE_Lerp:
+    case BLEND_NODE_BlendSpace1D:
+    case BLEND_NODE_BlendSpace2D:
+    {
+      // Inputs whose factor comes out as 0 are not evaluated at all
+      int32_t            FirstValue = PushValues(Compiler, Node->InputCount);
+      blend_instruction* Weights    = PushInstruction(Compiler, BLEND_OP_Weights);
+      Weights->ValueIndex           = FirstValue;
+      Weights->Operand              = NodeIndex;
+
+      int32_t Dest = AcquirePose(Compiler);
+      for(int i = 0; i < Node->InputCount; i++)
+      {
+        blend_instruction* Skip = PushInstruction(Compiler, BLEND_OP_SkipIfZero);
+        Skip->ValueIndex        = FirstValue + i;
+        int32_t SkipStart       = Compiler->Program->InstructionCount;
+
+        int32_t            Input      = CompileNode(Compiler, Node->Inputs[i]);
+        blend_instruction* Accumulate = PushInstruction(Compiler, BLEND_OP_Accumulate);
+        Accumulate->Dest              = Dest;
+        Accumulate->Input             = Input;
+        Accumulate->ValueIndex        = FirstValue + i;
+        Skip->Operand                 = Compiler->Program->InstructionCount - SkipStart;
+        ReleasePose(Compiler, Input);
+      }
+      return Dest;
+    }
+  }
+  assert(0 && "Unknown blend node type");
+  return 0;
+}
+
+bool
+CompileBlendGraph(blend_program* OutProgram, const blend_graph* Graph)
+{
+  assert(OutProgram && Graph);
+  assert(0 <= Graph->RootIndex && Graph->RootIndex < Graph->NodeCount);
+  OutProgram->Graph            = Graph;
+  OutProgram->InstructionCount = 0;
+  OutProgram->PoseCount        = 0;
+  OutProgram->ValueCount       = Graph->ParameterCount;
+
+  blend_compiler Compiler = {};
+  Compiler.Program        = OutProgram;
+  OutProgram->ResultPose  = CompileNode(&Compiler, Graph->RootIndex);
+  return !Compiler.Overflowed;
+}
+
+void
+InitPosePool(pose_pool* Pool, Memory::stack_allocator* Alloc, int32_t PoseCount)
+{
+  assert(0 < PoseCount && PoseCount <= BLEND_PROGRAM_MAX_POSE_COUNT);
+  const int32_t ThreadCount = JOB_SYSTEM_MAX_THREAD_COUNT;
+  Pool->PoseCount           = PoseCount;
+  Pool->Poses               = PushArray(Alloc, ThreadCount * PoseCount, Anim::soa_pose);
+  Pool->MirrorTransforms    = PushArray(Alloc, ThreadCount * SKELETON_MAX_BONE_COUNT, transform);
+  Pool->MirrorMatrices      = PushArray(Alloc, ThreadCount * SKELETON_MAX_BONE_COUNT, mat4);
+}
+
+void
+InitBlendGraphInstance(blend_graph_instance* Instance, const blend_program* Program,
+                       pose_pool* Pool, const Anim::skeleton_mirror_info* MirrorInfo)
+{
+  assert(Program && Pool);
+  assert(Program->PoseCount <= Pool->PoseCount);
+  *Instance            = {};
+  Instance->Program    = Program;
+  Instance->Pool       = Pool;
+  Instance->MirrorInfo = MirrorInfo;
+}
+
+// Blend factors for accumulating the inputs in order, input i is lerped in by its weight over
+// the sum of the weights up to and including it, so the first weighted input is copied
+static void
+ComputeBlendFactors(float* Values, int32_t FirstValue, const blend_node* Node)
+{
+  float Weights[BLEND_NODE_MAX_INPUT_COUNT] = {};
+  switch(Node->Type)
+  {
+    case BLEND_NODE_Lerp:
+    {
+      // Written out directly so that the result matches LerpSoAPoses(A, B, t)
+      const float t = ClampFloat(0.0f, Values[Node->ParameterIndices[0]], 1.0f);
+      Values[FirstValue]     = (t < 1.0f) ? 1.0f : 0.0f;
+      Values[FirstValue + 1] = t;
+      return;
+    }
+    case BLEND_NODE_BlendSpace1D:
+    {
+      const int32_t LastIndex = Node->InputCount - 1;
+      const float   X         = ClampFloat(Node->Positions[0].X, Values[Node->ParameterIndices[0]],
+                                         Node->Positions[LastIndex].X);
+      int32_t i = 0;
+      while(i < LastIndex - 1 && Node->Positions[i + 1].X < X)
+      {
+        i++;
+      }
+      if(LastIndex == 0)
+      {
+        Weights[0] = 1.0f;
+      }
+      else
+      {
+        const float t =
+          (X - Node->Positions[i].X) / (Node->Positions[i + 1].X - Node->Positions[i].X);
+        Weights[i]     = 1.0f - t;
+        Weights[i + 1] = t;
+      }
+    }
+    break;
+    case BLEND_NODE_BlendSpace2D:
+    {
+      const vec2 P = { Values[Node->ParameterIndices[0]], Values[Node->ParameterIndices[1]] };
+      for(int i = 0; i < Node->InputCount; i++)
+      {
+        const vec2  Delta           = P - Node->Positions[i];
+        const float DistanceSquared = Delta.X * Delta.X + Delta.Y * Delta.Y;
+        if(DistanceSquared < 0.000001f)
+        {
+          // On a sample, the others would only add noise
+          for(int j = 0; j < Node->InputCount; j++)
+          {
+            Weights[j] = (i == j) ? 1.0f : 0.0f;
+          }
+          break;
+        }
+        Weights[i] = 1.0f / DistanceSquared;
+      }
+    }
+    break;
+    default:
+      assert(0 && "Node has no blend weights");
+  }
+
+  float WeightSum = 0;
+  for(int i = 0; i < Node->InputCount; i++)
+  {
+    WeightSum += Weights[i];
+    Values[FirstValue + i] = (0 < Weights[i]) ? Weights[i] / WeightSum : 0.0f;
+  }
+}
+
+static void
+SampleClip(Anim::soa_pose* OutPose, blend_graph_instance* Instance, int32_t ClipIndex,
+           float GlobalTime)
+{
+  const blend_clip* Clip = &Instance->Program->Graph->Clips[ClipIndex];
+  assert(Clip->Animation);
+  float LocalTime = Anim::GetLocalSampleTime(Clip->Animation, GlobalTime, Clip->GlobalStartTime,
+                                             Clip->Loop, Clip->PlaybackRate);
+  Anim::LinearAnimationSample(OutPose, Clip->Animation, LocalTime,
+                              &Instance->KeyframeCursors[ClipIndex]);
+}
+
+void
+EvaluateBlendGraph(transform* OutTransforms, blend_graph_instance* Instance,
+                   const Anim::skeleton* Skeleton, float GlobalTime)
+{
+  const blend_program* Program = Instance->Program;
+  pose_pool*           Pool    = Instance->Pool;
+  assert(Program && Pool && Program->PoseCount <= Pool->PoseCount);
+
+  const int32_t   ThreadIndex = GetJobThreadIndex();
+  Anim::soa_pose* Poses       = &Pool->Poses[ThreadIndex * Pool->PoseCount];
+  const int32_t   BoneCount   = Skeleton->BoneCount;
+
+  float Values[BLEND_PROGRAM_MAX_VALUE_COUNT];
+  for(int i = 0; i < Program->Graph->ParameterCount; i++)
+  {
+    Values[i] = Instance->Parameters[i];
+  }
+
+  for(int i = 0; i < Program->InstructionCount; i++)
+  {
+    const blend_instruction& Instruction = Program->Instructions[i];
+    Anim::soa_pose*          Dest        = &Poses[Instruction.Dest];
+    switch(Instruction.Op)
+    {
+      case BLEND_OP_SampleClip:
+      {
+        SampleClip(Dest, Instance, Instruction.Operand, GlobalTime);
+      }
+      break;
+      case BLEND_OP_Weights:
+      {
+        ComputeBlendFactors(Values, Instruction.ValueIndex,
+                            &Program->Graph->Nodes[Instruction.Operand]);
+      }
+      break;
+      case BLEND_OP_SkipIfZero:
+      {
+        if(Values[Instruction.ValueIndex] <= 0)
+        {
+          i += Instruction.Operand;
+        }
+      }
+      break;
+      case BLEND_OP_Accumulate:
+      {
+        const float t = Values[Instruction.ValueIndex];
+        if(1.0f <= t)
+        {
+          *Dest = Poses[Instruction.Input];
+        }
+        else if(0 < t)
+        {
+          Anim::LerpSoAPoses(Dest, Dest, &Poses[Instruction.Input], BoneCount, t);
+        }
+      }
+      break;
+      case BLEND_OP_Add:
+      {
+        Anim::AddSoAPoses(Dest, Dest, &Poses[Instruction.Input], BoneCount,
+                          Values[Instruction.ValueIndex]);
+      }
+      break;
+      case BLEND_OP_Mirror:
+      {
+        assert(Instance->MirrorInfo);
+        transform* Transforms = &Pool->MirrorTransforms[ThreadIndex * SKELETON_MAX_BONE_COUNT];
+        mat4*      Matrices   = &Pool->MirrorMatrices[ThreadIndex * SKELETON_MAX_BONE_COUNT];
+        Anim::SoAPoseToTransforms(Transforms, Dest, BoneCount);
+        Anim::MirrorTransforms(Transforms, Matrices, Skeleton, Instance->MirrorInfo);
+        Anim::TransformsToSoAPose(Dest, Transforms, BoneCount);
+      }
+      break;
+    }
+  }
+
+  Anim::SoAPoseToTransforms(OutTransforms, &Poses[Program->ResultPose], BoneCount);
+}
+
+void
+BlendGraphBlendFunc(Anim::animation_player* Player, void* UserData)
+{
+  blend_graph_instance* Instance = (blend_graph_instance*)UserData;
+  EvaluateBlendGraph(Player->OutputTransforms, Instance, Player->Skeleton, Player->GlobalTimeSec);
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "anim.h"
+#include "stack_alloc.h"
+
+#define BLEND_GRAPH_MAX_NODE_COUNT 64
+#define BLEND_GRAPH_MAX_CLIP_COUNT 32
+#define BLEND_GRAPH_MAX_PARAMETER_COUNT 16
+#define BLEND_NODE_MAX_INPUT_COUNT 8
+#define BLEND_PROGRAM_MAX_INSTRUCTION_COUNT 256
+#define BLEND_PROGRAM_MAX_VALUE_COUNT 128
+#define BLEND_PROGRAM_MAX_POSE_COUNT 16
+
+enum blend_node_type
+{
+  BLEND_NODE_Clip,
+  BLEND_NODE_Lerp,         // Inputs[0] to Inputs[1] by parameter 0
+  BLEND_NODE_Additive,     // Inputs[1] added onto Inputs[0] with parameter 0 as the weight
+  BLEND_NODE_Mirror,       // Inputs[0] with its left and right sides swapped
+  BLEND_NODE_BlendSpace1D, // Between the two inputs around parameter 0, positions in X ascending
+  BLEND_NODE_BlendSpace2D, // Inverse distance weighted at (parameter 0, parameter 1)
+};
+
+struct blend_clip
+{
+  // Refreshed at frame start
+  Anim::animation* Animation;
+
+  float GlobalStartTime;
+  float PlaybackRate;
+  bool  Loop;
+};
+
+struct blend_node
+{
+  blend_node_type Type;
+  int32_t         ClipIndex;
+  int32_t         Inputs[BLEND_NODE_MAX_INPUT_COUNT]; // Node indices
+  vec2            Positions[BLEND_NODE_MAX_INPUT_COUNT]; // Of the inputs in a blend space
+  int32_t         InputCount;
+  int32_t         ParameterIndices[2];
+};
+
+// Built with the functions below, nodes may only reference nodes added before them
+struct blend_graph
+{
+  blend_node Nodes[BLEND_GRAPH_MAX_NODE_COUNT];
+  blend_clip Clips[BLEND_GRAPH_MAX_CLIP_COUNT];
+  int32_t    NodeCount;
+  int32_t    ClipCount;
+  int32_t    ParameterCount;
+  int32_t    RootIndex; // The last added node unless set otherwise
+};
+
+enum blend_op
+{
+  BLEND_OP_SampleClip, // Dest <- clip Operand
+  BLEND_OP_Weights,    // Blend factors of node Operand into the values from ValueIndex on
+  BLEND_OP_SkipIfZero, // Jump over the next Operand instructions if the value is 0
+  BLEND_OP_Accumulate, // Dest <- lerp(Dest, Inputs[0], value), a value of 1 copies
+  BLEND_OP_Add,        // Dest <- Dest + Inputs[0] weighted by the value
+  BLEND_OP_Mirror,     // Dest <- mirrored Dest
+};
+
+struct blend_instruction
+{
+  blend_op Op;
+  int32_t  Dest;   // Pose register
+  int32_t  Input;  // Pose register
+  int32_t  ValueIndex;
+  int32_t  Operand;
+};
+
+// The graph flattened in evaluation order. Pose registers are reused as soon as the pose they
+// hold has been blended in, so PoseCount is the most poses ever alive at once. The first values
+// are the graph parameters, the rest are computed blend factors
+struct blend_program
+{
+  const blend_graph* Graph;
+  blend_instruction  Instructions[BLEND_PROGRAM_MAX_INSTRUCTION_COUNT];
+  int32_t            InstructionCount;
+  int32_t            PoseCount;
+  int32_t            ValueCount;
+  int32_t            ResultPose;
+};
+
+// Evaluation scratch for every job thread, allocated once and recycled by each evaluation
+struct pose_pool
+{
+  Anim::soa_pose* Poses; // PoseCount per thread
+  transform*      MirrorTransforms; // SKELETON_MAX_BONE_COUNT per thread
+  mat4*           MirrorMatrices;   // SKELETON_MAX_BONE_COUNT per thread
+  int32_t         PoseCount;
+};
+
+// Per character state of a compiled graph
+struct blend_graph_instance
+{
+  const blend_program*              Program;
+  pose_pool*                        Pool;
+  const Anim::skeleton_mirror_info* MirrorInfo; // Needed by graphs with mirror nodes
+  float                             Parameters[BLEND_GRAPH_MAX_PARAMETER_COUNT];
+  int32_t                           KeyframeCursors[BLEND_GRAPH_MAX_CLIP_COUNT];
+};
+
+int32_t AddBlendParameter(blend_graph* Graph);
+int32_t AddClipNode(blend_graph* Graph, Anim::animation* Animation, bool Loop = true,
+                    float GlobalStartTime = 0.0f, float PlaybackRate = 1.0f);
+int32_t AddLerpNode(blend_graph* Graph, int32_t NodeA, int32_t NodeB, int32_t ParameterIndex);
+int32_t AddAdditiveNode(blend_graph* Graph, int32_t BaseNode, int32_t AdditiveNode,
+                        int32_t ParameterIndex);
+int32_t AddMirrorNode(blend_graph* Graph, int32_t Node);
+int32_t AddBlendSpace1DNode(blend_graph* Graph, int32_t ParameterIndex, const int32_t* Nodes,
+                            const float* Positions, int32_t NodeCount);
+int32_t AddBlendSpace2DNode(blend_graph* Graph, int32_t ParameterIndexX, int32_t ParameterIndexY,
+                            const int32_t* Nodes, const vec2* Positions, int32_t NodeCount);
+
+// Returns false if the program would exceed the BLEND_PROGRAM limits, the graph has to outlive
+// the program
+bool CompileBlendGraph(blend_program* OutProgram, const blend_graph* Graph);
+
+void InitPosePool(pose_pool* Pool, Memory::stack_allocator* Alloc, int32_t PoseCount);
+void InitBlendGraphInstance(blend_graph_instance* Instance, const blend_program* Program,
+                            pose_pool* Pool, const Anim::skeleton_mirror_info* MirrorInfo = NULL);
+
+// Safe to call from jobs, every thread evaluates in its own part of the pool
+void EvaluateBlendGraph(transform* OutTransforms, blend_graph_instance* Instance,
+                        const Anim::skeleton* Skeleton, float GlobalTime);
+// Blend function evaluating the blend_graph_instance passed as user data at the player's time,
+// which it leaves to the caller to advance. Graph clips do not need to be among the player's
+// animation states
+void BlendGraphBlendFunc(Anim::animation_player* Player, void* UserData);
@@ -1,44 +1,143 @@
 #include "blend_stack.h"
 #include "misc.h"
 
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+void
+InitBlendStack(blend_stack* BlendStack, int32_t Capacity)
+{
+  assert(0 < Capacity && Capacity <= BLEND_STACK_MAX_CAPACITY);
+  *BlendStack          = {};
+  BlendStack->Capacity = Capacity;
+}
+
+void
+SetBlendStackCapacity(blend_stack* BlendStack, int32_t Capacity)
+{
+  const blend_stack OldStack = *BlendStack;
+  InitBlendStack(BlendStack, Capacity);
+  for(int i = MaxInt32(0, OldStack.Count - Capacity); i < OldStack.Count; i++)
+  {
+    int32_t OldSlot = OldStack.GetSlot(i);
+    BlendStack->Push(OldStack.Entries[OldSlot], OldStack.BlendStartTimes[OldSlot],
+                     OldStack.BlendDurations[OldSlot]);
+    int32_t Slot                      = BlendStack->GetSlot(BlendStack->Count - 1);
+    BlendStack->Weights[Slot]         = OldStack.Weights[OldSlot];
+    BlendStack->KeyframeCursors[Slot] = OldStack.KeyframeCursors[OldSlot];
+  }
+}
+
 void
 PlayAnimation(blend_stack* BlendStack, Anim::animation* NewAnim, int32_t IndexInSet,
               float LocalAnimTime, float GlobalTime, float BlendInTime, bool Mirror, bool Loop)
 {
   assert(NewAnim);
 
-  blend_in_info NewBlend        = {};
-  NewBlend.Animation            = NewAnim;
-  NewBlend.IndexInSet           = IndexInSet;
-  NewBlend.GlobalAnimStartTime  = GlobalTime - LocalAnimTime;
-  NewBlend.GlobalBlendStartTime = GlobalTime;
-  NewBlend.BlendDuration        = BlendInTime;
-  NewBlend.Mirror               = Mirror;
-  NewBlend.Loop                 = Loop;
+  blend_in_info NewBlend       = {};
+  NewBlend.Animation           = NewAnim;
+  NewBlend.IndexInSet          = IndexInSet;
+  NewBlend.GlobalAnimStartTime = GlobalTime - LocalAnimTime;
+  NewBlend.Mirror              = Mirror;
+  NewBlend.Loop                = Loop;
+
+  BlendStack->Push(NewBlend, GlobalTime, BlendInTime);
+}
+
+// Weights of finished blends are 1, which also covers blends without a duration
+void
+UpdateBlendStackWeights(blend_stack* BlendStacks, const float* GlobalTimes, int32_t Count)
+{
+#if defined(__AVX__)
+  static_assert(BLEND_STACK_MAX_CAPACITY == 8, "Every slot has to be in the AVX register");
+  const __m256 Zero = _mm256_setzero_ps();
+  const __m256 One  = _mm256_set1_ps(1.0f);
+  for(int i = 0; i < Count; i++)
+  {
+    blend_stack* Stack     = &BlendStacks[i];
+    __m256       Durations = _mm256_loadu_ps(Stack->BlendDurations);
+    __m256       Elapsed =
+      _mm256_sub_ps(_mm256_set1_ps(GlobalTimes[i]), _mm256_loadu_ps(Stack->BlendStartTimes));
+    // Unused slots may divide 0 by 0, max returns its second operand for NaNs
+    __m256 Weights = _mm256_min_ps(_mm256_max_ps(_mm256_div_ps(Elapsed, Durations), Zero), One);
+    __m256 Finished = _mm256_cmp_ps(Elapsed, Durations, _CMP_GE_OQ);
+    _mm256_storeu_ps(Stack->Weights, _mm256_blendv_ps(Weights, One, Finished));
+  }
+#else
+  for(int i = 0; i < Count; i++)
+  {
+    blend_stack* Stack = &BlendStacks[i];
+    for(int s = 0; s < BLEND_STACK_MAX_CAPACITY; s++)
+    {
+      float Elapsed     = GlobalTimes[i] - Stack->BlendStartTimes[s];
+      Stack->Weights[s] = (Stack->BlendDurations[s] <= Elapsed)
+                            ? 1.0f
+                            : ClampFloat(0, Elapsed / Stack->BlendDurations[s], 1);
+    }
+  }
+#endif
+}
+
+// Samples the blend in storage slot Slot the way Anim::SampleAtGlobalTime samples a player's
+// animation, preferring the baked mirror of a mirrored blend
+static void
+SampleBlendStackSlot(Anim::soa_pose* OutPose, Anim::animation_player* C,
+                     const playback_info& PlaybackInfo, int32_t Slot)
+{
+  blend_stack*           BlendStack     = PlaybackInfo.BlendStack;
+  const blend_in_info&   Blend          = BlendStack->Entries[Slot];
+  int32_t*               KeyframeCursor = &BlendStack->KeyframeCursors[Slot];
+  const Anim::animation* Animation      = Blend.Animation;
+  bool                   MirrorSample   = Blend.Mirror && PlaybackInfo.MirrorInfo;
+  if(Blend.Mirror && PlaybackInfo.MirroredAnimations)
+  {
+    Animation    = &PlaybackInfo.MirroredAnimations[Blend.IndexInSet];
+    MirrorSample = false;
+  }
 
-  BlendStack->Push(NewBlend);
+  float SampleTime = Anim::GetLocalSampleTime(Animation, C->GlobalTimeSec,
+                                               Blend.GlobalAnimStartTime, Blend.Loop);
+  if(MirrorSample)
+  {
+    transform* Scratch =
+      &C->OutputTransforms[Animation->ChannelCount * (ANIM_PLAYER_OUTPUT_BLOCK_COUNT - 1)];
+    Anim::LinearMirroredAnimationSample(Scratch, C->HierarchicalModelSpaceMatrices, C->Skeleton,
+                                        Animation, SampleTime, PlaybackInfo.MirrorInfo,
+                                        KeyframeCursor);
+    Anim::TransformsToSoAPose(OutPose, Scratch, Animation->ChannelCount);
+  }
+  else
+  {
+    Anim::LinearAnimationSample(OutPose, Animation, SampleTime, KeyframeCursor);
+  }
 }
 
 // Deferred execution inside of the animation system
 void
 BlendStackBlendFunc(Anim::animation_player* C, void* UserData)
 {
-  playback_info                     PlaybackInfo = *(playback_info*)UserData;
-  const Anim::skeleton_mirror_info* MirrorInfo   = PlaybackInfo.MirrorInfo;
-  const blend_stack&                BlendStack   = *PlaybackInfo.BlendStack;
-  assert(C->AnimStateCount == BlendStack.Count);
-
-	if(C->AnimStateCount > 0)
-	{
-    Anim::SampleAtGlobalTime(C, 0, 0, C->States[0].Mirror ? MirrorInfo : NULL);
+  const playback_info& PlaybackInfo = *(playback_info*)UserData;
+  const blend_stack&   BlendStack   = *PlaybackInfo.BlendStack;
+  if(BlendStack.Empty())
+  {
+    for(int i = 0; i < C->Skeleton->BoneCount; i++)
+    {
+      C->OutputTransforms[i] = IdentityTransform();
+    }
+    return;
   }
-  for(int i = 1; i < C->AnimStateCount; i++)
+
+  // Blend in the structure of arrays layout and transpose the result once
+  Anim::soa_pose Pose;
+  Anim::soa_pose BlendInPose;
+  SampleBlendStackSlot(&Pose, C, PlaybackInfo, BlendStack.GetSlot(0));
+  for(int i = 1; i < BlendStack.Count; i++)
   {
-    Anim::SampleAtGlobalTime(C, i, 1, C->States[i].Mirror ? MirrorInfo : NULL);
-    float t = ClampFloat(0,
-                         (C->GlobalTimeSec - BlendStack[i].GlobalBlendStartTime) /
-                           BlendStack[i].BlendDuration,
-                         1);
-    Anim::LinearBlend(C, 0, 1, t, 0);
+    int32_t Slot = BlendStack.GetSlot(i);
+    SampleBlendStackSlot(&BlendInPose, C, PlaybackInfo, Slot);
+    Anim::LerpSoAPoses(&Pose, &Pose, &BlendInPose, C->Skeleton->BoneCount,
+                       BlendStack.Weights[Slot]);
   }
+  Anim::SoAPoseToTransforms(C->OutputTransforms, &Pose, C->Skeleton->BoneCount);
 }
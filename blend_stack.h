@@ -3,6 +3,10 @@
 #include "basic_data_structures.h"
 #include "anim.h"
 
+// The weights of a whole stack fit in one AVX register
+#define BLEND_STACK_MAX_CAPACITY 8
+#define BLEND_STACK_DEFAULT_CAPACITY 5
+
 struct blend_in_info
 {
   // Refreshed at frame start
@@ -11,21 +15,117 @@ struct blend_in_info
   // Stored Permanently
   int32_t IndexInSet;
   float   GlobalAnimStartTime;
-  float   GlobalBlendStartTime;
-  float   BlendDuration;
   bool    Mirror;
   bool    Loop;
 };
 
-typedef circular_stack<blend_in_info, ANIM_PLAYER_MAX_ANIM_COUNT> blend_stack;
+// Circular stack of the blends playing on a character, the oldest is dropped when a push exceeds
+// the character's capacity. Animation players evaluate it in place. The blend timing and the per
+// frame state are stored next to the entries by storage slot, see GetSlot()
+struct blend_stack
+{
+  blend_in_info Entries[BLEND_STACK_MAX_CAPACITY];
+  float         BlendStartTimes[BLEND_STACK_MAX_CAPACITY]; // Global
+  float         BlendDurations[BLEND_STACK_MAX_CAPACITY];
+  float         Weights[BLEND_STACK_MAX_CAPACITY]; // Written by UpdateBlendStackWeights
+  int32_t       KeyframeCursors[BLEND_STACK_MAX_CAPACITY];
+
+  int32_t StartIndex;
+  int32_t Count;
+  int32_t Capacity;
+
+  int32_t
+  GetSlot(int32_t Index) const
+  {
+    assert(0 <= Index && Index < Count);
+    return (StartIndex + Index) % Capacity;
+  }
+
+  void
+  Push(const blend_in_info& NewEntry, float BlendStartTime, float BlendDuration)
+  {
+    assert(0 < Capacity && Capacity <= BLEND_STACK_MAX_CAPACITY);
+    assert(0 <= Count && Count <= Capacity);
+
+    int32_t WriteIndex = (StartIndex + Count) % Capacity;
+    if(Count == Capacity)
+    {
+      StartIndex = (StartIndex + 1) % Capacity;
+    }
+    else
+    {
+      Count++;
+    }
+    Entries[WriteIndex]         = NewEntry;
+    BlendStartTimes[WriteIndex] = BlendStartTime;
+    BlendDurations[WriteIndex]  = BlendDuration;
+    Weights[WriteIndex]         = 0;
+    KeyframeCursors[WriteIndex] = 0;
+  }
+
+  blend_in_info
+  PopBack()
+  {
+    assert(0 < Count);
+    int32_t RemovedIndex = StartIndex;
+    StartIndex           = (StartIndex + 1) % Capacity;
+    Count--;
+    return Entries[RemovedIndex];
+  }
+
+  blend_in_info
+  Peek() const
+  {
+    return Entries[GetSlot(Count - 1)];
+  }
+
+  blend_in_info&
+  Peek()
+  {
+    return Entries[GetSlot(Count - 1)];
+  }
+
+  void
+  Clear()
+  {
+    StartIndex = 0;
+    Count      = 0;
+  }
+
+  bool
+  Empty() const
+  {
+    return Count == 0;
+  }
+
+  blend_in_info operator[](int32_t Index) const
+  {
+    return Entries[GetSlot(Index)];
+  }
+
+  blend_in_info& operator[](int32_t Index)
+  {
+    return Entries[GetSlot(Index)];
+  }
+};
 
 struct playback_info
 {
   const Anim::skeleton_mirror_info* MirrorInfo;
-  const blend_stack*                BlendStack;
+  // Baked mirrors of the controller's animations indexed like them, NULL if mirroring is done
+  // while sampling
+  const Anim::animation* MirroredAnimations;
+  blend_stack*           BlendStack;
 };
 
+void InitBlendStack(blend_stack* BlendStack, int32_t Capacity);
+// Keeps the newest blends that fit into the new capacity
+void SetBlendStackCapacity(blend_stack* BlendStack, int32_t Capacity);
+
 void PlayAnimation(blend_stack* BlendStack, Anim::animation* NewAnim, int32_t IndexInSet,
                    float LocalStartTime, float GlobalTime, float BlendInTime, bool Mirror,
                    bool Loop = false);
+// One pass over the stacks of all characters, run once per frame after their times have advanced
+void UpdateBlendStackWeights(blend_stack* BlendStacks, const float* GlobalTimes, int32_t Count);
+// Evaluates the playback_info's blend stack at the player's time with the current weights
 void BlendStackBlendFunc(Anim::animation_player* P, void* UserData);
@@ -481,7 +481,8 @@ PrintUsage()
   printf(
     "usage:\nbuilder input_file output_file_wo_ext [--root_bone name] [--scale value] "
     "[--print_scene] [--print_skeleton]"
-    "[--sampling_frequency freq] [--target_actor actor_file] --model | --actor | --animation\n");
+    "[--sampling_frequency freq] [--target_actor actor_file] [--compress] [--no_key_reduction] "
+    "--model | --actor | --animation\n");
 }
 
 int
@@ -496,6 +497,9 @@ main(int ArgCount, char** Args)
   bool BuildAnimation         = false;
   bool PrintScene             = false;
   bool PrintSkeletonHierarchy = false;
+  bool CompressAnimation      = false;
+
+  Anim::compression_settings CompressionSettings = Anim::GetDefaultCompressionSettings();
 
   float RescaleCoefficient = 1.0f;
   float SamplingFrequency  = 120.0f;
@@ -550,6 +554,14 @@ main(int ArgCount, char** Args)
       {
         PrintSkeletonHierarchy = true;
       }
+      else if(strcmp(Args[ArgIndex], "--compress") == 0)
+      {
+        CompressAnimation = true;
+      }
+      else if(strcmp(Args[ArgIndex], "--no_key_reduction") == 0)
+      {
+        CompressionSettings.ReduceKeys = false;
+      }
       else if(strcmp(Args[ArgIndex], "--sampling_frequency") == 0)
       {
         if(ArgIndex + 1 < ArgCount)
@@ -1023,9 +1035,54 @@ main(int ArgCount, char** Args)
     }
 
     assert(Allocator.GetUsedSize() == TotalAnimFileSize);
-    printf("writing: %s\n", AnimationName);
-    Asset::PackAnimationGroup(AnimGroup);
-    Platform::WriteEntireFile(AnimationName, TotalAnimFileSize, FileMemory);
+    bool WroteCompressed = false;
+    if(CompressAnimation)
+    {
+      if(1 < AnimGroup->AnimationCount)
+      {
+        printf("warning: compressing only the first of %d animations\n",
+               AnimGroup->AnimationCount);
+      }
+
+      // Constant tracks keep a header each, so a short clip can grow when compressed
+      const int32_t MaxCompressedSize =
+        Anim::GetMaxCompressedAnimationSize(AnimGroup->Animations[0]);
+      void*                   CompressedMemory    = malloc(MaxCompressedSize);
+      Memory::stack_allocator CompressedAllocator = {};
+      CompressedAllocator.Create(CompressedMemory, MaxCompressedSize);
+
+      Anim::compressed_animation* CompressedAnimation =
+        Anim::CompressAnimation(&CompressedAllocator, AnimGroup->Animations[0],
+                                CompressionSettings);
+      if(CompressedAnimation)
+      {
+        int32_t CompressedSize = CompressedAllocator.GetUsedSize();
+        if(CompressedSize < TotalAnimFileSize)
+        {
+          printf("writing: %s (compressed %d B to %d B)\n", AnimationName, TotalAnimFileSize,
+                 CompressedSize);
+          Asset::PackCompressedAnimation(CompressedAnimation);
+          Platform::WriteEntireFile(AnimationName, CompressedSize, CompressedMemory);
+          WroteCompressed = true;
+        }
+        else
+        {
+          printf("warning: compression does not shrink %s (%d B to %d B), writing it raw\n",
+                 AnimationName, TotalAnimFileSize, CompressedSize);
+        }
+      }
+      else
+      {
+        printf("warning: writing %s raw\n", AnimationName);
+      }
+      free(CompressedMemory);
+    }
+    if(!WroteCompressed)
+    {
+      printf("writing: %s\n", AnimationName);
+      Asset::PackAnimationGroup(AnimGroup);
+      Platform::WriteEntireFile(AnimationName, TotalAnimFileSize, FileMemory);
+    }
   }
 
   free(ModelName);
@@ -105,7 +105,12 @@ InitializeWorld(ecs_world* World, const ecs_runtime* Runtime)
 {
   World->Entities.Clear();
   World->VacantEntityIndices.Clear();
-  World->EntityCommands.Clear();
+  for(int i = 0; i < JOB_SYSTEM_MAX_THREAD_COUNT; i++)
+  {
+    World->CommandBuffers[i].Commands.Clear();
+    World->CommandBuffers[i].DataSize           = 0;
+    World->CommandBuffers[i].CreatedEntityCount = 0;
+  }
   World->Runtime = (ecs_runtime*)Runtime;
 }
 
@@ -116,20 +121,40 @@ AdaptWorldToNewRuntime(ecs_world* World, uint8_t* OldRuntimMemory, const ecs_run
 {
 }
 
-void
-ExecuteECSJob(ecs_runtime* runtime, const ecs_world* World,
-              const archetype_request& ArchetypeRequest, ECS_JOB_FUNCTION_PARAMETERS(JobFunc))
+struct ecs_chunk_job
+{
+  ECS_JOB_FUNCTION_PARAMETERS(JobFunc);
+  uintptr_t ComponentAddresses[ECS_ARCHETYPE_COMPONENT_MAX_COUNT];
+  int32_t   EntityCount;
+};
+
+JOB_FUNCTION(ECSChunkJob)
 {
+  ecs_chunk_job* ChunkJob = (ecs_chunk_job*)Data;
+  ChunkJob->JobFunc(&ChunkJob->ComponentAddresses[0], ChunkJob->EntityCount);
+}
+
+int32_t
+PushECSChunkJobs(job** OutJobs, Memory::stack_allocator* TempAlloc, const ecs_world* World,
+                 const archetype_request& ArchetypeRequest, ECS_JOB_FUNCTION_PARAMETERS(JobFunc))
+{
+  ecs_runtime* Runtime = World->Runtime;
+
   // Find matching archetypes
   fixed_stack<archetype*, ECS_ARCHETYPE_MAX_COUNT> MatchedArchetypes;
   MatchedArchetypes.Clear();
 
-  for(int a = 0; a < runtime->Archetypes.Count; a++)
+  int32_t ChunkCount = 0;
+  for(int a = 0; a < Runtime->Archetypes.Count; a++)
   {
-    if(DoesArchetypeMatchRequest(runtime->Archetypes[a], ArchetypeRequest))
+    if(DoesArchetypeMatchRequest(Runtime->Archetypes[a], ArchetypeRequest))
     {
-      MatchedArchetypes.Push(&runtime->Archetypes[a]);
-      a++;
+      MatchedArchetypes.Push(&Runtime->Archetypes[a]);
+      for(chunk* CurrentChunk = Runtime->Archetypes[a].FirstChunk; CurrentChunk != NULL;
+          CurrentChunk        = CurrentChunk->Header.NextChunk)
+      {
+        ChunkCount += (CurrentChunk->Header.EntityCount > 0) ? 1 : 0;
+      }
     }
   }
 
@@ -137,6 +162,11 @@ ExecuteECSJob(ecs_runtime* runtime, const ecs_world* World,
   UsedComponents.Clear();
   GetUsedComponents(&UsedComponents, ArchetypeRequest);
   assert(UsedComponents.Count < ECS_ARCHETYPE_COMPONENT_MAX_COUNT);
+
+  ecs_chunk_job* ChunkJobs = PushArray(TempAlloc, ChunkCount, ecs_chunk_job);
+  job*           Jobs      = PushArray(TempAlloc, ChunkCount, job);
+
+  int32_t JobIndex = 0;
   for(int a = 0; a < MatchedArchetypes.Count; a++)
   {
     uintptr_t ComponentOffsetArray[ECS_ARCHETYPE_COMPONENT_MAX_COUNT];
@@ -146,18 +176,42 @@ ExecuteECSJob(ecs_runtime* runtime, const ecs_world* World,
         GetComponentOffset(*MatchedArchetypes[a], UsedComponents[CompInd]);
     }
 
-    // Schedule jobs for execution
-    // TODO(Lukas): compute the component offset arrays and shedule the chunk updates in a different
     for(chunk* CurrentChunk = MatchedArchetypes[a]->FirstChunk; CurrentChunk != NULL;
         CurrentChunk        = CurrentChunk->Header.NextChunk)
     {
+      if(CurrentChunk->Header.EntityCount == 0)
+      {
+        continue;
+      }
+      ecs_chunk_job* ChunkJob = &ChunkJobs[JobIndex];
+      ChunkJob->JobFunc       = JobFunc;
+      ChunkJob->EntityCount   = CurrentChunk->Header.EntityCount;
       for(int CompInd = 0; CompInd < UsedComponents.Count; CompInd++)
       {
-        ComponentOffsetArray[CompInd] += (uintptr_t)CurrentChunk;
+        ChunkJob->ComponentAddresses[CompInd] =
+          (uintptr_t)CurrentChunk + ComponentOffsetArray[CompInd];
       }
-      JobFunc(&ComponentOffsetArray[0], UsedComponents.Count);
+      Jobs[JobIndex] = { ECSChunkJob, ChunkJob };
+      JobIndex++;
     }
   }
+  assert(JobIndex == ChunkCount);
+
+  *OutJobs = Jobs;
+  return ChunkCount;
+}
+
+job_counter*
+ExecuteECSJob(Memory::stack_allocator* TempAlloc, const ecs_world* World,
+              const archetype_request& ArchetypeRequest, ECS_JOB_FUNCTION_PARAMETERS(JobFunc))
+{
+  job_counter* Counter = PushStruct(TempAlloc, job_counter);
+  *Counter             = {};
+
+  job*    Jobs;
+  int32_t ChunkCount = PushECSChunkJobs(&Jobs, TempAlloc, World, ArchetypeRequest, JobFunc);
+  KickJobs(Counter, Jobs, ChunkCount);
+  return Counter;
 }
 
 archetype*
@@ -1,9 +1,12 @@
 #pragma once
 #include "stdint.h"
+#include "job_system.h"
+#include "stack_alloc.h"
 
 const int ECS_CHUNK_SIZE                           = 16 * 1024;
 const int ECS_ENTITY_MAX_COUNT                     = 200;
-const int ECS_WORLD_ENTITY_COMMAND_BUFFER_CAPACITY = 200;
+const int ECS_WORLD_ENTITY_COMMAND_BUFFER_CAPACITY = 200; // Per job thread
+const int ECS_WORLD_ENTITY_COMMAND_DATA_SIZE       = 2 * 1024;
 
 const int ECS_ARCHETYPE_COMPONENT_MAX_COUNT = 20;
 const int ECS_COMPONENT_MAX_COUNT           = 20;
@@ -38,8 +41,16 @@ struct archetype_request
 #define ECS_JOB_FUNCTION(Name) void Name(void* Components, int32_t Count)
 #define ECS_JOB_FUNCTION_PARAMETERS(Name) ECS_JOB_FUNCTION((*Name))
 
-void ExecuteECSJob(const ecs_world* World, const archetype_request* ArchetypeRequest,
-                   ECS_JOB_FUNCTION_PARAMETERS(JobFunc));
+// Kicks one job per non-empty chunk of the archetypes matching the request, which calls JobFunc
+// with the chunk's arrays of the used components in request order and its entity count. The job
+// data is pushed onto TempAlloc and has to stay there until the returned counter is waited for
+job_counter* ExecuteECSJob(Memory::stack_allocator* TempAlloc, const ecs_world* World,
+                           const archetype_request& ArchetypeRequest,
+                           ECS_JOB_FUNCTION_PARAMETERS(JobFunc));
+// The jobs ExecuteECSJob would kick, returns their count
+int32_t PushECSChunkJobs(job** OutJobs, Memory::stack_allocator* TempAlloc, const ecs_world* World,
+                         const archetype_request& ArchetypeRequest,
+                         ECS_JOB_FUNCTION_PARAMETERS(JobFunc));
 
 // Entity API
 bool      DoesEntityExist(const ecs_world* World, entity_id EntityID);
@@ -59,3 +70,19 @@ void SetComponent_(ecs_world* World, entity_id EntityID, const void* ComponentVa
   static_assert(sizeof(ComponentName) == sizeof(Value),                                            \
                 "compile time assertions: SetComponent() ComponentName and Value mismatch");       \
   SetComponent_(World, Entity, Value, sizeof(Value), COMPONENT_##ComponentName)
+
+// Deferred entity API
+// Safe to call from chunk jobs, the changes are recorded by the calling thread and applied by
+// RunWorldCommandBuffer(). The ID returned by DeferCreateEntity() is a placeholder that is only
+// valid in the deferred calls of the same thread until then
+entity_id DeferCreateEntity(ecs_world* World);
+void      DeferDestroyEntity(ecs_world* World, entity_id EntityID);
+void      DeferAddComponent(ecs_world* World, entity_id EntityID, component_id ComponentID);
+void      DeferRemoveComponent(ecs_world* World, entity_id EntityID, component_id ComponentID);
+void      DeferSetComponent_(ecs_world* World, entity_id EntityID, const void* ComponentValue,
+                             uint16_t ComponentSize, component_id ComponentID);
+
+#define DeferSetComponent(World, Entity, ComponentName, Value)                                     \
+  static_assert(sizeof(ComponentName) == sizeof(Value),                                            \
+                "compile time assertions: DeferSetComponent() ComponentName and Value mismatch");  \
+  DeferSetComponent_(World, Entity, Value, sizeof(Value), COMPONENT_##ComponentName)
@@ -0,0 +1,396 @@
+#include "ecs.h"
+#include "ecs_management.h"
+#include "ecs_internal.h"
+#include "assert.h"
+#include "string.h"
+
+#include <stdlib.h>
+
+static_assert(ECS_COMPONENT_MAX_COUNT <= 32, "Component sets are 32 bit masks");
+
+// Recording
+
+static inline ecs_command_buffer*
+GetThreadCommandBuffer(ecs_world* World)
+{
+  return &World->CommandBuffers[GetJobThreadIndex()];
+}
+
+static inline bool
+IsValidCommandEntity(const ecs_command_buffer* Buffer, entity_id EntityID)
+{
+  return 0 <= EntityID || (-2 - EntityID) < Buffer->CreatedEntityCount;
+}
+
+static entity_command*
+PushEntityCommand(ecs_command_buffer* Buffer, uint16_t Type, entity_id EntityID,
+                  component_id ComponentID)
+{
+  assert(!Buffer->Commands.Full());
+  assert(IsValidCommandEntity(Buffer, EntityID));
+  entity_command Command = {};
+  Command.Index          = EntityID;
+  Command.ComponentID    = ComponentID;
+  Command.Type           = Type;
+  Buffer->Commands.Push(Command);
+  return &Buffer->Commands[Buffer->Commands.Count - 1];
+}
+
+entity_id
+DeferCreateEntity(ecs_world* World)
+{
+  ecs_command_buffer* Buffer      = GetThreadCommandBuffer(World);
+  entity_id           Placeholder = (entity_id)(-2 - Buffer->CreatedEntityCount++);
+  PushEntityCommand(Buffer, ENTITY_COMMAND_Create, Placeholder, 0);
+  return Placeholder;
+}
+
+void
+DeferDestroyEntity(ecs_world* World, entity_id EntityID)
+{
+  PushEntityCommand(GetThreadCommandBuffer(World), ENTITY_COMMAND_Destroy, EntityID, 0);
+}
+
+void
+DeferAddComponent(ecs_world* World, entity_id EntityID, component_id ComponentID)
+{
+  PushEntityCommand(GetThreadCommandBuffer(World), ENTITY_COMMAND_AddComponent, EntityID,
+                    ComponentID);
+}
+
+void
+DeferRemoveComponent(ecs_world* World, entity_id EntityID, component_id ComponentID)
+{
+  PushEntityCommand(GetThreadCommandBuffer(World), ENTITY_COMMAND_RemoveComponent, EntityID,
+                    ComponentID);
+}
+
+void
+DeferSetComponent_(ecs_world* World, entity_id EntityID, const void* ComponentValue,
+                   uint16_t ComponentSize, component_id ComponentID)
+{
+  ecs_command_buffer* Buffer = GetThreadCommandBuffer(World);
+  assert(Buffer->DataSize + ComponentSize <= ECS_WORLD_ENTITY_COMMAND_DATA_SIZE);
+  entity_command* Command =
+    PushEntityCommand(Buffer, ENTITY_COMMAND_SetComponent, EntityID, ComponentID);
+  Command->Data = &Buffer->Data[Buffer->DataSize];
+  Command->Size = ComponentSize;
+  memcpy(Command->Data, ComponentValue, ComponentSize);
+  Buffer->DataSize += ComponentSize;
+}
+
+// Playback
+
+// The net effect of an entity's commands
+struct entity_command_fold
+{
+  uint32_t SourceMask;    // Components before the playback
+  uint32_t ComponentMask; // After the commands folded so far
+  uint32_t AddedMask;     // Components that start out zeroed
+  bool     Destroyed;
+};
+
+struct entity_move
+{
+  entity_id           EntityID;
+  int32_t             SourceArchetypeIndex; // -1 for entities without components
+  uint32_t            TargetMask;
+  entity_storage_info SourceStorage;
+};
+
+struct entity_slot_removal
+{
+  entity_id           EntityID;
+  entity_storage_info Storage;
+};
+
+static int
+EntityMoveCmpFunc(const void* A, const void* B)
+{
+  const entity_move* MoveA = (const entity_move*)A;
+  const entity_move* MoveB = (const entity_move*)B;
+  if(MoveA->SourceArchetypeIndex != MoveB->SourceArchetypeIndex)
+  {
+    return (MoveA->SourceArchetypeIndex < MoveB->SourceArchetypeIndex) ? -1 : 1;
+  }
+  if(MoveA->TargetMask != MoveB->TargetMask)
+  {
+    return (MoveA->TargetMask < MoveB->TargetMask) ? -1 : 1;
+  }
+  return MoveA->EntityID - MoveB->EntityID;
+}
+
+// By chunk and back to front inside of each chunk, so the entity a removal swaps into the freed
+// slot never has a removal pending
+static int
+EntitySlotRemovalCmpFunc(const void* A, const void* B)
+{
+  const entity_slot_removal* RemovalA = (const entity_slot_removal*)A;
+  const entity_slot_removal* RemovalB = (const entity_slot_removal*)B;
+  if(RemovalA->Storage.ChunkIndex != RemovalB->Storage.ChunkIndex)
+  {
+    return RemovalA->Storage.ChunkIndex - RemovalB->Storage.ChunkIndex;
+  }
+  return RemovalB->Storage.IndexInChunk - RemovalA->Storage.IndexInChunk;
+}
+
+static uint32_t
+GetArchetypeComponentMask(const archetype* Archetype)
+{
+  uint32_t ComponentMask = 0;
+  for(int i = 0; Archetype && i < Archetype->ComponentTypes.Count; i++)
+  {
+    ComponentMask |= 1u << Archetype->ComponentTypes[i].ID;
+  }
+  return ComponentMask;
+}
+
+static archetype*
+GetOrAddArchetype(ecs_runtime* Runtime, uint32_t ComponentMask)
+{
+  archetype TempArchetype = {};
+  TempArchetype.ComponentTypes.Clear();
+  for(component_id c = 0; c < Runtime->ComponentStructInfos.Count; c++)
+  {
+    if(ComponentMask & (1u << c))
+    {
+      AddComponentWithoutLosingCanonicalForm(&TempArchetype, c, Runtime);
+    }
+  }
+  archetype* MatchedArchetype = GetMatchingArchetype(Runtime, TempArchetype);
+  return MatchedArchetype ? MatchedArchetype : AddArchetype(Runtime, TempArchetype);
+}
+
+static void
+ZeroComponents(ecs_world* World, entity_storage_info Storage, const archetype& Archetype,
+               uint32_t ComponentMask)
+{
+  for(int i = 0; ComponentMask && i < Archetype.ComponentTypes.Count; i++)
+  {
+    component_id_and_offset IDAndOffset = Archetype.ComponentTypes[i];
+    if(ComponentMask & (1u << IDAndOffset.ID))
+    {
+      component_struct_info ComponentInfo = World->Runtime->ComponentStructInfos[IDAndOffset.ID];
+      memset(GetComponentAddress(World, Storage, IDAndOffset.Offset, ComponentInfo), 0,
+             (size_t)ComponentInfo.Size);
+    }
+  }
+}
+
+// Structural changes are applied per entity at once: every entity moves at most one time, from
+// its archetype to the one of its final component set. The moves are grouped by both archetypes,
+// so each group looks up its destination once and fills its chunks in one go, and the vacated
+// slots are compacted in a single pass afterwards. Component values are written last, the latest
+// one recorded wins, commands of different threads are ordered by the thread index
+void
+RunWorldCommandBuffer(ecs_runtime* Runtime, ecs_world* World)
+{
+  assert(Runtime == World->Runtime);
+
+  entity_command_fold Folds[ECS_ENTITY_MAX_COUNT];
+  entity_id           TouchedEntities[ECS_ENTITY_MAX_COUNT];
+  int32_t             TouchedCount = 0;
+  bool                Touched[ECS_ENTITY_MAX_COUNT];
+  memset(Touched, 0, sizeof(Touched));
+
+  // Create the new entities and fold the commands of every entity
+  for(int t = 0; t < JOB_SYSTEM_MAX_THREAD_COUNT; t++)
+  {
+    ecs_command_buffer* Buffer = &World->CommandBuffers[t];
+    entity_id           CreatedEntities[ECS_WORLD_ENTITY_COMMAND_BUFFER_CAPACITY];
+    for(int c = 0; c < Buffer->Commands.Count; c++)
+    {
+      entity_command* Command = &Buffer->Commands[c];
+      if(Command->Type == ENTITY_COMMAND_Create)
+      {
+        entity_id NewEntityID                = CreateEntity(World);
+        CreatedEntities[-2 - Command->Index] = NewEntityID;
+        Command->Index                       = NewEntityID;
+      }
+      else if(Command->Index < -1)
+      {
+        Command->Index = CreatedEntities[-2 - Command->Index];
+      }
+
+      entity_id EntityID = Command->Index;
+      assert(DoesEntityExist(World, EntityID));
+      entity_command_fold* Fold = &Folds[EntityID];
+      if(!Touched[EntityID])
+      {
+        Touched[EntityID]               = true;
+        TouchedEntities[TouchedCount++] = EntityID;
+        Fold->SourceMask    = GetArchetypeComponentMask(GetEntityArchetype(World, EntityID));
+        Fold->ComponentMask = Fold->SourceMask;
+        Fold->AddedMask     = 0;
+        Fold->Destroyed     = false;
+      }
+      assert(!Fold->Destroyed && "assert: command for a destroyed entity");
+
+      uint32_t ComponentBit = 1u << Command->ComponentID;
+      switch(Command->Type)
+      {
+        case ENTITY_COMMAND_Destroy:
+          Fold->Destroyed = true;
+          break;
+        case ENTITY_COMMAND_AddComponent:
+          assert(!(Fold->ComponentMask & ComponentBit) &&
+                 "assert: trying to add a component for the second time");
+          Fold->ComponentMask |= ComponentBit;
+          Fold->AddedMask |= ComponentBit;
+          break;
+        case ENTITY_COMMAND_RemoveComponent:
+          assert((Fold->ComponentMask & ComponentBit) &&
+                 "assert: trying to remove a not-added component");
+          Fold->ComponentMask &= ~ComponentBit;
+          Fold->AddedMask &= ~ComponentBit;
+          break;
+        case ENTITY_COMMAND_SetComponent:
+          assert((Fold->ComponentMask & ComponentBit) &&
+                 "assert: trying to set a not-added component");
+          assert(Runtime->ComponentStructInfos[Command->ComponentID].Size == Command->Size);
+          break;
+      }
+    }
+  }
+
+  entity_move         Moves[ECS_ENTITY_MAX_COUNT];
+  int32_t             MoveCount = 0;
+  entity_slot_removal Removals[ECS_ENTITY_MAX_COUNT];
+  int32_t             RemovalCount = 0;
+  for(int i = 0; i < TouchedCount; i++)
+  {
+    entity_id                  EntityID = TouchedEntities[i];
+    const entity_command_fold& Fold     = Folds[EntityID];
+    entity_storage_info        Storage  = World->Entities[EntityID];
+    if(Fold.Destroyed)
+    {
+      if(Storage.ChunkIndex != -1)
+      {
+        Removals[RemovalCount++] = { EntityID, Storage };
+      }
+      World->Entities[EntityID] = { -1, -1 };
+    }
+    else if(Fold.ComponentMask != Fold.SourceMask)
+    {
+      const archetype* Source = GetEntityArchetype(World, EntityID);
+
+      entity_move Move          = {};
+      Move.EntityID             = EntityID;
+      Move.SourceArchetypeIndex = Source ? GetArchetypeIndex(Runtime, Source) : -1;
+      Move.TargetMask           = Fold.ComponentMask;
+      Move.SourceStorage        = Storage;
+      Moves[MoveCount++]        = Move;
+    }
+    else if(Fold.AddedMask)
+    {
+      // Removed and added again, stays in place
+      ZeroComponents(World, Storage, *GetEntityArchetype(World, EntityID), Fold.AddedMask);
+    }
+  }
+
+  qsort(Moves, (size_t)MoveCount, sizeof(entity_move), EntityMoveCmpFunc);
+  for(int GroupStart = 0; GroupStart < MoveCount;)
+  {
+    int GroupEnd = GroupStart + 1;
+    while(GroupEnd < MoveCount &&
+          Moves[GroupEnd].SourceArchetypeIndex == Moves[GroupStart].SourceArchetypeIndex &&
+          Moves[GroupEnd].TargetMask == Moves[GroupStart].TargetMask)
+    {
+      GroupEnd++;
+    }
+
+    const entity_move& First           = Moves[GroupStart];
+    const archetype*   SourceArchetype = (First.SourceArchetypeIndex != -1)
+                                           ? &Runtime->Archetypes[First.SourceArchetypeIndex]
+                                           : NULL;
+    archetype* TargetArchetype = First.TargetMask ? GetOrAddArchetype(Runtime, First.TargetMask)
+                                                  : NULL;
+    for(int m = GroupStart; m < GroupEnd; m++)
+    {
+      const entity_move&  Move       = Moves[m];
+      entity_storage_info NewStorage = { -1, 0 };
+      if(TargetArchetype)
+      {
+        NewStorage = CreateNewArchetypeInstance(Runtime, TargetArchetype);
+        if(SourceArchetype)
+        {
+          CopyMatchingComponentValues(World, NewStorage, Move.SourceStorage, *TargetArchetype,
+                                      *SourceArchetype);
+        }
+        ZeroComponents(World, NewStorage, *TargetArchetype, Folds[Move.EntityID].AddedMask);
+      }
+      if(Move.SourceStorage.ChunkIndex != -1)
+      {
+        Removals[RemovalCount++] = { Move.EntityID, Move.SourceStorage };
+      }
+      World->Entities[Move.EntityID] = NewStorage;
+    }
+    GroupStart = GroupEnd;
+  }
+
+  qsort(Removals, (size_t)RemovalCount, sizeof(entity_slot_removal), EntitySlotRemovalCmpFunc);
+  for(int i = 0; i < RemovalCount; i++)
+  {
+    // The swapped in entity is looked up by its storage, so the removed one has to point at the
+    // vacated slot meanwhile
+    entity_slot_removal Removal       = Removals[i];
+    entity_storage_info NewStorage    = World->Entities[Removal.EntityID];
+    World->Entities[Removal.EntityID] = Removal.Storage;
+    RemoveEntityFromChunk(World, Removal.Storage);
+    World->Entities[Removal.EntityID] = NewStorage;
+  }
+
+  for(int i = 0; i < TouchedCount; i++)
+  {
+    entity_id EntityID = TouchedEntities[i];
+    if(Folds[EntityID].Destroyed)
+    {
+      if(EntityID == World->Entities.Count - 1)
+      {
+        World->Entities.Pop();
+      }
+      else
+      {
+        World->VacantEntityIndices.Push(EntityID);
+      }
+    }
+  }
+
+  // Backwards, so that only the latest value of a component is written. Values recorded before
+  // the component was added or removed again are dropped
+  uint32_t LaterWrittenMasks[ECS_ENTITY_MAX_COUNT];
+  for(int i = 0; i < TouchedCount; i++)
+  {
+    LaterWrittenMasks[TouchedEntities[i]] = 0;
+  }
+  for(int t = JOB_SYSTEM_MAX_THREAD_COUNT - 1; t >= 0; t--)
+  {
+    ecs_command_buffer* Buffer = &World->CommandBuffers[t];
+    for(int c = Buffer->Commands.Count - 1; c >= 0; c--)
+    {
+      const entity_command& Command      = Buffer->Commands[c];
+      uint32_t              ComponentBit = 1u << Command.ComponentID;
+      if(Command.Type == ENTITY_COMMAND_AddComponent ||
+         Command.Type == ENTITY_COMMAND_RemoveComponent)
+      {
+        LaterWrittenMasks[Command.Index] |= ComponentBit;
+      }
+      else if(Command.Type == ENTITY_COMMAND_SetComponent && !Folds[Command.Index].Destroyed &&
+              !(LaterWrittenMasks[Command.Index] & ComponentBit))
+      {
+        LaterWrittenMasks[Command.Index] |= ComponentBit;
+
+        const archetype* Archetype = GetEntityArchetype(World, Command.Index);
+        int32_t  ComponentIndex = GetComponentIndexInArchetype(*Archetype, Command.ComponentID);
+        uint8_t* Component =
+          GetComponentAddress(World, World->Entities[Command.Index],
+                              Archetype->ComponentTypes[ComponentIndex].Offset,
+                              Runtime->ComponentStructInfos[Command.ComponentID]);
+        memcpy(Component, Command.Data, Command.Size);
+      }
+    }
+    Buffer->Commands.Clear();
+    Buffer->DataSize           = 0;
+    Buffer->CreatedEntityCount = 0;
+  }
+}
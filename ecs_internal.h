@@ -29,14 +29,16 @@ void RemoveComponentWithoutLosingCanonicalForm(archetype* Archetype, component_i
 
 int32_t    GetArchetypeIndex(const ecs_runtime* Runtime, const archetype* Archetype);
 void       ComputeArchetypeComponentOffsets(archetype* Archetype, const ecs_runtime* Runtime);
-archetype* AddArchetype(ecs_runtime* Runtime, const archetype* Archetype);
+archetype* AddArchetype(ecs_runtime* Runtime, const archetype& Archetype);
 void       RemoveArchetypeAtIndex(ecs_runtime* Runtime, int32_t RemoveIndex);
 void RemoveArchetype(ecs_runtime* Runtime, archetype* Archetype);
 
 int32_t GetChunkIndex(const ecs_runtime* Runtime, const chunk* C);
 chunk*  GetChunkAtIndex(ecs_runtime* Runtime, int32_t ChunkIndex);
 
-entity_storage_info CreateNewArchetypeInstance(ecs_world* World, archetype* Archetype);
+entity_storage_info CreateNewArchetypeInstance(ecs_runtime* Runtime, archetype* Archetype);
+void                RemoveEntityFromChunk(ecs_world* World, entity_storage_info RemovedEntity);
+archetype*          GetMatchingArchetype(ecs_runtime* Runtime, const archetype& Archetype);
 
 void CopyMatchingComponentValues(ecs_world* World, entity_storage_info DstStorage,
                                  entity_storage_info SrcStorage, const archetype& DstArchetype,
@@ -53,12 +53,31 @@ struct entity_storage_info
 	int16_t IndexInChunk;
 };
 
+enum entity_command_type
+{
+  ENTITY_COMMAND_Create,
+  ENTITY_COMMAND_Destroy,
+  ENTITY_COMMAND_AddComponent,
+  ENTITY_COMMAND_RemoveComponent,
+  ENTITY_COMMAND_SetComponent,
+};
+
 struct entity_command
 {
-  uint8_t*  Data;
-  entity_id Index;
-  uint16_t  Size;
-  uint16_t  Flags;
+  uint8_t*     Data;  // The component value of ENTITY_COMMAND_SetComponent
+  entity_id    Index; // Placeholders of the entities created by the same buffer are below -1
+  component_id ComponentID;
+  uint16_t     Size;
+  uint16_t     Type;
+};
+
+// Written by a single job thread, so recording needs no synchronization
+struct ecs_command_buffer
+{
+  fixed_stack<entity_command, ECS_WORLD_ENTITY_COMMAND_BUFFER_CAPACITY> Commands;
+  uint8_t Data[ECS_WORLD_ENTITY_COMMAND_DATA_SIZE];
+  int32_t DataSize;
+  int32_t CreatedEntityCount;
 };
 
 struct ecs_world
@@ -68,7 +87,8 @@ struct ecs_world
   fixed_stack<entity_storage_info, ECS_ENTITY_MAX_COUNT, entity_id> Entities;
   fixed_stack<entity_id, ECS_ENTITY_MAX_COUNT, entity_id>           VacantEntityIndices;
 
-  fixed_stack<entity_command, ECS_WORLD_ENTITY_COMMAND_BUFFER_CAPACITY> EntityCommands;
+  // Indexed by the job thread that recorded the commands
+  ecs_command_buffer CommandBuffers[JOB_SYSTEM_MAX_THREAD_COUNT];
 };
 
 // Initialization
@@ -77,6 +97,7 @@ void InitializeArchetypeAndComponentTables(ecs_runtime*                 Runtime,
                                            const component_struct_info* ComponentInfos,
                                            const char** ComponentNames, int ComponentCount);
 void InitializeWorld(ecs_world* World, const ecs_runtime* Runtime);
+// Applies and clears the deferred changes of every thread, call when no job is recording
 void RunWorldCommandBuffer(ecs_runtime* Runtime, ecs_world* World);
 
 // Integrating saved worlds (used importing deserialize'ing)
@@ -0,0 +1,265 @@
+#include "ecs_scheduler.h"
+#include "ecs_internal.h"
+#include "thread_primitives.h"
+#include "profile.h"
+#include "misc.h"
+
+#include <assert.h>
+
+static_assert(ECS_ARCHETYPE_MAX_COUNT <= 64, "The matched archetypes are a 64 bit mask");
+
+struct ecs_system_run
+{
+  ecs_system_timing* Timing;
+  job*               Jobs;
+  int32_t            JobCount;
+  job_counter        Counter; // Of the chunk jobs, a child of the frame's counter
+
+  volatile int32_t RemainingDependencyCount;
+  volatile int32_t RemainingChunkCount;
+  int32_t          Dependents[ECS_SCHEDULER_MAX_SYSTEM_COUNT];
+  int32_t          DependentCount;
+};
+
+struct ecs_system_frame
+{
+  ecs_system_run* Runs;
+  // Holds one for every unfinished system, so it also covers the systems not kicked yet
+  job_counter Counter;
+};
+
+struct ecs_system_chunk_job
+{
+  job               ChunkJob;
+  ecs_system_frame* Frame;
+  int32_t           SystemIndex;
+};
+
+static inline uint64_t
+GetSystemCycleCount()
+{
+#if defined(USE_DEBUG_PROFILING)
+  return _rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static inline bool
+IsComponentUsed(uint8_t RequestType)
+{
+  return RequestType == REQUEST_Permission_RW || RequestType == REQUEST_Permission_R;
+}
+
+static bool
+DoSystemsConflict(const ecs_system& A, uint64_t ArchetypesA, const ecs_system& B,
+                  uint64_t ArchetypesB)
+{
+  if((ArchetypesA & ArchetypesB) == 0)
+  {
+    return false;
+  }
+  for(int a = 0; a < A.ArchetypeRequest.ComponentCount; a++)
+  {
+    component_request RequestA = A.ComponentRequests[a];
+    if(!IsComponentUsed(RequestA.Type))
+    {
+      continue;
+    }
+    for(int b = 0; b < B.ArchetypeRequest.ComponentCount; b++)
+    {
+      component_request RequestB = B.ComponentRequests[b];
+      if(RequestA.ID == RequestB.ID && IsComponentUsed(RequestB.Type) &&
+         (RequestA.Type == REQUEST_Permission_RW || RequestB.Type == REQUEST_Permission_RW))
+      {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+static void StartSystem(ecs_system_frame* Frame, int32_t SystemIndex);
+
+static void
+FinishSystem(ecs_system_frame* Frame, int32_t SystemIndex)
+{
+  ecs_system_run* Run        = &Frame->Runs[SystemIndex];
+  Run->Timing->EndCycleCount = GetSystemCycleCount();
+  for(int i = 0; i < Run->DependentCount; i++)
+  {
+    int32_t Dependent = Run->Dependents[i];
+    if(AtomicAddInt32(&Frame->Runs[Dependent].RemainingDependencyCount, -1) == 0)
+    {
+      StartSystem(Frame, Dependent);
+    }
+  }
+  // Last, the frame may end as soon as this reaches zero
+  AtomicAddInt32(&Frame->Counter.Value, -1);
+}
+
+JOB_FUNCTION(ECSSystemChunkJob)
+{
+  ecs_system_chunk_job* SystemJob = (ecs_system_chunk_job*)Data;
+  SystemJob->ChunkJob.Function(SystemJob->ChunkJob.Data);
+
+  ecs_system_frame* Frame = SystemJob->Frame;
+  if(AtomicAddInt32(&Frame->Runs[SystemJob->SystemIndex].RemainingChunkCount, -1) == 0)
+  {
+    FinishSystem(Frame, SystemJob->SystemIndex);
+  }
+}
+
+static void
+StartSystem(ecs_system_frame* Frame, int32_t SystemIndex)
+{
+  ecs_system_run* Run          = &Frame->Runs[SystemIndex];
+  Run->Timing->StartCycleCount = GetSystemCycleCount();
+  Run->Timing->ThreadIndex     = GetJobThreadIndex();
+  if(Run->JobCount == 0)
+  {
+    FinishSystem(Frame, SystemIndex);
+    return;
+  }
+  KickJobs(&Run->Counter, Run->Jobs, Run->JobCount);
+}
+
+int32_t
+RegisterECSSystem(ecs_system_scheduler* Scheduler, const char* Name,
+                  const archetype_request& ArchetypeRequest, ECS_JOB_FUNCTION_PARAMETERS(JobFunc))
+{
+  assert(Scheduler->SystemCount < ECS_SCHEDULER_MAX_SYSTEM_COUNT);
+  assert(0 < ArchetypeRequest.ComponentCount &&
+         ArchetypeRequest.ComponentCount <= ECS_ARCHETYPE_COMPONENT_MAX_COUNT);
+  assert(JobFunc);
+
+  int32_t     SystemIndex = Scheduler->SystemCount++;
+  ecs_system* System      = &Scheduler->Systems[SystemIndex];
+  System->Name            = Name;
+  System->JobFunc         = JobFunc;
+  for(int i = 0; i < ArchetypeRequest.ComponentCount; i++)
+  {
+    System->ComponentRequests[i] = ArchetypeRequest.ComponentRequests[i];
+  }
+  System->ArchetypeRequest.ComponentRequests = &System->ComponentRequests[0];
+  System->ArchetypeRequest.ComponentCount    = ArchetypeRequest.ComponentCount;
+  Scheduler->Timings[SystemIndex]            = {};
+  return SystemIndex;
+}
+
+void
+RunECSSystems(ecs_system_scheduler* Scheduler, Memory::stack_allocator* TempAlloc,
+              const ecs_world* World)
+{
+  const int32_t SystemCount = Scheduler->SystemCount;
+  if(SystemCount == 0)
+  {
+    return;
+  }
+  Memory::marker FrameMarker = TempAlloc->GetMarker();
+
+  const ecs_runtime* Runtime = World->Runtime;
+  uint64_t           MatchedArchetypes[ECS_SCHEDULER_MAX_SYSTEM_COUNT];
+  ecs_system_frame   Frame;
+  Frame.Runs    = PushArray(TempAlloc, SystemCount, ecs_system_run);
+  Frame.Counter = { SystemCount, NULL };
+  for(int s = 0; s < SystemCount; s++)
+  {
+    const ecs_system& System = Scheduler->Systems[s];
+
+    MatchedArchetypes[s] = 0;
+    for(int a = 0; a < Runtime->Archetypes.Count; a++)
+    {
+      if(Runtime->Archetypes[a].FirstChunk &&
+         DoesArchetypeMatchRequest(Runtime->Archetypes[a], System.ArchetypeRequest))
+      {
+        MatchedArchetypes[s] |= (uint64_t)1 << a;
+      }
+    }
+
+    job*    ChunkJobs;
+    int32_t ChunkCount =
+      PushECSChunkJobs(&ChunkJobs, TempAlloc, World, System.ArchetypeRequest, System.JobFunc);
+    ecs_system_chunk_job* SystemJobs = PushArray(TempAlloc, ChunkCount, ecs_system_chunk_job);
+
+    ecs_system_run* Run      = &Frame.Runs[s];
+    *Run                     = {};
+    Run->Timing              = &Scheduler->Timings[s];
+    Run->Jobs                = PushArray(TempAlloc, ChunkCount, job);
+    Run->JobCount            = ChunkCount;
+    Run->Counter.Parent      = &Frame.Counter;
+    Run->RemainingChunkCount = ChunkCount;
+    for(int i = 0; i < ChunkCount; i++)
+    {
+      SystemJobs[i] = { ChunkJobs[i], &Frame, s };
+      Run->Jobs[i]  = { ECSSystemChunkJob, &SystemJobs[i] };
+    }
+
+    *Run->Timing            = {};
+    Run->Timing->ChunkCount = ChunkCount;
+    for(int d = 0; d < s; d++)
+    {
+      if(DoSystemsConflict(Scheduler->Systems[d], MatchedArchetypes[d], System,
+                           MatchedArchetypes[s]))
+      {
+        Frame.Runs[d].Dependents[Frame.Runs[d].DependentCount++] = s;
+        Run->RemainingDependencyCount++;
+        Run->Timing->Wave = MaxInt32(Run->Timing->Wave, Scheduler->Timings[d].Wave + 1);
+      }
+    }
+  }
+
+  // Collected first, the systems kicked here may already start their dependents
+  int32_t ReadySystems[ECS_SCHEDULER_MAX_SYSTEM_COUNT];
+  int32_t ReadyCount = 0;
+  for(int s = 0; s < SystemCount; s++)
+  {
+    if(Frame.Runs[s].RemainingDependencyCount == 0)
+    {
+      ReadySystems[ReadyCount++] = s;
+    }
+  }
+  for(int i = 0; i < ReadyCount; i++)
+  {
+    StartSystem(&Frame, ReadySystems[i]);
+  }
+  WaitForCounter(&Frame.Counter);
+
+#if defined(USE_DEBUG_PROFILING)
+  {
+    // Every depth lists its events in the order they start, so the systems are sorted by their
+    // start and placed at the first depth that is free by then
+    int32_t Order[ECS_SCHEDULER_MAX_SYSTEM_COUNT];
+    for(int i = 0; i < SystemCount; i++)
+    {
+      int32_t j = i;
+      for(; 0 < j && Scheduler->Timings[i].StartCycleCount <
+                       Scheduler->Timings[Order[j - 1]].StartCycleCount;
+          j--)
+      {
+        Order[j] = Order[j - 1];
+      }
+      Order[j] = i;
+    }
+
+    uint64_t LaneEndCycleCounts[ECS_SCHEDULER_MAX_SYSTEM_COUNT];
+    int32_t  LaneCount = 0;
+    for(int i = 0; i < SystemCount; i++)
+    {
+      const ecs_system_timing& Timing = Scheduler->Timings[Order[i]];
+
+      int32_t Lane = 0;
+      while(Lane < LaneCount && Timing.StartCycleCount < LaneEndCycleCounts[Lane])
+      {
+        Lane++;
+      }
+      LaneCount                = MaxInt32(LaneCount, Lane + 1);
+      LaneEndCycleCounts[Lane] = Timing.EndCycleCount;
+      PushTimerEvent(TIMER_NAME_ECSSystem, Timing.StartCycleCount, Timing.EndCycleCount,
+                     g_CurrentTimerEventDepth + Lane);
+    }
+  }
+#endif // USE_DEBUG_PROFILING
+
+  TempAlloc->FreeToMarker(FrameMarker);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "ecs.h"
+
+#define ECS_SCHEDULER_MAX_SYSTEM_COUNT 32
+
+struct ecs_system
+{
+  const char*       Name;
+  component_request ComponentRequests[ECS_ARCHETYPE_COMPONENT_MAX_COUNT];
+  archetype_request ArchetypeRequest; // Points into ComponentRequests
+  ECS_JOB_FUNCTION_PARAMETERS(JobFunc);
+};
+
+// Of the last RunECSSystems() call
+struct ecs_system_timing
+{
+  uint64_t StartCycleCount; // When its dependencies had finished
+  uint64_t EndCycleCount;   // When its last chunk had finished
+  int32_t  ThreadIndex;     // That kicked its chunk jobs
+  int32_t  Wave;            // Length of its longest dependency chain
+  int32_t  ChunkCount;
+};
+
+// Systems run in registration order where their accesses conflict and concurrently otherwise.
+// Two systems conflict if they use a component of the same archetype and at least one of them
+// writes it (REQUEST_Permission_RW). The dependencies are rebuilt every frame from the current
+// archetypes, so systems touching disjoint archetypes never wait for each other
+struct ecs_system_scheduler
+{
+  ecs_system        Systems[ECS_SCHEDULER_MAX_SYSTEM_COUNT];
+  ecs_system_timing Timings[ECS_SCHEDULER_MAX_SYSTEM_COUNT];
+  int32_t           SystemCount;
+};
+
+// Returns the system's index, the requests are copied
+int32_t RegisterECSSystem(ecs_system_scheduler* Scheduler, const char* Name,
+                          const archetype_request& ArchetypeRequest,
+                          ECS_JOB_FUNCTION_PARAMETERS(JobFunc));
+
+// Runs every registered system once and waits for all of them. Systems make structural changes
+// with the deferred entity API, they are applied by RunWorldCommandBuffer(). Emits one ECSSystem
+// timer event per system, with concurrent systems at different depths
+void RunECSSystems(ecs_system_scheduler* Scheduler, Memory::stack_allocator* TempAlloc,
+                   const ecs_world* World);
@@ -0,0 +1,27 @@
+#pragma once
+#include "ecs_scheduler.h"
+#include "component_table.h"
+#include "transform.h"
+#include "common.h"
+
+// Systems of the game's ECS world, their chunk jobs must not use TIMED_BLOCK
+
+ECS_JOB_FUNCTION(NormalizeTransformRotations)
+{
+  transform* Transforms = *(transform**)Components;
+  for(int i = 0; i < Count; i++)
+  {
+    NormalizeTransformRotation(&Transforms[i]);
+  }
+}
+
+// Registers the systems RunECSSystems() runs every frame, call once with an empty scheduler
+void
+RegisterGameECSSystems(ecs_system_scheduler* Scheduler)
+{
+  assert(Scheduler->SystemCount == 0);
+  component_request TransformRequests[] = { { COMPONENT_transform, REQUEST_Permission_RW } };
+  archetype_request TransformRequest    = { TransformRequests, ArrayCount(TransformRequests) };
+  RegisterECSSystem(Scheduler, "NormalizeTransformRotations", TransformRequest,
+                    NormalizeTransformRotations);
+}
@@ -49,15 +49,15 @@ EditWorldAndInteractWithGUI(game_state* GameState, const game_input* Input)
                          GetEntityMVPMatrix(GameState, e).e);
       if(CurrentEntity->AnimPlayer)
       {
-        glUniformMatrix4fv(glGetUniformLocation(EntityIDShaderID, "g_boneMatrices"),
-                           CurrentEntity->AnimPlayer->Skeleton->BoneCount, GL_FALSE,
-                           (float*)CurrentEntity->AnimPlayer->HierarchicalModelSpaceMatrices);
+        glUniformMatrix3x4fv(glGetUniformLocation(EntityIDShaderID, "g_boneMatrices"),
+                             CurrentEntity->AnimPlayer->Skeleton->BoneCount, GL_FALSE,
+                             (float*)CurrentEntity->AnimPlayer->SkinningMatrices);
       }
       else
       {
-        mat4 Mat4Zeros = {};
-        glUniformMatrix4fv(glGetUniformLocation(EntityIDShaderID, "g_boneMatrices"), 1, GL_FALSE,
-                           Mat4Zeros.e);
+        Anim::skinning_matrix ZeroBoneMatrix = {};
+        glUniformMatrix3x4fv(glGetUniformLocation(EntityIDShaderID, "g_boneMatrices"), 1, GL_FALSE,
+                             (float*)&ZeroBoneMatrix);
       }
       Render::model* CurrentModel = GameState->Resources.GetModel(GameState->Entities[e].ModelID);
       for(int m = 0; m < CurrentModel->MeshCount; m++)
@@ -323,9 +323,16 @@ AnimationEditorInteraction(game_state* GameState, const game_input* Input)
   assert(0 <= GameState->AnimEditor.EntityIndex &&
          GameState->AnimEditor.EntityIndex < GameState->EntityCount);
   {
-    memcpy(GameState->Entities[GameState->AnimEditor.EntityIndex]
-             .AnimPlayer->HierarchicalModelSpaceMatrices,
+    Anim::animation_player* Player =
+      GameState->Entities[GameState->AnimEditor.EntityIndex].AnimPlayer;
+    memcpy(Player->HierarchicalModelSpaceMatrices,
            GameState->AnimEditor.HierarchicalModelSpaceMatrices,
            sizeof(mat4) * GameState->AnimEditor.Skeleton->BoneCount);
+    if(Player->SkinningMatrices)
+    {
+      Anim::ComputeSkinningMatrices(Player->SkinningMatrices,
+                                    Player->HierarchicalModelSpaceMatrices,
+                                    GameState->AnimEditor.Skeleton->BoneCount);
+    }
   }
 }
@@ -222,12 +222,19 @@ EntityEditor(game_state* GameState)
         SelectedEntity->AnimPlayer->OutputTransforms =
           PushArray(GameState->PersistentMemStack,
                     ANIM_PLAYER_OUTPUT_BLOCK_COUNT * SelectedModel->Skeleton->BoneCount, transform);
-        SelectedEntity->AnimPlayer->BoneSpaceMatrices =
-          PushArray(GameState->PersistentMemStack, SelectedModel->Skeleton->BoneCount, mat4);
-        SelectedEntity->AnimPlayer->ModelSpaceMatrices =
-          PushArray(GameState->PersistentMemStack, SelectedModel->Skeleton->BoneCount, mat4);
         SelectedEntity->AnimPlayer->HierarchicalModelSpaceMatrices =
           PushArray(GameState->PersistentMemStack, SelectedModel->Skeleton->BoneCount, mat4);
+        SelectedEntity->AnimPlayer->SkinningMatrices =
+          PushArray(GameState->PersistentMemStack, SelectedModel->Skeleton->BoneCount,
+                    Anim::skinning_matrix);
+        SelectedEntity->AnimPlayer->LODState.Poses =
+          PushArray(GameState->PersistentMemStack, 2 * SelectedModel->Skeleton->BoneCount,
+                    transform);
+
+        Anim::flat_skeleton* FlatSkeleton =
+          PushStruct(GameState->PersistentMemStack, Anim::flat_skeleton);
+        Anim::BuildFlatSkeleton(FlatSkeleton, SelectedModel->Skeleton);
+        SelectedEntity->AnimPlayer->FlatSkeleton = FlatSkeleton;
       }
       else if(SelectedEntity->AnimPlayer)
       {
@@ -302,6 +309,64 @@ EntityEditor(game_state* GameState)
                 RemoveReferencesAndResetAnimPlayer(&GameState->Resources,
                                                    SelectedEntity->AnimPlayer);
               }
+
+              static int32_t       BlendAnimationIndex = -1;
+              blend_graph_preview* Preview             = &GameState->BlendGraphPreview;
+              ImGui::Combo("Blend With", &BlendAnimationIndex, PathArrayToString,
+                           GameState->Resources.AnimationPaths,
+                           GameState->Resources.AnimationPathCount);
+              ImGui::SliderFloat("Blend Factor", &Preview->BlendFactor, 0.0f, 1.0f);
+              bool ClickedStartBlend = ImGui::Button("Start Blend");
+              if(SelectedAnimationIndex >= 0 && BlendAnimationIndex >= 0 && ClickedStartBlend)
+              {
+                Anim::animation_player* Player = SelectedEntity->AnimPlayer;
+                rid                     RIDs[2] = {
+                  GameState->Resources.ObtainAnimationPathRID(
+                    GameState->Resources.AnimationPaths[SelectedAnimationIndex].Name),
+                  GameState->Resources.ObtainAnimationPathRID(
+                    GameState->Resources.AnimationPaths[BlendAnimationIndex].Name)
+                };
+                Anim::animation* Animations[2] = { GameState->Resources.GetAnimation(RIDs[0]),
+                                                   GameState->Resources.GetAnimation(RIDs[1]) };
+                if(Animations[0]->ChannelCount == Player->Skeleton->BoneCount &&
+                   Animations[1]->ChannelCount == Player->Skeleton->BoneCount)
+                {
+                  // Only one player is previewed through the graph at a time
+                  if(Preview->Player && Preview->Player->BlendFunc == BlendGraphBlendFunc)
+                  {
+                    RemoveReferencesAndResetAnimPlayer(&GameState->Resources, Preview->Player);
+                  }
+                  RemoveReferencesAndResetAnimPlayer(&GameState->Resources, Player);
+
+                  // Clip nodes are indexed like the player's animations, their pointers are
+                  // refreshed from the player before every update
+                  Preview->Graph   = {};
+                  int32_t BlendIdx = AddBlendParameter(&Preview->Graph);
+                  int32_t NodeA =
+                    AddClipNode(&Preview->Graph, Animations[0], Loop, Player->GlobalTimeSec);
+                  int32_t NodeB =
+                    AddClipNode(&Preview->Graph, Animations[1], Loop, Player->GlobalTimeSec);
+                  AddLerpNode(&Preview->Graph, NodeA, NodeB, BlendIdx);
+                  bool Compiled = CompileBlendGraph(&Preview->Program, &Preview->Graph);
+                  assert(Compiled);
+                  if(!Preview->Pool.Poses)
+                  {
+                    InitPosePool(&Preview->Pool, GameState->PersistentMemStack,
+                                 Preview->Program.PoseCount);
+                  }
+                  InitBlendGraphInstance(&Preview->Instance, &Preview->Program, &Preview->Pool,
+                                         NULL);
+
+                  for(int i = 0; i < 2; i++)
+                  {
+                    Anim::SetAnimation(Player, RIDs[i], i);
+                    GameState->Resources.Animations.AddReference(RIDs[i]);
+                  }
+                  Player->AnimStateCount = 2;
+                  Player->BlendFunc      = BlendGraphBlendFunc;
+                  Preview->Player        = Player;
+                }
+              }
             }
           }
 
@@ -416,6 +481,13 @@ EntityEditor(game_state* GameState)
                 sprintf(TempBuffer, "MM Entity Index: %d", MMEntityIndex);
                 ImGui::Text(TempBuffer);
 
+                int32_t BlendStackCapacity = MMEntity.BlendStack->Capacity;
+                if(ImGui::SliderInt("Blend Stack Capacity", &BlendStackCapacity, 1,
+                                    BLEND_STACK_MAX_CAPACITY))
+                {
+                  SetBlendStackCapacity(MMEntity.BlendStack, BlendStackCapacity);
+                }
+
                 // static bool s_ShowInputControlParameters = false;
                 if(ImGui::TreeNode("Movement Control Options"))
                 {
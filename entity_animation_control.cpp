@@ -1,7 +1,7 @@
 #include "entity_animation_control.h"
 #include "debug_drawing.h"
 
-void DrawFrameInfo(mm_frame_info AnimGoal, mat4 CoordinateFrame,
+void DrawFrameInfo(mm_frame_info AnimGoal, const mm_feature_layout& Layout, mat4 CoordinateFrame,
                    mm_info_debug_settings DebugSettings, vec3 BoneColor, vec3 VelocityColor,
                    vec3 TrajectoryColor, vec3 DirectionColor);
 
@@ -12,7 +12,7 @@ void
 SetDefaultMMControllerFileds(mm_aos_entity_data* MMEntityData)
 {
   *MMEntityData->MMControllerRID = {};
-  *MMEntityData->BlendStack      = {};
+  InitBlendStack(MMEntityData->BlendStack, BLEND_STACK_DEFAULT_CAPACITY);
   *MMEntityData->EntityIndex     = -1;
   *MMEntityData->FollowSpline    = false;
   *MMEntityData->SplineState     = { };
@@ -251,12 +251,12 @@ FetchAnimationPointers(Resource::resource_manager* Resources, mm_controller_data
 {
   for(int i = 0; i < Count; i++)
   {
-    MMControllers[i]->Animations.HardClear();
+    assert(MMControllers[i]->Animations.Count == MMControllers[i]->Params.AnimRIDs.Count);
     for(int j = 0; j < MMControllers[i]->Params.AnimRIDs.Count; j++)
     {
       Anim::animation* Anim = Resources->GetAnimation(MMControllers[i]->Params.AnimRIDs[j]);
       assert(Anim);
-      MMControllers[i]->Animations.Push(Anim);
+      MMControllers[i]->Animations[j] = Anim;
     }
 
     for(int j = 0; j < BlendStacks[i].Count; j++)
@@ -287,26 +287,29 @@ PlayAnimsIfBlendStacksAreEmpty(blend_stack* BSs, float* GlobalTimes,
 
 void
 DrawGoalFrameInfos(const mm_frame_info* GoalInfos, const blend_stack* BlendStacks,
-                   const transform* LastMatchTransforms, int32_t Count,
+                   const transform* LastMatchTransforms,
+                   const mm_controller_data* const* MMControllers, int32_t Count,
                    const mm_info_debug_settings* MMInfoDebug, vec3 BoneColor, vec3 TrajectoryColor,
                    vec3 DirectionColor)
 {
   for(int i = 0; i < Count; i++)
   {
-    DrawFrameInfo(GoalInfos[i], TransformToMat4(LastMatchTransforms[i]), *MMInfoDebug, BoneColor,
-                  BoneColor, TrajectoryColor, DirectionColor);
+    DrawFrameInfo(GoalInfos[i], MMControllers[i]->Layout, TransformToMat4(LastMatchTransforms[i]),
+                  *MMInfoDebug, BoneColor, BoneColor, TrajectoryColor, DirectionColor);
   }
 }
 
 void
-DrawGoalFrameInfos(const mm_frame_info* GoalInfos, const int32_t* EntityIndices, int32_t Count,
+DrawGoalFrameInfos(const mm_frame_info* GoalInfos, const int32_t* EntityIndices,
+                   const mm_controller_data* const* MMControllers, int32_t Count,
                    const entity* Entities, const mm_info_debug_settings* MMInfoDebug,
                    vec3 BoneColor, vec3 TrajectoryColor, vec3 DirectionColor)
 {
   for(int i = 0; i < Count; i++)
   {
-    DrawFrameInfo(GoalInfos[i], TransformToMat4(Entities[EntityIndices[i]].Transform), *MMInfoDebug,
-                  BoneColor, BoneColor, TrajectoryColor, DirectionColor);
+    DrawFrameInfo(GoalInfos[i], MMControllers[i]->Layout,
+                  TransformToMat4(Entities[EntityIndices[i]].Transform), *MMInfoDebug, BoneColor,
+                  BoneColor, TrajectoryColor, DirectionColor);
   }
 }
 
@@ -500,12 +503,12 @@ mm_frame_info
 VisualFlipGoalX(const mm_frame_info& Goal)
 {
   mm_frame_info FlippedGoal = Goal;
-  for(int i = 0; i < MM_COMPARISON_BONE_COUNT; i++)
+  for(int i = 0; i < MM_MAX_COMPARISON_BONE_COUNT; i++)
   {
     FlippedGoal.BonePs[i].X *= -1;
     FlippedGoal.BoneVs[i].X *= -1;
   }
-  for(int i = 0; i < MM_POINT_COUNT; i++)
+  for(int i = 0; i < MM_MAX_POINT_COUNT; i++)
   {
     FlippedGoal.TrajectoryPs[i].X *= -1;
     FlippedGoal.TrajectoryAngles[i] *= -1;
@@ -535,30 +538,133 @@ IsNewAnimSufficientlyFarAway(const Anim::animation* NewAnim, float NewAnimLocalS
   return true;
 }
 
+// Frame of the controller's set at the top of the blend stack
+mm_continuation
+GetMMContinuation(const blend_stack& BlendStack, const mm_controller_data* MMController,
+                  float GlobalTime)
+{
+  mm_continuation Result = { -1, 0.0f, false };
+  if(0 < BlendStack.Count)
+  {
+    const blend_in_info ActiveAnimBlend = BlendStack.Peek();
+    if(0 <= ActiveAnimBlend.IndexInSet &&
+       ActiveAnimBlend.IndexInSet < MMController->Animations.Count &&
+       MMController->Animations[ActiveAnimBlend.IndexInSet] == ActiveAnimBlend.Animation)
+    {
+      Result.AnimIndex  = ActiveAnimBlend.IndexInSet;
+      Result.LocalTime  = GetLocalSampleTime(ActiveAnimBlend.Animation, GlobalTime,
+                                            ActiveAnimBlend.GlobalAnimStartTime);
+      Result.IsMirrored = ActiveAnimBlend.Mirror;
+    }
+  }
+  return Result;
+}
+
 void
 MotionMatchGoals(blend_stack* OutBlendStacks, mm_frame_info* LastMatchedGoals,
-                 transform* OutLastMatchedTransforms, const mm_frame_info* AnimGoals,
+                 transform* OutLastMatchedTransforms, mm_search_stats* OutStats,
+                 mm_telemetry* Telemetry, const mm_frame_info* AnimGoals,
                  const mm_frame_info*             MirroredAnimGoals,
-                 const mm_controller_data* const* MMControllers, const float* GlobalTimes,
-                 const int32_t* EntityIndices, int32_t Count, entity* Entities)
+                 const mm_controller_data* const* MMControllers, const rid* MMControllerRIDs,
+                 const float* GlobalTimes, const int32_t* EntityIndices, int32_t Count,
+                 entity* Entities, bool SearchFromContinuation)
 {
+  assert(Count <= MM_CONTROLLER_MAX_COUNT);
+  int32_t       NewAnimIndices[MM_CONTROLLER_MAX_COUNT];
+  float         NewAnimLocalStartTimes[MM_CONTROLLER_MAX_COUNT];
+  bool          NewMatchesAreMirrored[MM_CONTROLLER_MAX_COUNT];
+  mm_frame_info BestMatches[MM_CONTROLLER_MAX_COUNT];
+
+  // Search once per controller for all of the entities sharing it
+  bool IsMatched[MM_CONTROLLER_MAX_COUNT] = {};
   for(int i = 0; i < Count; i++)
   {
-    int32_t NewAnimIndex;
-    float   NewAnimLocalStartTime;
-    bool    NewMatchIsMirrored = false;
+    if(IsMatched[i])
+    {
+      continue;
+    }
+    const mm_controller_data* MMController = MMControllers[i];
+    const bool MatchMirrors = MMController->Params.DynamicParams.MatchMirroredAnimations;
 
-    mm_frame_info BestMatch = {};
-    if(!MMControllers[i]->Params.DynamicParams.MatchMirroredAnimations)
+    int32_t         BatchEntityIndices[MM_CONTROLLER_MAX_COUNT];
+    mm_frame_info   BatchGoals[MM_CONTROLLER_MAX_COUNT];
+    mm_frame_info   BatchMirroredGoals[MM_CONTROLLER_MAX_COUNT];
+    mm_continuation BatchContinuations[MM_CONTROLLER_MAX_COUNT];
+    int32_t         BatchCount = 0;
+    for(int j = i; j < Count; j++)
     {
-      MotionMatch(&NewAnimIndex, &NewAnimLocalStartTime, &BestMatch, MMControllers[i],
-                  AnimGoals[i]);
+      if(MMControllers[j] == MMController)
+      {
+        IsMatched[j]                   = true;
+        BatchEntityIndices[BatchCount] = j;
+        BatchGoals[BatchCount]         = AnimGoals[j];
+        BatchMirroredGoals[BatchCount] = MirroredAnimGoals[j];
+        BatchContinuations[BatchCount] =
+          GetMMContinuation(OutBlendStacks[j], MMController, GlobalTimes[j]);
+        BatchCount++;
+      }
     }
-    else
+
+    int32_t       BatchAnimIndices[MM_CONTROLLER_MAX_COUNT];
+    float         BatchLocalStartTimes[MM_CONTROLLER_MAX_COUNT];
+    mm_frame_info BatchBestMatches[MM_CONTROLLER_MAX_COUNT];
+    bool          BatchMatchesAreMirrored[MM_CONTROLLER_MAX_COUNT];
+    mm_search_stats BatchStats = {};
+    int64_t         BatchStart = Platform::GetCurrentCounter();
+    MotionMatchBatch(NULL, BatchAnimIndices, BatchLocalStartTimes, BatchBestMatches,
+                     BatchMatchesAreMirrored, &BatchStats, MMController, BatchGoals,
+                     MatchMirrors ? BatchMirroredGoals : NULL,
+                     SearchFromContinuation ? BatchContinuations : NULL, BatchCount);
+    int64_t BatchEnd = Platform::GetCurrentCounter();
+    if(OutStats)
+    {
+      AddMMSearchStats(OutStats, BatchStats);
+    }
+
+    if(Telemetry)
+    {
+      const rid ControllerRID = MMControllerRIDs[i];
+      RecordMMSearches(Telemetry, ControllerRID, BatchStats.SearchCount, BatchStats.FramesTouched,
+                       BatchStats.FramesCutShort,
+                       (int64_t)(1e6f * Platform::GetTimeInSeconds(BatchStart, BatchEnd)));
+      for(int b = 0; b < BatchCount; b++)
+      {
+        const mm_frame_info& Goal =
+          BatchMatchesAreMirrored[b] ? BatchMirroredGoals[b] : BatchGoals[b];
+        float GoalFeatures[MM_MAX_FEATURE_ROW_COUNT];
+        float MatchFeatures[MM_MAX_FEATURE_ROW_COUNT];
+        GetFrameInfoFeatures(GoalFeatures, Goal, MMController->Layout);
+        GetFrameInfoFeatures(MatchFeatures, BatchBestMatches[b], MMController->Layout);
+
+        float BonePCost;
+        float BoneVCost;
+        float TrajPCost;
+        float TrajVCost;
+        float TrajACost;
+        ComputeCostComponents(&BonePCost, &BoneVCost, &TrajPCost, &TrajVCost, &TrajACost,
+                              GoalFeatures, MatchFeatures, MMController->Layout,
+                              MMController->Params.DynamicParams);
+        RecordMMWinnerCost(Telemetry, ControllerRID, BonePCost, BoneVCost, TrajPCost, TrajVCost,
+                           TrajACost);
+      }
+    }
+
+    for(int b = 0; b < BatchCount; b++)
     {
-      MotionMatchWithMirrors(&NewAnimIndex, &NewAnimLocalStartTime, &BestMatch, &NewMatchIsMirrored,
-                             MMControllers[i], AnimGoals[i], MirroredAnimGoals[i]);
+      int32_t EntityIndex                 = BatchEntityIndices[b];
+      NewAnimIndices[EntityIndex]         = BatchAnimIndices[b];
+      NewAnimLocalStartTimes[EntityIndex] = BatchLocalStartTimes[b];
+      BestMatches[EntityIndex]            = BatchBestMatches[b];
+      NewMatchesAreMirrored[EntityIndex]  = BatchMatchesAreMirrored[b];
     }
+  }
+
+  for(int i = 0; i < Count; i++)
+  {
+    int32_t       NewAnimIndex          = NewAnimIndices[i];
+    float         NewAnimLocalStartTime = NewAnimLocalStartTimes[i];
+    bool          NewMatchIsMirrored    = NewMatchesAreMirrored[i];
+    mm_frame_info BestMatch             = BestMatches[i];
 
     const Anim::animation* MatchedAnim = MMControllers[i]->Animations[NewAnimIndex];
 
@@ -575,59 +681,16 @@ MotionMatchGoals(blend_stack* OutBlendStacks, mm_frame_info* LastMatchedGoals,
       // Store the transform of where the last match occured
       OutLastMatchedTransforms[i] = Entities[EntityIndices[i]].Transform;
     }
-  }
-}
-
-transform
-GetLocalAnimRootMotionDelta(Anim::animation* RootMotionAnim, const Anim::skeleton* Skeleton,
-                            bool MirrorRootMotionInX, float LocalSampleTime, float dt)
-{
-  assert(RootMotionAnim);
-
-  const int HipBoneIndex = 0;
-
-  transform RootDelta = IdentityTransform();
-
-  float NextSampleTime = LocalSampleTime + dt;
-
-  transform CurrentHipTransform =
-    Anim::LinearAnimationBoneSample(RootMotionAnim, HipBoneIndex, LocalSampleTime);
-  transform NextHipTransform =
-    Anim::LinearAnimationBoneSample(RootMotionAnim, HipBoneIndex, NextSampleTime);
-
-  {
-    // mat4 Mat4CurrentHip = TransformToMat4(CurrentHipTransform);
-    mat4 Mat4CurrentHip =
-      Math::MulMat4(Skeleton->Bones[HipBoneIndex].BindPose, TransformToMat4(CurrentHipTransform));
-    mat4 Mat4CurrentRoot;
-    mat4 Mat4InvCurrentRoot;
-    Anim::GetRootAndInvRootMatrices(&Mat4CurrentRoot, &Mat4InvCurrentRoot, Mat4CurrentHip);
+    else if(Telemetry)
     {
-      // mat4 Mat4NextHip = TransformToMat4(NextHipTransform);
-      mat4 Mat4NextHip =
-        Math::MulMat4(Skeleton->Bones[HipBoneIndex].BindPose, TransformToMat4(NextHipTransform));
-      mat4 Mat4NextRoot;
-      Anim::GetRootAndInvRootMatrices(&Mat4NextRoot, NULL, Mat4NextHip);
-      {
-        mat4 Mat4LocalRootDelta = Math::MulMat4(Mat4InvCurrentRoot, Mat4NextRoot);
-        quat dR                 = Math::QuatFromTo(Mat4CurrentRoot.Z, Mat4NextRoot.Z);
-        if(MirrorRootMotionInX)
-        {
-          Mat4LocalRootDelta = Math::MulMat4(Math::Mat4Scale(-1, 1, 1), Mat4LocalRootDelta);
-          dR                 = Math::QuatFromTo(Mat4NextRoot.Z, Mat4CurrentRoot.Z);
-        }
-
-        vec3 dT     = Mat4LocalRootDelta.T;
-        RootDelta.T = dT;
-        RootDelta.R = dR;
-        return RootDelta;
-      }
+      RecordMMKeptClip(Telemetry, MMControllerRIDs[i]);
     }
   }
 }
 
 void
-ComputeLocalRootMotion(transform* OutLocalDeltaRootMotions, const Anim::skeleton* const* Skeletons,
+ComputeLocalRootMotion(transform* OutLocalDeltaRootMotions,
+                       const mm_controller_data* const* MMControllers,
                        const blend_stack* BlendStacks, const float* GlobalTimes, int32_t Count,
                        float dt)
 {
@@ -637,9 +700,12 @@ ComputeLocalRootMotion(transform* OutLocalDeltaRootMotions, const Anim::skeleton
     Anim::animation* RootMotionAnim = AnimBlend.Animation;
     float            LocalSampleTime =
       Anim::GetLocalSampleTime(RootMotionAnim, GlobalTimes[i], AnimBlend.GlobalAnimStartTime);
+    const array_handle<Anim::root_motion_key>& RootMotionTrack =
+      MMControllers[i]->RootMotionTracks[AnimBlend.IndexInSet];
+    assert(RootMotionTrack.Count == RootMotionAnim->KeyframeCount);
     OutLocalDeltaRootMotions[i] =
-      GetLocalAnimRootMotionDelta(RootMotionAnim, Skeletons[i], AnimBlend.Mirror, LocalSampleTime,
-                                  dt);
+      Anim::SampleRootMotionDelta(RootMotionTrack.Elements, RootMotionAnim, LocalSampleTime, dt,
+                                  AnimBlend.Mirror);
   }
 }
 
@@ -678,20 +744,19 @@ AdvanceAnimPlayerTimes(float* InOutAnimPlayerTimes, int32_t Count, float dt)
 }
 
 void
-RemoveBlendedOutAnimsFromBlendStacks(blend_stack* InOutBlendStacks, const float* GlobalPlayTimes,
-                                     int32_t Count)
+RemoveBlendedOutAnimsFromBlendStacks(blend_stack* InOutBlendStacks, int32_t Count)
 {
   for(int i = 0; i < Count; i++)
   {
-    for(int j = InOutBlendStacks[i].Count - 1; j >= 1; j--)
+    blend_stack* BlendStack = &InOutBlendStacks[i];
+    for(int j = BlendStack->Count - 1; j >= 1; j--)
     {
-      blend_in_info TempBlendInfo = InOutBlendStacks[i][j];
-
-      if((GlobalPlayTimes[i] - TempBlendInfo.GlobalBlendStartTime) >= TempBlendInfo.BlendDuration)
+      // Everything below a fully blended in animation no longer contributes to the pose
+      if(BlendStack->Weights[BlendStack->GetSlot(j)] >= 1.0f)
       {
         for(int k = 0; k < j; k++)
         {
-          InOutBlendStacks[i].PopBack();
+          BlendStack->PopBack();
         }
         break;
       }
@@ -700,39 +765,24 @@ RemoveBlendedOutAnimsFromBlendStacks(blend_stack* InOutBlendStacks, const float*
 }
 
 void
-CopyMMAnimDataToAnimationPlayers(entity* OutEntities, const blend_stack* BlendStacks,
-                                 const float* GlobalPlayTimes, const int32_t* EntityIndices,
-                                 int32_t Count)
+BindBlendStacksToAnimationPlayers(entity* OutEntities, const float* GlobalPlayTimes,
+                                  const int32_t* EntityIndices, int32_t Count)
 {
   for(int e = 0; e < Count; e++)
   {
     Anim::animation_player* C = OutEntities[EntityIndices[e]].AnimPlayer;
     C->BlendFunc              = BlendStackBlendFunc;
     C->GlobalTimeSec          = GlobalPlayTimes[e];
-    for(int i = 0; i < ANIM_PLAYER_MAX_ANIM_COUNT; i++)
-    {
-      C->States[i] = {};
-    }
-    C->AnimStateCount = BlendStacks[e].Count;
-
-    for(int a = 0; a < C->AnimStateCount; a++)
-    {
-      const blend_in_info BlendInfo = BlendStacks[e][a];
-      C->Animations[a]              = BlendInfo.Animation;
-      C->States[a].StartTimeSec     = BlendInfo.GlobalAnimStartTime;
-      C->States[a].Mirror           = BlendInfo.Mirror;
-      C->States[a].Loop             = BlendInfo.Loop;
-      C->States[a].PlaybackRateSec  = 1.0f;
-    }
   }
 }
 
 void
-DrawFrameInfo(mm_frame_info AnimGoal, mat4 CoordinateFrame, mm_info_debug_settings DebugSettings,
-              vec3 BoneColor, vec3 VelocityColor, vec3 TrajectoryColor, vec3 DirectionColor)
+DrawFrameInfo(mm_frame_info AnimGoal, const mm_feature_layout& Layout, mat4 CoordinateFrame,
+              mm_info_debug_settings DebugSettings, vec3 BoneColor, vec3 VelocityColor,
+              vec3 TrajectoryColor, vec3 DirectionColor)
 {
 	const vec3 VerticalOffset{0, 0.005f, 0};
-  for(int i = 0; i < MM_COMPARISON_BONE_COUNT; i++)
+  for(int i = 0; i < Layout.BoneCount; i++)
   {
     vec4 HomogLocalBoneP = { AnimGoal.BonePs[i], 1 };
     vec3 WorldBoneP      = Math::MulMat4Vec4(CoordinateFrame, HomogLocalBoneP).XYZ;
@@ -753,7 +803,7 @@ DrawFrameInfo(mm_frame_info AnimGoal, mat4 CoordinateFrame, mm_info_debug_settin
   vec3 PrevWorldTrajectoryPointP = CoordinateFrame.T;
   if(DebugSettings.ShowTrajectory)
   {
-    for(int i = 0; i < MM_POINT_COUNT; i++)
+    for(int i = 0; i < Layout.PointCount; i++)
     {
       vec4 HomogTrajectoryPointP = { AnimGoal.TrajectoryPs[i], 1 };
       vec3 WorldTrajectoryPointP = Math::MulMat4Vec4(CoordinateFrame, HomogTrajectoryPointP).XYZ;
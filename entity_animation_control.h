@@ -2,6 +2,7 @@
 
 #include "movement_spline.h"
 #include "motion_matching.h"
+#include "mm_telemetry.h"
 #include "goal_gen.h"
 #include "rid.h"
 
@@ -126,11 +127,13 @@ void PlayAnimsIfBlendStacksAreEmpty(blend_stack* BSs, float* GlobalTimes,
                                     const mm_controller_data* const* MMControllers, int32_t Count);
 
 void DrawGoalFrameInfos(const mm_frame_info* GoalInfos, const blend_stack* BlendStacks,
-                        const transform* LastMatchTransforms, int32_t Count,
+                        const transform* LastMatchTransforms,
+                        const mm_controller_data* const* MMControllers, int32_t Count,
                         const mm_info_debug_settings* MMInfoDebug, vec3 BoneColor,
                         vec3 TrajectoryColor, vec3 DirectionColor);
 
-void DrawGoalFrameInfos(const mm_frame_info* GoalInfos, const int32_t* EntityIndices, int32_t Count,
+void DrawGoalFrameInfos(const mm_frame_info* GoalInfos, const int32_t* EntityIndices,
+                        const mm_controller_data* const* MMControllers, int32_t Count,
                         const entity* Entities, const mm_info_debug_settings* MMInfoDebug,
                         vec3 BoneColor = { 1, 0, 1 }, vec3 TrajectoryColor = { 0, 0, 1 },
                         vec3 DirectionColor = { 1, 0, 0 });
@@ -163,23 +166,30 @@ void GenerateGoalsFromSplines(Memory::stack_allocator* TempAlloc, mm_frame_info*
                               int32_t Count, const movement_spline* Splines,
                               int32_t DebugSplineCount, const entity* Entities);
 
+// With SearchFromContinuation the searches start from the frame each entity is playing, which
+// gives the same matches while scoring fewer frames. OutStats and Telemetry can be NULL
 void MotionMatchGoals(blend_stack* OutBlendStacks, mm_frame_info* LastMatchedGoals,
-                      transform* OutLastMatchedTransforms, const mm_frame_info* AnimGoals,
+                      transform* OutLastMatchedTransforms, mm_search_stats* OutStats,
+                      mm_telemetry* Telemetry, const mm_frame_info* AnimGoals,
                       const mm_frame_info*             MirroredAnimGoals,
-                      const mm_controller_data* const* MMControllers, const float* GlobalTimes,
-                      const int32_t* EntityIndices, int32_t Count, entity* Entities);
-void ComputeLocalRootMotion(transform*                   OutLocalDeltaRootMotions,
-                            const Anim::skeleton* const* Skeletons, const blend_stack* BlendStacks,
-                            const float* GlobalTimes, int32_t Count, float dt);
+                      const mm_controller_data* const* MMControllers, const rid* MMControllerRIDs,
+                      const float* GlobalTimes, const int32_t* EntityIndices, int32_t Count,
+                      entity* Entities, bool SearchFromContinuation);
+// Samples the controllers' root motion tracks of the dominant blends
+void ComputeLocalRootMotion(transform*                       OutLocalDeltaRootMotions,
+                            const mm_controller_data* const* MMControllers,
+                            const blend_stack* BlendStacks, const float* GlobalTimes,
+                            int32_t Count, float dt);
 
 void ApplyRootMotion(entity* InOutEntities, trajectory* Trajectories,
                      const transform* LocalDeltaRootMotions, int32_t* EntityIndices, int32_t Count);
 
 void AdvanceAnimPlayerTimes(float* InOutAnimPlayerTimes, int32_t Count, float dt);
 
-void RemoveBlendedOutAnimsFromBlendStacks(blend_stack* InOutBlendStacks,
-                                          const float* GlobalPlayTimes, int32_t Count);
+// Expects the weights of the current frame, see UpdateBlendStackWeights()
+void RemoveBlendedOutAnimsFromBlendStacks(blend_stack* InOutBlendStacks, int32_t Count);
 
-void CopyMMAnimDataToAnimationPlayers(entity* OutEntities, const blend_stack* BlendStacks,
-                                      const float* GlobalPlayTimes, const int32_t* EntityIndices,
-                                      int32_t Count);
+// The players evaluate the blend stacks in place through the playback_infos set up for rendering,
+// nothing but the time is copied
+void BindBlendStacksToAnimationPlayers(entity* OutEntities, const float* GlobalPlayTimes,
+                                       const int32_t* EntityIndices, int32_t Count);
@@ -5,6 +5,7 @@
 
 #include "model.h"
 #include "anim.h"
+#include "anim_system.h"
 #include "skeleton.h"
 #include "linear_math/vector.h"
 #include "linear_math/matrix.h"
@@ -21,8 +22,10 @@
 #include "dynamics.h"
 #include "motion_matching.h"
 #include "ecs_management.h"
+#include "ecs_scheduler.h"
 #include "movement_spline.h"
 #include "blend_stack.h"
+#include "blend_graph.h"
 #include "entity_animation_control.h"
 #include "testing_system.h"
 #include "load_texture.h"
@@ -46,6 +49,9 @@ static const char* g_SelectionEnumStrings[SELECT_EnumCount] = { FOR_ALL_NAMES(GE
 #undef GENERATE_ENUM
 #undef GENERATE_STRING
 
+// Most animations a profile edited in the GUI can list, built controllers have no such limit
+#define MM_PROFILE_EDITOR_ANIM_CAPACITY 1024
+
 struct mm_profile_editor
 {
   mm_params ActiveProfile;
@@ -53,6 +59,17 @@ struct mm_profile_editor
   bool      SyncDynamic;
 };
 
+// Debug preview of two animations lerped by a blend graph, drives at most one player at a time
+struct blend_graph_preview
+{
+  Anim::animation_player* Player;
+  blend_graph             Graph;
+  blend_program           Program;
+  blend_graph_instance    Instance;
+  pose_pool               Pool; // Pushed on the persistent stack on first use
+  float                   BlendFactor;
+};
+
 struct game_state
 {
   Memory::stack_allocator* PersistentMemStack;
@@ -67,8 +84,9 @@ struct game_state
   Resource::resource_manager Resources;
   physics_world              Physics;
 
-  ecs_runtime* ECSRuntime;
-  ecs_world*   ECSWorld;
+  ecs_runtime*         ECSRuntime;
+  ecs_world*           ECSWorld;
+  ecs_system_scheduler ECSScheduler;
 
   camera Camera;
   camera PreviewCamera;
@@ -77,6 +95,13 @@ struct game_state
   mm_profile_editor MMEditor;
   mm_debug_settings MMDebug;
   mm_timeline_state MMTimelineState;
+  mm_search_stats   MMSearchStats; // Of the last update
+  mm_telemetry      MMTelemetry;
+
+  blend_graph_preview BlendGraphPreview;
+
+  anim_lod_settings AnimLODSettings;
+  anim_lod_counters AnimLODCounters; // Of the last update
 
   testing_system TestingSystem;
 
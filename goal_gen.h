@@ -38,7 +38,7 @@ inline void
 GetGoalAndUpdateTrajectory(mm_frame_info* OutGoal, trajectory* Trajectory,
                            const mat4& InvEntityMatrix, const float PositionBias,
                            const float DirectionBias, vec3 DesiredLocalVelocity,
-                           vec3 DesiredLocalFacing)
+                           vec3 DesiredLocalFacing, const mm_fixed_params& Params)
 {
   const float SampleFrequency = HALF_TRAJECTORY_TRANSFORM_COUNT;
 
@@ -93,10 +93,10 @@ GetGoalAndUpdateTrajectory(mm_frame_info* OutGoal, trajectory* Trajectory,
   //
   {
     // Generate a goal from this array
-    for(int i = 0; i < MM_POINT_COUNT; i++)
+    for(int i = 0; i < Params.TrajectorySampleTimes.Count; i++)
     {
       int TrajectoryPointIndex =
-        int(float(i + 1) * float(HALF_TRAJECTORY_TRANSFORM_COUNT - 1) / float(MM_POINT_COUNT));
+        int(Params.TrajectorySampleTimes[i] * float(HALF_TRAJECTORY_TRANSFORM_COUNT - 1));
 
       trajectory_transform PointTransform =
         Trajectory->Transforms[HALF_TRAJECTORY_TRANSFORM_COUNT + TrajectoryPointIndex];
@@ -122,18 +122,17 @@ struct trajectory_update_args
 inline void
 GetLongtermGoal(mm_frame_info* OutGoal, trajectory* Trajectory, vec3 StartVelocity,
                 vec3 DesiredVelocity, vec3 DesiredFacing, float TimeHorizon,
-                const trajectory_update_args* TrajectoryArgs)
+                const mm_fixed_params& Params, const trajectory_update_args* TrajectoryArgs)
 {
   if(TrajectoryArgs)
   {
     GetGoalAndUpdateTrajectory(OutGoal, Trajectory, TrajectoryArgs->InvEntityMatrix,
                                TrajectoryArgs->PositionBias, TrajectoryArgs->DirectionBias,
-                               DesiredVelocity, DesiredFacing);
+                               DesiredVelocity, DesiredFacing, Params);
   }
   else
   {
-    const float Step       = 1 / 60.0f;
-    float       PointDelta = TimeHorizon / MM_POINT_COUNT;
+    const float Step = 1 / 60.0f;
 
     assert(Math::Length(DesiredFacing) > 0.5f);
     float GoalAngle = atan2f(DesiredFacing.X, DesiredFacing.Z);
@@ -141,9 +140,9 @@ GetLongtermGoal(mm_frame_info* OutGoal, trajectory* Trajectory, vec3 StartVeloci
     vec3  CurrentPoint    = {};
     vec3  CurrentVelocity = StartVelocity;
     float Elapsed         = 0.0f;
-    for(int p = 0; p < MM_POINT_COUNT; p++)
+    for(int p = 0; p < Params.TrajectorySampleTimes.Count; p++)
     {
-      float PointTimeHorizon = (p + 1) * PointDelta;
+      float PointTimeHorizon = Params.TrajectorySampleTimes[p] * TimeHorizon;
       for(; Elapsed <= PointTimeHorizon; Elapsed += Step)
       {
         CurrentPoint += CurrentVelocity * Step;
@@ -156,7 +155,7 @@ GetLongtermGoal(mm_frame_info* OutGoal, trajectory* Trajectory, vec3 StartVeloci
       OutGoal->TrajectoryPs[p] = CurrentPoint;
       OutGoal->TrajectoryVs[p] = Math::Length(CurrentVelocity);
       {
-        float t = (p + 1) / float(MM_POINT_COUNT);
+        float t = Params.TrajectorySampleTimes[p];
 
         OutGoal->TrajectoryAngles[p] = t * GoalAngle;
       }
@@ -270,7 +269,7 @@ GetPoseGoal(mm_frame_info* OutPose, mm_frame_info* OutMirrorPose, vec3* OutRootV
   if(OutMirrorPose && GenerateMirrorInfo)
   {
     mat3 MirrorMatrix = Math::Mat3Scale(MirrorMatrixDiagonal);
-    for(int b = 0; b < MM_COMPARISON_BONE_COUNT; b++)
+    for(int b = 0; b < Params.ComparisonBoneIndices.Count; b++)
     {
       OutMirrorPose->BonePs[b] = Math::MulMat3Vec3(MirrorMatrix, OutMirrorPose->BonePs[b]);
       OutMirrorPose->BoneVs[b] = Math::MulMat3Vec3(MirrorMatrix, OutMirrorPose->BoneVs[b]);
@@ -299,7 +298,7 @@ GetPoseGoal(mm_frame_info* OutPose, mm_frame_info* OutMirrorPose, vec3* OutRootV
 inline void
 CopyLongtermGoalFromRightToLeft(mm_frame_info* Dest, mm_frame_info Src)
 {
-  for(int i = 0; i < MM_POINT_COUNT; i++)
+  for(int i = 0; i < MM_MAX_POINT_COUNT; i++)
   {
     Dest->TrajectoryPs[i]     = Src.TrajectoryPs[i];
     Dest->TrajectoryVs[i]     = Src.TrajectoryVs[i];
@@ -315,7 +314,7 @@ MirrorLongtermGoal(mm_frame_info* InOutInfo, vec3 MirrorMatDiagonal = { -1, 1, 1
          3.0f);
 
   mat3 MirrorMatrix = Math::Mat3Scale(MirrorMatDiagonal);
-  for(int i = 0; i < MM_POINT_COUNT; i++)
+  for(int i = 0; i < MM_MAX_POINT_COUNT; i++)
   {
     InOutInfo->TrajectoryPs[i] = Math::MulMat3Vec3(MirrorMatrix, InOutInfo->TrajectoryPs[i]);
     InOutInfo->TrajectoryAngles[i] *= -1;
@@ -342,7 +341,7 @@ GetMMGoal(mm_frame_info* OutGoal, mm_frame_info* OutMirroredGoal, trajectory* Co
   {
     *OutGoal = MirroredAnimPose;
     GetLongtermGoal(OutGoal, ControlTrajectory, MirroredAnimVelocity, DesiredVelocity,
-                    DesiredFacing, TimeHorizon, TrajectoryArgs);
+                    DesiredFacing, TimeHorizon, Params, TrajectoryArgs);
 
     *OutMirroredGoal = AnimPose;
   }
@@ -350,7 +349,7 @@ GetMMGoal(mm_frame_info* OutGoal, mm_frame_info* OutMirroredGoal, trajectory* Co
   {
     *OutGoal = AnimPose;
     GetLongtermGoal(OutGoal, ControlTrajectory, AnimVelocity, DesiredVelocity, DesiredFacing,
-                    TimeHorizon, TrajectoryArgs);
+                    TimeHorizon, Params, TrajectoryArgs);
 
     *OutMirroredGoal = MirroredAnimPose;
   }
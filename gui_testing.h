@@ -103,6 +103,20 @@ MMWindows(game_state* GameState, const game_input* Input, bool& s_ShowMotionMatc
 
     mm_debug_settings& MMDebug = GameState->MMDebug;
     UI::Checkbox("Apply Root Motion", &MMDebug.ApplyRootMotion);
+    UI::Checkbox("Search From Continuation", &MMDebug.SearchFromContinuation);
+    {
+      const mm_search_stats& Stats = GameState->MMSearchStats;
+      char TempBuffer[64];
+      sprintf(TempBuffer, "Searches: %d", Stats.SearchCount);
+      UI::Text(TempBuffer);
+      sprintf(TempBuffer, "Frames touched per search: %d",
+              (0 < Stats.SearchCount) ? Stats.FramesTouched / Stats.SearchCount : 0);
+      UI::Text(TempBuffer);
+      sprintf(TempBuffer, "Cost evaluations cut short: %d", Stats.FramesCutShort);
+      UI::Text(TempBuffer);
+      sprintf(TempBuffer, "Kept continuation: %d", Stats.ContinuationMatchCount);
+      UI::Text(TempBuffer);
+    }
     UI::Text("Debug Display");
     UI::SliderFloat("Trajectory Duration (sec)", &MMDebug.TrajectoryDuration, 0, 10);
     UI::SliderInt("Trajectory Sample Count", &MMDebug.TrajectorySampleCount, 2, 40);
@@ -219,6 +233,8 @@ TestGui(game_state* GameState, const game_input* Input)
       static bool s_ShowTimelineRegion           = false;
       static bool s_ShowFrameSummaries           = false;
       static bool s_ShowGPUFrameSummaries        = false;
+      static bool s_ShowMMTelemetry              = false;
+      static bool s_ShowAnimLOD                  = false;
       static bool s_ShowEntityEditor             = false;
       static bool s_ShowChunkMemoryVisualization = false;
 
@@ -317,7 +333,16 @@ TestGui(game_state* GameState, const game_input* Input)
               GLOBAL_FRAME_ENDPOINT_TABLE[s_CurrentModifiableFrameIndex];
             const float BaselineCycleCount =
               5e6; //(float)(FrameCycleCounter.FrameEnd - FrameCycleCounter.FrameStart);
-            for(int j = 0; j < 5; j++)
+            // Concurrent ECS systems are stacked below their block
+            int32_t MaxEventDepth = 4;
+            for(int i = 0; i < GLOBAL_TIMER_FRAME_EVENT_COUNT_TABLE[s_CurrentModifiableFrameIndex];
+                i++)
+            {
+              const timer_event& Event =
+                GLOBAL_FRAME_TIMER_EVENT_TABLE[s_CurrentModifiableFrameIndex][i];
+              MaxEventDepth = MaxInt32(MaxEventDepth, Event.EventDepth);
+            }
+            for(int j = 0; j <= MaxEventDepth; j++)
             {
               float CurrentHorizontalPosition = 0.0f;
               for(int i = 0;
@@ -410,6 +435,81 @@ TestGui(game_state* GameState, const game_input* Input)
           }
         }
       }
+
+      if(UI::CollapsingHeader("Motion Matching Searches", &s_ShowMMTelemetry))
+      {
+        mm_telemetry* Telemetry = &GameState->MMTelemetry;
+        if(UI::Button("Write CSV"))
+        {
+          WriteMMTelemetryToCSV(Telemetry, "mm_search_telemetry");
+        }
+        UI::SameLine();
+        if(UI::Button("Reset"))
+        {
+          ResetMMTelemetry(Telemetry);
+        }
+        for(int c = 0; c < Telemetry->ControllerCount; c++)
+        {
+          const mm_telemetry_counters& Counters = Telemetry->Controllers[c];
+          const float SearchCount = (float)MaxInt32(1, Counters.SearchCount);
+
+          char TempBuffer[128];
+          sprintf(TempBuffer, "Controller %d: %.1f searches/s, %.0f frames/search, kept %.1f%%",
+                  Counters.ControllerRID.Value, (double)Telemetry->SearchesPerSecond[c],
+                  (double)((float)Counters.FramesTouched / SearchCount),
+                  (double)(100.0f * (float)Counters.KeptClipCount / SearchCount));
+          UI::Text(TempBuffer);
+          sprintf(TempBuffer,
+                  "  Winner cost: BoneP %.3f, BoneV %.3f, TrajP %.3f, TrajV %.3f, TrajA %.3f",
+                  (double)(Counters.BonePCost / SearchCount),
+                  (double)(Counters.BoneVCost / SearchCount),
+                  (double)(Counters.TrajPCost / SearchCount),
+                  (double)(Counters.TrajVCost / SearchCount),
+                  (double)(Counters.TrajACost / SearchCount));
+          UI::Text(TempBuffer);
+          sprintf(TempBuffer, "  Latency: mean %.1fus, p50 <%.0fus, p90 <%.0fus, p99 <%.0fus",
+                  (double)((float)Counters.LatencyMicroseconds / SearchCount),
+                  (double)GetMMLatencyPercentile(Counters, 0.5f),
+                  (double)GetMMLatencyPercentile(Counters, 0.9f),
+                  (double)GetMMLatencyPercentile(Counters, 0.99f));
+          UI::Text(TempBuffer);
+          for(int b = 0; b < MM_TELEMETRY_LATENCY_BUCKET_COUNT; b++)
+          {
+            if(0 < Counters.LatencyBuckets[b])
+            {
+              sprintf(TempBuffer, "    <%dus: %d", 1 << b, Counters.LatencyBuckets[b]);
+              UI::Text(TempBuffer);
+            }
+          }
+        }
+      }
+
+      if(UI::CollapsingHeader("Animation LOD", &s_ShowAnimLOD))
+      {
+        anim_lod_settings*       Settings = &GameState->AnimLODSettings;
+        const anim_lod_counters& Counters = GameState->AnimLODCounters;
+        UI::Checkbox("Enabled", &Settings->Enabled);
+        UI::SliderFloat("LOD 1 Distance", &Settings->Distances[0], 0.0f, Settings->Distances[1]);
+        UI::SliderFloat("LOD 2 Distance", &Settings->Distances[1], Settings->Distances[0], 200.0f);
+        UI::SliderInt("LOD 1 Update Period", &Settings->UpdatePeriods[1], 1, 8);
+        UI::SliderInt("LOD 2 Update Period", &Settings->UpdatePeriods[2], 1, 8);
+
+        char TempBuffer[128];
+        sprintf(TempBuffer, "Players per LOD: %d, %d, %d", Counters.PlayerCounts[0],
+                Counters.PlayerCounts[1], Counters.PlayerCounts[2]);
+        UI::Text(TempBuffer);
+        sprintf(TempBuffer, "Evaluated %d players, interpolated %d", Counters.EvaluatedPlayerCount,
+                Counters.InterpolatedPlayerCount);
+        UI::Text(TempBuffer);
+        sprintf(TempBuffer, "Bones: evaluated %d, skipped %d", Counters.EvaluatedBoneCount,
+                Counters.SkippedBoneCount);
+        UI::Text(TempBuffer);
+        sprintf(TempBuffer, "Evaluation %.1fus, interpolation %.1fus, saved ~%.1fus",
+                (double)Counters.EvaluationMicroseconds,
+                (double)Counters.InterpolationMicroseconds,
+                (double)GetAnimLODSavedMicroseconds(Counters));
+        UI::Text(TempBuffer);
+      }
       {
         Memory::marker EntityEditorMemStart = GameState->TemporaryMemStack->GetMarker();
         const int      TempBufferCapacity   = 64;
@@ -1334,12 +1434,19 @@ EntityGUI(game_state* GameState, bool& s_ShowEntityTools)
             PushArray(GameState->PersistentMemStack,
                       ANIM_PLAYER_OUTPUT_BLOCK_COUNT * SelectedModel->Skeleton->BoneCount,
                       transform);
-          SelectedEntity->AnimPlayer->BoneSpaceMatrices =
-            PushArray(GameState->PersistentMemStack, SelectedModel->Skeleton->BoneCount, mat4);
-          SelectedEntity->AnimPlayer->ModelSpaceMatrices =
-            PushArray(GameState->PersistentMemStack, SelectedModel->Skeleton->BoneCount, mat4);
           SelectedEntity->AnimPlayer->HierarchicalModelSpaceMatrices =
             PushArray(GameState->PersistentMemStack, SelectedModel->Skeleton->BoneCount, mat4);
+          SelectedEntity->AnimPlayer->SkinningMatrices =
+            PushArray(GameState->PersistentMemStack, SelectedModel->Skeleton->BoneCount,
+                      Anim::skinning_matrix);
+          SelectedEntity->AnimPlayer->LODState.Poses =
+            PushArray(GameState->PersistentMemStack, 2 * SelectedModel->Skeleton->BoneCount,
+                      transform);
+
+          Anim::flat_skeleton* FlatSkeleton =
+            PushStruct(GameState->PersistentMemStack, Anim::flat_skeleton);
+          Anim::BuildFlatSkeleton(FlatSkeleton, SelectedModel->Skeleton);
+          SelectedEntity->AnimPlayer->FlatSkeleton = FlatSkeleton;
         }
         else if(SelectedEntity->AnimPlayer)
         {
@@ -1535,6 +1642,14 @@ EntityGUI(game_state* GameState, bool& s_ShowEntityTools)
                   sprintf(TempBuffer, "MM Entity Index: %d", MMEntityIndex);
                   UI::Text(TempBuffer);
 
+                  int32_t BlendStackCapacity = MMEntity.BlendStack->Capacity;
+                  UI::SliderInt("Blend Stack Capacity", &BlendStackCapacity, 1,
+                                BLEND_STACK_MAX_CAPACITY);
+                  if(BlendStackCapacity != MMEntity.BlendStack->Capacity)
+                  {
+                    SetBlendStackCapacity(MMEntity.BlendStack, BlendStackCapacity);
+                  }
+
 
                   static bool s_ShowInputControlParameters = false;
                   if(UI::TreeNode("Movement Control Options", &s_ShowInputControlParameters))
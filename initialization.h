@@ -496,9 +496,11 @@ SetGameStatePODFields(game_state* GameState)
     GameState->MMDebug.TrajectoryDuration          = 1;
     GameState->MMDebug.TrajectorySampleCount       = 20;
     GameState->MMDebug.ApplyRootMotion             = true;
+    GameState->MMDebug.SearchFromContinuation      = true;
     GameState->MMDebug.ShowRootTrajectories        = false;
     GameState->MMDebug.ShowHipTrajectories         = false;
     GameState->MMDebug.ShowSmoothGoals             = false;
+    ResetMMTelemetry(&GameState->MMTelemetry);
 
     GameState->MMDebug.CurrentGoal.ShowTrajectory       = true;
     GameState->MMDebug.MatchedGoal.ShowTrajectory       = true;
@@ -513,6 +515,12 @@ SetGameStatePODFields(game_state* GameState)
     // Default constructed :(
   }
 
+  // Animation level of detail
+  {
+    GameState->AnimLODSettings = GetDefaultAnimLODSettings();
+    GameState->AnimLODCounters = {};
+  }
+
   // PARTICLE SYSTEM INITIALIZATION
   {
     GameState->ParticleMode = false;
@@ -0,0 +1,282 @@
+#include "job_system.h"
+#include "thread_primitives.h"
+
+#include <assert.h>
+
+#define JOB_WAIT_SPIN_COUNT 64
+
+struct queued_job
+{
+  job          Job;
+  job_counter* Counter;
+};
+
+// Ring buffer owned by one thread, which pushes and pops at the bottom while the other threads
+// steal from the top. Locked so that threads outside of the job system can kick jobs too
+struct job_deque
+{
+  queued_job Jobs[JOB_QUEUE_CAPACITY];
+  int32_t    Top;
+  int32_t    Count;
+  spin_lock  Lock;
+};
+
+struct job_system
+{
+  job_deque Deques[JOB_SYSTEM_MAX_THREAD_COUNT];
+
+  Platform::semaphore     WorkAvailable;
+  Platform::thread_handle Workers[JOB_SYSTEM_MAX_THREAD_COUNT - 1];
+  int32_t                 WorkerCount;
+  volatile int32_t        ShouldQuit;
+};
+
+static job_system g_JobSystem;
+
+static thread_local int32_t t_JobThreadIndex = 0;
+
+static bool
+TryPushJob(job_deque* Deque, const queued_job& Job)
+{
+  bool Pushed = false;
+  BeginSpinLock(&Deque->Lock);
+  if(Deque->Count < JOB_QUEUE_CAPACITY)
+  {
+    int32_t Bottom      = (Deque->Top + Deque->Count) % JOB_QUEUE_CAPACITY;
+    Deque->Jobs[Bottom] = Job;
+    Deque->Count++;
+    Pushed = true;
+  }
+  EndSpinLock(&Deque->Lock);
+  return Pushed;
+}
+
+// The newest job, whose data is most likely still in the cache
+static bool
+TryPopJob(job_deque* Deque, queued_job* OutJob)
+{
+  bool Popped = false;
+  BeginSpinLock(&Deque->Lock);
+  if(Deque->Count > 0)
+  {
+    Deque->Count--;
+    *OutJob = Deque->Jobs[(Deque->Top + Deque->Count) % JOB_QUEUE_CAPACITY];
+    Popped  = true;
+  }
+  EndSpinLock(&Deque->Lock);
+  return Popped;
+}
+
+static bool
+TryStealJob(job_deque* Deque, queued_job* OutJob)
+{
+  bool Stolen = false;
+  BeginSpinLock(&Deque->Lock);
+  if(Deque->Count > 0)
+  {
+    *OutJob    = Deque->Jobs[Deque->Top];
+    Deque->Top = (Deque->Top + 1) % JOB_QUEUE_CAPACITY;
+    Deque->Count--;
+    Stolen = true;
+  }
+  EndSpinLock(&Deque->Lock);
+  return Stolen;
+}
+
+// Own jobs first, then the other threads' starting with the next one
+static bool
+TryGetJob(queued_job* OutJob)
+{
+  const int32_t ThreadIndex = t_JobThreadIndex;
+  if(TryPopJob(&g_JobSystem.Deques[ThreadIndex], OutJob))
+  {
+    return true;
+  }
+  const int32_t ThreadCount = g_JobSystem.WorkerCount + 1;
+  for(int i = 1; i < ThreadCount; i++)
+  {
+    if(TryStealJob(&g_JobSystem.Deques[(ThreadIndex + i) % ThreadCount], OutJob))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void
+FinishJob(job_counter* Counter)
+{
+  // The waiting thread may release a counter as soon as it reaches zero, so its parent is read
+  // before the decrement
+  while(Counter)
+  {
+    job_counter* Parent = Counter->Parent;
+    if(AtomicAddInt32(&Counter->Value, -1) != 0)
+    {
+      break;
+    }
+    Counter = Parent;
+  }
+}
+
+static void
+RunJob(const queued_job& Job)
+{
+  Job.Job.Function(Job.Job.Data);
+  FinishJob(Job.Counter);
+}
+
+struct worker_start_info
+{
+  int32_t ThreadIndex;
+};
+
+static worker_start_info g_WorkerStartInfos[JOB_SYSTEM_MAX_THREAD_COUNT - 1];
+
+static THREAD_PROC(WorkerThreadProc)
+{
+  t_JobThreadIndex = ((worker_start_info*)Data)->ThreadIndex;
+  while(true)
+  {
+    queued_job Job;
+    if(TryGetJob(&Job))
+    {
+      RunJob(Job);
+      continue;
+    }
+
+    Platform::WaitOnSemaphore(&g_JobSystem.WorkAvailable);
+    if(AtomicReadInt32(&g_JobSystem.ShouldQuit))
+    {
+      break;
+    }
+  }
+}
+
+void
+InitJobSystem(int32_t WorkerCount)
+{
+  assert(0 <= WorkerCount);
+  assert(g_JobSystem.WorkerCount == 0);
+  if(WorkerCount > JOB_SYSTEM_MAX_THREAD_COUNT - 1)
+  {
+    WorkerCount = JOB_SYSTEM_MAX_THREAD_COUNT - 1;
+  }
+
+  for(int i = 0; i < JOB_SYSTEM_MAX_THREAD_COUNT; i++)
+  {
+    g_JobSystem.Deques[i].Top   = 0;
+    g_JobSystem.Deques[i].Count = 0;
+    g_JobSystem.Deques[i].Lock  = {};
+  }
+  g_JobSystem.ShouldQuit = 0;
+  Platform::InitSemaphore(&g_JobSystem.WorkAvailable, 0);
+
+  t_JobThreadIndex = 0;
+  // Set before the workers start stealing
+  g_JobSystem.WorkerCount = WorkerCount;
+  for(int i = 0; i < WorkerCount; i++)
+  {
+    g_WorkerStartInfos[i].ThreadIndex = i + 1;
+    g_JobSystem.Workers[i] =
+      Platform::CreateWorkerThread(WorkerThreadProc, &g_WorkerStartInfos[i]);
+  }
+}
+
+void
+ShutdownJobSystem()
+{
+  AtomicWriteInt32(&g_JobSystem.ShouldQuit, 1);
+  Platform::SignalSemaphore(&g_JobSystem.WorkAvailable, g_JobSystem.WorkerCount);
+  for(int i = 0; i < g_JobSystem.WorkerCount; i++)
+  {
+    Platform::JoinThread(g_JobSystem.Workers[i]);
+  }
+  g_JobSystem.WorkerCount = 0;
+  Platform::DestroySemaphore(&g_JobSystem.WorkAvailable);
+}
+
+int32_t
+GetJobThreadCount()
+{
+  return g_JobSystem.WorkerCount + 1;
+}
+
+int32_t
+GetJobThreadIndex()
+{
+  return t_JobThreadIndex;
+}
+
+void
+KickJobs(job_counter* Counter, const job* Jobs, int32_t JobCount)
+{
+  assert(Counter && Jobs);
+  if(JobCount <= 0)
+  {
+    return;
+  }
+
+  // Hold the parent before any job can finish, the hold is dropped again if the counter already
+  // had one
+  if(Counter->Parent)
+  {
+    AtomicAddInt32(&Counter->Parent->Value, 1);
+  }
+  if(AtomicAddInt32(&Counter->Value, JobCount) != JobCount && Counter->Parent)
+  {
+    AtomicAddInt32(&Counter->Parent->Value, -1);
+  }
+
+  if(g_JobSystem.WorkerCount == 0)
+  {
+    for(int i = 0; i < JobCount; i++)
+    {
+      RunJob({ Jobs[i], Counter });
+    }
+    return;
+  }
+
+  job_deque* Deque       = &g_JobSystem.Deques[t_JobThreadIndex];
+  int32_t    PushedCount = 0;
+  for(int i = 0; i < JobCount; i++)
+  {
+    queued_job Job = { Jobs[i], Counter };
+    if(TryPushJob(Deque, Job))
+    {
+      PushedCount++;
+    }
+    else
+    {
+      // The deque is full, do the work here instead of blocking
+      RunJob(Job);
+    }
+  }
+  Platform::SignalSemaphore(&g_JobSystem.WorkAvailable,
+                            (PushedCount < g_JobSystem.WorkerCount) ? PushedCount
+                                                                    : g_JobSystem.WorkerCount);
+}
+
+void
+WaitForCounter(job_counter* Counter)
+{
+  int32_t IdleSpinCount = 0;
+  while(AtomicReadInt32(&Counter->Value) != 0)
+  {
+    queued_job Job;
+    if(TryGetJob(&Job))
+    {
+      RunJob(Job);
+      IdleSpinCount = 0;
+    }
+    else if(++IdleSpinCount < JOB_WAIT_SPIN_COUNT)
+    {
+      SpinPause();
+    }
+    else
+    {
+      // Let the workers run when there are more threads than cores
+      Platform::YieldThread();
+    }
+  }
+}
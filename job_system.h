@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+
+// Worker threads plus the thread that called InitJobSystem
+#define JOB_SYSTEM_MAX_THREAD_COUNT 32
+// Of the deque of every thread, jobs kicked into a full deque run on the kicking thread
+#define JOB_QUEUE_CAPACITY 1024
+
+// Note: the profiler is not thread safe, job functions must not use TIMED_BLOCK
+#define JOB_FUNCTION(Name) void Name(void* Data)
+typedef JOB_FUNCTION(job_function);
+
+struct job
+{
+  job_function* Function;
+  void*         Data;
+};
+
+// Counts the unfinished jobs of a kick, must outlive the call to WaitForCounter. A counter with
+// a parent counts as one unfinished job of the parent while it is above zero, so waiting for the
+// parent also waits for the jobs kicked with its children
+struct job_counter
+{
+  volatile int32_t Value;
+  job_counter*     Parent;
+};
+
+// WorkerCount of 0 runs every job on the calling thread
+void InitJobSystem(int32_t WorkerCount);
+void ShutdownJobSystem();
+
+// Number of threads jobs can run on, including the main thread
+int32_t GetJobThreadCount();
+// 0 for the main thread, [1, GetJobThreadCount()) for workers
+int32_t GetJobThreadIndex();
+
+// Every thread queues its jobs in its own deque and runs them newest first, idle threads steal
+// the oldest jobs of the others
+void KickJobs(job_counter* Counter, const job* Jobs, int32_t JobCount);
+// Executes queued jobs, its own and stolen ones, on the waiting thread until the counter reaches
+// zero
+void WaitForCounter(job_counter* Counter);
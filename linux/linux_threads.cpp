@@ -0,0 +1,93 @@
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include "../thread_primitives.h"
+
+static_assert(sizeof(sem_t) <= sizeof(Platform::semaphore),
+              "compile time assertion: Platform::semaphore cannot hold a sem_t");
+
+struct linux_thread_start_info
+{
+  Platform::thread_proc* Proc;
+  void*                  Data;
+};
+
+static void*
+LinuxThreadStart(void* StartInfoPtr)
+{
+  linux_thread_start_info StartInfo = *(linux_thread_start_info*)StartInfoPtr;
+  delete(linux_thread_start_info*)StartInfoPtr;
+  StartInfo.Proc(StartInfo.Data);
+  return NULL;
+}
+
+namespace Platform
+{
+  int32_t
+  GetLogicalCoreCount()
+  {
+    long CoreCount = sysconf(_SC_NPROCESSORS_ONLN);
+    return (CoreCount > 0) ? (int32_t)CoreCount : 1;
+  }
+
+  thread_handle
+  CreateWorkerThread(thread_proc* Proc, void* Data)
+  {
+    linux_thread_start_info* StartInfo = new linux_thread_start_info;
+    StartInfo->Proc                    = Proc;
+    StartInfo->Data                    = Data;
+
+    pthread_t Thread;
+    int       Error = pthread_create(&Thread, NULL, LinuxThreadStart, StartInfo);
+    assert(Error == 0);
+
+    thread_handle Result = { (uintptr_t)Thread };
+    return Result;
+  }
+
+  void
+  JoinThread(thread_handle Thread)
+  {
+    pthread_join((pthread_t)Thread.Value, NULL);
+  }
+
+  void
+  YieldThread()
+  {
+    sched_yield();
+  }
+
+  void
+  InitSemaphore(semaphore* Semaphore, int32_t InitialCount)
+  {
+    int Error = sem_init((sem_t*)Semaphore->Storage, 0, (unsigned)InitialCount);
+    assert(Error == 0);
+  }
+
+  void
+  DestroySemaphore(semaphore* Semaphore)
+  {
+    sem_destroy((sem_t*)Semaphore->Storage);
+  }
+
+  void
+  SignalSemaphore(semaphore* Semaphore, int32_t Count)
+  {
+    for(int i = 0; i < Count; i++)
+    {
+      sem_post((sem_t*)Semaphore->Storage);
+    }
+  }
+
+  void
+  WaitOnSemaphore(semaphore* Semaphore)
+  {
+    while(sem_wait((sem_t*)Semaphore->Storage) != 0)
+    {
+      // Interrupted by a signal
+    }
+  }
+}
@@ -41,17 +41,20 @@ inline void
 ExportAndSetMMController(Memory::stack_allocator* Alloc, Resource::resource_manager* Resources,
                          const mm_params* Params, const char* FileName)
 {
+  Memory::marker AnimationsStart = Alloc->GetMarker();
+
   // Fetch the animation pointers
-  fixed_stack<Anim::animation*, MM_ANIM_CAPACITY> Animations = {};
+  array_handle<Anim::animation*> Animations = {};
+  Animations.Init(PushArray(Alloc, Params->AnimRIDs.Count, Anim::animation*),
+                  Params->AnimRIDs.Count);
   for(int i = 0; i < Params->AnimRIDs.Count; i++)
   {
-    Animations.Push(Resources->GetAnimation(Params->AnimRIDs[i]));
+    Animations[i] = Resources->GetAnimation(Params->AnimRIDs[i]);
   }
 
   Memory::marker MMControllerAssetStart = Alloc->GetMarker();
 
-  mm_controller_data* MMControllerAsset =
-    PrecomputeRuntimeMMData(Alloc, Animations.GetArrayHandle(), *Params);
+  mm_controller_data* MMControllerAsset = PrecomputeRuntimeMMData(Alloc, Animations, *Params);
   // assert(MMControllerAssetStart.Address == (uint8_t*)MMControllerAsset);
 
   size_t AlignmentSize = (uint8_t*)MMControllerAsset - (uint8_t*)MMControllerAssetStart.Address;
@@ -59,12 +62,13 @@ ExportAndSetMMController(Memory::stack_allocator* Alloc, Resource::resource_mana
   size_t MMControllerAssetSize =
     Alloc->GetByteCountAboveMarker(MMControllerAssetStart) - AlignmentSize;
 
-  Resources->UpdateOrCreateMMController(MMControllerAsset, MMControllerAssetSize, FileName);
-
+  // Pack before handing the data out, the resource manager copy has to relocate the pointers
   Asset::PackMMController(MMControllerAsset);
   Platform::WriteEntireFile(FileName, MMControllerAssetSize, MMControllerAsset);
 
-  Alloc->FreeToMarker(MMControllerAssetStart);
+  Resources->UpdateOrCreateMMController(MMControllerAsset, MMControllerAssetSize, FileName);
+
+  Alloc->FreeToMarker(AnimationsStart);
 }
 
 void
@@ -111,15 +115,21 @@ MMControllerEditorGUI(rid* OutNewControllerRID, mm_profile_editor* MMEditor,
       {
         if(TargetIsTemplate)
         {
-          Asset::ImportMMParams(TempStack, &MMEditor->ActiveProfile,
-                                Resources->MMParamPaths[TargetPathIndex].Name);
-
-          // Set the animation RIDs from the paths
-          MMEditor->ActiveProfile.AnimRIDs.HardClear();
-          for(int i = 0; i < MMEditor->ActiveProfile.AnimPaths.Count; i++)
+          if(Asset::ImportMMParams(TempStack, &MMEditor->ActiveProfile,
+                                   Resources->MMParamPaths[TargetPathIndex].Name))
+          {
+            // Set the animation RIDs from the paths
+            MMEditor->ActiveProfile.AnimRIDs.Clear();
+            for(int i = 0; i < MMEditor->ActiveProfile.AnimPaths.Count; i++)
+            {
+              MMEditor->ActiveProfile.AnimRIDs.Push(
+                Resources->ObtainAnimationPathRID(MMEditor->ActiveProfile.AnimPaths[i].Name));
+            }
+          }
+          else
           {
-            MMEditor->ActiveProfile.AnimRIDs.Push(
-              Resources->ObtainAnimationPathRID(MMEditor->ActiveProfile.AnimPaths[i].Name));
+            printf("runtime error: %s is not a template of version %u. Recreate it\n",
+                   Resources->MMParamPaths[TargetPathIndex].Name, MM_PARAMS_FILE_VERSION);
           }
         }
         else if(TargetIsController)
@@ -127,7 +137,7 @@ MMControllerEditorGUI(rid* OutNewControllerRID, mm_profile_editor* MMEditor,
           rid MMControllerRID =
             Resources->ObtainMMControllerPathRID(Resources->MMParamPaths[TargetPathIndex].Name);
           mm_controller_data* MMController = Resources->GetMMController(MMControllerRID);
-          MMEditor->ActiveProfile          = MMController->Params;
+          CopyMMParams(&MMEditor->ActiveProfile, MMController->Params);
         }
       }
     }
@@ -281,14 +291,30 @@ MMControllerEditorGUI(rid* OutNewControllerRID, mm_profile_editor* MMEditor,
                       &MMEditor->ActiveProfile.DynamicParams.TrajVCoefficient, 0, 1);*/
       UI::SliderFloat("Trajectory Angle Influence",
                       &MMEditor->ActiveProfile.DynamicParams.TrajAngleCoefficient, 0, 1);
-      static bool s_ShowTrajectoryPointWeights;
-      if(UI::TreeNode("Trajectory Point Weights", &s_ShowTrajectoryPointWeights))
+      static bool s_ShowTrajectoryPoints;
+      if(UI::TreeNode("Trajectory Points", &s_ShowTrajectoryPoints))
       {
-        for(int i = 0; i < MM_POINT_COUNT; i++)
+        fixed_stack<float, MM_MAX_POINT_COUNT>& SampleTimes =
+          MMEditor->ActiveProfile.FixedParams.TrajectorySampleTimes;
+        if(UI::Button("Add Point", LeftOfComboButtonWidth) && !SampleTimes.Full())
+        {
+          MMEditor->ActiveProfile.DynamicParams.TrajectoryWeights[SampleTimes.Count] = 1.0f;
+          SampleTimes.Push(1.0f);
+        }
+        UI::SameLine();
+        if(UI::Button("Remove Point", LeftOfComboButtonWidth) && 1 < SampleTimes.Count)
+        {
+          SampleTimes.Pop();
+        }
+        for(int i = 0; i < SampleTimes.Count; i++)
         {
+          // Sample times are fractions of the time horizon and must not decrease
+          const float MinSampleTime = (0 < i) ? SampleTimes[i - 1] : 0.01f;
           char TempBuff[32];
+          snprintf(TempBuff, ArrayCount(TempBuff), "Point #%d Time", i + 1);
+          UI::SliderFloat(TempBuff, &SampleTimes[i], MinSampleTime, 1);
+          SampleTimes[i] = ClampFloat(MinSampleTime, SampleTimes[i], 1);
           snprintf(TempBuff, ArrayCount(TempBuff), "Point #%d Weight", i + 1);
-          UI::Text(TempBuff);
           UI::SliderFloat(TempBuff, &MMEditor->ActiveProfile.DynamicParams.TrajectoryWeights[i], 0,
                           1);
         }
@@ -381,7 +407,7 @@ MMControllerEditorGUI(rid* OutNewControllerRID, mm_profile_editor* MMEditor,
 
     if(UI::Button("Save Template", LeftOfComboButtonWidth))
     {
-      Asset::ExportMMParams(&MMEditor->ActiveProfile,
+      Asset::ExportMMParams(TempStack, &MMEditor->ActiveProfile,
                             TargetIsTemplate ? Resources->MMParamPaths[TargetPathIndex].Name
                                              : NewTemplatePath);
     }
@@ -403,7 +429,7 @@ MMControllerEditorGUI(rid* OutNewControllerRID, mm_profile_editor* MMEditor,
 
       if(UI::Button("Build Controller", LeftOfComboButtonWidth))
       {
-        MMEditor->ActiveProfile.AnimRIDs.HardClear();
+        MMEditor->ActiveProfile.AnimRIDs.Clear();
         for(int i = 0; i < MMEditor->ActiveProfile.AnimPaths.Count; i++)
         {
           rid AnimRID =
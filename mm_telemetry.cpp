@@ -0,0 +1,249 @@
+#include "mm_telemetry.h"
+#include "csv_data_table.h"
+#include "misc.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+static mm_telemetry_counters*
+GetCounters(mm_telemetry_counters* Controllers, int32_t* ControllerCount, rid ControllerRID)
+{
+  for(int i = 0; i < *ControllerCount; i++)
+  {
+    if(Controllers[i].ControllerRID.Value == ControllerRID.Value)
+    {
+      return &Controllers[i];
+    }
+  }
+  if(*ControllerCount < MM_TELEMETRY_MAX_CONTROLLER_COUNT)
+  {
+    mm_telemetry_counters* Counters = &Controllers[(*ControllerCount)++];
+    *Counters                       = {};
+    Counters->ControllerRID         = ControllerRID;
+    return Counters;
+  }
+  return NULL;
+}
+
+static mm_telemetry_counters*
+GetThreadCounters(mm_telemetry* Telemetry, rid ControllerRID)
+{
+  assert(Telemetry);
+  mm_thread_telemetry* Thread = &Telemetry->Threads[GetJobThreadIndex()];
+  return GetCounters(Thread->Controllers, &Thread->ControllerCount, ControllerRID);
+}
+
+static int32_t
+GetLatencyBucketIndex(int64_t Microseconds)
+{
+  int32_t BucketIndex = 0;
+  while(0 < Microseconds && BucketIndex < MM_TELEMETRY_LATENCY_BUCKET_COUNT - 1)
+  {
+    Microseconds >>= 1;
+    BucketIndex++;
+  }
+  return BucketIndex;
+}
+
+void
+ResetMMTelemetry(mm_telemetry* Telemetry)
+{
+  memset(Telemetry, 0, sizeof(mm_telemetry));
+}
+
+void
+RecordMMSearches(mm_telemetry* Telemetry, rid ControllerRID, int32_t SearchCount,
+                 int32_t FramesTouched, int32_t FramesCutShort, int64_t ElapsedMicroseconds)
+{
+  mm_telemetry_counters* Counters = GetThreadCounters(Telemetry, ControllerRID);
+  if(!Counters || SearchCount <= 0)
+  {
+    return;
+  }
+  Counters->SearchCount += SearchCount;
+  Counters->FramesTouched += FramesTouched;
+  Counters->FramesCutShort += FramesCutShort;
+  Counters->LatencyMicroseconds += ElapsedMicroseconds;
+  // Searches of a batch share their passes over the features, so split the time evenly
+  Counters->LatencyBuckets[GetLatencyBucketIndex(ElapsedMicroseconds / SearchCount)] +=
+    SearchCount;
+}
+
+void
+RecordMMWinnerCost(mm_telemetry* Telemetry, rid ControllerRID, float BonePCost, float BoneVCost,
+                   float TrajPCost, float TrajVCost, float TrajACost)
+{
+  mm_telemetry_counters* Counters = GetThreadCounters(Telemetry, ControllerRID);
+  if(Counters)
+  {
+    Counters->BonePCost += BonePCost;
+    Counters->BoneVCost += BoneVCost;
+    Counters->TrajPCost += TrajPCost;
+    Counters->TrajVCost += TrajVCost;
+    Counters->TrajACost += TrajACost;
+  }
+}
+
+void
+RecordMMKeptClip(mm_telemetry* Telemetry, rid ControllerRID)
+{
+  mm_telemetry_counters* Counters = GetThreadCounters(Telemetry, ControllerRID);
+  if(Counters)
+  {
+    Counters->KeptClipCount++;
+  }
+}
+
+void
+MergeMMTelemetry(mm_telemetry* Telemetry, float dt)
+{
+  for(int t = 0; t < JOB_SYSTEM_MAX_THREAD_COUNT; t++)
+  {
+    mm_thread_telemetry* Thread = &Telemetry->Threads[t];
+    for(int c = 0; c < Thread->ControllerCount; c++)
+    {
+      const mm_telemetry_counters& Src = Thread->Controllers[c];
+
+      mm_telemetry_counters* Dest =
+        GetCounters(Telemetry->Controllers, &Telemetry->ControllerCount, Src.ControllerRID);
+      if(!Dest)
+      {
+        continue;
+      }
+      Dest->SearchCount += Src.SearchCount;
+      Dest->FramesTouched += Src.FramesTouched;
+      Dest->FramesCutShort += Src.FramesCutShort;
+      Dest->KeptClipCount += Src.KeptClipCount;
+      Dest->BonePCost += Src.BonePCost;
+      Dest->BoneVCost += Src.BoneVCost;
+      Dest->TrajPCost += Src.TrajPCost;
+      Dest->TrajVCost += Src.TrajVCost;
+      Dest->TrajACost += Src.TrajACost;
+      Dest->LatencyMicroseconds += Src.LatencyMicroseconds;
+      for(int b = 0; b < MM_TELEMETRY_LATENCY_BUCKET_COUNT; b++)
+      {
+        Dest->LatencyBuckets[b] += Src.LatencyBuckets[b];
+      }
+      Telemetry->WindowSearchCounts[Dest - Telemetry->Controllers] += Src.SearchCount;
+    }
+    Thread->ControllerCount = 0;
+  }
+
+  Telemetry->WindowElapsedTime += dt;
+  if(MM_TELEMETRY_WINDOW_DURATION <= Telemetry->WindowElapsedTime)
+  {
+    for(int c = 0; c < Telemetry->ControllerCount; c++)
+    {
+      Telemetry->SearchesPerSecond[c] =
+        (float)Telemetry->WindowSearchCounts[c] / Telemetry->WindowElapsedTime;
+      Telemetry->WindowSearchCounts[c] = 0;
+    }
+    Telemetry->WindowElapsedTime = 0;
+  }
+}
+
+float
+GetMMLatencyPercentile(const mm_telemetry_counters& Counters, float Fraction)
+{
+  int32_t RankedSearchCount = (int32_t)(Fraction * (float)Counters.SearchCount);
+  int32_t SearchCount       = 0;
+  for(int b = 0; b < MM_TELEMETRY_LATENCY_BUCKET_COUNT; b++)
+  {
+    SearchCount += Counters.LatencyBuckets[b];
+    if(RankedSearchCount < SearchCount)
+    {
+      return (float)(1 << b);
+    }
+  }
+  return (float)(1 << (MM_TELEMETRY_LATENCY_BUCKET_COUNT - 1));
+}
+
+struct mm_telemetry_data_row
+{
+  int32_t ControllerRID;
+  int32_t SearchCount;
+  float   SearchesPerSecond;
+  float   FramesPerSearch;
+  float   CutShortPerSearch;
+  float   KeptClipRatio;
+  float   MeanBonePCost;
+  float   MeanBoneVCost;
+  float   MeanTrajPCost;
+  float   MeanTrajVCost;
+  float   MeanTrajACost;
+  float   MeanLatency;
+  float   Latency50;
+  float   Latency90;
+  float   Latency99;
+};
+
+void
+WriteMMTelemetryToCSV(const mm_telemetry* Telemetry, const char* FileName)
+{
+  assert(Telemetry && FileName);
+  if(Telemetry->ControllerCount == 0)
+  {
+    return;
+  }
+
+  data_table Table = {};
+  AddColumn(&Table.Header, "controller_rid", COLUMN_TYPE_int32,
+            offsetof(mm_telemetry_data_row, ControllerRID));
+  AddColumn(&Table.Header, "searches", COLUMN_TYPE_int32,
+            offsetof(mm_telemetry_data_row, SearchCount));
+  AddColumn(&Table.Header, "searches_per_second", COLUMN_TYPE_float,
+            offsetof(mm_telemetry_data_row, SearchesPerSecond));
+  AddColumn(&Table.Header, "frames_per_search", COLUMN_TYPE_float,
+            offsetof(mm_telemetry_data_row, FramesPerSearch));
+  AddColumn(&Table.Header, "cut_short_per_search", COLUMN_TYPE_float,
+            offsetof(mm_telemetry_data_row, CutShortPerSearch));
+  AddColumn(&Table.Header, "kept_clip_ratio", COLUMN_TYPE_float,
+            offsetof(mm_telemetry_data_row, KeptClipRatio));
+  AddColumn(&Table.Header, "bone_p_cost", COLUMN_TYPE_float,
+            offsetof(mm_telemetry_data_row, MeanBonePCost));
+  AddColumn(&Table.Header, "bone_v_cost", COLUMN_TYPE_float,
+            offsetof(mm_telemetry_data_row, MeanBoneVCost));
+  AddColumn(&Table.Header, "traj_p_cost", COLUMN_TYPE_float,
+            offsetof(mm_telemetry_data_row, MeanTrajPCost));
+  AddColumn(&Table.Header, "traj_v_cost", COLUMN_TYPE_float,
+            offsetof(mm_telemetry_data_row, MeanTrajVCost));
+  AddColumn(&Table.Header, "traj_a_cost", COLUMN_TYPE_float,
+            offsetof(mm_telemetry_data_row, MeanTrajACost));
+  AddColumn(&Table.Header, "mean_latency_us", COLUMN_TYPE_float,
+            offsetof(mm_telemetry_data_row, MeanLatency));
+  AddColumn(&Table.Header, "p50_latency_us", COLUMN_TYPE_float,
+            offsetof(mm_telemetry_data_row, Latency50));
+  AddColumn(&Table.Header, "p90_latency_us", COLUMN_TYPE_float,
+            offsetof(mm_telemetry_data_row, Latency90));
+  AddColumn(&Table.Header, "p99_latency_us", COLUMN_TYPE_float,
+            offsetof(mm_telemetry_data_row, Latency99));
+  CreateTable(&Table, FileName, Telemetry->ControllerCount, sizeof(mm_telemetry_data_row));
+
+  for(int c = 0; c < Telemetry->ControllerCount; c++)
+  {
+    const mm_telemetry_counters& Counters = Telemetry->Controllers[c];
+    const float SearchCount = (float)MaxInt32(1, Counters.SearchCount);
+
+    mm_telemetry_data_row Row = {};
+    Row.ControllerRID         = Counters.ControllerRID.Value;
+    Row.SearchCount           = Counters.SearchCount;
+    Row.SearchesPerSecond     = Telemetry->SearchesPerSecond[c];
+    Row.FramesPerSearch       = (float)Counters.FramesTouched / SearchCount;
+    Row.CutShortPerSearch     = (float)Counters.FramesCutShort / SearchCount;
+    Row.KeptClipRatio         = (float)Counters.KeptClipCount / SearchCount;
+    Row.MeanBonePCost         = Counters.BonePCost / SearchCount;
+    Row.MeanBoneVCost         = Counters.BoneVCost / SearchCount;
+    Row.MeanTrajPCost         = Counters.TrajPCost / SearchCount;
+    Row.MeanTrajVCost         = Counters.TrajVCost / SearchCount;
+    Row.MeanTrajACost         = Counters.TrajACost / SearchCount;
+    Row.MeanLatency           = (float)Counters.LatencyMicroseconds / SearchCount;
+    Row.Latency50             = GetMMLatencyPercentile(Counters, 0.5f);
+    Row.Latency90             = GetMMLatencyPercentile(Counters, 0.9f);
+    Row.Latency99             = GetMMLatencyPercentile(Counters, 0.99f);
+    AddRow(&Table, &Row, sizeof(Row));
+  }
+
+  WriteDataTableToCSV(Table);
+  DestroyTable(&Table);
+}
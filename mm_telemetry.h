@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "rid.h"
+#include "job_system.h"
+
+#define MM_TELEMETRY_MAX_CONTROLLER_COUNT 20
+// Bucket 0 holds searches under 1us, bucket i > 0 those in [2^(i-1), 2^i)us, the last is open
+#define MM_TELEMETRY_LATENCY_BUCKET_COUNT 16
+#define MM_TELEMETRY_WINDOW_DURATION 1.0f
+
+// Summed over the searches of one controller
+struct mm_telemetry_counters
+{
+  rid     ControllerRID;
+  int32_t SearchCount;
+  int32_t FramesTouched;
+  int32_t FramesCutShort;
+  int32_t KeptClipCount; // Searches after which the entity kept playing its clip
+
+  // Weighted cost terms of the winning frames
+  float BonePCost;
+  float BoneVCost;
+  float TrajPCost;
+  float TrajVCost;
+  float TrajACost;
+
+  int64_t LatencyMicroseconds;
+  int32_t LatencyBuckets[MM_TELEMETRY_LATENCY_BUCKET_COUNT];
+};
+
+// Only written by the job thread with the same index, merged at the end of a frame
+struct mm_thread_telemetry
+{
+  mm_telemetry_counters Controllers[MM_TELEMETRY_MAX_CONTROLLER_COUNT];
+  int32_t               ControllerCount;
+  uint8_t               CacheLinePadding[64]; // Keeps threads from sharing a line
+};
+
+struct mm_telemetry
+{
+  mm_thread_telemetry Threads[JOB_SYSTEM_MAX_THREAD_COUNT];
+
+  // Since the last reset
+  mm_telemetry_counters Controllers[MM_TELEMETRY_MAX_CONTROLLER_COUNT];
+  int32_t               ControllerCount;
+
+  // Searches per second are measured over windows of MM_TELEMETRY_WINDOW_DURATION
+  int32_t WindowSearchCounts[MM_TELEMETRY_MAX_CONTROLLER_COUNT];
+  float   SearchesPerSecond[MM_TELEMETRY_MAX_CONTROLLER_COUNT];
+  float   WindowElapsedTime;
+};
+
+void ResetMMTelemetry(mm_telemetry* Telemetry);
+
+// Record into the counters of the calling job thread, safe to call from jobs
+void RecordMMSearches(mm_telemetry* Telemetry, rid ControllerRID, int32_t SearchCount,
+                      int32_t FramesTouched, int32_t FramesCutShort, int64_t ElapsedMicroseconds);
+void RecordMMWinnerCost(mm_telemetry* Telemetry, rid ControllerRID, float BonePCost,
+                        float BoneVCost, float TrajPCost, float TrajVCost, float TrajACost);
+void RecordMMKeptClip(mm_telemetry* Telemetry, rid ControllerRID);
+
+// Folds the per-thread counters into the totals, call once per frame once no job records
+void MergeMMTelemetry(mm_telemetry* Telemetry, float dt);
+
+// Upper end of the latency bucket the Fraction-th search falls in
+float GetMMLatencyPercentile(const mm_telemetry_counters& Counters, float Fraction);
+
+// Writes a row per controller to data/measurements/<FileName>.csv
+void WriteMMTelemetryToCSV(const mm_telemetry* Telemetry, const char* FileName);
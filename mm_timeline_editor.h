@@ -78,7 +78,8 @@ AreBlendStackTopsEqual(const blend_stack& A, const blend_stack& B)
 uint32_t
 GetMMControllerHash(const mm_controller_data* MMController)
 {
-   return  UI::Hash(&MMController->Animations, sizeof(MMController->Animations), 0);
+   return  UI::Hash(MMController->Animations.Elements,
+                    MMController->Animations.Count * sizeof(Anim::animation*), 0);
 }
 
 void
@@ -99,12 +100,16 @@ OverwriteSelectedMMEntity(blend_stack* BlendStacks, float* AnimPlayerTimes,
     if(MMTimelineState->SavedControllerHash != ActiveControllerHash)
     {
       MMTimelineState->SavedControllerHash = ActiveControllerHash;
-      MMTimelineState->SavedBlendStack =
-        (MMTimelineState->Paused) ? blend_stack{} : BlendStacks[MMEntityIndex];
+      MMTimelineState->SavedBlendStack     = BlendStacks[MMEntityIndex];
       MMTimelineState->Scrubbing           = false;
       MMTimelineState->SavedAnimPlayerTime = AnimPlayerTimes[MMEntityIndex];
       MMTimelineState->SavedTransform      = Entities[MMEntityIndex].Transform;
       ControllerWasRebuildOrReloaded       = true;
+      // Cleared rather than zeroed to keep the entity's blend stack capacity
+      if(MMTimelineState->Paused)
+      {
+        MMTimelineState->SavedBlendStack.Clear();
+      }
     }
 
     if(!ControllerWasRebuildOrReloaded)
@@ -141,16 +146,19 @@ MMTimelineWindow(mm_timeline_state* TimelineState, blend_stack BlendStack,
   if(TimelineState->SavedControllerHash != CurrentControllerHash)
   {
     TimelineState->SavedControllerHash = CurrentControllerHash;
-    TimelineState->SavedBlendStack     = (TimelineState->Paused) ? blend_stack{} : BlendStack;
+    TimelineState->SavedBlendStack     = BlendStack;
     TimelineState->Scrubbing           = false;
     TimelineState->SavedAnimPlayerTime = AnimPlayerTime;
     TimelineState->SavedTransform      = Transform;
+    if(TimelineState->Paused)
+    {
+      TimelineState->SavedBlendStack.Clear();
+    }
   }
 
   // Defining what will be used from mm_controller_data
-  const array_handle<Anim::animation*>    Animations = MMController->Animations.GetArrayHandle();
-  const array_handle<mm_frame_info_range> AnimInfoRanges =
-    MMController->AnimFrameInfoRanges.GetArrayHandle();
+  const array_handle<Anim::animation*>    Animations     = MMController->Animations;
+  const array_handle<mm_frame_info_range> AnimInfoRanges = MMController->AnimFrameInfoRanges;
   const array_handle<path> AnimPaths = MMController->Params.AnimPaths.GetArrayHandle();
   float InfoSamplingFrequency        = MMController->Params.FixedParams.MetadataSamplingFrequency;
 
@@ -169,7 +177,6 @@ MMTimelineWindow(mm_timeline_state* TimelineState, blend_stack BlendStack,
   static bool ShowUnusableRegions = true;
   static int  TimelineEditorMode  = 0;
 
-  float AnimDurations[MM_ANIM_CAPACITY];
   // TOP LINE VISUALIZATION PARAMETER UI
   {
     UI::PushWidth(200);
@@ -204,8 +211,7 @@ MMTimelineWindow(mm_timeline_state* TimelineState, blend_stack BlendStack,
       int   MaxAnimNameLength = 0;
       for(int a = 0; a < Animations.Count; a++)
       {
-        AnimDurations[a] = Anim::GetAnimDuration(Animations[a]);
-        MaxAnimDuration  = MaxFloat(MaxAnimDuration, AnimDurations[a]);
+        MaxAnimDuration = MaxFloat(MaxAnimDuration, Anim::GetAnimDuration(Animations[a]));
         MaxAnimNameLength =
           MaxInt32(MaxAnimNameLength, int32_t(strlen(strrchr(AnimPaths[a].Name, '/') + 1)));
       }
@@ -224,7 +230,8 @@ MMTimelineWindow(mm_timeline_state* TimelineState, blend_stack BlendStack,
         // Finding scale factor to transform ranges in seconds to widths in pixels
         const float PixelsPerSecond =
           TotalWidthAfterText /
-          ((RangeScaleOption == RANGE_SCALE_Relative) ? MaxAnimDuration : AnimDurations[a]);
+          ((RangeScaleOption == RANGE_SCALE_Relative) ? MaxAnimDuration
+                                                      : Anim::GetAnimDuration(Animations[a]));
 
         const float AnimStartTime = Animations[a]->SampleTimes[0];
         const float AnimEndTime   = Animations[a]->SampleTimes[Animations[a]->KeyframeCount - 1];
@@ -243,9 +250,9 @@ MMTimelineWindow(mm_timeline_state* TimelineState, blend_stack BlendStack,
         if(ShowUnusableRegions)
           ColoredRanges.Push({ InfoRangeEndTime, AnimEndTime, 0, { 0.2f, 0.5f, 0.3f, 0.9f } });
 
-        fixed_stack<float, ANIM_PLAYER_MAX_ANIM_COUNT>   AnimPlayheads      = {};
-        fixed_stack<vec4, ANIM_PLAYER_MAX_ANIM_COUNT>    AnimPlayheadColors = {};
-        fixed_stack<int32_t, ANIM_PLAYER_MAX_ANIM_COUNT> BlendStackIndices  = {};
+        fixed_stack<float, BLEND_STACK_MAX_CAPACITY>   AnimPlayheads      = {};
+        fixed_stack<vec4, BLEND_STACK_MAX_CAPACITY>    AnimPlayheadColors = {};
+        fixed_stack<int32_t, BLEND_STACK_MAX_CAPACITY> BlendStackIndices  = {};
         for(int i = BlendStack.Count - 1; i >= 0; i--)
         {
           vec4 PlayheadColor = { 1, 0.5f, 0.3f, 1 };
@@ -341,11 +348,12 @@ MMTimelineWindow(mm_timeline_state* TimelineState, blend_stack BlendStack,
     float TrajPCost;
     float TrajVCost;
     float TrajACost;
+    float GoalFeatures[MM_MAX_FEATURE_ROW_COUNT];
+    float FrameFeatures[MM_MAX_FEATURE_ROW_COUNT];
+    GetFrameInfoFeatures(GoalFeatures, AnimGoal, MMController->Layout);
+    GetFrameFeatures(FrameFeatures, MMController, FrameInfoIndex);
     float Cost = ComputeCostComponents(&BonePCost, &BoneVCost, &TrajPCost, &TrajVCost, &TrajACost,
-                                       AnimGoal, MMController->FrameInfos[FrameInfoIndex],
-                                       Params.BonePCoefficient, Params.BoneVCoefficient,
-                                       Params.TrajPCoefficient, Params.TrajVCoefficient,
-                                       Params.TrajAngleCoefficient, Params.TrajectoryWeights);
+                                       GoalFeatures, FrameFeatures, MMController->Layout, Params);
     float FullCostWidth = 0.3f * UI::GetUsableWindowWidth() * Cost;
     UI::Button("Cost", FullCostWidth);
 
@@ -1,13 +1,387 @@
 #include "motion_matching.h"
 #include "misc.h"
 #include "profile.h"
+#include "job_system.h"
 
 #include <cfloat>
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
 
-#define MM_MAX_FRAME_INFO_COUNT 10 * 60 * 90
+// Searches over this many frames or more are split into tasks run by the job system
+#define MM_PARALLEL_SEARCH_MIN_FRAME_COUNT 8192
+#define MM_PARALLEL_SEARCH_TASKS_PER_THREAD 4
+#define MM_PARALLEL_SEARCH_MAX_TASK_COUNT                                                          \
+  (MM_PARALLEL_SEARCH_TASKS_PER_THREAD * JOB_SYSTEM_MAX_THREAD_COUNT)
+// Motion set precomputation samples animations in jobs of at most this many frames
+#define MM_PRECOMPUTE_TASK_FRAME_COUNT 128
 
 const int32_t g_SkipFrameCount = 1;
-// Copy the velocity for the last frame
+
+void
+InitMMParamsAnimStorage(mm_params* Params, Memory::stack_allocator* Alloc, int32_t AnimCapacity)
+{
+  assert(0 <= AnimCapacity);
+  Params->AnimRIDs.Init(PushArray(Alloc, AnimCapacity, rid), 0, AnimCapacity);
+  Params->AnimPaths.Init(PushArray(Alloc, AnimCapacity, path), 0, AnimCapacity);
+}
+
+void
+CopyMMParams(mm_params* Dest, const mm_params& Src)
+{
+  assert(Src.AnimRIDs.Count <= Dest->AnimRIDs.Capacity);
+  assert(Src.AnimPaths.Count <= Dest->AnimPaths.Capacity);
+  stack_handle<rid>  AnimRIDs  = Dest->AnimRIDs;
+  stack_handle<path> AnimPaths = Dest->AnimPaths;
+
+  *Dest           = Src;
+  Dest->AnimRIDs  = AnimRIDs;
+  Dest->AnimPaths = AnimPaths;
+  Dest->AnimRIDs.Resize(Src.AnimRIDs.Count);
+  Dest->AnimPaths.Resize(Src.AnimPaths.Count);
+  if(0 < Src.AnimRIDs.Count)
+  {
+    memcpy(Dest->AnimRIDs.Elements, Src.AnimRIDs.Elements, Src.AnimRIDs.Count * sizeof(rid));
+  }
+  if(0 < Src.AnimPaths.Count)
+  {
+    memcpy(Dest->AnimPaths.Elements, Src.AnimPaths.Elements, Src.AnimPaths.Count * sizeof(path));
+  }
+}
+
+inline int32_t
+GetFeatureBlockCount(int32_t FrameCount)
+{
+  return (FrameCount + MM_FEATURE_BLOCK_WIDTH - 1) / MM_FEATURE_BLOCK_WIDTH;
+}
+
+// Places the frames of Anim after the FirstFrame frames of the animations before it in the set
+mm_frame_info_range
+GetAnimFrameInfoRange(const Anim::animation* Anim, int32_t FirstFrame, const mm_params& Params)
+{
+  const mm_fixed_params& FixedParams = Params.FixedParams;
+  assert(Anim->ChannelCount == FixedParams.Skeleton.BoneCount);
+  assert(1 < Anim->KeyframeCount);
+  const float AnimDuration  = Anim::GetAnimDuration(Anim);
+  const float FrameDuration = AnimDuration / float(Anim->KeyframeCount);
+
+  const float AnimStartSkipTime = Anim->SampleTimes[0] + FrameDuration * float(g_SkipFrameCount);
+
+  const int32_t NewFrameInfoCount = int32_t(
+    MaxFloat(0.0f,
+             ((AnimDuration - AnimStartSkipTime - Params.DynamicParams.TrajectoryTimeHorizon) *
+              FixedParams.MetadataSamplingFrequency)));
+
+  mm_frame_info_range Range = {};
+  Range.StartTimeInAnim     = AnimStartSkipTime;
+  Range.Start               = FirstFrame;
+  Range.End                 = FirstFrame + NewFrameInfoCount;
+  return Range;
+}
+
+// Fills the position and trajectory rows of frames [FirstFrame, EndFrame) of Range, counted from
+// Range.Start. OutFeatures points at the row of frame Range.Start, TempMatrices and TempTransforms
+// have room for a pose of the skeleton
+void
+ComputeAnimFramePositions(float* OutFeatures, mat4* TempMatrices, transform* TempTransforms,
+                          const Anim::animation* Anim, const mm_frame_info_range& Range,
+                          const mm_params& Params, const mm_feature_layout& Layout,
+                          int32_t FirstFrame, int32_t EndFrame)
+{
+  const mm_fixed_params& FixedParams = Params.FixedParams;
+  assert(0 <= FirstFrame && EndFrame <= Range.End - Range.Start);
+
+  // Frames are sampled in order, so each trajectory point advances its own cursor
+  int32_t PoseKeyframeCursor                            = 0;
+  int32_t TrajectoryKeyframeCursors[MM_MAX_POINT_COUNT] = {};
+  for(int i = FirstFrame; i < EndFrame; i++)
+  {
+    float* Frame = OutFeatures + i * Layout.RowCount;
+    float  CurrentSampleTime =
+      Range.StartTimeInAnim + float(i) * (1.0f / FixedParams.MetadataSamplingFrequency);
+    Anim::LinearAnimationSample(TempTransforms, Anim, CurrentSampleTime, &PoseKeyframeCursor);
+
+    Anim::ComputeBoneSpacePoses(TempMatrices, TempTransforms, Anim->ChannelCount);
+    ComputeModelSpacePoses(TempMatrices, TempMatrices, &FixedParams.Skeleton);
+    ComputeFinalHierarchicalPoses(TempMatrices, TempMatrices, &FixedParams.Skeleton);
+
+    mat4    InvRootMatrix;
+    mat4    RootMatrix;
+    int32_t HipIndex = 0;
+    mat4    HipMatrix =
+      Math::MulMat4(TempMatrices[HipIndex], FixedParams.Skeleton.Bones[HipIndex].BindPose);
+    Anim::GetRootAndInvRootMatrices(&RootMatrix, &InvRootMatrix, HipMatrix);
+
+    // Fill Bone Positions
+    for(int b = 0; b < Layout.BoneCount; b++)
+    {
+      const int32_t BoneIndex = FixedParams.ComparisonBoneIndices[b];
+      const mat4    BoneMatrix =
+        Math::MulMat4(TempMatrices[BoneIndex], FixedParams.Skeleton.Bones[BoneIndex].BindPose);
+      vec3 BoneP = Math::MulMat4(InvRootMatrix, BoneMatrix).T;
+      Frame[Layout.BonePRow + 3 * b + 0] = BoneP.X;
+      Frame[Layout.BonePRow + 3 * b + 1] = BoneP.Y;
+      Frame[Layout.BonePRow + 3 * b + 2] = BoneP.Z;
+    }
+
+    // Fill Bone Trajectory Positions
+    for(int p = 0; p < Layout.PointCount; p++)
+    {
+      transform SampleHipTransform = Anim::LinearAnimationBoneSample(
+        Anim, HipIndex,
+        CurrentSampleTime +
+          FixedParams.TrajectorySampleTimes[p] * Params.DynamicParams.TrajectoryTimeHorizon,
+        &TrajectoryKeyframeCursors[p]);
+      // NOTE(Lukas) this should use the root bone if animation has a dedicated one
+      const Anim::bone* Bone = &FixedParams.Skeleton.Bones[HipIndex];
+      mat4              CurrentHipMatrix =
+        Math::MulMat4(Bone->BindPose,
+                      Math::MulMat4(TransformToMat4(SampleHipTransform), Bone->InverseBindPose));
+      vec3 SamplePoint      = CurrentHipMatrix.T;
+      vec4 SamplePointHomog = { SamplePoint, 1 };
+      vec3 TrajectoryP      = Math::MulMat4Vec4(InvRootMatrix, SamplePointHomog).XYZ;
+
+      vec3 CurrentZInTrajectorySpace =
+        Math::MulMat4Vec4(InvRootMatrix, { CurrentHipMatrix.Z, 0 }).XYZ;
+      float TrajectoryAngle = atan2f(CurrentZInTrajectorySpace.X, CurrentZInTrajectorySpace.Z);
+
+      Frame[Layout.TrajPRow + 3 * p + 0]   = TrajectoryP.X;
+      Frame[Layout.TrajPRow + 3 * p + 1]   = 0;
+      Frame[Layout.TrajPRow + 3 * p + 2]   = TrajectoryP.Z;
+      Frame[Layout.TrajDirRow + 2 * p + 0] = sinf(TrajectoryAngle);
+      Frame[Layout.TrajDirRow + 2 * p + 1] = cosf(TrajectoryAngle);
+    }
+  }
+}
+
+// Computes the bone velocities of frames [FirstFrame, EndFrame) of Range from the positions of the
+// next frame, so those have to be filled for the whole range first. The last frame gets the
+// velocity of the one before it
+void
+ComputeAnimFrameVelocities(float* OutFeatures, const mm_frame_info_range& Range,
+                           const mm_params& Params, const mm_feature_layout& Layout,
+                           int32_t FirstFrame, int32_t EndFrame)
+{
+  const int32_t FrameCount = Range.End - Range.Start;
+  assert(0 <= FirstFrame && EndFrame <= FrameCount);
+  for(int i = FirstFrame; i < EndFrame; i++)
+  {
+    float* Frame = OutFeatures + i * Layout.RowCount;
+    if(FrameCount < 2)
+    {
+      memset(Frame + Layout.BoneVRow, 0, sizeof(float) * 3 * Layout.BoneCount);
+      continue;
+    }
+    // Recomputed instead of copied so that no frame depends on the velocity of another one
+    const float* Frame0 = OutFeatures + MinInt32(i, FrameCount - 2) * Layout.RowCount;
+    const float* Frame1 = Frame0 + Layout.RowCount;
+    for(int r = Layout.BoneVRow; r < Layout.BoneVRow + 3 * Layout.BoneCount; r++)
+    {
+      const int32_t PRow = r - Layout.BoneVRow + Layout.BonePRow;
+      Frame[r] = (Frame1[PRow] - Frame0[PRow]) * Params.FixedParams.MetadataSamplingFrequency;
+    }
+  }
+}
+
+// Fills the feature rows of the frames in Range, OutFeatures points at the row of frame Range.Start
+void
+ComputeAnimFeatures(float* OutFeatures, Memory::stack_allocator* TempAlloc,
+                    const Anim::animation* Anim, const mm_frame_info_range& Range,
+                    const mm_params& Params, const mm_feature_layout& Layout)
+{
+  const int32_t  BoneCount   = Params.FixedParams.Skeleton.BoneCount;
+  const int32_t  FrameCount  = Range.End - Range.Start;
+  Memory::marker StartMarker = TempAlloc->GetMarker();
+
+  // Alloc temp memory for transforms and matrices
+  mat4*      TempMatrices   = PushArray(TempAlloc, BoneCount, mat4);
+  transform* TempTransforms = PushArray(TempAlloc, BoneCount, transform);
+  ComputeAnimFramePositions(OutFeatures, TempMatrices, TempTransforms, Anim, Range, Params, Layout,
+                            0, FrameCount);
+  ComputeAnimFrameVelocities(OutFeatures, Range, Params, Layout, 0, FrameCount);
+
+  TempAlloc->FreeToMarker(StartMarker);
+}
+
+// Frames of one animation sampled by a single precompute job
+struct mm_precompute_task
+{
+  float*                   Features; // Row of frame Range.Start
+  const Anim::animation*   Anim;
+  mm_frame_info_range      Range;
+  int32_t                  FirstFrame; // Counted from Range.Start
+  int32_t                  EndFrame;
+  const mm_params*         Params;
+  const mm_feature_layout* Layout;
+  mat4*                    ThreadMatrices; // A pose of the skeleton for every job thread
+  transform*               ThreadTransforms;
+};
+
+JOB_FUNCTION(ComputeFramePositionsJob)
+{
+  mm_precompute_task* Task       = (mm_precompute_task*)Data;
+  const int32_t       BoneCount  = Task->Params->FixedParams.Skeleton.BoneCount;
+  const int32_t       PoseOffset = GetJobThreadIndex() * BoneCount;
+  ComputeAnimFramePositions(Task->Features, Task->ThreadMatrices + PoseOffset,
+                            Task->ThreadTransforms + PoseOffset, Task->Anim, Task->Range,
+                            *Task->Params, *Task->Layout, Task->FirstFrame, Task->EndFrame);
+}
+
+JOB_FUNCTION(ComputeFrameVelocitiesJob)
+{
+  mm_precompute_task* Task = (mm_precompute_task*)Data;
+  ComputeAnimFrameVelocities(Task->Features, Task->Range, *Task->Params, *Task->Layout,
+                             Task->FirstFrame, Task->EndFrame);
+}
+
+// Every task writes only the rows of its own frames, so the result does not depend on the order
+// the jobs run in and matches ComputeAnimFeatures bit for bit
+void
+ComputeFeaturesInParallel(float* OutFeatures, Memory::stack_allocator* TempAlloc,
+                          const mm_controller_data* MMData)
+{
+  const int32_t            AnimCount = MMData->Animations.Count;
+  const mm_feature_layout& Layout    = MMData->Layout;
+  const int32_t            BoneCount = MMData->Params.FixedParams.Skeleton.BoneCount;
+
+  int32_t TaskCount = 0;
+  for(int a = 0; a < AnimCount; a++)
+  {
+    const mm_frame_info_range& Range = MMData->AnimFrameInfoRanges[a];
+    TaskCount += (Range.End - Range.Start + MM_PRECOMPUTE_TASK_FRAME_COUNT - 1) /
+                 MM_PRECOMPUTE_TASK_FRAME_COUNT;
+  }
+  if(TaskCount == 0)
+  {
+    return;
+  }
+
+  Memory::marker      StartMarker = TempAlloc->GetMarker();
+  mm_precompute_task* Tasks       = PushArray(TempAlloc, TaskCount, mm_precompute_task);
+  job*                Jobs        = PushArray(TempAlloc, TaskCount, job);
+  mat4*      ThreadMatrices   = PushArray(TempAlloc, GetJobThreadCount() * BoneCount, mat4);
+  transform* ThreadTransforms = PushArray(TempAlloc, GetJobThreadCount() * BoneCount, transform);
+
+  int32_t TaskIndex = 0;
+  for(int a = 0; a < AnimCount; a++)
+  {
+    const mm_frame_info_range& Range      = MMData->AnimFrameInfoRanges[a];
+    const int32_t              FrameCount = Range.End - Range.Start;
+    for(int f = 0; f < FrameCount; f += MM_PRECOMPUTE_TASK_FRAME_COUNT)
+    {
+      mm_precompute_task* Task = &Tasks[TaskIndex];
+      Task->Features           = OutFeatures + Range.Start * Layout.RowCount;
+      Task->Anim               = MMData->Animations[a];
+      Task->Range              = Range;
+      Task->FirstFrame         = f;
+      Task->EndFrame           = MinInt32(f + MM_PRECOMPUTE_TASK_FRAME_COUNT, FrameCount);
+      Task->Params             = &MMData->Params;
+      Task->Layout             = &Layout;
+      Task->ThreadMatrices     = ThreadMatrices;
+      Task->ThreadTransforms   = ThreadTransforms;
+      Jobs[TaskIndex]          = { ComputeFramePositionsJob, Task };
+      TaskIndex++;
+    }
+  }
+  assert(TaskIndex == TaskCount);
+
+  job_counter Counter = {};
+  KickJobs(&Counter, Jobs, TaskCount);
+  WaitForCounter(&Counter);
+
+  // The velocities read the positions of the next task's first frame
+  for(int t = 0; t < TaskCount; t++)
+  {
+    Jobs[t].Function = ComputeFrameVelocitiesJob;
+  }
+  KickJobs(&Counter, Jobs, TaskCount);
+  WaitForCounter(&Counter);
+
+  TempAlloc->FreeToMarker(StartMarker);
+}
+
+// Pushes a controller with its own copy of the params and the animation list, the frame ranges are
+// left for the caller to fill
+mm_controller_data*
+PushMMControllerData(Memory::stack_allocator* Alloc, array_handle<Anim::animation*> Animations,
+                     const mm_params& Params)
+{
+  const int32_t AnimCount = Animations.Count;
+  assert(0 < AnimCount && AnimCount == Params.AnimRIDs.Count);
+  assert(0 < Params.FixedParams.TrajectorySampleTimes.Count);
+
+  mm_controller_data* MMData = PushAlignedStruct(Alloc, mm_controller_data);
+  memset(MMData, 0, sizeof(mm_controller_data));
+  MMData->Version = MM_CONTROLLER_DATA_VERSION;
+
+  InitMMParamsAnimStorage(&MMData->Params, Alloc, AnimCount);
+  CopyMMParams(&MMData->Params, Params);
+
+  MMData->Animations.Init(PushAlignedArray(Alloc, AnimCount, Anim::animation*), AnimCount);
+  memcpy(MMData->Animations.Elements, Animations.Elements, AnimCount * sizeof(Anim::animation*));
+  MMData->AnimFrameInfoRanges.Init(PushAlignedArray(Alloc, AnimCount, mm_frame_info_range),
+                                   AnimCount);
+  MMData->Layout = GetFeatureLayout(Params.FixedParams);
+  return MMData;
+}
+
+// The float features are only needed to build the search data, so they go on top of everything
+// that stays in the asset and are freed again afterwards
+inline float*
+PushMMFeatures(Memory::stack_allocator* Alloc, const mm_controller_data* MMData)
+{
+  return PushAlignedArray(Alloc, MMData->FrameCount * MMData->Layout.RowCount, float);
+}
+
+// Pushes keyframe storage for the mirrored copy of every animation in the set
+inline void
+PushMirroredAnimations(Memory::stack_allocator* Alloc, mm_controller_data* MMData)
+{
+  const int32_t AnimCount = MMData->Animations.Count;
+  MMData->MirroredAnimations.Init(PushAlignedArray(Alloc, AnimCount, Anim::animation), AnimCount);
+  for(int a = 0; a < AnimCount; a++)
+  {
+    const Anim::animation* Anim     = MMData->Animations[a];
+    Anim::animation*       Mirrored = &MMData->MirroredAnimations[a];
+    Mirrored->KeyframeCount         = Anim->KeyframeCount;
+    Mirrored->ChannelCount          = Anim->ChannelCount;
+    Mirrored->SampleTimes           = PushArray(Alloc, Anim->KeyframeCount, float);
+    Mirrored->Transforms =
+      PushArray(Alloc, Anim->KeyframeCount * Anim->ChannelCount, transform);
+  }
+}
+
+// Pushes and computes the root motion keys of every animation in the set
+inline void
+PushRootMotionTracks(Memory::stack_allocator* Alloc, mm_controller_data* MMData)
+{
+  const int32_t AnimCount = MMData->Animations.Count;
+  MMData->RootMotionTracks.Init(PushAlignedArray(Alloc, AnimCount,
+                                                 array_handle<Anim::root_motion_key>),
+                                AnimCount);
+  for(int a = 0; a < AnimCount; a++)
+  {
+    const Anim::animation* Anim = MMData->Animations[a];
+    MMData->RootMotionTracks[a].Init(PushArray(Alloc, Anim->KeyframeCount, Anim::root_motion_key),
+                                     Anim->KeyframeCount);
+    Anim::ComputeRootMotionKeys(MMData->RootMotionTracks[a].Elements,
+                                &MMData->Params.FixedParams.Skeleton, Anim);
+  }
+}
+
+inline void
+BakeMirroredAnimation(Memory::stack_allocator* TempAlloc, mm_controller_data* MMData,
+                      int32_t AnimIndex)
+{
+  const Anim::skeleton* Skeleton = &MMData->Params.FixedParams.Skeleton;
+
+  Memory::marker Marker       = TempAlloc->GetMarker();
+  mat4*          TempMatrices = PushArray(TempAlloc, Skeleton->BoneCount, mat4);
+  Anim::BakeMirroredAnimation(&MMData->MirroredAnimations[AnimIndex], TempMatrices, Skeleton,
+                              MMData->Animations[AnimIndex],
+                              &MMData->Params.DynamicParams.MirrorInfo);
+  TempAlloc->FreeToMarker(Marker);
+}
 
 // TODO(Lukas) make this be used by the asset pipeline
 mm_controller_data*
@@ -16,317 +390,1973 @@ PrecomputeRuntimeMMData(Memory::stack_allocator*       TempAlloc,
 {
   TIMED_BLOCK(BuildMotionSet);
 
-  mm_controller_data* MMData = PushAlignedStruct(TempAlloc, mm_controller_data);
-  memset(MMData, 0, sizeof(mm_controller_data));
-  MMData->Params = Params;
+  // The asset keeps its own copy of the animation lists
+  mm_controller_data* MMData    = PushMMControllerData(TempAlloc, Animations, Params);
+  const int32_t       AnimCount = Animations.Count;
+
+  // Lay out the frames of every animation in the set
+  int32_t FrameCount = 0;
+  for(int a = 0; a < AnimCount; a++)
+  {
+    MMData->AnimFrameInfoRanges[a] = GetAnimFrameInfoRange(Animations[a], FrameCount, Params);
+    FrameCount                     = MMData->AnimFrameInfoRanges[a].End;
+  }
+  MMData->FrameCount = FrameCount;
+  PushRootMotionTracks(TempAlloc, MMData);
+
+  // Set up the mirroring info for goal generation
+  MMData->Params.FixedParams.MirrorBoneIndices.HardClear();
+  if(MMData->Params.DynamicParams.MatchMirroredAnimations)
+  {
+    for(int i = 0; i < MMData->Params.FixedParams.ComparisonBoneIndices.Count; i++)
+    {
+      int BoneA = MMData->Params.FixedParams.ComparisonBoneIndices[i];
+      int BoneB = -1;
+      for(int p = 0; p < MMData->Params.DynamicParams.MirrorInfo.PairCount; p++)
+      {
+        int CandidateA = MMData->Params.DynamicParams.MirrorInfo.BoneMirrorIndices[p].a;
+        int CandidateB = MMData->Params.DynamicParams.MirrorInfo.BoneMirrorIndices[p].b;
+        if(BoneA == CandidateA)
+        {
+          BoneB = CandidateB;
+					break;
+        }
+
+        if(BoneA == CandidateB)
+        {
+          BoneB = CandidateA;
+					break;
+        }
+      }
+      // TODO(Lukas) Make sura that the bones selected are always in the mirror info stack
+      assert(BoneB != -1 && "Search bone does not have a mirror");
+      MMData->Params.FixedParams.MirrorBoneIndices.Push(BoneB);
+    }
+
+    // Mirroring whole poses while playing costs more than sampling them, so bake it here
+    PushMirroredAnimations(TempAlloc, MMData);
+    for(int a = 0; a < AnimCount; a++)
+    {
+      BakeMirroredAnimation(TempAlloc, MMData, a);
+    }
+  }
+
+  PushSearchData(TempAlloc, MMData);
+  Memory::marker FeaturesStart = TempAlloc->GetMarker();
+  float*         Features      = PushMMFeatures(TempAlloc, MMData);
+  ComputeFeaturesInParallel(Features, TempAlloc, MMData);
+  BuildSearchData(MMData, Features);
+  TempAlloc->FreeToMarker(FeaturesStart);
+  return MMData;
+}
+
+void
+GetFrameInfoFeatures(float* OutFeatures, const mm_frame_info& Info, const mm_feature_layout& Layout)
+{
+  for(int b = 0; b < Layout.BoneCount; b++)
+  {
+    OutFeatures[Layout.BonePRow + 3 * b + 0] = Info.BonePs[b].X;
+    OutFeatures[Layout.BonePRow + 3 * b + 1] = Info.BonePs[b].Y;
+    OutFeatures[Layout.BonePRow + 3 * b + 2] = Info.BonePs[b].Z;
+    OutFeatures[Layout.BoneVRow + 3 * b + 0] = Info.BoneVs[b].X;
+    OutFeatures[Layout.BoneVRow + 3 * b + 1] = Info.BoneVs[b].Y;
+    OutFeatures[Layout.BoneVRow + 3 * b + 2] = Info.BoneVs[b].Z;
+  }
+  for(int p = 0; p < Layout.PointCount; p++)
+  {
+    OutFeatures[Layout.TrajPRow + 3 * p + 0]   = Info.TrajectoryPs[p].X;
+    OutFeatures[Layout.TrajPRow + 3 * p + 1]   = Info.TrajectoryPs[p].Y;
+    OutFeatures[Layout.TrajPRow + 3 * p + 2]   = Info.TrajectoryPs[p].Z;
+    OutFeatures[Layout.TrajDirRow + 2 * p + 0] = sinf(Info.TrajectoryAngles[p]);
+    OutFeatures[Layout.TrajDirRow + 2 * p + 1] = cosf(Info.TrajectoryAngles[p]);
+  }
+}
+
+mm_frame_info
+GetFrameInfo(const float* Features, const mm_feature_layout& Layout)
+{
+  mm_frame_info Result = {};
+  for(int b = 0; b < Layout.BoneCount; b++)
+  {
+    Result.BonePs[b] = { Features[Layout.BonePRow + 3 * b + 0],
+                         Features[Layout.BonePRow + 3 * b + 1],
+                         Features[Layout.BonePRow + 3 * b + 2] };
+    Result.BoneVs[b] = { Features[Layout.BoneVRow + 3 * b + 0],
+                         Features[Layout.BoneVRow + 3 * b + 1],
+                         Features[Layout.BoneVRow + 3 * b + 2] };
+  }
+  for(int p = 0; p < Layout.PointCount; p++)
+  {
+    Result.TrajectoryPs[p]     = { Features[Layout.TrajPRow + 3 * p + 0],
+                               Features[Layout.TrajPRow + 3 * p + 1],
+                               Features[Layout.TrajPRow + 3 * p + 2] };
+    Result.TrajectoryAngles[p] =
+      atan2f(Features[Layout.TrajDirRow + 2 * p + 0], Features[Layout.TrajDirRow + 2 * p + 1]);
+  }
+  return Result;
+}
+
+mm_frame_info
+GetFrameInfo(const mm_controller_data* MMData, int32_t FrameIndex)
+{
+  float Features[MM_MAX_FEATURE_ROW_COUNT];
+  GetFrameFeatures(Features, MMData, FrameIndex);
+  mm_frame_info Result = GetFrameInfo(Features, MMData->Layout);
+
+  // Velocities are not features, each point gets the mean speed over the segment leading to it
+  // from the previous point, the trajectory starting at the root
+  const fixed_stack<float, MM_MAX_POINT_COUNT>& SampleTimes =
+    MMData->Params.FixedParams.TrajectorySampleTimes;
+  const float TimeHorizon = MMData->Params.DynamicParams.TrajectoryTimeHorizon;
+  for(int p = 0; p < MMData->Layout.PointCount; p++)
+  {
+    vec3  PrevP   = (p == 0) ? vec3{} : Result.TrajectoryPs[p - 1];
+    float PrevT   = (p == 0) ? 0.0f : SampleTimes[p - 1];
+    float Elapsed = (SampleTimes[p] - PrevT) * TimeHorizon;
+    Result.TrajectoryVs[p] =
+      (0.0f < Elapsed) ? Math::Length(Result.TrajectoryPs[p] - PrevP) / Elapsed : 0.0f;
+  }
+  return Result;
+}
+
+// Goal features laid out like a single column of a feature block
+struct mm_feature_goal
+{
+  float Rows[MM_MAX_FEATURE_ROW_COUNT];
+};
+
+mm_feature_goal
+GetFeatureGoal(const mm_frame_info& Goal, const mm_feature_layout& Layout)
+{
+  mm_feature_goal Result;
+  GetFrameInfoFeatures(Result.Rows, Goal, Layout);
+  return Result;
+}
+
+// Copies the features of frames [FirstFrame, EndFrame) into their lanes of the blocks
+void
+WriteFeatureBlockFrames(float* Blocks, const float* Features, const mm_feature_layout& Layout,
+                        int32_t FirstFrame, int32_t EndFrame)
+{
+  const int32_t BlockStride = Layout.RowCount * MM_FEATURE_BLOCK_WIDTH;
+  for(int i = FirstFrame; i < EndFrame; i++)
+  {
+    const float* Frame = Features + i * Layout.RowCount;
+    float*       Block = Blocks + (i / MM_FEATURE_BLOCK_WIDTH) * BlockStride;
+    const int    Lane  = i % MM_FEATURE_BLOCK_WIDTH;
+    for(int r = 0; r < Layout.RowCount; r++)
+    {
+      Block[r * MM_FEATURE_BLOCK_WIDTH + Lane] = Frame[r];
+    }
+  }
+}
+
+// Writes the values the quantized blocks hold for frames [FirstFrame, EndFrame), which are within
+// Quantization.MaxErrors of their exact features
+void
+ReconstructQuantizedFrames(float* Features, const mm_controller_data* MMData, int32_t FirstFrame,
+                           int32_t EndFrame)
+{
+  assert(MMData->QuantizedBlocks.IsValid());
+  const mm_feature_quantization& Quantization = MMData->Quantization;
+  const int32_t                  RowCount     = MMData->Layout.RowCount;
+  for(int i = FirstFrame; i < EndFrame; i++)
+  {
+    const uint16_t* Block = MMData->QuantizedBlocks.Elements +
+                            (i / MM_FEATURE_BLOCK_WIDTH) * RowCount * MM_FEATURE_BLOCK_WIDTH;
+    const int Lane  = i % MM_FEATURE_BLOCK_WIDTH;
+    float*    Frame = Features + i * RowCount;
+    for(int r = 0; r < RowCount; r++)
+    {
+      Frame[r] = Quantization.Offsets[r] +
+                 (float)Block[r * MM_FEATURE_BLOCK_WIDTH + Lane] * Quantization.Scales[r];
+    }
+  }
+}
+
+// Rows of one feature vector share the largest scale among them, so that the search can apply it
+// once to the length of the vector instead of to every row
+inline void
+ShareQuantizationScale(float* Scales, int32_t FirstRow, int32_t RowCount)
+{
+  float Scale = 0.0f;
+  for(int r = FirstRow; r < FirstRow + RowCount; r++)
+  {
+    Scale = MaxFloat(Scale, Scales[r]);
+  }
+  // Constant features still need a usable scale, their values are all quantized to 0 anyway
+  if(Scale < FLT_MIN)
+  {
+    Scale = 1.0f;
+  }
+  for(int r = FirstRow; r < FirstRow + RowCount; r++)
+  {
+    Scales[r] = Scale;
+  }
+}
+
+// Picks the offsets and scales that cover the value range of every row, MaxErrors are zeroed
+void
+ComputeFeatureQuantization(mm_feature_quantization* OutQuantization, const float* Features,
+                           int32_t FrameCount, const mm_feature_layout& Layout)
+{
+  float MinRows[MM_MAX_FEATURE_ROW_COUNT];
+  float MaxRows[MM_MAX_FEATURE_ROW_COUNT];
+  for(int r = 0; r < Layout.RowCount; r++)
+  {
+    MinRows[r] = FLT_MAX;
+    MaxRows[r] = -FLT_MAX;
+  }
+  for(int i = 0; i < FrameCount; i++)
+  {
+    const float* Frame = Features + i * Layout.RowCount;
+    for(int r = 0; r < Layout.RowCount; r++)
+    {
+      MinRows[r] = MinFloat(MinRows[r], Frame[r]);
+      MaxRows[r] = MaxFloat(MaxRows[r], Frame[r]);
+    }
+  }
+
+  memset(OutQuantization, 0, sizeof(mm_feature_quantization));
+  for(int r = 0; r < Layout.RowCount; r++)
+  {
+    OutQuantization->Offsets[r]   = MinRows[r];
+    OutQuantization->Scales[r]    = (MaxRows[r] - MinRows[r]) / float(MM_QUANTIZED_MAX_VALUE);
+    OutQuantization->MaxErrors[r] = 0.0f;
+  }
+  for(int b = 0; b < Layout.BoneCount; b++)
+  {
+    ShareQuantizationScale(OutQuantization->Scales, Layout.BonePRow + 3 * b, 3);
+    ShareQuantizationScale(OutQuantization->Scales, Layout.BoneVRow + 3 * b, 3);
+  }
+  for(int p = 0; p < Layout.PointCount; p++)
+  {
+    ShareQuantizationScale(OutQuantization->Scales, Layout.TrajPRow + 3 * p, 3);
+    ShareQuantizationScale(OutQuantization->Scales, Layout.TrajDirRow + 2 * p, 2);
+  }
+}
+
+// Quantizes frames [FirstFrame, EndFrame) into their lanes of the blocks and grows MaxErrors to
+// cover them
+void
+QuantizeFeatureBlockFrames(uint16_t* Blocks, mm_feature_quantization* Quantization,
+                           const float* Features, const mm_feature_layout& Layout,
+                           int32_t FirstFrame, int32_t EndFrame)
+{
+  const int32_t BlockStride = Layout.RowCount * MM_FEATURE_BLOCK_WIDTH;
+  for(int i = FirstFrame; i < EndFrame; i++)
+  {
+    const float* Frame = Features + i * Layout.RowCount;
+    uint16_t*    Block = Blocks + (i / MM_FEATURE_BLOCK_WIDTH) * BlockStride;
+    const int    Lane  = i % MM_FEATURE_BLOCK_WIDTH;
+    for(int r = 0; r < Layout.RowCount; r++)
+    {
+      const float Offset = Quantization->Offsets[r];
+      const float Scale  = Quantization->Scales[r];
+      int32_t     Value  = (int32_t)roundf((Frame[r] - Offset) / Scale);
+      Value              = ClampInt32InIn(0, Value, MM_QUANTIZED_MAX_VALUE);
+      Block[r * MM_FEATURE_BLOCK_WIDTH + Lane] = (uint16_t)Value;
+
+      // The search bounds its error with this, so measure it in double to not underestimate it,
+      // then round the float conversion up
+      double Error = fabs((double)Frame[r] - ((double)Offset + (double)Value * Scale));
+      Quantization->MaxErrors[r] =
+        MaxFloat(Quantization->MaxErrors[r], (float)Error * (1.0f + FLT_EPSILON));
+    }
+  }
+}
+
+// Length of the difference between the goal and a frame over rows [FirstRow, FirstRow + RowCount),
+// row r of the frame being Frame[r * FrameStride]
+inline float
+GetRowDiffLength(const float* Goal, const float* Frame, int32_t FrameStride, int32_t FirstRow,
+                 int32_t RowCount)
+{
+  float LengthSq = 0.0f;
+  for(int r = FirstRow; r < FirstRow + RowCount; r++)
+  {
+    float Diff = Goal[r] - Frame[r * FrameStride];
+    LengthSq += Diff * Diff;
+  }
+  return sqrtf(LengthSq);
+}
+
+// Cost terms before the coefficients are applied
+struct mm_cost_terms
+{
+  float BoneP;
+  float BoneV;
+  float TrajP;
+  float TrajDir;
+};
+
+// The block searches perform exactly the same float operations in the same order, so
+// every search agrees on the cost of a frame down to the last bit
+inline mm_cost_terms
+ComputeCostTerms(const float* Goal, const float* Frame, int32_t FrameStride,
+                 const mm_feature_layout& Layout, const mm_dynamic_params& Params)
+{
+  mm_cost_terms Terms = {};
+  for(int b = 0; b < Layout.BoneCount; b++)
+  {
+    Terms.BoneP += GetRowDiffLength(Goal, Frame, FrameStride, Layout.BonePRow + 3 * b, 3);
+  }
+  for(int b = 0; b < Layout.BoneCount; b++)
+  {
+    Terms.BoneV += GetRowDiffLength(Goal, Frame, FrameStride, Layout.BoneVRow + 3 * b, 3);
+  }
+  for(int p = 0; p < Layout.PointCount; p++)
+  {
+    Terms.TrajP += Params.TrajectoryWeights[p] *
+                   GetRowDiffLength(Goal, Frame, FrameStride, Layout.TrajPRow + 3 * p, 3);
+    Terms.TrajDir += Params.TrajectoryWeights[p] *
+                     GetRowDiffLength(Goal, Frame, FrameStride, Layout.TrajDirRow + 2 * p, 2);
+  }
+  return Terms;
+}
+
+inline float
+CombineCostTerms(const mm_cost_terms& Terms, const mm_dynamic_params& Params)
+{
+  return Params.BonePCoefficient * Terms.BoneP + Params.BoneVCoefficient * Terms.BoneV +
+         Params.TrajPCoefficient * Terms.TrajP + Params.TrajAngleCoefficient * Terms.TrajDir;
+}
+
+float
+ComputeCost(const float* A, const float* B, const mm_feature_layout& Layout,
+            const mm_dynamic_params& Params)
+{
+  return CombineCostTerms(ComputeCostTerms(A, B, 1, Layout, Params), Params);
+}
+
+float
+ComputeCostComponents(float* BonePCost, float* BoneVCost, float* TrajPCost, float* TrajVCost,
+                      float* TrajACost, const float* A, const float* B,
+                      const mm_feature_layout& Layout, const mm_dynamic_params& Params)
+{
+  mm_cost_terms Terms = ComputeCostTerms(A, B, 1, Layout, Params);
+  *BonePCost = Terms.BoneP * Params.BonePCoefficient;
+  *BoneVCost = Terms.BoneV * Params.BoneVCoefficient;
+  *TrajPCost = Terms.TrajP * Params.TrajPCoefficient;
+  *TrajVCost = 0; // Trajectory velocities are not part of the features
+  *TrajACost = Terms.TrajDir * Params.TrajAngleCoefficient;
+  return CombineCostTerms(Terms, Params);
+}
+
+// ComputeCost that stops once the partial sum of the cost terms exceeds Bound and returns that
+// partial sum instead. With non-negative terms it is a lower bound of the cost, so a frame cut
+// short can not beat a match of cost Bound. The full sum is the same float as ComputeCost's
+float
+ComputeBoundedCost(bool* OutCutShort, const float* Goal, const float* Frame,
+                   const mm_feature_layout& Layout, const mm_dynamic_params& Params, float Bound)
+{
+  *OutCutShort = true;
+
+  float BoneP = 0.0f;
+  for(int b = 0; b < Layout.BoneCount; b++)
+  {
+    BoneP += GetRowDiffLength(Goal, Frame, 1, Layout.BonePRow + 3 * b, 3);
+  }
+  float Cost = Params.BonePCoefficient * BoneP;
+  if(Bound < Cost)
+  {
+    return Cost;
+  }
+
+  float BoneV = 0.0f;
+  for(int b = 0; b < Layout.BoneCount; b++)
+  {
+    BoneV += GetRowDiffLength(Goal, Frame, 1, Layout.BoneVRow + 3 * b, 3);
+  }
+  Cost = Cost + Params.BoneVCoefficient * BoneV;
+  if(Bound < Cost)
+  {
+    return Cost;
+  }
+
+  float TrajP = 0.0f;
+  for(int p = 0; p < Layout.PointCount; p++)
+  {
+    TrajP += Params.TrajectoryWeights[p] *
+             GetRowDiffLength(Goal, Frame, 1, Layout.TrajPRow + 3 * p, 3);
+  }
+  Cost = Cost + Params.TrajPCoefficient * TrajP;
+  if(Bound < Cost)
+  {
+    return Cost;
+  }
+
+  float TrajDir = 0.0f;
+  for(int p = 0; p < Layout.PointCount; p++)
+  {
+    TrajDir += Params.TrajectoryWeights[p] *
+               GetRowDiffLength(Goal, Frame, 1, Layout.TrajDirRow + 2 * p, 2);
+  }
+  *OutCutShort = false;
+  return Cost + Params.TrajAngleCoefficient * TrajDir;
+}
+
+// Same split as r_BuildSearchNode
+int32_t
+r_GetSearchNodeCount(int32_t BlockCount)
+{
+  if(BlockCount <= MM_SEARCH_TREE_LEAF_BLOCK_COUNT)
+  {
+    return 1;
+  }
+  return 1 + r_GetSearchNodeCount(BlockCount / 2) +
+         r_GetSearchNodeCount(BlockCount - BlockCount / 2);
+}
+
+// Bounds are the RowCount minimums followed by the RowCount maximums of the frames under a node
+void
+ComputeLeafNodeBounds(float* Bounds, const array_handle<float>& Features,
+                      const mm_feature_layout& Layout, int32_t FirstBlock, int32_t EndBlock)
+{
+  const int32_t RowCount = Layout.RowCount;
+  float*        MinRows  = Bounds;
+  float*        MaxRows  = Bounds + RowCount;
+  for(int r = 0; r < RowCount; r++)
+  {
+    MinRows[r] = FLT_MAX;
+    MaxRows[r] = -FLT_MAX;
+  }
+  // Padding lanes of the last block are not part of the bounds
+  const int32_t EndFrame = MinInt32(Features.Count / RowCount, EndBlock * MM_FEATURE_BLOCK_WIDTH);
+  for(int i = FirstBlock * MM_FEATURE_BLOCK_WIDTH; i < EndFrame; i++)
+  {
+    const float* Frame = Features.Elements + i * RowCount;
+    for(int r = 0; r < RowCount; r++)
+    {
+      MinRows[r] = MinFloat(MinRows[r], Frame[r]);
+      MaxRows[r] = MaxFloat(MaxRows[r], Frame[r]);
+    }
+  }
+}
+
+inline void
+MergeSearchNodeBounds(float* NodeBounds, int32_t RowCount, int32_t NodeIndex, int32_t ChildA,
+                      int32_t ChildB)
+{
+  float*       MinRows  = NodeBounds + 2 * RowCount * NodeIndex;
+  float*       MaxRows  = MinRows + RowCount;
+  const float* MinRowsA = NodeBounds + 2 * RowCount * ChildA;
+  const float* MinRowsB = NodeBounds + 2 * RowCount * ChildB;
+  for(int r = 0; r < RowCount; r++)
+  {
+    MinRows[r] = MinFloat(MinRowsA[r], MinRowsB[r]);
+    MaxRows[r] = MaxFloat(MinRowsA[RowCount + r], MinRowsB[RowCount + r]);
+  }
+}
+
+int32_t
+r_BuildSearchNode(stack_handle<mm_search_node>* Nodes, float* NodeBounds,
+                  const array_handle<float>& Features, const mm_feature_layout& Layout,
+                  int32_t FirstBlock, int32_t EndBlock, int32_t Depth)
+{
+  assert(FirstBlock < EndBlock);
+  assert(Depth < MM_SEARCH_TREE_MAX_DEPTH);
+
+  int32_t NodeIndex = Nodes->Count;
+  Nodes->Push({});
+  (*Nodes)[NodeIndex].FirstBlock      = FirstBlock;
+  (*Nodes)[NodeIndex].EndBlock        = EndBlock;
+  (*Nodes)[NodeIndex].ChildIndices[0] = -1;
+  (*Nodes)[NodeIndex].ChildIndices[1] = -1;
+
+  const int32_t RowCount = Layout.RowCount;
+  if(MM_SEARCH_TREE_LEAF_BLOCK_COUNT < EndBlock - FirstBlock)
+  {
+    int32_t MiddleBlock = FirstBlock + (EndBlock - FirstBlock) / 2;
+    int32_t ChildA =
+      r_BuildSearchNode(Nodes, NodeBounds, Features, Layout, FirstBlock, MiddleBlock, Depth + 1);
+    int32_t ChildB =
+      r_BuildSearchNode(Nodes, NodeBounds, Features, Layout, MiddleBlock, EndBlock, Depth + 1);
+
+    (*Nodes)[NodeIndex].ChildIndices[0] = ChildA;
+    (*Nodes)[NodeIndex].ChildIndices[1] = ChildB;
+    MergeSearchNodeBounds(NodeBounds, RowCount, NodeIndex, ChildA, ChildB);
+  }
+  else
+  {
+    ComputeLeafNodeBounds(NodeBounds + 2 * RowCount * NodeIndex, Features, Layout, FirstBlock,
+                          EndBlock);
+  }
+  return NodeIndex;
+}
+
+// Refits the bounds of the nodes under NodeIndex that cover blocks [FirstBlock, EndBlock), the
+// structure of the tree only depends on the block count so it stays the same
+void
+r_RefitSearchNode(const mm_search_node* Nodes, float* NodeBounds,
+                  const array_handle<float>& Features, const mm_feature_layout& Layout,
+                  int32_t NodeIndex, int32_t FirstBlock, int32_t EndBlock)
+{
+  const mm_search_node& Node = Nodes[NodeIndex];
+  if(EndBlock <= Node.FirstBlock || Node.EndBlock <= FirstBlock)
+  {
+    return;
+  }
+  if(Node.ChildIndices[0] == -1)
+  {
+    ComputeLeafNodeBounds(NodeBounds + 2 * Layout.RowCount * NodeIndex, Features, Layout,
+                          Node.FirstBlock, Node.EndBlock);
+    return;
+  }
+  r_RefitSearchNode(Nodes, NodeBounds, Features, Layout, Node.ChildIndices[0], FirstBlock,
+                    EndBlock);
+  r_RefitSearchNode(Nodes, NodeBounds, Features, Layout, Node.ChildIndices[1], FirstBlock,
+                    EndBlock);
+  MergeSearchNodeBounds(NodeBounds, Layout.RowCount, NodeIndex, Node.ChildIndices[0],
+                        Node.ChildIndices[1]);
+}
+
+void
+PushSearchData(Memory::stack_allocator* Alloc, mm_controller_data* MMData, bool AllowQuantization)
+{
+  assert(0 < MMData->Layout.RowCount && 0 <= MMData->FrameCount);
+  const int32_t RowCount    = MMData->Layout.RowCount;
+  const int32_t BlockCount  = GetFeatureBlockCount(MMData->FrameCount);
+  const int32_t BlockStride = RowCount * MM_FEATURE_BLOCK_WIDTH;
+  MMData->BlockCount        = BlockCount;
+  MMData->FeatureBlocks     = {};
+  MMData->QuantizedBlocks   = {};
+  MMData->ExactFeatures     = {};
+  MMData->SearchNodes       = {};
+  MMData->SearchNodeBounds  = {};
+  // The padding lanes of the last block are zeroed here and never written again
+  if(AllowQuantization && MM_QUANTIZED_MIN_FRAME_COUNT <= MMData->FrameCount)
+  {
+    MMData->QuantizedBlocks.Init(PushAlignedArray(Alloc, BlockCount * BlockStride, uint16_t),
+                                 BlockCount * BlockStride);
+    memset(MMData->QuantizedBlocks.Elements, 0, sizeof(uint16_t) * BlockCount * BlockStride);
+    MMData->ExactFeatures.Init(PushAlignedArray(Alloc, MMData->FrameCount * RowCount, float),
+                               MMData->FrameCount * RowCount);
+  }
+  else
+  {
+    MMData->FeatureBlocks.Init(PushAlignedArray(Alloc, BlockCount * BlockStride, float),
+                               BlockCount * BlockStride);
+    memset(MMData->FeatureBlocks.Elements, 0, sizeof(float) * BlockCount * BlockStride);
+  }
+  if(MM_SEARCH_TREE_MIN_FRAME_COUNT <= MMData->FrameCount)
+  {
+    const int32_t NodeCount = r_GetSearchNodeCount(BlockCount);
+    MMData->SearchNodes.Init(PushAlignedArray(Alloc, NodeCount, mm_search_node), NodeCount);
+    MMData->SearchNodeBounds.Init(PushAlignedArray(Alloc, 2 * RowCount * NodeCount, float),
+                                  2 * RowCount * NodeCount);
+  }
+}
+
+void
+BuildSearchData(mm_controller_data* MMData, float* Features)
+{
+  assert(Features || MMData->FrameCount == 0);
+  const mm_feature_layout& Layout     = MMData->Layout;
+  const int32_t            FrameCount = MMData->FrameCount;
+  if(MMData->QuantizedBlocks.IsValid())
+  {
+    memcpy(MMData->ExactFeatures.Elements, Features, FrameCount * Layout.RowCount * sizeof(float));
+    ComputeFeatureQuantization(&MMData->Quantization, Features, FrameCount, Layout);
+    QuantizeFeatureBlockFrames(MMData->QuantizedBlocks.Elements, &MMData->Quantization, Features,
+                               Layout, 0, FrameCount);
+    // The tree has to bound the values the block search sees
+    ReconstructQuantizedFrames(Features, MMData, 0, FrameCount);
+  }
+  else if(MMData->FeatureBlocks.IsValid())
+  {
+    WriteFeatureBlockFrames(MMData->FeatureBlocks.Elements, Features, Layout, 0, FrameCount);
+  }
+  if(MMData->SearchNodes.IsValid())
+  {
+    array_handle<float> FeatureMatrix = {};
+    FeatureMatrix.Init(Features, FrameCount * Layout.RowCount);
+
+    stack_handle<mm_search_node> Nodes = {};
+    Nodes.Init(MMData->SearchNodes.Elements, 0, MMData->SearchNodes.Count);
+    r_BuildSearchNode(&Nodes, MMData->SearchNodeBounds.Elements, FeatureMatrix, Layout, 0,
+                      MMData->BlockCount, 0);
+    assert(Nodes.Full());
+  }
+}
+
+// True when the current offsets and scales can represent frames [FirstFrame, EndFrame) without
+// clamping
+bool
+AreFramesInQuantizationRange(const mm_feature_quantization& Quantization, const float* Features,
+                             const mm_feature_layout& Layout, int32_t FirstFrame, int32_t EndFrame)
+{
+  for(int i = FirstFrame; i < EndFrame; i++)
+  {
+    const float* Frame = Features + i * Layout.RowCount;
+    for(int r = 0; r < Layout.RowCount; r++)
+    {
+      int32_t Value =
+        (int32_t)roundf((Frame[r] - Quantization.Offsets[r]) / Quantization.Scales[r]);
+      if(Value < 0 || MM_QUANTIZED_MAX_VALUE < Value)
+      {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool
+UpdateRuntimeMMDataAnimation(Memory::stack_allocator* TempAlloc, mm_controller_data* MMData,
+                             int32_t AnimIndex)
+{
+  TIMED_BLOCK(BuildMotionSet);
+  assert(0 <= AnimIndex && AnimIndex < MMData->Animations.Count);
+
+  const Anim::animation*    Anim     = MMData->Animations[AnimIndex];
+  const mm_frame_info_range OldRange = MMData->AnimFrameInfoRanges[AnimIndex];
+  const mm_frame_info_range Range    = GetAnimFrameInfoRange(Anim, OldRange.Start, MMData->Params);
+  // Neither the frames nor the baked keyframes have room to grow
+  if(Range.End != OldRange.End ||
+     MMData->RootMotionTracks[AnimIndex].Count != Anim->KeyframeCount)
+  {
+    return false;
+  }
+  if(MMData->MirroredAnimations.IsValid())
+  {
+    const Anim::animation& Mirrored = MMData->MirroredAnimations[AnimIndex];
+    if(Mirrored.KeyframeCount != Anim->KeyframeCount ||
+       Mirrored.ChannelCount != Anim->ChannelCount)
+    {
+      return false;
+    }
+    BakeMirroredAnimation(TempAlloc, MMData, AnimIndex);
+  }
+  Anim::ComputeRootMotionKeys(MMData->RootMotionTracks[AnimIndex].Elements,
+                              &MMData->Params.FixedParams.Skeleton, Anim);
+
+  const mm_feature_layout& Layout = MMData->Layout;
+  MMData->AnimFrameInfoRanges[AnimIndex] = Range;
+  if(Range.Start == Range.End)
+  {
+    return true;
+  }
+
+  // The other frames are read back, the leaves of the tree may span both
+  Memory::marker FeaturesStart = TempAlloc->GetMarker();
+  float*         Features      = PushMMFeatures(TempAlloc, MMData);
+  for(int i = 0; i < MMData->FrameCount; i++)
+  {
+    GetFrameFeatures(Features + i * Layout.RowCount, MMData, i);
+  }
+  ComputeAnimFeatures(Features + Range.Start * Layout.RowCount, TempAlloc, Anim, Range,
+                      MMData->Params, Layout);
+
+  int32_t FirstChangedFrame = Range.Start;
+  int32_t EndChangedFrame   = Range.End;
+  if(MMData->FeatureBlocks.IsValid())
+  {
+    WriteFeatureBlockFrames(MMData->FeatureBlocks.Elements, Features, Layout, Range.Start,
+                            Range.End);
+  }
+  if(MMData->QuantizedBlocks.IsValid())
+  {
+    memcpy(MMData->ExactFeatures.Elements + Range.Start * Layout.RowCount,
+           Features + Range.Start * Layout.RowCount,
+           (Range.End - Range.Start) * Layout.RowCount * sizeof(float));
+    // The old offsets, scales and errors stay conservative for the rest of the set, so only a
+    // value outside of them requires quantizing every frame again
+    if(AreFramesInQuantizationRange(MMData->Quantization, Features, Layout, Range.Start,
+                                    Range.End))
+    {
+      QuantizeFeatureBlockFrames(MMData->QuantizedBlocks.Elements, &MMData->Quantization,
+                                 Features, Layout, Range.Start, Range.End);
+    }
+    else
+    {
+      ComputeFeatureQuantization(&MMData->Quantization, Features, MMData->FrameCount, Layout);
+      QuantizeFeatureBlockFrames(MMData->QuantizedBlocks.Elements, &MMData->Quantization,
+                                 Features, Layout, 0, MMData->FrameCount);
+      FirstChangedFrame = 0;
+      EndChangedFrame   = MMData->FrameCount;
+    }
+    // Unchanged frames in the refit leaves need their reconstruction as well
+    ReconstructQuantizedFrames(Features, MMData, 0, MMData->FrameCount);
+  }
+  if(MMData->SearchNodes.IsValid())
+  {
+    array_handle<float> FeatureMatrix = {};
+    FeatureMatrix.Init(Features, MMData->FrameCount * Layout.RowCount);
+    r_RefitSearchNode(MMData->SearchNodes.Elements, MMData->SearchNodeBounds.Elements,
+                      FeatureMatrix, Layout, 0, FirstChangedFrame / MM_FEATURE_BLOCK_WIDTH,
+                      GetFeatureBlockCount(EndChangedFrame));
+  }
+  TempAlloc->FreeToMarker(FeaturesStart);
+  return true;
+}
+
+mm_controller_data*
+SpliceRuntimeMMDataAnimation(Memory::stack_allocator* TempAlloc, const mm_controller_data* MMData,
+                             int32_t AnimIndex)
+{
+  TIMED_BLOCK(BuildMotionSet);
+  assert(0 <= AnimIndex && AnimIndex < MMData->Animations.Count);
+
+  // The mirror bone indices come along with the params
+  mm_controller_data* Result = PushMMControllerData(TempAlloc, MMData->Animations, MMData->Params);
+  const int32_t       AnimCount = MMData->Animations.Count;
+  const int32_t       RowCount  = MMData->Layout.RowCount;
+
+  // Only the changed animation can change length, the others are shifted after it
+  int32_t FrameCount = 0;
+  for(int a = 0; a < AnimCount; a++)
+  {
+    mm_frame_info_range Range = MMData->AnimFrameInfoRanges[a];
+    if(a == AnimIndex)
+    {
+      Range = GetAnimFrameInfoRange(MMData->Animations[a], FrameCount, MMData->Params);
+    }
+    else
+    {
+      Range.End   = FrameCount + (Range.End - Range.Start);
+      Range.Start = FrameCount;
+    }
+    Result->AnimFrameInfoRanges[a] = Range;
+    FrameCount                     = Range.End;
+  }
+  Result->FrameCount = FrameCount;
+
+  // Root motion keys are cheap enough to compute again for every animation
+  PushRootMotionTracks(TempAlloc, Result);
+
+  if(MMData->MirroredAnimations.IsValid())
+  {
+    PushMirroredAnimations(TempAlloc, Result);
+    for(int a = 0; a < AnimCount; a++)
+    {
+      if(a == AnimIndex)
+      {
+        BakeMirroredAnimation(TempAlloc, Result, a);
+      }
+      else
+      {
+        const Anim::animation& Src  = MMData->MirroredAnimations[a];
+        Anim::animation*       Dest = &Result->MirroredAnimations[a];
+        assert(Dest->KeyframeCount == Src.KeyframeCount && Dest->ChannelCount == Src.ChannelCount);
+        memcpy(Dest->SampleTimes, Src.SampleTimes, Src.KeyframeCount * sizeof(float));
+        memcpy(Dest->Transforms, Src.Transforms,
+               Src.KeyframeCount * Src.ChannelCount * sizeof(transform));
+      }
+    }
+  }
+
+  PushSearchData(TempAlloc, Result);
+  Memory::marker FeaturesStart = TempAlloc->GetMarker();
+  float*         Features      = PushMMFeatures(TempAlloc, Result);
+  for(int a = 0; a < AnimCount; a++)
+  {
+    const mm_frame_info_range& Range = Result->AnimFrameInfoRanges[a];
+    float*                     Dest  = Features + Range.Start * RowCount;
+    if(a == AnimIndex)
+    {
+      ComputeAnimFeatures(Dest, TempAlloc, Result->Animations[a], Range, Result->Params,
+                          Result->Layout);
+    }
+    else
+    {
+      const mm_frame_info_range& OldRange = MMData->AnimFrameInfoRanges[a];
+      for(int i = 0; i < Range.End - Range.Start; i++)
+      {
+        GetFrameFeatures(Dest + i * RowCount, MMData, OldRange.Start + i);
+      }
+    }
+  }
+  BuildSearchData(Result, Features);
+  TempAlloc->FreeToMarker(FeaturesStart);
+  return Result;
+}
+
+// Row r of a block holds feature r of its MM_FEATURE_BLOCK_WIDTH frames
+#if defined(__AVX__)
+inline __m256
+GetBlockRowDiffLength(const float* Block, const float* GoalRows, int32_t FirstRow,
+                      int32_t RowCount)
+{
+  __m256 LengthSq = _mm256_setzero_ps();
+  for(int r = FirstRow; r < FirstRow + RowCount; r++)
+  {
+    __m256 Diff = _mm256_sub_ps(_mm256_set1_ps(GoalRows[r]),
+                                _mm256_loadu_ps(Block + r * MM_FEATURE_BLOCK_WIDTH));
+    LengthSq    = _mm256_add_ps(LengthSq, _mm256_mul_ps(Diff, Diff));
+  }
+  return _mm256_sqrt_ps(LengthSq);
+}
+
+inline __m256
+ComputeBlockCost(const float* Block, const mm_feature_goal& Goal, const mm_feature_layout& Layout,
+                 const mm_dynamic_params& Params)
+{
+  __m256 PosDiffSum = _mm256_setzero_ps();
+  __m256 VelDiffSum = _mm256_setzero_ps();
+  for(int b = 0; b < Layout.BoneCount; b++)
+  {
+    PosDiffSum = _mm256_add_ps(PosDiffSum, GetBlockRowDiffLength(Block, Goal.Rows,
+                                                                 Layout.BonePRow + 3 * b, 3));
+  }
+  for(int b = 0; b < Layout.BoneCount; b++)
+  {
+    VelDiffSum = _mm256_add_ps(VelDiffSum, GetBlockRowDiffLength(Block, Goal.Rows,
+                                                                 Layout.BoneVRow + 3 * b, 3));
+  }
+
+  __m256 TrajDiffSum    = _mm256_setzero_ps();
+  __m256 TrajDirDiffSum = _mm256_setzero_ps();
+  for(int p = 0; p < Layout.PointCount; p++)
+  {
+    __m256 Weight = _mm256_set1_ps(Params.TrajectoryWeights[p]);
+    TrajDiffSum =
+      _mm256_add_ps(TrajDiffSum,
+                    _mm256_mul_ps(Weight, GetBlockRowDiffLength(Block, Goal.Rows,
+                                                                 Layout.TrajPRow + 3 * p, 3)));
+    TrajDirDiffSum =
+      _mm256_add_ps(TrajDirDiffSum,
+                    _mm256_mul_ps(Weight, GetBlockRowDiffLength(Block, Goal.Rows,
+                                                                 Layout.TrajDirRow + 2 * p, 2)));
+  }
+
+  __m256 Cost =
+    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(Params.BonePCoefficient), PosDiffSum),
+                  _mm256_mul_ps(_mm256_set1_ps(Params.BoneVCoefficient), VelDiffSum));
+  Cost = _mm256_add_ps(Cost, _mm256_mul_ps(_mm256_set1_ps(Params.TrajPCoefficient), TrajDiffSum));
+  Cost = _mm256_add_ps(Cost,
+                       _mm256_mul_ps(_mm256_set1_ps(Params.TrajAngleCoefficient), TrajDirDiffSum));
+  return Cost;
+}
+#endif
+
+// Scalar fallback used when the target has no AVX, mirrors ComputeBlockCost lane by lane
+void
+ComputeBlockCostScalar(float* OutCosts, const float* Block, const mm_feature_goal& Goal,
+                       const mm_feature_layout& Layout, const mm_dynamic_params& Params)
+{
+  for(int l = 0; l < MM_FEATURE_BLOCK_WIDTH; l++)
+  {
+    OutCosts[l] = CombineCostTerms(ComputeCostTerms(Goal.Rows, Block + l, MM_FEATURE_BLOCK_WIDTH,
+                                                    Layout, Params),
+                                   Params);
+  }
+}
+
+// Per lane running minimum over the feature blocks; ties keep the lowest frame index, also when
+// the blocks are not visited in order
+struct mm_block_search_state
+{
+  float BestCosts[MM_FEATURE_BLOCK_WIDTH];
+  float BestIndices[MM_FEATURE_BLOCK_WIDTH];
+  float BestIsMirrored[MM_FEATURE_BLOCK_WIDTH];
+};
+
+#if defined(__AVX__)
+inline __m256
+IsLaneBetter(__m256 Cost, __m256 Indices, __m256 BestCosts, __m256 BestIndices)
+{
+  __m256 IsCheaper = _mm256_cmp_ps(Cost, BestCosts, _CMP_LT_OQ);
+  __m256 IsTied    = _mm256_cmp_ps(Cost, BestCosts, _CMP_EQ_OQ);
+  __m256 IsEarlier = _mm256_cmp_ps(Indices, BestIndices, _CMP_LT_OQ);
+  return _mm256_or_ps(IsCheaper, _mm256_and_ps(IsTied, IsEarlier));
+}
+#endif
+
+void
+SearchFeatureBlocks(mm_block_search_state* State, const float* Blocks, int32_t FirstBlock,
+                    int32_t EndBlock, int32_t FrameCount, const mm_feature_goal& Goal,
+                    const mm_feature_goal* MirroredGoal, const mm_feature_layout& Layout,
+                    const mm_dynamic_params& Params)
+{
+  const int32_t BlockStride = Layout.RowCount * MM_FEATURE_BLOCK_WIDTH;
+#if defined(__AVX__)
+  __m256 BestCosts      = _mm256_loadu_ps(State->BestCosts);
+  __m256 BestIndices    = _mm256_loadu_ps(State->BestIndices);
+  __m256 BestIsMirrored = _mm256_loadu_ps(State->BestIsMirrored);
+
+  const __m256 LaneStep     = _mm256_set1_ps(float(MM_FEATURE_BLOCK_WIDTH));
+  const __m256 FrameCount8  = _mm256_set1_ps(float(FrameCount));
+  const __m256 MirroredFlag = _mm256_set1_ps(1.0f);
+
+  __m256 Indices = _mm256_add_ps(_mm256_set1_ps(float(FirstBlock * MM_FEATURE_BLOCK_WIDTH)),
+                                 _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7));
+  for(int b = FirstBlock; b < EndBlock; b++)
+  {
+    __m256 IsValid = _mm256_cmp_ps(Indices, FrameCount8, _CMP_LT_OQ);
+
+    __m256 Cost     = ComputeBlockCost(Blocks + b * BlockStride, Goal, Layout, Params);
+    __m256 IsBetter = _mm256_and_ps(IsLaneBetter(Cost, Indices, BestCosts, BestIndices), IsValid);
+    BestCosts       = _mm256_blendv_ps(BestCosts, Cost, IsBetter);
+    BestIndices     = _mm256_blendv_ps(BestIndices, Indices, IsBetter);
+    BestIsMirrored  = _mm256_andnot_ps(IsBetter, BestIsMirrored);
+
+    if(MirroredGoal)
+    {
+      __m256 MirroredCost =
+        ComputeBlockCost(Blocks + b * BlockStride, *MirroredGoal, Layout, Params);
+      IsBetter =
+        _mm256_and_ps(IsLaneBetter(MirroredCost, Indices, BestCosts, BestIndices), IsValid);
+      BestCosts      = _mm256_blendv_ps(BestCosts, MirroredCost, IsBetter);
+      BestIndices    = _mm256_blendv_ps(BestIndices, Indices, IsBetter);
+      BestIsMirrored = _mm256_blendv_ps(BestIsMirrored, MirroredFlag, IsBetter);
+    }
+    Indices = _mm256_add_ps(Indices, LaneStep);
+  }
+
+  _mm256_storeu_ps(State->BestCosts, BestCosts);
+  _mm256_storeu_ps(State->BestIndices, BestIndices);
+  _mm256_storeu_ps(State->BestIsMirrored, BestIsMirrored);
+#else
+  for(int b = FirstBlock; b < EndBlock; b++)
+  {
+    float Costs[MM_FEATURE_BLOCK_WIDTH];
+    float MirroredCosts[MM_FEATURE_BLOCK_WIDTH];
+    ComputeBlockCostScalar(Costs, Blocks + b * BlockStride, Goal, Layout, Params);
+    if(MirroredGoal)
+    {
+      ComputeBlockCostScalar(MirroredCosts, Blocks + b * BlockStride, *MirroredGoal, Layout,
+                             Params);
+    }
+    for(int l = 0; l < MM_FEATURE_BLOCK_WIDTH; l++)
+    {
+      int32_t FrameIndex = b * MM_FEATURE_BLOCK_WIDTH + l;
+      if(FrameCount <= FrameIndex)
+      {
+        break;
+      }
+      if(Costs[l] < State->BestCosts[l] ||
+         (Costs[l] == State->BestCosts[l] && FrameIndex < int32_t(State->BestIndices[l])))
+      {
+        State->BestCosts[l]      = Costs[l];
+        State->BestIndices[l]    = float(FrameIndex);
+        State->BestIsMirrored[l] = 0.0f;
+      }
+      if(MirroredGoal &&
+         (MirroredCosts[l] < State->BestCosts[l] ||
+          (MirroredCosts[l] == State->BestCosts[l] && FrameIndex < int32_t(State->BestIndices[l]))))
+      {
+        State->BestCosts[l]      = MirroredCosts[l];
+        State->BestIndices[l]    = float(FrameIndex);
+        State->BestIsMirrored[l] = 1.0f;
+      }
+    }
+  }
+#endif
+}
+
+void
+InitBlockSearchState(mm_block_search_state* State)
+{
+  for(int l = 0; l < MM_FEATURE_BLOCK_WIDTH; l++)
+  {
+    State->BestCosts[l]      = FLT_MAX;
+    State->BestIndices[l]    = -1.0f;
+    State->BestIsMirrored[l] = 0.0f;
+  }
+}
+
+// Reduces the lanes to a single best match, picking the lowest frame index on equal costs
+float
+ReduceBlockSearchState(int32_t* OutBestIndex, bool* OutIsMirrored,
+                       const mm_block_search_state& State)
+{
+  float   SmallestCost = FLT_MAX;
+  int32_t BestIndex    = -1;
+  bool    IsMirrored   = false;
+  for(int l = 0; l < MM_FEATURE_BLOCK_WIDTH; l++)
+  {
+    int32_t LaneIndex = int32_t(State.BestIndices[l]);
+    if(LaneIndex == -1)
+    {
+      continue;
+    }
+    if(State.BestCosts[l] < SmallestCost ||
+       (State.BestCosts[l] == SmallestCost && LaneIndex < BestIndex))
+    {
+      SmallestCost = State.BestCosts[l];
+      BestIndex    = LaneIndex;
+      IsMirrored   = (State.BestIsMirrored[l] != 0.0f);
+    }
+  }
+  *OutBestIndex  = BestIndex;
+  *OutIsMirrored = IsMirrored;
+  return SmallestCost;
+}
+
+float
+GetBlockSearchBestCost(const mm_block_search_state& State)
+{
+  float BestCost = FLT_MAX;
+  for(int l = 0; l < MM_FEATURE_BLOCK_WIDTH; l++)
+  {
+    BestCost = MinFloat(BestCost, State.BestCosts[l]);
+  }
+  return BestCost;
+}
+
+// Signed distance from the goal value to the closest value in [Min, Max]
+inline float
+GetDistanceToRange(float Value, float Min, float Max)
+{
+  if(Value < Min)
+  {
+    return Value - Min;
+  }
+  if(Max < Value)
+  {
+    return Value - Max;
+  }
+  return 0.0f;
+}
+
+// Distances from the goal to the node's bounds, laid out like the goal rows
+void
+GetNodeDistances(float* OutDistances, const float* NodeBounds, const mm_feature_goal& Goal,
+                 const mm_feature_layout& Layout)
+{
+  const float* MinRows = NodeBounds;
+  const float* MaxRows = NodeBounds + Layout.RowCount;
+  for(int r = 0; r < Layout.RowCount; r++)
+  {
+    OutDistances[r] = GetDistanceToRange(Goal.Rows[r], MinRows[r], MaxRows[r]);
+  }
+}
+
+// Smallest cost any frame inside the node's bounds can have. Uses the same operation order as
+// ComputeCost and every per-axis distance is no larger than the real one, so the bound never
+// exceeds an actual frame cost
+float
+ComputeNodeLowerBound(const float* NodeBounds, const mm_feature_goal& Goal,
+                      const mm_feature_layout& Layout, const mm_dynamic_params& Params)
+{
+  // The distances are the differences of a frame at zero
+  float       Distances[MM_MAX_FEATURE_ROW_COUNT];
+  const float Zeros[MM_MAX_FEATURE_ROW_COUNT] = {};
+  GetNodeDistances(Distances, NodeBounds, Goal, Layout);
+  float LowerBound =
+    CombineCostTerms(ComputeCostTerms(Distances, Zeros, 1, Layout, Params), Params);
+
+  // Stay conservative in case the compiler contracts the two cost evaluations differently
+  return LowerBound * (1.0f - 1e-5f);
+}
+
+// Pruning and the quantized error bounds are only valid when no cost term can be negative
+bool
+HasNonNegativeCostTerms(const mm_controller_data* MMData)
+{
+  const mm_dynamic_params& Params = MMData->Params.DynamicParams;
+  if(Params.BonePCoefficient < 0 || Params.BoneVCoefficient < 0 || Params.TrajPCoefficient < 0 ||
+     Params.TrajAngleCoefficient < 0)
+  {
+    return false;
+  }
+  for(int p = 0; p < MMData->Layout.PointCount; p++)
+  {
+    if(Params.TrajectoryWeights[p] < 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool
+CanUseSearchTree(const mm_controller_data* MMData)
+{
+  return MMData->SearchNodes.IsValid() && HasNonNegativeCostTerms(MMData);
+}
+
+// Both feature stores give the exact ComputeCost result, otherwise Features is scanned directly
+bool
+CanUseSearchData(const mm_controller_data* MMData)
+{
+  return MMData->FeatureBlocks.IsValid() ||
+         (MMData->QuantizedBlocks.IsValid() && HasNonNegativeCostTerms(MMData));
+}
+
+// Goal features relative to the quantization offsets, with a bound on how far the cost computed
+// from the quantized features can be from ComputeCost
+// Adding a 16 bit value to the mantissa of 2^23 gives the float 2^23 + Value, which converts the
+// quantized rows without the 32 bit integer instructions that AVX lacks
+#define MM_QUANTIZED_FLOAT_BIAS 8388608.0f
+#define MM_QUANTIZED_FLOAT_BIAS_HIGH_BITS 0x4B00
+
+// Goal rows in quantized units, biased by MM_QUANTIZED_FLOAT_BIAS
+struct mm_quantized_goal
+{
+  float Rows[MM_MAX_FEATURE_ROW_COUNT];
+  float ErrorBound;
+};
+
+mm_quantized_goal
+GetQuantizedGoal(const mm_feature_goal& Goal, const mm_feature_quantization& Quantization,
+                 const mm_feature_layout& Layout, const mm_dynamic_params& Params)
+{
+  mm_quantized_goal Result;
+  float             RowErrors[MM_MAX_FEATURE_ROW_COUNT];
+  for(int r = 0; r < Layout.RowCount; r++)
+  {
+    const double Scale = Quantization.Scales[r];
+    const double Row =
+      ((double)Goal.Rows[r] - (double)Quantization.Offsets[r]) / Scale + MM_QUANTIZED_FLOAT_BIAS;
+    Result.Rows[r] = (float)Row;
+    // Representation error of the frames plus the rounding of the biased goal row
+    RowErrors[r] =
+      Quantization.MaxErrors[r] + (float)(fabs((double)Result.Rows[r] - Row) * Scale);
+  }
+
+  // The length of a difference changes by at most the length of the error vector
+  const float Zeros[MM_MAX_FEATURE_ROW_COUNT] = {};
+  Result.ErrorBound =
+    1.01f * CombineCostTerms(ComputeCostTerms(RowErrors, Zeros, 1, Layout, Params), Params);
+  return Result;
+}
+
+#if defined(__AVX__)
+inline __m256
+GetQuantizedRowDiffLength(const uint16_t* Block, const mm_quantized_goal& Goal,
+                          const mm_feature_quantization& Quantization, int32_t FirstRow,
+                          int32_t RowCount)
+{
+  const __m128i BiasHighBits = _mm_set1_epi16(MM_QUANTIZED_FLOAT_BIAS_HIGH_BITS);
+
+  __m256 LengthSq = _mm256_setzero_ps();
+  for(int r = FirstRow; r < FirstRow + RowCount; r++)
+  {
+    __m128i Packed = _mm_loadu_si128((const __m128i*)(Block + r * MM_FEATURE_BLOCK_WIDTH));
+    __m256i Values = _mm256_insertf128_si256(_mm256_castsi128_si256(
+                                               _mm_unpacklo_epi16(Packed, BiasHighBits)),
+                                             _mm_unpackhi_epi16(Packed, BiasHighBits), 1);
+    __m256 Diff = _mm256_sub_ps(_mm256_set1_ps(Goal.Rows[r]), _mm256_castsi256_ps(Values));
+    LengthSq    = _mm256_add_ps(LengthSq, _mm256_mul_ps(Diff, Diff));
+  }
+  return _mm256_mul_ps(_mm256_sqrt_ps(LengthSq), _mm256_set1_ps(Quantization.Scales[FirstRow]));
+}
+
+// Approximate cost of the eight frames in the block, within Goal.ErrorBound of ComputeCost
+inline __m256
+ComputeQuantizedBlockCost(const uint16_t* Block, const mm_quantized_goal& Goal,
+                          const mm_feature_quantization& Quantization,
+                          const mm_feature_layout& Layout, const mm_dynamic_params& Params)
+{
+  __m256 PosDiffSum = _mm256_setzero_ps();
+  __m256 VelDiffSum = _mm256_setzero_ps();
+  for(int b = 0; b < Layout.BoneCount; b++)
+  {
+    PosDiffSum = _mm256_add_ps(PosDiffSum, GetQuantizedRowDiffLength(Block, Goal, Quantization,
+                                                                     Layout.BonePRow + 3 * b, 3));
+    VelDiffSum = _mm256_add_ps(VelDiffSum, GetQuantizedRowDiffLength(Block, Goal, Quantization,
+                                                                     Layout.BoneVRow + 3 * b, 3));
+  }
+
+  __m256 TrajDiffSum    = _mm256_setzero_ps();
+  __m256 TrajDirDiffSum = _mm256_setzero_ps();
+  for(int p = 0; p < Layout.PointCount; p++)
+  {
+    __m256 Weight = _mm256_set1_ps(Params.TrajectoryWeights[p]);
+    TrajDiffSum =
+      _mm256_add_ps(TrajDiffSum,
+                    _mm256_mul_ps(Weight, GetQuantizedRowDiffLength(Block, Goal, Quantization,
+                                                                    Layout.TrajPRow + 3 * p, 3)));
+    TrajDirDiffSum =
+      _mm256_add_ps(TrajDirDiffSum,
+                    _mm256_mul_ps(Weight, GetQuantizedRowDiffLength(Block, Goal, Quantization,
+                                                                    Layout.TrajDirRow + 2 * p, 2)));
+  }
+
+  __m256 Cost =
+    _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(Params.BonePCoefficient), PosDiffSum),
+                  _mm256_mul_ps(_mm256_set1_ps(Params.BoneVCoefficient), VelDiffSum));
+  Cost = _mm256_add_ps(Cost, _mm256_mul_ps(_mm256_set1_ps(Params.TrajPCoefficient), TrajDiffSum));
+  Cost = _mm256_add_ps(Cost,
+                       _mm256_mul_ps(_mm256_set1_ps(Params.TrajAngleCoefficient), TrajDirDiffSum));
+  return Cost;
+}
+#endif
+
+inline float
+GetQuantizedRowDiffLengthScalar(const uint16_t* Block, const mm_quantized_goal& Goal,
+                                const mm_feature_quantization& Quantization, int32_t FirstRow,
+                                int32_t RowCount, int32_t Lane)
+{
+  float LengthSq = 0.0f;
+  for(int r = FirstRow; r < FirstRow + RowCount; r++)
+  {
+    float Diff =
+      Goal.Rows[r] - (MM_QUANTIZED_FLOAT_BIAS + float(Block[r * MM_FEATURE_BLOCK_WIDTH + Lane]));
+    LengthSq += Diff * Diff;
+  }
+  return sqrtf(LengthSq) * Quantization.Scales[FirstRow];
+}
+
+void
+ComputeQuantizedBlockCostScalar(float* OutCosts, const uint16_t* Block,
+                                const mm_quantized_goal&       Goal,
+                                const mm_feature_quantization& Quantization,
+                                const mm_feature_layout& Layout, const mm_dynamic_params& Params)
+{
+  for(int l = 0; l < MM_FEATURE_BLOCK_WIDTH; l++)
+  {
+    float PosDiffSum = 0.0f;
+    float VelDiffSum = 0.0f;
+    for(int b = 0; b < Layout.BoneCount; b++)
+    {
+      PosDiffSum += GetQuantizedRowDiffLengthScalar(Block, Goal, Quantization,
+                                                    Layout.BonePRow + 3 * b, 3, l);
+      VelDiffSum += GetQuantizedRowDiffLengthScalar(Block, Goal, Quantization,
+                                                    Layout.BoneVRow + 3 * b, 3, l);
+    }
+
+    float TrajDiffSum    = 0.0f;
+    float TrajDirDiffSum = 0.0f;
+    for(int p = 0; p < Layout.PointCount; p++)
+    {
+      TrajDiffSum += Params.TrajectoryWeights[p] *
+                     GetQuantizedRowDiffLengthScalar(Block, Goal, Quantization,
+                                                     Layout.TrajPRow + 3 * p, 3, l);
+      TrajDirDiffSum += Params.TrajectoryWeights[p] *
+                        GetQuantizedRowDiffLengthScalar(Block, Goal, Quantization,
+                                                        Layout.TrajDirRow + 2 * p, 2, l);
+    }
+
+    OutCosts[l] = Params.BonePCoefficient * PosDiffSum + Params.BoneVCoefficient * VelDiffSum +
+                  Params.TrajPCoefficient * TrajDiffSum +
+                  Params.TrajAngleCoefficient * TrajDirDiffSum;
+  }
+}
+
+void
+ComputeQuantizedBlockCosts(float* OutCosts, const uint16_t* Block, const mm_quantized_goal& Goal,
+                           const mm_feature_quantization& Quantization,
+                           const mm_feature_layout& Layout, const mm_dynamic_params& Params)
+{
+#if defined(__AVX__)
+  _mm256_storeu_ps(OutCosts, ComputeQuantizedBlockCost(Block, Goal, Quantization, Layout, Params));
+#else
+  ComputeQuantizedBlockCostScalar(OutCosts, Block, Goal, Quantization, Layout, Params);
+#endif
+}
+
 
-  mm_frame_info* FrameInfoStorage =
-    PushAlignedArray(TempAlloc, MM_MAX_FRAME_INFO_COUNT, mm_frame_info);
+// Bit l is set when Costs[l] is below Threshold
+inline int32_t
+GetLanesBelowMask(const float* Costs, float Threshold)
+{
+#if defined(__AVX__)
+  return _mm256_movemask_ps(
+    _mm256_cmp_ps(_mm256_loadu_ps(Costs), _mm256_set1_ps(Threshold), _CMP_LT_OQ));
+#else
+  int32_t Mask = 0;
+  for(int l = 0; l < MM_FEATURE_BLOCK_WIDTH; l++)
+  {
+    Mask |= (Costs[l] < Threshold) << l;
+  }
+  return Mask;
+#endif
+}
 
-  // Alloc temp memory for transforms and matrices
-  mat4*      TempMatrices = PushArray(TempAlloc, Params.FixedParams.Skeleton.BoneCount, mat4);
-  transform* TempTransforms =
-    PushArray(TempAlloc, Params.FixedParams.Skeleton.BoneCount, transform);
+struct mm_search_candidate
+{
+  float   Cost;
+  int32_t FrameIndex;
+  bool    IsMirrored;
+};
 
-  // Initialize the frame info stack
-  stack_handle<mm_frame_info> FrameInfoStack = {};
-  FrameInfoStack.Init(FrameInfoStorage, 0, sizeof(mm_frame_info) * MM_MAX_FRAME_INFO_COUNT);
+// The MM_QUANTIZED_CANDIDATE_COUNT cheapest frames by approximate cost, sorted by cost
+struct mm_candidate_list
+{
+  mm_search_candidate Candidates[MM_QUANTIZED_CANDIDATE_COUNT];
+  int32_t             Count;
+};
 
-  // Loop over all animations in the set
-  for(int a = 0; a < Params.AnimRIDs.Count; a++)
+// Frames at or above this approximate cost are not kept by the list
+inline float
+GetCandidateThreshold(const mm_candidate_list& List)
+{
+  if(List.Count < MM_QUANTIZED_CANDIDATE_COUNT)
   {
-    const Anim::animation* Anim = Animations[a];
-    assert(Anim->ChannelCount == Params.FixedParams.Skeleton.BoneCount);
-    assert(1 < Anim->KeyframeCount);
-    const float AnimDuration  = Anim::GetAnimDuration(Anim);
-    const float FrameDuration = AnimDuration / float(Anim->KeyframeCount);
+    return FLT_MAX;
+  }
+  return List.Candidates[MM_QUANTIZED_CANDIDATE_COUNT - 1].Cost;
+}
 
-    const float PositionSamplingPeriod =
-      Params.DynamicParams.TrajectoryTimeHorizon / float(MM_POINT_COUNT);
+void
+InsertCandidate(mm_candidate_list* List, float Cost, int32_t FrameIndex, bool IsMirrored)
+{
+  assert(Cost < GetCandidateThreshold(*List));
+  int32_t InsertIndex = MinInt32(List->Count, MM_QUANTIZED_CANDIDATE_COUNT - 1);
+  while(0 < InsertIndex && Cost < List->Candidates[InsertIndex - 1].Cost)
+  {
+    List->Candidates[InsertIndex] = List->Candidates[InsertIndex - 1];
+    InsertIndex--;
+  }
+  List->Candidates[InsertIndex] = { Cost, FrameIndex, IsMirrored };
+  List->Count                   = MinInt32(List->Count + 1, MM_QUANTIZED_CANDIDATE_COUNT);
+}
 
-    const float AnimStartSkipTime = Anim->SampleTimes[0] + FrameDuration * float(g_SkipFrameCount);
+// Exactly scored frame the search only has to beat
+struct mm_search_bound
+{
+  float   Cost; // FLT_MAX without a bound
+  int32_t FrameIndex;
+  bool    IsMirrored;
+};
 
-    const int32_t NewFrameInfoCount = int32_t(
-      MaxFloat(0.0f,
-               ((AnimDuration - AnimStartSkipTime - Params.DynamicParams.TrajectoryTimeHorizon) *
-                Params.FixedParams.MetadataSamplingFrequency)));
+// Everything a single search needs, in the representations used by the controller's search data
+struct mm_search_goal
+{
+  bool              HasMirroredGoal;
+  bool              UseCostBound; // Whether ComputeBoundedCost is valid for the controller
+  mm_feature_goal   FeatureGoal;
+  mm_feature_goal   MirroredFeatureGoal;
+  mm_quantized_goal QuantizedGoal;
+  mm_quantized_goal QuantizedMirroredGoal;
+  mm_search_bound   Continuation;
+};
 
-    mm_frame_info_range CurrentRange = {};
+void
+InitSearchGoal(mm_search_goal* SearchGoal, const mm_controller_data* MMData,
+               const mm_frame_info& Goal, const mm_frame_info* MirroredGoal)
+{
+  SearchGoal->HasMirroredGoal = (MirroredGoal != NULL);
+  SearchGoal->UseCostBound    = HasNonNegativeCostTerms(MMData);
+  SearchGoal->FeatureGoal     = GetFeatureGoal(Goal, MMData->Layout);
+  SearchGoal->Continuation    = { FLT_MAX, -1, false };
+  if(MirroredGoal)
+  {
+    SearchGoal->MirroredFeatureGoal = GetFeatureGoal(*MirroredGoal, MMData->Layout);
+  }
+  if(MMData->QuantizedBlocks.IsValid())
+  {
+    SearchGoal->QuantizedGoal = GetQuantizedGoal(SearchGoal->FeatureGoal, MMData->Quantization,
+                                                 MMData->Layout, MMData->Params.DynamicParams);
+    if(MirroredGoal)
     {
-      CurrentRange.StartTimeInAnim = AnimStartSkipTime;
-      CurrentRange.Start           = FrameInfoStack.Count;
-      CurrentRange.End             = FrameInfoStack.Count + NewFrameInfoCount;
+      SearchGoal->QuantizedMirroredGoal =
+        GetQuantizedGoal(SearchGoal->MirroredFeatureGoal, MMData->Quantization, MMData->Layout,
+                         MMData->Params.DynamicParams);
     }
-    FrameInfoStack.Expand(NewFrameInfoCount);
-    MMData->AnimFrameInfoRanges.Push(CurrentRange);
+  }
+}
 
-    for(int i = 0; i < NewFrameInfoCount; i++)
-    {
-      int32_t FrameInfoIndex    = CurrentRange.Start + i;
-      float   CurrentSampleTime = CurrentRange.StartTimeInAnim +
-                                float(i) * (1.0f / Params.FixedParams.MetadataSamplingFrequency);
-      Anim::LinearAnimationSample(TempTransforms, Anim, CurrentSampleTime);
+// Frame of the set playing Continuation, -1 when it is not part of the set
+int32_t
+GetContinuationFrameIndex(const mm_controller_data* MMData, const mm_continuation& Continuation)
+{
+  if(Continuation.AnimIndex < 0 || MMData->AnimFrameInfoRanges.Count <= Continuation.AnimIndex)
+  {
+    return -1;
+  }
+  const mm_frame_info_range Range = MMData->AnimFrameInfoRanges[Continuation.AnimIndex];
+  const int32_t             FrameIndex =
+    Range.Start + (int32_t)floorf((Continuation.LocalTime - Range.StartTimeInAnim) *
+                                    MMData->Params.FixedParams.MetadataSamplingFrequency +
+                                  0.5f);
+  return (Range.Start <= FrameIndex && FrameIndex < Range.End) ? FrameIndex : -1;
+}
+
+float ComputeExactCost(const mm_controller_data* MMData, const mm_search_goal& SearchGoal,
+                       int32_t FrameIndex, bool IsMirrored);
+
+// Scores the frame that keeps the current animation playing, the search then only looks for
+// frames beating it
+void
+SetSearchGoalContinuation(mm_search_goal* SearchGoal, mm_search_stats* Stats,
+                          const mm_controller_data* MMData, const mm_continuation& Continuation)
+{
+  const int32_t FrameIndex = GetContinuationFrameIndex(MMData, Continuation);
+  if(FrameIndex == -1 || !SearchGoal->UseCostBound ||
+     (Continuation.IsMirrored && !SearchGoal->HasMirroredGoal))
+  {
+    return;
+  }
+  SearchGoal->Continuation.Cost =
+    ComputeExactCost(MMData, *SearchGoal, FrameIndex, Continuation.IsMirrored);
+  SearchGoal->Continuation.FrameIndex = FrameIndex;
+  SearchGoal->Continuation.IsMirrored = Continuation.IsMirrored;
+  Stats->FramesTouched++;
+}
 
-      Anim::ComputeBoneSpacePoses(TempMatrices, TempTransforms, Anim->ChannelCount);
-      ComputeModelSpacePoses(TempMatrices, TempMatrices, &Params.FixedParams.Skeleton);
-      ComputeFinalHierarchicalPoses(TempMatrices, TempMatrices, &Params.FixedParams.Skeleton);
+// Largest possible difference between an approximate quantized cost near Cost and the exact one
+inline float
+GetQuantizedCostSlack(float Cost, const mm_search_goal& SearchGoal)
+{
+  float ErrorBound = SearchGoal.QuantizedGoal.ErrorBound;
+  if(SearchGoal.HasMirroredGoal)
+  {
+    ErrorBound = MaxFloat(ErrorBound, SearchGoal.QuantizedMirroredGoal.ErrorBound);
+  }
+  // Leave room for the different rounding of the two cost evaluations
+  return ErrorBound + 1e-4f * AbsFloat(Cost) + 1e-6f;
+}
 
-      mat4    InvRootMatrix;
-      mat4    RootMatrix;
-      int32_t HipIndex = 0;
-      mat4    HipMatrix =
-        Math::MulMat4(TempMatrices[HipIndex], Params.FixedParams.Skeleton.Bones[HipIndex].BindPose);
-      Anim::GetRootAndInvRootMatrices(&RootMatrix, &InvRootMatrix, HipMatrix);
+// Frames at or above this approximate cost are not kept by the list. Besides the list being full,
+// a frame more than two slacks above the cheapest candidate or one slack above the exact cost of
+// the continuation can not beat it once rescored
+inline float
+GetCandidateInsertThreshold(const mm_candidate_list& List, const mm_search_goal& SearchGoal)
+{
+  const float ContinuationCost = SearchGoal.Continuation.Cost;
+  const float BoundThreshold =
+    (ContinuationCost == FLT_MAX)
+      ? FLT_MAX
+      : ContinuationCost + GetQuantizedCostSlack(ContinuationCost, SearchGoal);
+  if(List.Count == 0)
+  {
+    return BoundThreshold;
+  }
+  const float BestCost   = List.Candidates[0].Cost;
+  const float UpperBound = BestCost + GetQuantizedCostSlack(BestCost, SearchGoal);
+  return MinFloat(BoundThreshold,
+                  MinFloat(GetCandidateThreshold(List),
+                           UpperBound + GetQuantizedCostSlack(UpperBound, SearchGoal)));
+}
 
-      // Fill Bone Positions
-      for(int b = 0; b < Params.FixedParams.ComparisonBoneIndices.Count; b++)
-      {
-        FrameInfoStack[FrameInfoIndex].BonePs[b] =
-          Math::MulMat4(InvRootMatrix,
-                        Math::MulMat4(TempMatrices[Params.FixedParams.ComparisonBoneIndices[b]],
-                                      Params.FixedParams.Skeleton
-                                        .Bones[Params.FixedParams.ComparisonBoneIndices[b]]
-                                        .BindPose))
-            .T;
-      }
-      // Fill Bone Trajectory Positions
+void
+SearchQuantizedBlocks(mm_candidate_list* Candidates, const mm_controller_data* MMData,
+                      int32_t FirstBlock, int32_t EndBlock, const mm_search_goal& SearchGoal)
+{
+  const uint16_t*                Blocks       = MMData->QuantizedBlocks.Elements;
+  const mm_feature_quantization& Quantization = MMData->Quantization;
+  const mm_feature_layout&       Layout       = MMData->Layout;
+  const mm_dynamic_params&       Params       = MMData->Params.DynamicParams;
+  const int32_t                  BlockStride  = Layout.RowCount * MM_FEATURE_BLOCK_WIDTH;
+  for(int b = FirstBlock; b < EndBlock; b++)
+  {
+    float Costs[MM_FEATURE_BLOCK_WIDTH];
+    float MirroredCosts[MM_FEATURE_BLOCK_WIDTH];
+    ComputeQuantizedBlockCosts(Costs, Blocks + b * BlockStride, SearchGoal.QuantizedGoal,
+                               Quantization, Layout, Params);
+    if(SearchGoal.HasMirroredGoal)
+    {
+      ComputeQuantizedBlockCosts(MirroredCosts, Blocks + b * BlockStride,
+                                 SearchGoal.QuantizedMirroredGoal, Quantization, Layout, Params);
+    }
 
-      for(int p = 0; p < MM_POINT_COUNT; p++)
-      {
-        transform SampleHipTransform =
-          Anim::LinearAnimationBoneSample(Anim, HipIndex,
-                                          CurrentSampleTime + (p + 1) * PositionSamplingPeriod);
-        // NOTE(Lukas) this should use the root bone if animation has a dedicated one
-        const Anim::bone* Bone = &Params.FixedParams.Skeleton.Bones[HipIndex];
-        mat4              CurrentHipMatrix =
-          Math::MulMat4(Bone->BindPose,
-                        Math::MulMat4(TransformToMat4(SampleHipTransform), Bone->InverseBindPose));
-        vec3 SamplePoint      = CurrentHipMatrix.T;
-        vec4 SamplePointHomog = { SamplePoint, 1 };
-        FrameInfoStack[FrameInfoIndex].TrajectoryPs[p] =
-          Math::MulMat4Vec4(InvRootMatrix, SamplePointHomog).XYZ;
-
-        FrameInfoStack[FrameInfoIndex].TrajectoryPs[p].Y = 0;
-
-        vec3 CurrentZInTrajectorySpace =
-          Math::MulMat4Vec4(InvRootMatrix, { CurrentHipMatrix.Z, 0 }).XYZ;
-
-        FrameInfoStack[FrameInfoIndex].TrajectoryAngles[p] =
-          atan2f(CurrentZInTrajectorySpace.X, CurrentZInTrajectorySpace.Z);
-      }
+    // Most blocks have no frame good enough for the list
+    const float Threshold = GetCandidateInsertThreshold(*Candidates, SearchGoal);
+    if(GetLanesBelowMask(Costs, Threshold) == 0 &&
+       (!SearchGoal.HasMirroredGoal || GetLanesBelowMask(MirroredCosts, Threshold) == 0))
+    {
+      continue;
     }
 
-    // Compute velocity for first n-1 frames
-    for(int i = 0; i < NewFrameInfoCount - 1; i++)
+    const int32_t FirstFrame = b * MM_FEATURE_BLOCK_WIDTH;
+    const int32_t LaneCount  = MinInt32(MM_FEATURE_BLOCK_WIDTH, MMData->FrameCount - FirstFrame);
+    for(int l = 0; l < LaneCount; l++)
     {
-      for(int b = 0; b < MM_COMPARISON_BONE_COUNT; b++)
+      if(Costs[l] < GetCandidateInsertThreshold(*Candidates, SearchGoal))
       {
-        FrameInfoStack[i].BoneVs[b] =
-          (FrameInfoStack[i + 1].BonePs[b] - FrameInfoStack[i].BonePs[b]) *
-          MMData->Params.FixedParams.MetadataSamplingFrequency;
+        InsertCandidate(Candidates, Costs[l], FirstFrame + l, false);
       }
-
-      for(int p = 0; p < MM_POINT_COUNT; p++)
+      if(SearchGoal.HasMirroredGoal &&
+         MirroredCosts[l] < GetCandidateInsertThreshold(*Candidates, SearchGoal))
       {
-        FrameInfoStack[i].TrajectoryVs[p] =
-          Math::Length(FrameInfoStack[i + 1].TrajectoryPs[p] - FrameInfoStack[i].TrajectoryPs[p]) /
-          PositionSamplingPeriod;
+        InsertCandidate(Candidates, MirroredCosts[l], FirstFrame + l, true);
       }
     }
+  }
+}
+
+// Per search progress, only the member matching the controller's feature store is used
+struct mm_search_state
+{
+  mm_block_search_state BlockState;
+  mm_candidate_list     Candidates;
+  int32_t               FramesTouched;
+};
+
+// The continuation frame goes to the lane a block scan would put it in, so that it takes part in
+// the pruning and in the final reduction like any scanned frame
+void
+InitSearchState(mm_search_state* State, const mm_search_goal& SearchGoal)
+{
+  InitBlockSearchState(&State->BlockState);
+  State->Candidates.Count = 0;
+  State->FramesTouched    = 0;
+
+  const mm_search_bound& Continuation = SearchGoal.Continuation;
+  if(Continuation.FrameIndex != -1)
+  {
+    const int32_t Lane                   = Continuation.FrameIndex % MM_FEATURE_BLOCK_WIDTH;
+    State->BlockState.BestCosts[Lane]      = Continuation.Cost;
+    State->BlockState.BestIndices[Lane]    = float(Continuation.FrameIndex);
+    State->BlockState.BestIsMirrored[Lane] = Continuation.IsMirrored ? 1.0f : 0.0f;
+  }
+}
+
+void
+SearchBlocks(mm_search_state* State, const mm_controller_data* MMData, int32_t FirstBlock,
+             int32_t EndBlock, const mm_search_goal& SearchGoal)
+{
+  const int32_t FrameCount =
+    MinInt32(EndBlock * MM_FEATURE_BLOCK_WIDTH, MMData->FrameCount) -
+    FirstBlock * MM_FEATURE_BLOCK_WIDTH;
+  State->FramesTouched += SearchGoal.HasMirroredGoal ? 2 * FrameCount : FrameCount;
+  if(MMData->QuantizedBlocks.IsValid())
+  {
+    SearchQuantizedBlocks(&State->Candidates, MMData, FirstBlock, EndBlock, SearchGoal);
+  }
+  else
+  {
+    SearchFeatureBlocks(&State->BlockState, MMData->FeatureBlocks.Elements, FirstBlock, EndBlock,
+                        MMData->FrameCount, SearchGoal.FeatureGoal,
+                        SearchGoal.HasMirroredGoal ? &SearchGoal.MirroredFeatureGoal : NULL,
+                        MMData->Layout, MMData->Params.DynamicParams);
+  }
+}
+
+// Frames whose exact cost is above the threshold can not change the result of the search
+float
+GetPruningThreshold(const mm_search_state& State, const mm_controller_data* MMData,
+                    const mm_search_goal& SearchGoal)
+{
+  if(MMData->QuantizedBlocks.IsValid())
+  {
+    float Threshold = GetCandidateInsertThreshold(State.Candidates, SearchGoal);
+    return (Threshold == FLT_MAX) ? FLT_MAX
+                                  : Threshold + GetQuantizedCostSlack(Threshold, SearchGoal);
+  }
+  return GetBlockSearchBestCost(State.BlockState);
+}
+
+struct mm_search_node_entry
+{
+  int32_t NodeIndex;
+  float   LowerBound;
+};
+
+// Depth first traversal of the subtree at RootNodeIndex visiting the child with the smaller bound
+// first. Nodes whose lower bound exceeds the pruning threshold are skipped
+void
+SearchTree(mm_search_state* State, const mm_controller_data* MMData, int32_t RootNodeIndex,
+           const mm_search_goal& SearchGoal)
+{
+  const mm_dynamic_params& Params     = MMData->Params.DynamicParams;
+  const mm_feature_layout& Layout     = MMData->Layout;
+  const mm_search_node*    Nodes      = MMData->SearchNodes.Elements;
+  const float*             NodeBounds = MMData->SearchNodeBounds.Elements;
+
+  fixed_stack<mm_search_node_entry, 2 * MM_SEARCH_TREE_MAX_DEPTH> NodeStack;
+  NodeStack.Push({ RootNodeIndex, 0.0f });
+
+  float Threshold = GetPruningThreshold(*State, MMData, SearchGoal);
+  while(!NodeStack.Empty())
+  {
+    mm_search_node_entry Entry = NodeStack.Pop();
+    if(Threshold < Entry.LowerBound)
+    {
+      continue;
+    }
+
+    const mm_search_node& Node = Nodes[Entry.NodeIndex];
+    if(Node.ChildIndices[0] == -1)
+    {
+      SearchBlocks(State, MMData, Node.FirstBlock, Node.EndBlock, SearchGoal);
+      Threshold = GetPruningThreshold(*State, MMData, SearchGoal);
+      continue;
+    }
 
-    if(0 < NewFrameInfoCount)
+    mm_search_node_entry Children[2];
+    for(int c = 0; c < 2; c++)
     {
-      int32_t LastFrameIndex = NewFrameInfoCount - 1;
-      // Copy the velocity for the last frame
-      // Last frames data
-      for(int b = 0; b < MM_COMPARISON_BONE_COUNT; b++)
+      const float* ChildBounds = NodeBounds + 2 * Layout.RowCount * Node.ChildIndices[c];
+      Children[c].NodeIndex    = Node.ChildIndices[c];
+      Children[c].LowerBound =
+        ComputeNodeLowerBound(ChildBounds, SearchGoal.FeatureGoal, Layout, Params);
+      if(SearchGoal.HasMirroredGoal)
       {
-        FrameInfoStack[LastFrameIndex].BoneVs[b] =
-          (0 < LastFrameIndex) ? FrameInfoStack[LastFrameIndex - 1].BoneVs[b] : vec3{ 0, 0, 0 };
+        Children[c].LowerBound =
+          MinFloat(Children[c].LowerBound,
+                   ComputeNodeLowerBound(ChildBounds, SearchGoal.MirroredFeatureGoal, Layout,
+                                         Params));
       }
-      /*for(int p = 0; p < MM_POINT_COUNT; p++)
-      {
-        FrameInfoStack[LastFrameIndex].TrajectoryVs[p] =
-          (0 < LastFrameIndex) ? FrameInfoStack[LastFrameIndex - 1].TrajectoryVs[p] : 0.0f;
-      }*/
     }
+    // Push the further child first so that the closer one is searched first
+    int32_t Closer = (Children[1].LowerBound < Children[0].LowerBound) ? 1 : 0;
+    if(Children[1 - Closer].LowerBound <= Threshold)
+    {
+      NodeStack.Push(Children[1 - Closer]);
+    }
+    if(Children[Closer].LowerBound <= Threshold)
+    {
+      NodeStack.Push(Children[Closer]);
+    }
+  }
+}
+
+// Orders matches by cost, then by frame index, then unmirrored before mirrored
+inline bool
+IsBetterMatch(float Cost, int32_t FrameIndex, bool IsMirrored, float BestCost,
+              int32_t BestFrameIndex, bool BestIsMirrored)
+{
+  if(BestFrameIndex == -1 || Cost < BestCost)
+  {
+    return true;
   }
-  MMData->FrameInfos            = FrameInfoStack.GetArrayHandle();
-  Memory::marker AssetEndMarker = {};
+  if(Cost == BestCost)
   {
-      AssetEndMarker.Address = (uint8_t*)(MMData->FrameInfos.Elements + MMData->FrameInfos.Count);
+    return (FrameIndex < BestFrameIndex) ||
+           (FrameIndex == BestFrameIndex && !IsMirrored && BestIsMirrored);
   }
+  return false;
+}
 
-  // Set up the mirroring info for goal generation
-  MMData->Params.FixedParams.MirrorBoneIndices.HardClear();
-  if(MMData->Params.DynamicParams.MatchMirroredAnimations)
+float
+ComputeExactCost(const mm_controller_data* MMData, const mm_search_goal& SearchGoal,
+                 int32_t FrameIndex, bool IsMirrored)
+{
+  float Frame[MM_MAX_FEATURE_ROW_COUNT];
+  GetFrameFeatures(Frame, MMData, FrameIndex);
+  return ComputeCost(IsMirrored ? SearchGoal.MirroredFeatureGoal.Rows : SearchGoal.FeatureGoal.Rows,
+                     Frame, MMData->Layout, MMData->Params.DynamicParams);
+}
+
+// Exact cost of frames that can still beat a match of cost Bound, anything above Bound otherwise
+float
+ComputeCostBelowBound(mm_search_stats* Stats, const mm_controller_data* MMData,
+                      const mm_search_goal& SearchGoal, int32_t FrameIndex, bool IsMirrored,
+                      float Bound)
+{
+  float Frame[MM_MAX_FEATURE_ROW_COUNT];
+  GetFrameFeatures(Frame, MMData, FrameIndex);
+  bool  CutShort = false;
+  float Cost =
+    ComputeBoundedCost(&CutShort,
+                       IsMirrored ? SearchGoal.MirroredFeatureGoal.Rows
+                                  : SearchGoal.FeatureGoal.Rows,
+                       Frame, MMData->Layout, MMData->Params.DynamicParams,
+                       SearchGoal.UseCostBound ? Bound : FLT_MAX);
+  Stats->FramesTouched++;
+  Stats->FramesCutShort += CutShort ? 1 : 0;
+  return Cost;
+}
+
+// Rescores the candidates of every state against MMData->ExactFeatures. The result is proven exact
+// when every frame left out of the candidates has an approximate cost too high to beat it,
+// otherwise all frames that could still beat it are rescored
+float
+FinishQuantizedSearch(int32_t* OutBestIndex, bool* OutIsMirrored, mm_search_stats* Stats,
+                      const mm_controller_data* MMData, const mm_search_goal& SearchGoal,
+                      const mm_search_state* States, int32_t StateCount)
+{
+  float   BestCost       = SearchGoal.Continuation.Cost;
+  int32_t BestIndex      = SearchGoal.Continuation.FrameIndex;
+  bool    BestIsMirrored = SearchGoal.Continuation.IsMirrored;
+  float   MinThreshold   = FLT_MAX;
+  for(int s = 0; s < StateCount; s++)
   {
-    for(int i = 0; i < MMData->Params.FixedParams.ComparisonBoneIndices.Count; i++)
+    const mm_candidate_list& List = States[s].Candidates;
+    for(int c = 0; c < List.Count; c++)
     {
-      int BoneA = MMData->Params.FixedParams.ComparisonBoneIndices[i];
-      int BoneB = -1;
-      for(int p = 0; p < MMData->Params.DynamicParams.MirrorInfo.PairCount; p++)
+      const mm_search_candidate& Candidate = List.Candidates[c];
+      float Cost = ComputeCostBelowBound(Stats, MMData, SearchGoal, Candidate.FrameIndex,
+                                         Candidate.IsMirrored, BestCost);
+      if(IsBetterMatch(Cost, Candidate.FrameIndex, Candidate.IsMirrored, BestCost, BestIndex,
+                       BestIsMirrored))
       {
-        int CandidateA = MMData->Params.DynamicParams.MirrorInfo.BoneMirrorIndices[p].a;
-        int CandidateB = MMData->Params.DynamicParams.MirrorInfo.BoneMirrorIndices[p].b;
-        if(BoneA == CandidateA)
-        {
-          BoneB = CandidateB;
-					break;
-        }
+        BestCost       = Cost;
+        BestIndex      = Candidate.FrameIndex;
+        BestIsMirrored = Candidate.IsMirrored;
+      }
+    }
+    MinThreshold = MinFloat(MinThreshold, GetCandidateThreshold(List));
+  }
+  assert(BestIndex != -1);
 
-        if(BoneA == CandidateB)
+  const float RescoreThreshold = BestCost + GetQuantizedCostSlack(BestCost, SearchGoal);
+  if(MinThreshold != FLT_MAX && MinThreshold <= RescoreThreshold)
+  {
+    const uint16_t*                Blocks       = MMData->QuantizedBlocks.Elements;
+    const mm_feature_quantization& Quantization = MMData->Quantization;
+    const mm_feature_layout&       Layout       = MMData->Layout;
+    const mm_dynamic_params&       Params       = MMData->Params.DynamicParams;
+    const int32_t                  BlockStride  = Layout.RowCount * MM_FEATURE_BLOCK_WIDTH;
+    for(int b = 0; b < MMData->BlockCount; b++)
+    {
+      float Costs[MM_FEATURE_BLOCK_WIDTH];
+      float MirroredCosts[MM_FEATURE_BLOCK_WIDTH];
+      ComputeQuantizedBlockCosts(Costs, Blocks + b * BlockStride, SearchGoal.QuantizedGoal,
+                                 Quantization, Layout, Params);
+      if(SearchGoal.HasMirroredGoal)
+      {
+        ComputeQuantizedBlockCosts(MirroredCosts, Blocks + b * BlockStride,
+                                   SearchGoal.QuantizedMirroredGoal, Quantization, Layout, Params);
+      }
+
+      const int32_t FirstFrame = b * MM_FEATURE_BLOCK_WIDTH;
+      const int32_t LaneCount  = MinInt32(MM_FEATURE_BLOCK_WIDTH, MMData->FrameCount - FirstFrame);
+      Stats->FramesTouched += SearchGoal.HasMirroredGoal ? 2 * LaneCount : LaneCount;
+      for(int l = 0; l < LaneCount; l++)
+      {
+        for(int m = 0; m < (SearchGoal.HasMirroredGoal ? 2 : 1); m++)
         {
-          BoneB = CandidateA;
-					break;
+          const bool IsMirrored = (m == 1);
+          if((IsMirrored ? MirroredCosts[l] : Costs[l]) <= RescoreThreshold)
+          {
+            float Cost = ComputeCostBelowBound(Stats, MMData, SearchGoal, FirstFrame + l,
+                                               IsMirrored, BestCost);
+            if(IsBetterMatch(Cost, FirstFrame + l, IsMirrored, BestCost, BestIndex,
+                             BestIsMirrored))
+            {
+              BestCost       = Cost;
+              BestIndex      = FirstFrame + l;
+              BestIsMirrored = IsMirrored;
+            }
+          }
         }
       }
-      // TODO(Lukas) Make sura that the bones selected are always in the mirror info stack
-      assert(BoneB != -1 && "Search bone does not have a mirror");
-      MMData->Params.FixedParams.MirrorBoneIndices.Push(BoneB);
     }
   }
 
-  TempAlloc->FreeToMarker(AssetEndMarker);
-  return MMData;
+  *OutBestIndex  = BestIndex;
+  *OutIsMirrored = BestIsMirrored;
+  return BestCost;
 }
 
+// Merges the results of searches over disjoint parts of the motion set
 float
-ComputeCost(const mm_frame_info& A, const mm_frame_info& B, float PosCoef, float VelCoef,
-            float TrajCoef, float TrajVCoef, float TrajAngleCoef, const float* TrajectoryWeights)
+FinishSearch(int32_t* OutBestIndex, bool* OutIsMirrored, mm_search_stats* Stats,
+             const mm_controller_data* MMData, const mm_search_goal& SearchGoal,
+             const mm_search_state* States, int32_t StateCount)
 {
-  float PosDiffSum = 0.0f;
-  for(int b = 0; b < MM_COMPARISON_BONE_COUNT; b++)
+  for(int s = 0; s < StateCount; s++)
   {
-    vec3 Diff = A.BonePs[b] - B.BonePs[b];
-    PosDiffSum += Math::Length(Diff);
+    Stats->FramesTouched += States[s].FramesTouched;
   }
-
-  float VelDiffSum = 0.0f;
-  for(int b = 0; b < MM_COMPARISON_BONE_COUNT; b++)
+  if(MMData->QuantizedBlocks.IsValid())
   {
-    vec3 VelDiff = A.BoneVs[b] - B.BoneVs[b];
-    VelDiffSum += Math::Length(VelDiff);
+    return FinishQuantizedSearch(OutBestIndex, OutIsMirrored, Stats, MMData, SearchGoal, States,
+                                 StateCount);
   }
 
-  float TrajDiffSum  = 0.0f;
-  //float TrajVDiffSum = 0.0f;
-  for(int p = 0; p < MM_POINT_COUNT; p++)
+  float   BestCost       = FLT_MAX;
+  int32_t BestIndex      = -1;
+  bool    BestIsMirrored = false;
+  for(int s = 0; s < StateCount; s++)
   {
-    vec3 Diff = A.TrajectoryPs[p] - B.TrajectoryPs[p];
-    TrajDiffSum += TrajectoryWeights[p] * Math::Length(Diff);
-    /*float VDiff = TrajectoryWeights[p] * fabs(A.TrajectoryVs[p] - B.TrajectoryVs[p]);
-    TrajVDiffSum += VDiff;*/
+    int32_t StateBestIndex;
+    bool    StateIsMirrored;
+    float   StateCost = ReduceBlockSearchState(&StateBestIndex, &StateIsMirrored,
+                                             States[s].BlockState);
+    if(StateBestIndex != -1 &&
+       IsBetterMatch(StateCost, StateBestIndex, StateIsMirrored, BestCost, BestIndex,
+                     BestIsMirrored))
+    {
+      BestCost       = StateCost;
+      BestIndex      = StateBestIndex;
+      BestIsMirrored = StateIsMirrored;
+    }
   }
+  *OutBestIndex  = BestIndex;
+  *OutIsMirrored = BestIsMirrored;
+  return BestCost;
+}
 
-  float TrajDirDiffSum = 0.0f;
-  for(int p = 0; p < MM_POINT_COUNT; p++)
+struct mm_search_task
+{
+  const mm_controller_data* MMData;
+  const mm_search_goal*     SearchGoal;
+  int32_t                   RootNodeIndex; // -1 when linearly scanning [FirstBlock, EndBlock)
+  int32_t                   FirstBlock;
+  int32_t                   EndBlock;
+  mm_search_state           State;
+};
+
+JOB_FUNCTION(SearchTaskJob)
+{
+  mm_search_task* Task = (mm_search_task*)Data;
+  InitSearchState(&Task->State, *Task->SearchGoal);
+  if(Task->RootNodeIndex != -1)
   {
-    vec2 DirA = { sinf(A.TrajectoryAngles[p]), cosf(A.TrajectoryAngles[p]) };
-    vec2 DirB = { sinf(B.TrajectoryAngles[p]), cosf(B.TrajectoryAngles[p]) };
-    vec2 Diff = DirA - DirB;
-    TrajDirDiffSum += TrajectoryWeights[p] * Math::Length(Diff);
+    SearchTree(&Task->State, Task->MMData, Task->RootNodeIndex, *Task->SearchGoal);
   }
+  else
+  {
+    SearchBlocks(&Task->State, Task->MMData, Task->FirstBlock, Task->EndBlock, *Task->SearchGoal);
+  }
+}
 
-  float Cost = PosCoef * PosDiffSum + VelCoef * VelDiffSum + TrajCoef * TrajDiffSum +
-               /*TrajVCoef * TrajVDiffSum +*/ TrajAngleCoef * TrajDirDiffSum;
-
-  return Cost;
+// Splits the search tree into at most MaxRootCount disjoint subtrees by repeatedly expanding the
+// subtree covering the most blocks
+int32_t
+GetSearchTreeTaskRoots(int32_t* OutRootIndices, int32_t MaxRootCount, const mm_search_node* Nodes)
+{
+  int32_t RootCount = 1;
+  OutRootIndices[0] = 0;
+  while(RootCount < MaxRootCount)
+  {
+    int32_t LargestRoot       = -1;
+    int32_t LargestBlockCount = 0;
+    for(int r = 0; r < RootCount; r++)
+    {
+      const mm_search_node& Node = Nodes[OutRootIndices[r]];
+      if(Node.ChildIndices[0] != -1 && LargestBlockCount < Node.EndBlock - Node.FirstBlock)
+      {
+        LargestRoot       = r;
+        LargestBlockCount = Node.EndBlock - Node.FirstBlock;
+      }
+    }
+    if(LargestRoot == -1)
+    {
+      break;
+    }
+    const mm_search_node& Expanded = Nodes[OutRootIndices[LargestRoot]];
+    OutRootIndices[LargestRoot]    = Expanded.ChildIndices[0];
+    OutRootIndices[RootCount++]    = Expanded.ChildIndices[1];
+  }
+  return RootCount;
 }
 
+// Finds the cheapest frame in the search data. With a search tree the nodes are visited depth
+// first, the child with the smaller lower bound first, and every node whose lower bound on the
+// cost of its frames exceeds the best cost found so far is skipped with all of its frames. Without
+// a usable tree every feature block is scored. Large searches are split into subtrees or block
+// ranges run as tasks, whose results are merged picking the lowest frame index on equal costs, so
+// the result does not depend on the task count or on the order in which the tasks finish
 float
-ComputeCostComponents(float* BonePCost, float* BoneVCost, float* TrajPCost, float* TrajVCost,
-                      float* TrajACost, const mm_frame_info& A, const mm_frame_info& B,
-                      float PosCoef, float VelCoef, float TrajCoef, float TrajVCoef,
-                      float TrajAngleCoef, const float* TrajectoryWeights)
+SearchFeatures(int32_t* OutBestIndex, bool* OutIsMirrored, mm_search_stats* Stats,
+               const mm_controller_data* MMData, const mm_search_goal& SearchGoal)
 {
-  float PosDiffSum = 0.0f;
-  for(int b = 0; b < MM_COMPARISON_BONE_COUNT; b++)
+  const bool    UseTree     = CanUseSearchTree(MMData);
+  const int32_t ThreadCount = GetJobThreadCount();
+  if(ThreadCount <= 1 || MMData->FrameCount < MM_PARALLEL_SEARCH_MIN_FRAME_COUNT)
   {
-    vec3 Diff = A.BonePs[b] - B.BonePs[b];
-    PosDiffSum += Math::Length(Diff);
+    mm_search_state SearchState;
+    InitSearchState(&SearchState, SearchGoal);
+    if(UseTree)
+    {
+      SearchTree(&SearchState, MMData, 0, SearchGoal);
+    }
+    else
+    {
+      SearchBlocks(&SearchState, MMData, 0, MMData->BlockCount, SearchGoal);
+    }
+    return FinishSearch(OutBestIndex, OutIsMirrored, Stats, MMData, SearchGoal, &SearchState, 1);
   }
 
-  float VelDiffSum = 0.0f;
-  for(int b = 0; b < MM_COMPARISON_BONE_COUNT; b++)
+  const int32_t  BlockCount = MMData->BlockCount;
+  mm_search_task Tasks[MM_PARALLEL_SEARCH_MAX_TASK_COUNT];
+  job            Jobs[MM_PARALLEL_SEARCH_MAX_TASK_COUNT];
+  int32_t        TaskCount =
+    MinInt32(ThreadCount * MM_PARALLEL_SEARCH_TASKS_PER_THREAD, MM_PARALLEL_SEARCH_MAX_TASK_COUNT);
+  if(UseTree)
   {
-    vec3 VelDiff = A.BoneVs[b] - B.BoneVs[b];
-    VelDiffSum += Math::Length(VelDiff);
+    int32_t RootIndices[MM_PARALLEL_SEARCH_MAX_TASK_COUNT];
+    TaskCount = GetSearchTreeTaskRoots(RootIndices, TaskCount, MMData->SearchNodes.Elements);
+    for(int t = 0; t < TaskCount; t++)
+    {
+      Tasks[t].RootNodeIndex = RootIndices[t];
+    }
   }
-
-  float TrajDiffSum  = 0.0f;
-  //float TrajVDiffSum = 0.0f;
-  for(int p = 0; p < MM_POINT_COUNT; p++)
+  else
   {
-    vec3 Diff = A.TrajectoryPs[p] - B.TrajectoryPs[p];
-    TrajDiffSum += TrajectoryWeights[p] * Math::Length(Diff);
-    /*float VDiff = TrajectoryWeights[p] * fabs(A.TrajectoryVs[p] - B.TrajectoryVs[p]);
-    TrajVDiffSum += VDiff;*/
+    TaskCount = MinInt32(TaskCount, BlockCount);
+    for(int t = 0; t < TaskCount; t++)
+    {
+      Tasks[t].RootNodeIndex = -1;
+      Tasks[t].FirstBlock    = (BlockCount * t) / TaskCount;
+      Tasks[t].EndBlock      = (BlockCount * (t + 1)) / TaskCount;
+    }
   }
-
-  float TrajDirDiffSum = 0.0f;
-  for(int p = 0; p < MM_POINT_COUNT; p++)
+  for(int t = 0; t < TaskCount; t++)
   {
-    vec2 DirA = { sinf(A.TrajectoryAngles[p]), cosf(A.TrajectoryAngles[p]) };
-    vec2 DirB = { sinf(B.TrajectoryAngles[p]), cosf(B.TrajectoryAngles[p]) };
-    vec2 Diff = DirA - DirB;
-    TrajDirDiffSum += TrajectoryWeights[p] * Math::Length(Diff);
+    Tasks[t].MMData     = MMData;
+    Tasks[t].SearchGoal = &SearchGoal;
+    Jobs[t]             = { SearchTaskJob, &Tasks[t] };
   }
-  *BonePCost = PosDiffSum * PosCoef;
-  *BoneVCost = VelDiffSum * VelCoef;
-  *TrajPCost = TrajDiffSum * TrajCoef;
-  *TrajVCost = 0;//TrajVDiffSum * TrajVCoef;
-  *TrajACost = TrajDirDiffSum * TrajAngleCoef;
 
-  float Cost = PosCoef * PosDiffSum + VelCoef * VelDiffSum + TrajCoef * TrajDiffSum +
-               /*TrajVCoef * TrajVDiffSum +*/ TrajAngleCoef * TrajDirDiffSum;
+  job_counter Counter = {};
+  KickJobs(&Counter, Jobs, TaskCount);
+  WaitForCounter(&Counter);
 
-  return Cost;
+  mm_search_state TaskStates[MM_PARALLEL_SEARCH_MAX_TASK_COUNT];
+  for(int t = 0; t < TaskCount; t++)
+  {
+    TaskStates[t] = Tasks[t].State;
+  }
+  return FinishSearch(OutBestIndex, OutIsMirrored, Stats, MMData, SearchGoal, TaskStates,
+                      TaskCount);
 }
 
+// Fallback for controllers whose search data cannot give exact costs, a quantized set with
+// negative cost terms. The tree's lower bounds do not hold then, so instead of pruning subtrees
+// every frame is visited in order, its cost evaluation cut short once the partial sum exceeds the
+// best cost found so far when the cost bound is usable
 float
-MotionMatch(int32_t* OutAnimIndex, float* OutLocalStartTime, mm_frame_info* OutBestMatch,
-            const mm_controller_data* MMData, mm_frame_info Goal)
+SearchFrameFeatures(int32_t* OutBestIndex, bool* OutIsMirrored, mm_search_stats* Stats,
+                    const mm_controller_data* MMData, const mm_search_goal& SearchGoal)
 {
-  TIMED_BLOCK(MotionMatch);
-  assert(OutAnimIndex && OutLocalStartTime);
-  assert(MMData);
-  assert(MMData->FrameInfos.IsValid());
-
-  float   SmallestCost       = FLT_MAX;
-  int32_t BestFrameInfoIndex = -1;
-  for(int i = 0; i < MMData->FrameInfos.Count; i++)
+  float   SmallestCost       = SearchGoal.Continuation.Cost;
+  int32_t BestFrameInfoIndex = SearchGoal.Continuation.FrameIndex;
+  bool    MatchIsMirrored    = SearchGoal.Continuation.IsMirrored;
+  for(int i = 0; i < MMData->FrameCount; i++)
   {
+    for(int m = 0; m < (SearchGoal.HasMirroredGoal ? 2 : 1); m++)
     {
-      float CurrentCost =
-        ComputeCost(Goal, MMData->FrameInfos[i], MMData->Params.DynamicParams.BonePCoefficient,
-                    MMData->Params.DynamicParams.BoneVCoefficient,
-                    MMData->Params.DynamicParams.TrajPCoefficient,
-                    MMData->Params.DynamicParams.TrajVCoefficient,
-                    MMData->Params.DynamicParams.TrajAngleCoefficient,
-                    MMData->Params.DynamicParams.TrajectoryWeights);
-      if(CurrentCost < SmallestCost)
+      const bool IsMirrored = (m == 1);
+      float Cost = ComputeCostBelowBound(Stats, MMData, SearchGoal, i, IsMirrored, SmallestCost);
+      if(IsBetterMatch(Cost, i, IsMirrored, SmallestCost, BestFrameInfoIndex, MatchIsMirrored))
       {
-        SmallestCost       = CurrentCost;
+        SmallestCost       = Cost;
         BestFrameInfoIndex = i;
+        MatchIsMirrored    = IsMirrored;
       }
     }
   }
+  *OutBestIndex  = BestFrameInfoIndex;
+  *OutIsMirrored = MatchIsMirrored;
+  return SmallestCost;
+}
 
-  assert(BestFrameInfoIndex != -1);
-
+void
+GetAnimIndexAndLocalTime(int32_t* OutAnimIndex, float* OutLocalStartTime,
+                         const mm_controller_data* MMData, int32_t FrameInfoIndex)
+{
   for(int a = 0; a < MMData->AnimFrameInfoRanges.Count; a++)
   {
     mm_frame_info_range CurrentRange = MMData->AnimFrameInfoRanges[a];
-    if(CurrentRange.Start <= BestFrameInfoIndex && BestFrameInfoIndex < CurrentRange.End)
+    if(CurrentRange.Start <= FrameInfoIndex && FrameInfoIndex < CurrentRange.End)
     {
       *OutAnimIndex = a;
       *OutLocalStartTime =
-        CurrentRange.StartTimeInAnim + (BestFrameInfoIndex - CurrentRange.Start) /
+        CurrentRange.StartTimeInAnim + (FrameInfoIndex - CurrentRange.Start) /
                                          MMData->Params.FixedParams.MetadataSamplingFrequency;
-      *OutBestMatch = MMData->FrameInfos[BestFrameInfoIndex];
     }
   }
+}
+
+float
+MotionMatch(int32_t* OutAnimIndex, float* OutLocalStartTime, mm_frame_info* OutBestMatch,
+            const mm_controller_data* MMData, mm_frame_info Goal)
+{
+  TIMED_BLOCK(MotionMatch);
+  assert(OutAnimIndex && OutLocalStartTime);
+  assert(MMData);
+  assert(MMData->FeatureBlocks.IsValid() || MMData->QuantizedBlocks.IsValid());
+
+  mm_search_goal SearchGoal;
+  InitSearchGoal(&SearchGoal, MMData, Goal, NULL);
+
+  float           SmallestCost;
+  int32_t         BestFrameInfoIndex = -1;
+  bool            IsMirrored;
+  mm_search_stats Stats = {};
+  if(CanUseSearchData(MMData))
+  {
+    SmallestCost = SearchFeatures(&BestFrameInfoIndex, &IsMirrored, &Stats, MMData, SearchGoal);
+  }
+  else
+  {
+    SmallestCost =
+      SearchFrameFeatures(&BestFrameInfoIndex, &IsMirrored, &Stats, MMData, SearchGoal);
+  }
+
+  assert(BestFrameInfoIndex != -1);
+
+  GetAnimIndexAndLocalTime(OutAnimIndex, OutLocalStartTime, MMData, BestFrameInfoIndex);
+  *OutBestMatch = GetFrameInfo(MMData, BestFrameInfoIndex);
 
   return SmallestCost;
 }
@@ -337,62 +2367,128 @@ MotionMatchWithMirrors(int32_t* OutAnimIndex, float* OutLocalStartTime, mm_frame
                        mm_frame_info Goal, mm_frame_info MirroredGoal)
 {
   TIMED_BLOCK(MotionMatch);
-  assert(MMData->FrameInfos.IsValid());
-
-  float   SmallestCost       = FLT_MAX;
-  int32_t BestFrameInfoIndex = -1;
-  bool    MatchIsMirrored    = false;
-  for(int i = 0; i < MMData->FrameInfos.Count; i++)
-  {
-    {
-      float CurrentCost =
-        ComputeCost(Goal, MMData->FrameInfos[i], MMData->Params.DynamicParams.BonePCoefficient,
-                    MMData->Params.DynamicParams.BoneVCoefficient,
-                    MMData->Params.DynamicParams.TrajPCoefficient,
-                    MMData->Params.DynamicParams.TrajVCoefficient,
-                    MMData->Params.DynamicParams.TrajAngleCoefficient,
-                    MMData->Params.DynamicParams.TrajectoryWeights);
-      if(CurrentCost < SmallestCost)
+  assert(MMData->FeatureBlocks.IsValid() || MMData->QuantizedBlocks.IsValid());
+
+  mm_search_goal SearchGoal;
+  InitSearchGoal(&SearchGoal, MMData, Goal, &MirroredGoal);
+
+  float           SmallestCost;
+  int32_t         BestFrameInfoIndex = -1;
+  bool            MatchIsMirrored    = false;
+  mm_search_stats Stats              = {};
+  if(CanUseSearchData(MMData))
+  {
+    SmallestCost =
+      SearchFeatures(&BestFrameInfoIndex, &MatchIsMirrored, &Stats, MMData, SearchGoal);
+  }
+  else
+  {
+    SmallestCost =
+      SearchFrameFeatures(&BestFrameInfoIndex, &MatchIsMirrored, &Stats, MMData, SearchGoal);
+  }
+
+  assert(BestFrameInfoIndex != -1);
+
+  GetAnimIndexAndLocalTime(OutAnimIndex, OutLocalStartTime, MMData, BestFrameInfoIndex);
+  *OutBestMatch = GetFrameInfo(MMData, BestFrameInfoIndex);
+  *OutMatchedMirrored = MatchIsMirrored;
+
+  return SmallestCost;
+}
+
+void
+MotionMatchBatch(float* OutCosts, int32_t* OutAnimIndices, float* OutLocalStartTimes,
+                 mm_frame_info* OutBestMatches, bool* OutMatchedMirrored,
+                 mm_search_stats* OutStats, const mm_controller_data* MMData,
+                 const mm_frame_info* Goals, const mm_frame_info* MirroredGoals,
+                 const mm_continuation* Continuations, int32_t GoalCount)
+{
+  TIMED_BLOCK(MotionMatch);
+  assert(OutAnimIndices && OutLocalStartTimes && OutBestMatches && OutMatchedMirrored);
+  assert(MMData);
+  assert(MMData->FeatureBlocks.IsValid() || MMData->QuantizedBlocks.IsValid());
+
+  mm_search_stats Stats = {};
+  // With a bound from the continuation the tree prunes most of the set, which beats streaming
+  // every block once for all goals
+  const bool SearchGoalsSeparately =
+    Continuations && CanUseSearchData(MMData) && CanUseSearchTree(MMData);
+
+  const int32_t BlockCount = MMData->BlockCount;
+  for(int FirstGoal = 0; FirstGoal < GoalCount; FirstGoal += MM_BATCH_MAX_GOAL_COUNT)
+  {
+    const int32_t BatchGoalCount = MinInt32(MM_BATCH_MAX_GOAL_COUNT, GoalCount - FirstGoal);
+
+    mm_search_state SearchStates[MM_BATCH_MAX_GOAL_COUNT];
+    mm_search_goal  SearchGoals[MM_BATCH_MAX_GOAL_COUNT];
+    for(int g = 0; g < BatchGoalCount; g++)
+    {
+      InitSearchGoal(&SearchGoals[g], MMData, Goals[FirstGoal + g],
+                     MirroredGoals ? &MirroredGoals[FirstGoal + g] : NULL);
+      if(Continuations)
       {
-        SmallestCost       = CurrentCost;
-        BestFrameInfoIndex = i;
-        MatchIsMirrored    = false;
+        SetSearchGoalContinuation(&SearchGoals[g], &Stats, MMData, Continuations[FirstGoal + g]);
       }
+      InitSearchState(&SearchStates[g], SearchGoals[g]);
     }
 
+    if(CanUseSearchData(MMData) && !SearchGoalsSeparately)
     {
-      float MirroredCost = ComputeCost(MirroredGoal, MMData->FrameInfos[i],
-                                       MMData->Params.DynamicParams.BonePCoefficient,
-                                       MMData->Params.DynamicParams.BoneVCoefficient,
-                                       MMData->Params.DynamicParams.TrajPCoefficient,
-                                       MMData->Params.DynamicParams.TrajVCoefficient,
-                                       MMData->Params.DynamicParams.TrajAngleCoefficient,
-                                       MMData->Params.DynamicParams.TrajectoryWeights);
-
-      if(MirroredCost < SmallestCost)
+      // Stream the feature blocks through the cache once, scoring each tile against all goals
+      for(int FirstBlock = 0; FirstBlock < BlockCount; FirstBlock += MM_BATCH_TILE_BLOCK_COUNT)
       {
-        SmallestCost       = MirroredCost;
-        BestFrameInfoIndex = i;
-        MatchIsMirrored    = true;
+        const int32_t EndBlock = MinInt32(FirstBlock + MM_BATCH_TILE_BLOCK_COUNT, BlockCount);
+        for(int g = 0; g < BatchGoalCount; g++)
+        {
+          SearchBlocks(&SearchStates[g], MMData, FirstBlock, EndBlock, SearchGoals[g]);
+        }
       }
     }
-  }
 
-  assert(BestFrameInfoIndex != -1);
-
-  for(int a = 0; a < MMData->AnimFrameInfoRanges.Count; a++)
-  {
-    mm_frame_info_range CurrentRange = MMData->AnimFrameInfoRanges[a];
-    if(CurrentRange.Start <= BestFrameInfoIndex && BestFrameInfoIndex < CurrentRange.End)
+    for(int g = 0; g < BatchGoalCount; g++)
     {
-      *OutAnimIndex = a;
-      *OutLocalStartTime =
-        CurrentRange.StartTimeInAnim + (BestFrameInfoIndex - CurrentRange.Start) /
-                                         MMData->Params.FixedParams.MetadataSamplingFrequency;
-      *OutBestMatch = MMData->FrameInfos[BestFrameInfoIndex];
+      const int32_t GoalIndex          = FirstGoal + g;
+      int32_t       BestFrameInfoIndex = -1;
+      bool          MatchIsMirrored    = false;
+      float         SmallestCost;
+      if(SearchGoalsSeparately)
+      {
+        SmallestCost =
+          SearchFeatures(&BestFrameInfoIndex, &MatchIsMirrored, &Stats, MMData, SearchGoals[g]);
+      }
+      else if(CanUseSearchData(MMData))
+      {
+        SmallestCost = FinishSearch(&BestFrameInfoIndex, &MatchIsMirrored, &Stats, MMData,
+                                    SearchGoals[g], &SearchStates[g], 1);
+      }
+      else
+      {
+        SmallestCost = SearchFrameFeatures(&BestFrameInfoIndex, &MatchIsMirrored, &Stats, MMData,
+                                           SearchGoals[g]);
+      }
+      assert(BestFrameInfoIndex != -1);
+
+      const mm_search_bound& Continuation = SearchGoals[g].Continuation;
+      if(BestFrameInfoIndex == Continuation.FrameIndex &&
+         MatchIsMirrored == Continuation.IsMirrored)
+      {
+        Stats.ContinuationMatchCount++;
+      }
+
+      GetAnimIndexAndLocalTime(&OutAnimIndices[GoalIndex], &OutLocalStartTimes[GoalIndex], MMData,
+                               BestFrameInfoIndex);
+      OutBestMatches[GoalIndex] = GetFrameInfo(MMData, BestFrameInfoIndex);
+      OutMatchedMirrored[GoalIndex] = MatchIsMirrored;
+      if(OutCosts)
+      {
+        OutCosts[GoalIndex] = SmallestCost;
+      }
     }
   }
-  *OutMatchedMirrored = MatchIsMirrored;
 
-  return SmallestCost;
+  if(OutStats)
+  {
+    Stats.SearchCount = GoalCount;
+    AddMMSearchStats(OutStats, Stats);
+  }
 }
@@ -8,9 +8,11 @@
 #include "file_queries.h"
 #include "misc.h"
 
-#define MM_POINT_COUNT 3
-#define MM_COMPARISON_BONE_COUNT 2
-#define MM_ANIM_CAPACITY 35
+// Capacities of the runtime feature schema, the features of a controller only store the bones
+// and trajectory samples its params actually use
+#define MM_MAX_COMPARISON_BONE_COUNT 8
+#define MM_MAX_POINT_COUNT 8
+#define MM_DEFAULT_POINT_COUNT 3
 
 struct mm_info_debug_settings
 {
@@ -29,6 +31,7 @@ struct mm_debug_settings
   bool  ShowHipTrajectories;
   bool  ShowRootTrajectories;
   bool  ApplyRootMotion;
+  bool  SearchFromContinuation;
 
   mm_info_debug_settings CurrentGoal;
   mm_info_debug_settings MatchedGoal;
@@ -36,8 +39,10 @@ struct mm_debug_settings
 
 struct mm_fixed_params
 {
-  fixed_stack<int32_t, MM_COMPARISON_BONE_COUNT> ComparisonBoneIndices;
-  fixed_stack<int32_t, MM_COMPARISON_BONE_COUNT> MirrorBoneIndices;
+  fixed_stack<int32_t, MM_MAX_COMPARISON_BONE_COUNT> ComparisonBoneIndices;
+  fixed_stack<int32_t, MM_MAX_COMPARISON_BONE_COUNT> MirrorBoneIndices;
+  // Increasing fractions of TrajectoryTimeHorizon at which the future trajectory is matched
+  fixed_stack<float, MM_MAX_POINT_COUNT>             TrajectorySampleTimes;
 
   Anim::skeleton             Skeleton;
   float                      MetadataSamplingFrequency;
@@ -54,26 +59,33 @@ struct mm_dynamic_params
   float                      BlendInTime;
   float                      MinTimeOffsetThreshold;
   bool                       MatchMirroredAnimations;
-  float                      TrajectoryWeights[MM_POINT_COUNT];
+  float                      TrajectoryWeights[MM_MAX_POINT_COUNT];
   Anim::skeleton_mirror_info MirrorInfo;
 };
 
 struct mm_params
 {
-  fixed_stack<rid, MM_ANIM_CAPACITY>  AnimRIDs;
-  fixed_stack<path, MM_ANIM_CAPACITY> AnimPaths;
+  // Not owned by the params: they point into the controller asset or into the profile editor
+  stack_handle<rid>  AnimRIDs;
+  stack_handle<path> AnimPaths;
 
   mm_fixed_params   FixedParams;
   mm_dynamic_params DynamicParams;
 };
 
+// Stored in .template files, bump whenever the layout of mm_params changes
+#define MM_PARAMS_FILE_MAGIC 0x504d4d54 // "TMMP"
+#define MM_PARAMS_FILE_VERSION 1
+
+// Goal and debug representation of a frame, only the first ComparisonBoneIndices.Count bones and
+// TrajectorySampleTimes.Count points are used
 struct mm_frame_info
 {
-  vec3  BonePs[MM_COMPARISON_BONE_COUNT];
-  vec3  BoneVs[MM_COMPARISON_BONE_COUNT];
-  vec3  TrajectoryPs[MM_POINT_COUNT];
-  float TrajectoryVs[MM_POINT_COUNT];
-  float TrajectoryAngles[MM_POINT_COUNT];
+  vec3  BonePs[MM_MAX_COMPARISON_BONE_COUNT];
+  vec3  BoneVs[MM_MAX_COMPARISON_BONE_COUNT];
+  vec3  TrajectoryPs[MM_MAX_POINT_COUNT];
+  float TrajectoryVs[MM_MAX_POINT_COUNT];
+  float TrajectoryAngles[MM_MAX_POINT_COUNT];
 };
 
 struct mm_frame_info_range
@@ -83,15 +95,139 @@ struct mm_frame_info_range
   int32_t End;
 };
 
+// Row layout of a frame's feature vector. Trajectory angles are stored as unit direction vectors
+// so that the search does not need any trigonometry
+struct mm_feature_layout
+{
+  int32_t BoneCount;
+  int32_t PointCount;
+  int32_t BonePRow;
+  int32_t BoneVRow;
+  int32_t TrajPRow;
+  int32_t TrajDirRow;
+  int32_t RowCount;
+};
+
+#define MM_MAX_FEATURE_ROW_COUNT (6 * MM_MAX_COMPARISON_BONE_COUNT + 5 * MM_MAX_POINT_COUNT)
+
+inline mm_feature_layout
+GetFeatureLayout(const mm_fixed_params& Params)
+{
+  mm_feature_layout Layout;
+  Layout.BoneCount  = Params.ComparisonBoneIndices.Count;
+  Layout.PointCount = Params.TrajectorySampleTimes.Count;
+  Layout.BonePRow   = 0;
+  Layout.BoneVRow   = Layout.BonePRow + 3 * Layout.BoneCount;
+  Layout.TrajPRow   = Layout.BoneVRow + 3 * Layout.BoneCount;
+  Layout.TrajDirRow = Layout.TrajPRow + 3 * Layout.PointCount;
+  Layout.RowCount   = Layout.TrajDirRow + 2 * Layout.PointCount;
+  return Layout;
+}
+
+// Number of frames scored at once by the feature block search (one AVX register of floats)
+#define MM_FEATURE_BLOCK_WIDTH 8
+
+// Motion sets this large store 16 bit feature blocks, halving the bytes read per search
+#define MM_QUANTIZED_MIN_FRAME_COUNT 8192
+// Approximate best matches re-scored with the exact cost function
+#define MM_QUANTIZED_CANDIDATE_COUNT 16
+#define MM_QUANTIZED_MAX_VALUE 65535
+
+// Row r of a quantized frame is Offsets[r] + Value * Scales[r]
+struct mm_feature_quantization
+{
+  // Smallest value of each row
+  float Offsets[MM_MAX_FEATURE_ROW_COUNT];
+  // Equal for all rows of a feature vector (a bone position, a trajectory direction, ...)
+  float Scales[MM_MAX_FEATURE_ROW_COUNT];
+  // Largest reconstruction error of each row over all frames
+  float MaxErrors[MM_MAX_FEATURE_ROW_COUNT];
+};
+
+// Search tree leaves cover this many consecutive feature blocks
+#define MM_SEARCH_TREE_LEAF_BLOCK_COUNT 4
+// Smaller motion sets are searched faster by brute force, so no tree is built for them
+#define MM_SEARCH_TREE_MIN_FRAME_COUNT 512
+#define MM_SEARCH_TREE_MAX_DEPTH 32
+
+// Batched searches score every goal against this many feature blocks before moving on
+#define MM_BATCH_TILE_BLOCK_COUNT 16
+#define MM_BATCH_MAX_GOAL_COUNT 32
+
+// Bounding box hierarchy node over a range of consecutive feature blocks, its row bounds are
+// stored in mm_controller_data::SearchNodeBounds
+struct mm_search_node
+{
+  int32_t FirstBlock;
+  int32_t EndBlock;
+  int32_t ChildIndices[2]; // -1 for leaves
+};
+
+// Bump whenever the layout of mm_controller_data changes, older exports have to be re-exported
+#define MM_CONTROLLER_DATA_VERSION 6
+
+// All arrays are stored in the same allocation, right after the struct
 struct mm_controller_data
 {
-  mm_params Params;
+  uint32_t          Version;
+  mm_params         Params;
+  mm_feature_layout Layout;
+
+  array_handle<Anim::animation*>    Animations;
+  array_handle<mm_frame_info_range> AnimFrameInfoRanges;
+  // Left and right swapped copies of Animations with their keyframes stored in the asset, only
+  // baked when mirrored animations are matched. Mirrored playback samples these directly
+  array_handle<Anim::animation> MirroredAnimations;
+  // Root motion keys of every keyframe of Animations[a] in RootMotionTracks[a], mirrored playback
+  // samples the same keys
+  array_handle<array_handle<Anim::root_motion_key>> RootMotionTracks;
+
+  int32_t FrameCount;
 
-  fixed_stack<Anim::animation*, MM_ANIM_CAPACITY>    Animations;
-  fixed_stack<mm_frame_info_range, MM_ANIM_CAPACITY> AnimFrameInfoRanges;
-  array_handle<mm_frame_info>                        FrameInfos;
+  // Only one of FeatureBlocks and QuantizedBlocks is built, depending on the frame count. Block b
+  // is the Layout.RowCount x MM_FEATURE_BLOCK_WIDTH matrix at b * Layout.RowCount *
+  // MM_FEATURE_BLOCK_WIDTH, which stores row r of MM_FEATURE_BLOCK_WIDTH consecutive frames
+  // contiguously. Quantized blocks only rank the frames approximately, the best candidates are
+  // re-scored against ExactFeatures
+  int32_t                 BlockCount;
+  array_handle<float>     FeatureBlocks;
+  array_handle<uint16_t>  QuantizedBlocks;
+  mm_feature_quantization Quantization;
+  // Cold FrameCount x Layout.RowCount copy of the computed features, only kept for quantized sets.
+  // A search reads the rows of its few candidates from it, never the whole matrix
+  array_handle<float> ExactFeatures;
+
+  array_handle<mm_search_node> SearchNodes;
+  // Layout.RowCount minimums followed by Layout.RowCount maximums per node
+  array_handle<float> SearchNodeBounds;
 };
 
+// Writes the exact Layout.RowCount features of a frame to OutFeatures
+inline void
+GetFrameFeatures(float* OutFeatures, const mm_controller_data* MMData, int32_t FrameIndex)
+{
+  assert(0 <= FrameIndex && FrameIndex < MMData->FrameCount);
+  const int32_t RowCount = MMData->Layout.RowCount;
+  if(MMData->QuantizedBlocks.IsValid())
+  {
+    assert(MMData->ExactFeatures.IsValid());
+    memcpy(OutFeatures, MMData->ExactFeatures.Elements + FrameIndex * RowCount,
+           RowCount * sizeof(float));
+  }
+  else
+  {
+    assert(MMData->FeatureBlocks.IsValid());
+    const int32_t BlockIndex = FrameIndex / MM_FEATURE_BLOCK_WIDTH;
+    const int32_t Lane       = FrameIndex % MM_FEATURE_BLOCK_WIDTH;
+    const float*  Block =
+      MMData->FeatureBlocks.Elements + BlockIndex * RowCount * MM_FEATURE_BLOCK_WIDTH;
+    for(int r = 0; r < RowCount; r++)
+    {
+      OutFeatures[r] = Block[r * MM_FEATURE_BLOCK_WIDTH + Lane];
+    }
+  }
+}
+
 enum anim_endpoint_extrapolation_type
 {
   EXTRAPOLATE_None,
@@ -100,10 +236,44 @@ enum anim_endpoint_extrapolation_type
   EXTRAPOLATE_Continue,
 };
 
+// The frame an entity keeps playing when the search finds nothing better
+struct mm_continuation
+{
+  int32_t AnimIndex; // -1 when nothing from the set is playing
+  float   LocalTime;
+  bool    IsMirrored;
+};
+
+// Work done by searches, frames are counted once per goal they are scored against
+struct mm_search_stats
+{
+  int32_t SearchCount;
+  int32_t FramesTouched;          // Scored by the block kernels or by ComputeCost
+  int32_t FramesCutShort;         // ComputeCost calls stopped early by the cost bound
+  int32_t ContinuationMatchCount; // Searches that found nothing beating the continuation
+};
+
+inline void
+AddMMSearchStats(mm_search_stats* Dest, const mm_search_stats& Src)
+{
+  Dest->SearchCount += Src.SearchCount;
+  Dest->FramesTouched += Src.FramesTouched;
+  Dest->FramesCutShort += Src.FramesCutShort;
+  Dest->ContinuationMatchCount += Src.ContinuationMatchCount;
+}
+
+// Keeps the animation list storage of Params
 inline void
 ResetMMParamsToDefault(mm_params* Params)
 {
+  stack_handle<rid>  AnimRIDs  = Params->AnimRIDs;
+  stack_handle<path> AnimPaths = Params->AnimPaths;
   memset(Params, 0, sizeof(mm_params));
+  Params->AnimRIDs              = AnimRIDs;
+  Params->AnimPaths             = AnimPaths;
+  Params->AnimRIDs.Count        = 0;
+  Params->AnimPaths.Count       = 0;
+
   Params->DynamicParams.BonePCoefficient        = 1.0f;
   Params->DynamicParams.BoneVCoefficient        = 0.05f;
   Params->DynamicParams.TrajPCoefficient        = 0.6f;
@@ -114,25 +284,68 @@ ResetMMParamsToDefault(mm_params* Params)
   Params->DynamicParams.MinTimeOffsetThreshold  = 0.25f;
   Params->DynamicParams.MatchMirroredAnimations = false;
   Params->FixedParams.MetadataSamplingFrequency = 30.0f;
-	for(int i = 0; i < MM_POINT_COUNT; i++)
-	{
+  for(int i = 0; i < MM_MAX_POINT_COUNT; i++)
+  {
     Params->DynamicParams.TrajectoryWeights[i] =
-      ClampFloat(0, 0.1f + float(i) / float(MM_POINT_COUNT - 1), 1);
+      ClampFloat(0, 0.1f + float(i) / float(MM_DEFAULT_POINT_COUNT - 1), 1);
+  }
+  for(int i = 0; i < MM_DEFAULT_POINT_COUNT; i++)
+  {
+    Params->FixedParams.TrajectorySampleTimes.Push(float(i + 1) / float(MM_DEFAULT_POINT_COUNT));
   }
 }
 
+// Points the animation lists of Params at new storage for AnimCapacity animations
+void InitMMParamsAnimStorage(mm_params* Params, Memory::stack_allocator* Alloc,
+                             int32_t AnimCapacity);
+// Copies Src into Dest, whose animation list storage has to be large enough for Src's animations
+void CopyMMParams(mm_params* Dest, const mm_params& Src);
+
 // Main metadata precomputation
 mm_controller_data* PrecomputeRuntimeMMData(Memory::stack_allocator*       TempAlloc,
                                             array_handle<Anim::animation*> Animations,
                                             const mm_params&               Params);
-// Cost function used for search
-float ComputeCost(const mm_frame_info& A, const mm_frame_info& B, float PosCoef, float VelCoef,
-                  float TrajCoef, float TrajVCoef, float TrajAngleCoef, const float* TrajectoryWeights);
+// Pushes the feature store picked by MMData->FrameCount and the search tree over it. The float
+// features are pushed after them, so that they can be freed once BuildSearchData is done. Without
+// AllowQuantization large sets keep float blocks too, which is mostly useful for testing
+void PushSearchData(Memory::stack_allocator* Alloc, mm_controller_data* MMData,
+                    bool AllowQuantization = true);
+// Fills what PushSearchData pushed from the FrameCount x Layout.RowCount matrix Features. The rows
+// of a quantized set are replaced by their reconstruction, the search tree bounds those
+void BuildSearchData(mm_controller_data* MMData, float* Features);
+
+// Incremental rebuild after MMData->Animations[AnimIndex] has changed. Recomputes the features, the
+// root motion and the mirrored copy of that animation in place and patches the search data over
+// them, returns false without touching MMData when the animation's frame or keyframe count changed.
+// Quantized sets quantize every frame again when the new features do not fit the old quantization
+bool UpdateRuntimeMMDataAnimation(Memory::stack_allocator* TempAlloc, mm_controller_data* MMData,
+                                  int32_t AnimIndex);
+// Same as above for any frame count: builds a new controller at the top of TempAlloc that copies
+// the features of the other animations instead of recomputing them
+mm_controller_data* SpliceRuntimeMMDataAnimation(Memory::stack_allocator*  TempAlloc,
+                                                 const mm_controller_data* MMData,
+                                                 int32_t                   AnimIndex);
+
+// Writes the Layout.RowCount features of Info to OutFeatures
+void GetFrameInfoFeatures(float* OutFeatures, const mm_frame_info& Info,
+                          const mm_feature_layout& Layout);
+// Inverse of the above, trajectory velocities are not features and are returned as zero
+mm_frame_info GetFrameInfo(const float* Features, const mm_feature_layout& Layout);
+mm_frame_info GetFrameInfo(const mm_controller_data* MMData, int32_t FrameIndex);
+
+// Cost function used for search, A and B are feature vectors
+float ComputeCost(const float* A, const float* B, const mm_feature_layout& Layout,
+                  const mm_dynamic_params& Params);
+
+// Stops summing the cost terms once they exceed Bound and returns the partial sum, with
+// OutCutShort set. Only a lower bound of the cost when every term is non-negative
+float ComputeBoundedCost(bool* OutCutShort, const float* Goal, const float* Frame,
+                         const mm_feature_layout& Layout, const mm_dynamic_params& Params,
+                         float Bound);
 
 float ComputeCostComponents(float* BonePComp, float* BoneVComp, float* TrajPComp, float* TrajVComp,
-                            float* TrajAComp, const mm_frame_info& A, const mm_frame_info& B,
-                            float PosCoef, float VelCoef, float TrajCoef, float TrajVCoef,
-                            float TrajAngleCoef, const float* TrajectoryWeights);
+                            float* TrajAComp, const float* A, const float* B,
+                            const mm_feature_layout& Layout, const mm_dynamic_params& Params);
 
 // Runtime API
 float MotionMatch(int32_t* OutAnimIndex, float* OutLocalStartTime, mm_frame_info* OutBestMatch,
@@ -141,3 +354,12 @@ float MotionMatchWithMirrors(int32_t* OutAnimIndex, float* OutLocalStartTime,
                              mm_frame_info* OutBestMatch, bool* OutMatchedMirrored,
                              const mm_controller_data* MMData, mm_frame_info Goal,
                              mm_frame_info MirroredGoal);
+// Matches the goals of every entity using the same controller in a single pass over the frame
+// data. MirroredGoals should be NULL when mirrored animations are not matched.
+// With Continuations each goal first scores the frame its entity is playing, and the search only
+// looks for frames beating that cost. The result is the same as without them. OutStats can be NULL
+void MotionMatchBatch(float* OutCosts, int32_t* OutAnimIndices, float* OutLocalStartTimes,
+                      mm_frame_info* OutBestMatches, bool* OutMatchedMirrored,
+                      mm_search_stats* OutStats, const mm_controller_data* MMData,
+                      const mm_frame_info* Goals, const mm_frame_info* MirroredGoals,
+                      const mm_continuation* Continuations, int32_t GoalCount);
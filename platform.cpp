@@ -12,6 +12,8 @@
 #include "common.h"
 #include "profile.h"
 #include "load_texture.h"
+#include "job_system.h"
+#include "thread_primitives.h"
 
 static bool
 ProcessInput(const game_input* OldInput, game_input* NewInput, SDL_Event* Event, SDL_Window* Window)
@@ -438,6 +440,9 @@ main(int argc, char* argv[])
     }
   }
 
+  // Leave one core for the main thread
+  InitJobSystem(Platform::GetLogicalCoreCount() - 1);
+
   SDL_Event Event;
 
   ImGuiIO& IO = ImGui::GetIO();
@@ -484,6 +489,8 @@ main(int argc, char* argv[])
     LastFrameStart = CurrentFrameStart;
   }
 
+  ShutdownJobSystem();
+
   ImGui::DestroyContext();
   free(GameMemory.TemporaryMemory);
   free(GameMemory.PersistentMemory);
@@ -37,6 +37,27 @@ timer_event_autoclose_wrapper::~timer_event_autoclose_wrapper()
   --g_CurrentTimerEventDepth;
 }
 
+void
+PushTimerEvent(int32_t NameTableIndex, uint64_t StartCycleCount, uint64_t EndCycleCount,
+               int32_t EventDepth)
+{
+  if(g_CurrentTimerEventCount >= PROFILE_MAX_TIMER_EVENTS_PER_FRAME)
+  {
+    return;
+  }
+  timer_event* Event =
+    &GLOBAL_FRAME_TIMER_EVENT_TABLE[g_CurrentProfilerFrameIndex][g_CurrentTimerEventCount];
+  Event->StartCycleCount = StartCycleCount;
+  Event->EndCycleCount   = EndCycleCount;
+  Event->EventDepth      = EventDepth;
+  Event->NameTableIndex  = NameTableIndex;
+  ++g_CurrentTimerEventCount;
+
+  GLOBAL_TIMER_FRAME_SUMMARY_TABLE[g_CurrentProfilerFrameIndex][NameTableIndex].CycleCount +=
+    EndCycleCount - StartCycleCount;
+  GLOBAL_TIMER_FRAME_SUMMARY_TABLE[g_CurrentProfilerFrameIndex][NameTableIndex].Calls++;
+}
+
 gpu_timer_event GPU_TIMER_EVENT_TABLE[PROFILE_MAX_FRAME_COUNT + 1][GPU_TIMER_EnumCount];
 uint32_t        GPU_QUERY_OBJECT_TABLE[GPU_TIMER_EnumCount];
 #endif // USE_DEBUG_PROFILING
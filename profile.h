@@ -79,6 +79,8 @@ enum
   TIMER_NAME_Particles,
   TIMER_NAME_ImGuiDemo,
   TIMER_NAME_RenderImGui,
+  TIMER_NAME_ECSSystems,
+  TIMER_NAME_ECSSystem,
   TIMER_NAME_Count,
 };
 
@@ -139,6 +141,8 @@ const char TIMER_NAME_TABLE[][TIMER_NAME_Count] = {
   "Particles",
   "ImGuiDemo",
   "RenderImGui",
+  "ECSSystems",
+  "ECSSystem",
 };
 
 const float TIMER_UI_COLOR_TABLE[TIMER_NAME_Count][3] =
@@ -155,7 +159,8 @@ const float TIMER_UI_COLOR_TABLE[TIMER_NAME_Count][3] =
     { 0, 0, 1 },          { 0.1f, 0.8f, 0.2f }, { 0, 0, 1 },          { 1, 1, 0 },
     { 0.5f, 0.2f, 0.5f }, { 0.6f, 0.5f, 0.3f }, { 1, 0.2f, 0.3f },    { 0.6f, 0.5f, 0.3f },
     { 1, 0.2f, 0.3f },    { 1, 0.2f, 0.2f },    { 0.2f, 0.4f, 0.6f }, { 0, 0.5f, 1 },
-    { 0, 0.5f, 1 }, {0.5f, 0.1f, 0.3f}, {0.7f, 0.3f, 0.2f} };
+    { 0, 0.5f, 1 }, {0.5f, 0.1f, 0.3f}, {0.7f, 0.3f, 0.2f}, {0.3f, 0.6f, 0.9f},
+    {0.6f, 0.8f, 1} };
 
 struct frame_endpoints
 {
@@ -197,6 +202,11 @@ struct timer_event_autoclose_wrapper
   ~timer_event_autoclose_wrapper();
 };
 
+// Records a block timed somewhere the timed block macros can not be used, e.g. on job threads,
+// call on the main thread
+void PushTimerEvent(int32_t NameTableIndex, uint64_t StartCycleCount, uint64_t EndCycleCount,
+                    int32_t EventDepth);
+
 #define FOR_ALL_NAMES(DO_FUNC)                                                                     \
   DO_FUNC(GeomPrePass)                                                                             \
   DO_FUNC(Shadowmapping)                                                                           \
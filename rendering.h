@@ -189,15 +189,15 @@ RenderShadowmapCascadesToTextures(game_state* GameState)
             GameState->R.MeshInstances[i].AnimPlayer;
           if(CurrentAnimPlayer)
 					{
-            glUniformMatrix4fv(glGetUniformLocation(SunDepthShaderID, "g_boneMatrices"),
-                               CurrentAnimPlayer->Skeleton->BoneCount, GL_FALSE,
-                               (float*)CurrentAnimPlayer->HierarchicalModelSpaceMatrices);
+            glUniformMatrix3x4fv(glGetUniformLocation(SunDepthShaderID, "g_boneMatrices"),
+                                 CurrentAnimPlayer->Skeleton->BoneCount, GL_FALSE,
+                                 (float*)CurrentAnimPlayer->SkinningMatrices);
           }
 					else
 					{
-						mat4 Mat4Zeros = {};
-            glUniformMatrix4fv(glGetUniformLocation(SunDepthShaderID, "g_boneMatrices"), 1,
-                               GL_FALSE, Mat4Zeros.e);
+						Anim::skinning_matrix ZeroBoneMatrix = {};
+            glUniformMatrix3x4fv(glGetUniformLocation(SunDepthShaderID, "g_boneMatrices"), 1,
+                                 GL_FALSE, (float*)&ZeroBoneMatrix);
           }
 #endif
 
@@ -336,15 +336,15 @@ RenderMainSceneObjects(game_state* GameState)
     }
     if(CurrentMaterial->Common.IsSkeletal && CurrentAnimPlayer)
     {
-      glUniformMatrix4fv(glGetUniformLocation(CurrentShaderID, "g_boneMatrices"),
-                         CurrentAnimPlayer->Skeleton->BoneCount, GL_FALSE,
-                         (float*)CurrentAnimPlayer->HierarchicalModelSpaceMatrices);
+      glUniformMatrix3x4fv(glGetUniformLocation(CurrentShaderID, "g_boneMatrices"),
+                           CurrentAnimPlayer->Skeleton->BoneCount, GL_FALSE,
+                           (float*)CurrentAnimPlayer->SkinningMatrices);
     }
     else
     {
-      mat4 Mat4Zeros = {};
-      glUniformMatrix4fv(glGetUniformLocation(CurrentShaderID, "g_boneMatrices"), 1, GL_FALSE,
-                         Mat4Zeros.e);
+      Anim::skinning_matrix ZeroBoneMatrix = {};
+      glUniformMatrix3x4fv(glGetUniformLocation(CurrentShaderID, "g_boneMatrices"), 1, GL_FALSE,
+                           (float*)&ZeroBoneMatrix);
     }
     glUniformMatrix4fv(glGetUniformLocation(CurrentShaderID, "mat_mvp"), 1, GL_FALSE,
                        MeshInstance->MVP.e);
@@ -378,15 +378,15 @@ RenderObjectSelectionHighlighting(game_state* GameState, entity* SelectedEntity)
                      GetEntityMVPMatrix(GameState, GameState->SelectedEntityIndex).e);
   if(SelectedEntity->AnimPlayer)
   {
-    glUniformMatrix4fv(glGetUniformLocation(ColorShaderID, "g_boneMatrices"),
-                       SelectedEntity->AnimPlayer->Skeleton->BoneCount, GL_FALSE,
-                       (float*)SelectedEntity->AnimPlayer->HierarchicalModelSpaceMatrices);
+    glUniformMatrix3x4fv(glGetUniformLocation(ColorShaderID, "g_boneMatrices"),
+                         SelectedEntity->AnimPlayer->Skeleton->BoneCount, GL_FALSE,
+                         (float*)SelectedEntity->AnimPlayer->SkinningMatrices);
   }
   else
   {
-    mat4 Mat4Zeros = {};
-    glUniformMatrix4fv(glGetUniformLocation(ColorShaderID, "g_boneMatrices"), 1, GL_FALSE,
-                       Mat4Zeros.e);
+    Anim::skinning_matrix ZeroBoneMatrix = {};
+    glUniformMatrix3x4fv(glGetUniformLocation(ColorShaderID, "g_boneMatrices"), 1, GL_FALSE,
+                         (float*)&ZeroBoneMatrix);
   }
   if(GameState->SelectionMode == SELECT_Mesh)
   {
@@ -430,9 +430,9 @@ RenderMaterialPreviewToTexture(game_state* GameState)
 
   if(PreviewMaterial->Common.IsSkeletal)
   {
-    mat4 Mat4Zeros = {};
-    glUniformMatrix4fv(glGetUniformLocation(MaterialPreviewShaderID, "g_boneMatrices"), 1, GL_FALSE,
-                       Mat4Zeros.e);
+    Anim::skinning_matrix ZeroBoneMatrix = {};
+    glUniformMatrix3x4fv(glGetUniformLocation(MaterialPreviewShaderID, "g_boneMatrices"), 1,
+                         GL_FALSE, (float*)&ZeroBoneMatrix);
   }
   glEnable(GL_BLEND);
   mat4           PreviewSphereMatrix = Math::Mat4Ident();
@@ -147,8 +147,24 @@ namespace Resource
         {
           return false;
         }
-        Anim::animation_group* AnimationGroup = (Anim::animation_group*)AssetReadResult.Contents;
-        Asset::UnpackAnimationGroup(AnimationGroup);
+        Anim::animation_group* AnimationGroup;
+        if(Asset::IsCompressedAnimationFile(AssetReadResult.Contents,
+                                            AssetReadResult.ContentsSize))
+        {
+          // Decompressed into the layout of a raw file, so FreeAnimation works for both
+          Anim::compressed_animation* CompressedAnimation =
+            (Anim::compressed_animation*)AssetReadResult.Contents;
+          Asset::UnpackCompressedAnimation(CompressedAnimation);
+          uint8_t* GroupMemory = this->AnimationHeap.Alloc(
+            Asset::GetDecompressedAnimationGroupSize(CompressedAnimation));
+          AnimationGroup = Asset::DecompressAnimationGroup(GroupMemory, CompressedAnimation);
+          this->AnimationHeap.Dealloc((uint8_t*)AssetReadResult.Contents);
+        }
+        else
+        {
+          AnimationGroup = (Anim::animation_group*)AssetReadResult.Contents;
+          Asset::UnpackAnimationGroup(AnimationGroup);
+        }
 
         Animation = AnimationGroup->Animations[0];
 
@@ -162,7 +178,7 @@ namespace Resource
 	void
   resource_manager::AddMMControllerAnimationReferences(mm_controller_data* Controller)
   {
-    Controller->Params.AnimRIDs.HardClear();
+    Controller->Params.AnimRIDs.Clear();
     for(int i = 0; i < Controller->Params.AnimPaths.Count; i++)
     {
       rid AnimRID = this->ObtainAnimationPathRID(Controller->Params.AnimPaths[i].Name);
@@ -194,7 +210,13 @@ namespace Resource
           return false;
         }
         Controller = (mm_controller_data*)AssetReadResult.Contents;
-        Asset::UnpackMMController(Controller);
+        if(!Asset::UnpackMMController(Controller))
+        {
+          printf("runtime error: %s has controller version %u, expected %u. Re-export it\n", Path,
+                 Controller->Version, MM_CONTROLLER_DATA_VERSION);
+          this->MMControllerHeap.Dealloc((uint8_t*)Controller);
+          return false;
+        }
 
         this->MMControllers.Set(RID, Controller, Path);
         this->AddMMControllerAnimationReferences(Controller);
@@ -237,12 +259,72 @@ namespace Resource
     mm_controller_data* NewController = (mm_controller_data*)this->MMControllerHeap.Alloc(
       Memory::SafeTruncate_size_t_To_uint32_t(Size));
     memcpy(NewController, ControllerData, Size);
+    // The data is passed in packed, so the copy's offsets are relative to its own base
+    bool Unpacked = Asset::UnpackMMController(NewController);
+    assert(Unpacked);
     this->MMControllers.Set(RID, NewController, Path);
     AddMMControllerAnimationReferences(NewController);
 
     return RID;
   }
 
+  void
+  resource_manager::UpdateMMControllerAnimation(rid AnimRID)
+  {
+    for(int i = 1; i <= RESOURCE_MAX_COUNT; i++)
+    {
+      mm_controller_data* Controller;
+      char*               Path;
+      rid                 RID = { i };
+      if(!this->MMControllers.Get(RID, &Controller, &Path) || !Controller)
+      {
+        continue;
+      }
+
+      bool Updated = false;
+      for(int a = 0; a < Controller->Params.AnimRIDs.Count; a++)
+      {
+        if(Controller->Params.AnimRIDs[a].Value != AnimRID.Value)
+        {
+          continue;
+        }
+        // Reloading moves the animation, the entities refetch these pointers every frame anyway
+        for(int j = 0; j < Controller->Params.AnimRIDs.Count; j++)
+        {
+          Controller->Animations[j] = this->GetAnimation(Controller->Params.AnimRIDs[j]);
+        }
+
+        if(!UpdateRuntimeMMDataAnimation(this->TemporaryStack, Controller, a))
+        {
+          // The frame count changed, so the controller needs a new allocation
+          Memory::marker MMControllerAssetStart = this->TemporaryStack->GetMarker();
+          mm_controller_data* NewController =
+            SpliceRuntimeMMDataAnimation(this->TemporaryStack, Controller, a);
+
+          size_t AlignmentSize =
+            (uint8_t*)NewController - (uint8_t*)MMControllerAssetStart.Address;
+          size_t NewControllerSize =
+            this->TemporaryStack->GetByteCountAboveMarker(MMControllerAssetStart) -
+            AlignmentSize;
+          path ControllerPath;
+          strcpy(ControllerPath.Name, Path);
+
+          Asset::PackMMController(NewController);
+          UpdateOrCreateMMController(NewController, NewControllerSize, ControllerPath.Name);
+          this->TemporaryStack->FreeToMarker(MMControllerAssetStart);
+
+          bool Found = this->MMControllers.Get(RID, &Controller, &Path);
+          assert(Found && Controller);
+        }
+        Updated = true;
+      }
+      if(Updated)
+      {
+        printf("Updated controller: %s, re-export it to keep the changes\n", Path);
+      }
+    }
+  }
+
   bool
   resource_manager::LoadMaterial(rid RID)
   {
@@ -692,6 +774,7 @@ namespace Resource
               printf("Reloading animation: %s\n", DiffedAnimations[i].Path.Name);
               FreeAnimation(RID);
               LoadAnimation(RID);
+              UpdateMMControllerAnimation(RID);
             }
           }
         }
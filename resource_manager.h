@@ -74,6 +74,9 @@ namespace Resource
     void FreeShader(rid RID);
     void FreeMMController(rid RID);
 
+    // Rebuilds the features of the loaded controllers that use a reloaded animation
+    void UpdateMMControllerAnimation(rid AnimRID);
+
     GLuint DefaultShaderID;
 
   public:
@@ -110,6 +113,7 @@ namespace Resource
     int32_t MMControllerPathCount;
     int32_t ParticleSystemPathCount;
 
+    // ControllerData has to be packed with Asset::PackMMController
     rid UpdateOrCreateMMController(mm_controller_data* ControllerData, size_t Size,
                                    const char* Path);
     void AddMMControllerAnimationReferences(mm_controller_data* Controller);
@@ -325,12 +325,21 @@ ImportScene(game_state* GameState, const char* Path)
       GameState->Entities[e].AnimPlayer->OutputTransforms =
         PushArray(GameState->PersistentMemStack,
                   ANIM_PLAYER_OUTPUT_BLOCK_COUNT * Model->Skeleton->BoneCount, transform);
-      GameState->Entities[e].AnimPlayer->BoneSpaceMatrices =
-        PushArray(GameState->PersistentMemStack, Model->Skeleton->BoneCount, mat4);
-      GameState->Entities[e].AnimPlayer->ModelSpaceMatrices =
-        PushArray(GameState->PersistentMemStack, Model->Skeleton->BoneCount, mat4);
+      GameState->Entities[e].AnimPlayer->BoneSpaceMatrices  = NULL;
+      GameState->Entities[e].AnimPlayer->ModelSpaceMatrices = NULL;
       GameState->Entities[e].AnimPlayer->HierarchicalModelSpaceMatrices =
         PushArray(GameState->PersistentMemStack, Model->Skeleton->BoneCount, mat4);
+      GameState->Entities[e].AnimPlayer->SkinningMatrices =
+        PushArray(GameState->PersistentMemStack, Model->Skeleton->BoneCount,
+                  Anim::skinning_matrix);
+      GameState->Entities[e].AnimPlayer->LODState       = {};
+      GameState->Entities[e].AnimPlayer->LODState.Poses =
+        PushArray(GameState->PersistentMemStack, 2 * Model->Skeleton->BoneCount, transform);
+
+      Anim::flat_skeleton* FlatSkeleton =
+        PushStruct(GameState->PersistentMemStack, Anim::flat_skeleton);
+      Anim::BuildFlatSkeleton(FlatSkeleton, Model->Skeleton);
+      GameState->Entities[e].AnimPlayer->FlatSkeleton = FlatSkeleton;
     }
 
     GameState->Entities[e].MaterialIDs =
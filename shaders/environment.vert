@@ -13,7 +13,7 @@ layout(location = 5) in vec4 a_boneWeights;
 
 uniform mat4 mat_mvp;
 uniform mat4 mat_model;
-uniform mat4 g_boneMatrices[20];
+uniform mat3x4 g_boneMatrices[20];
 uniform vec3 cameraPosition;
 uniform int flags;
 
@@ -35,13 +35,15 @@ main()
     mat4 modelMatrix = mat_model;
     mat4 mvpMatrix = mat_mvp;
 
-    if((flags & SKELETAL) != 0 && (g_boneMatrices[0] != mat4(0.0f)) &&
+    if((flags & SKELETAL) != 0 && (g_boneMatrices[0] != mat3x4(0.0f)) &&
      (a_boneWeights.x + a_boneWeights.y + a_boneWeights.z + a_boneWeights.w) > 0.99f)
     {
-        mat4 finalPoseMatrix = g_boneMatrices[a_boneIndices.x] * a_boneWeights.x +
-                               g_boneMatrices[a_boneIndices.y] * a_boneWeights.y +
-                               g_boneMatrices[a_boneIndices.z] * a_boneWeights.z +
-                               g_boneMatrices[a_boneIndices.w] * a_boneWeights.w;
+        mat3x4 boneRows = g_boneMatrices[a_boneIndices.x] * a_boneWeights.x +
+                          g_boneMatrices[a_boneIndices.y] * a_boneWeights.y +
+                          g_boneMatrices[a_boneIndices.z] * a_boneWeights.z +
+                          g_boneMatrices[a_boneIndices.w] * a_boneWeights.w;
+        mat4 finalPoseMatrix =
+          transpose(mat4(boneRows[0], boneRows[1], boneRows[2], vec4(0, 0, 0, 1)));
         modelMatrix *= finalPoseMatrix;
         mvpMatrix *= finalPoseMatrix;
     }
@@ -9,7 +9,7 @@ layout(location = 5) in vec4 a_boneWeights;
 
 uniform mat4 mat_mvp;
 uniform mat4 mat_model;
-uniform mat4 g_boneMatrices[20];
+uniform mat3x4 g_boneMatrices[20];
 uniform int  flags;
 uniform vec3 cameraPosition;
 uniform vec3 lightPosition;
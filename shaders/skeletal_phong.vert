@@ -9,7 +9,7 @@ layout(location = 5) in vec4 a_bone_weights;
 
 uniform mat4 mat_mvp;
 uniform mat4 mat_model;
-uniform mat4 g_bone_matrices[20];
+uniform mat3x4 g_bone_matrices[20];
 
 out vec2 frag_texCoord;
 out vec3 frag_normal;
@@ -20,10 +20,12 @@ main()
 {
   frag_texCoord = a_texCoord;
 
-  mat4 final_pose_matrix = g_bone_matrices[a_bone_indices.x] * a_bone_weights.x +
-                           g_bone_matrices[a_bone_indices.y] * a_bone_weights.y +
-                           g_bone_matrices[a_bone_indices.z] * a_bone_weights.z +
-                           g_bone_matrices[a_bone_indices.w] * a_bone_weights.w;
+  mat3x4 bone_rows = g_bone_matrices[a_bone_indices.x] * a_bone_weights.x +
+                     g_bone_matrices[a_bone_indices.y] * a_bone_weights.y +
+                     g_bone_matrices[a_bone_indices.z] * a_bone_weights.z +
+                     g_bone_matrices[a_bone_indices.w] * a_bone_weights.w;
+  mat4 final_pose_matrix =
+    transpose(mat4(bone_rows[0], bone_rows[1], bone_rows[2], vec4(0, 0, 0, 1)));
   frag_normal = mat3(transpose(inverse(mat_model * final_pose_matrix))) * a_normal;
 
   frag_position = vec3(mat_model * final_pose_matrix * vec4(a_position, 1.0f));
@@ -43,16 +43,17 @@ namespace Anim
   }
 
   inline int
-  r_GetBoneDepth(const Anim::skeleton* Skeleton, int BoneIndex)
+  GetBoneDepth(const Anim::skeleton* Skeleton, int BoneIndex)
   {
     assert(BoneIndex >= 0 && BoneIndex < Skeleton->BoneCount);
 
-    int ParentIndex = Skeleton->Bones[BoneIndex].ParentIndex;
-    if(ParentIndex < 0)
+    int Depth = 0;
+    for(int ParentIndex = Skeleton->Bones[BoneIndex].ParentIndex; 0 <= ParentIndex;
+        ParentIndex     = Skeleton->Bones[ParentIndex].ParentIndex)
     {
-      return 0;
+      Depth++;
     }
-    return 1 + r_GetBoneDepth(Skeleton, ParentIndex);
+    return Depth;
   }
 
   inline void
@@ -62,7 +63,7 @@ namespace Anim
     {
       const bone* Bone = &Skeleton->Bones[i];
 
-      int BoneDepth = r_GetBoneDepth(Skeleton, i);
+      int BoneDepth = GetBoneDepth(Skeleton, i);
       for(int d = 0; d < BoneDepth; d++)
       {
         printf("  ");
@@ -16,7 +16,13 @@ MeasureFootSkate(foot_skate_test* Test, Anim::animation_player* AnimPlayer,
   vec3 FuturePs[MAX_TEST_BONE_COUNT];
   vec3 Velocities[MAX_TEST_BONE_COUNT];
 
-  playback_info PlaybackInfo = playback_info{  MirrorInfo, BlendStack};
+  // The weights are recomputed for both sample times, the cursors may not move in the original
+  blend_stack   SampledBlendStack = *BlendStack;
+  playback_info PlaybackInfo      = {};
+  PlaybackInfo.MirrorInfo         = MirrorInfo;
+  PlaybackInfo.MirroredAnimations =
+    MMController->MirroredAnimations.IsValid() ? MMController->MirroredAnimations.Elements : NULL;
+  PlaybackInfo.BlendStack = &SampledBlendStack;
 
   const float OriginalAnimPlayerTime = AnimPlayer->GlobalTimeSec;
   const int   HipBoneIndex           = 0;
@@ -25,14 +31,9 @@ MeasureFootSkate(foot_skate_test* Test, Anim::animation_player* AnimPlayer,
   AnimPlayer->GlobalTimeSec -= dt;
   // FirstPoseSample
   {
+    UpdateBlendStackWeights(&SampledBlendStack, &AnimPlayer->GlobalTimeSec, 1);
     AnimPlayer->BlendFunc(AnimPlayer, &PlaybackInfo);
-
-    Anim::ComputeBoneSpacePoses(AnimPlayer->BoneSpaceMatrices, AnimPlayer->OutputTransforms,
-                                AnimPlayer->Skeleton->BoneCount);
-    Anim::ComputeModelSpacePoses(AnimPlayer->ModelSpaceMatrices, AnimPlayer->BoneSpaceMatrices,
-                                 AnimPlayer->Skeleton);
-    Anim::ComputeFinalHierarchicalPoses(AnimPlayer->HierarchicalModelSpaceMatrices,
-                                        AnimPlayer->ModelSpaceMatrices, AnimPlayer->Skeleton);
+    Anim::ComputePlayerPoses(AnimPlayer);
     mat4 InvRootMatrix;
     Anim::GetRootAndInvRootMatrices(NULL, &InvRootMatrix,
                                     AnimPlayer->HierarchicalModelSpaceMatrices[HipBoneIndex]);
@@ -53,14 +54,9 @@ MeasureFootSkate(foot_skate_test* Test, Anim::animation_player* AnimPlayer,
   AnimPlayer->GlobalTimeSec += dt;
   // Sample CurrentPose Pose
   {
+    UpdateBlendStackWeights(&SampledBlendStack, &AnimPlayer->GlobalTimeSec, 1);
     AnimPlayer->BlendFunc(AnimPlayer, &PlaybackInfo);
-
-    Anim::ComputeBoneSpacePoses(AnimPlayer->BoneSpaceMatrices, AnimPlayer->OutputTransforms,
-                                AnimPlayer->Skeleton->BoneCount);
-    Anim::ComputeModelSpacePoses(AnimPlayer->ModelSpaceMatrices, AnimPlayer->BoneSpaceMatrices,
-                                 AnimPlayer->Skeleton);
-    Anim::ComputeFinalHierarchicalPoses(AnimPlayer->HierarchicalModelSpaceMatrices,
-                                        AnimPlayer->ModelSpaceMatrices, AnimPlayer->Skeleton);
+    Anim::ComputePlayerPoses(AnimPlayer);
     mat4 InvRootMatrix;
     Anim::GetRootAndInvRootMatrices(NULL, &InvRootMatrix,
                                     AnimPlayer->HierarchicalModelSpaceMatrices[HipBoneIndex]);
@@ -121,13 +117,14 @@ MeasureFootSkate(foot_skate_test* Test, Anim::animation_player* AnimPlayer,
   Result.RightFootYVel = Velocities[1].Y;
   Result.RightFootZVel = Velocities[1].Z;
   Result.AnimCount     = BlendStack->Count;
-  assert(BlendStack->Count == AnimPlayer->AnimStateCount);
+  const blend_in_info DominantBlend = BlendStack->Peek();
   Result.LocalAnimTime =
-    Anim::GetLocalSampleTime(AnimPlayer, AnimPlayer->AnimStateCount - 1, AnimPlayer->GlobalTimeSec);
-  Result.AnimIsMirrored = BlendStack->Peek().Mirror;
+    Anim::GetLocalSampleTime(DominantBlend.Animation, AnimPlayer->GlobalTimeSec,
+                             DominantBlend.GlobalAnimStartTime, DominantBlend.Loop);
+  Result.AnimIsMirrored = DominantBlend.Mirror;
   for(int i = 0; i < MMController->Animations.Count; i++)
   {
-    if(BlendStack->Peek().Animation == MMController->Animations[i])
+    if(DominantBlend.Animation == MMController->Animations[i])
     {
       Result.AnimIndex = i;
       break;
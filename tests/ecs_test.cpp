@@ -0,0 +1,393 @@
+// Runs jobs over a small ECS world with its own components and checks the world afterwards, on
+// the worker threads of the job system. Returns 1 and prints the failed checks when one fails.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "misc.h"
+#include "ecs.h"
+#include "ecs_management.h"
+#include "ecs_internal.h"
+#include "ecs_scheduler.h"
+#include "job_system.h"
+#include "thread_primitives.h"
+
+#define TEST_CHUNK_MEMORY_SIZE (64 * ECS_CHUNK_SIZE)
+#define CACHE_LINE_SIZE 64
+
+// Large enough for a couple hundred entities to fill several chunks
+struct test_visit
+{
+  int32_t EntityID;
+  int32_t Value;
+  uint8_t Padding[248];
+};
+
+struct test_tag
+{
+  int32_t Value;
+};
+
+enum test_component_type
+{
+  TEST_COMPONENT_Visit,
+  TEST_COMPONENT_Tag,
+  TEST_COMPONENT_Count,
+};
+
+static const char* g_TestComponentNames[TEST_COMPONENT_Count] = { "test_visit", "test_tag" };
+static const component_struct_info g_TestComponentInfos[TEST_COMPONENT_Count] = {
+  { (uint8_t)alignof(test_visit), (uint16_t)sizeof(test_visit) },
+  { (uint8_t)alignof(test_tag), (uint16_t)sizeof(test_tag) },
+};
+
+static int32_t g_FailedCheckCount;
+
+#define TEST_CHECK(Condition)                                                                      \
+  if(!(Condition))                                                                                 \
+  {                                                                                                \
+    printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #Condition);                           \
+    g_FailedCheckCount++;                                                                          \
+  }
+
+// Pushes a world of the test components like InitializeECS does for the game's
+ecs_world*
+PushTestWorld(Memory::stack_allocator* Alloc)
+{
+  uint8_t*     ChunkMemory = Alloc->AlignedAlloc(TEST_CHUNK_MEMORY_SIZE, CACHE_LINE_SIZE);
+  ecs_runtime* Runtime     = PushStruct(Alloc, ecs_runtime);
+  ecs_world*   World       = PushStruct(Alloc, ecs_world);
+
+  InitializeChunkHeap(Runtime, ChunkMemory, TEST_CHUNK_MEMORY_SIZE);
+  InitializeArchetypeAndComponentTables(Runtime, g_TestComponentInfos, g_TestComponentNames,
+                                        TEST_COMPONENT_Count);
+  InitializeWorld(World, Runtime);
+  return World;
+}
+
+void*
+GetTestComponent(const ecs_world* World, entity_id EntityID, component_id ComponentID)
+{
+  const archetype* Archetype = GetEntityArchetype(World, EntityID);
+  return GetComponentAddress(World, World->Entities[EntityID],
+                             (int32_t)GetComponentOffset(*Archetype, ComponentID),
+                             World->Runtime->ComponentStructInfos[ComponentID]);
+}
+
+// Chunk jobs
+
+static volatile int32_t g_VisitCounts[ECS_ENTITY_MAX_COUNT];
+
+ECS_JOB_FUNCTION(CountVisits)
+{
+  test_visit* Visits = *(test_visit**)Components;
+  for(int i = 0; i < Count; i++)
+  {
+    AtomicAddInt32(&g_VisitCounts[Visits[i].EntityID], 1);
+  }
+}
+
+// Every entity in a matched archetype has to be visited once, however its archetype's entities
+// are spread over chunks and whichever thread runs them
+void
+TestChunkJobsVisitEveryEntityOnce(Memory::stack_allocator* TempAlloc)
+{
+  Memory::marker WorldStart = TempAlloc->GetMarker();
+  ecs_world*     World      = PushTestWorld(TempAlloc);
+
+  for(int i = 0; i < ECS_ENTITY_MAX_COUNT; i++)
+  {
+    entity_id EntityID = CreateEntity(World);
+    AddComponent(World, EntityID, TEST_COMPONENT_Visit);
+    if(i % 3 == 0)
+    {
+      AddComponent(World, EntityID, TEST_COMPONENT_Tag);
+    }
+    ((test_visit*)GetTestComponent(World, EntityID, TEST_COMPONENT_Visit))->EntityID = EntityID;
+  }
+  // Leaves holes that the last entities of the chunks are moved into
+  for(int i = 5; i < ECS_ENTITY_MAX_COUNT; i += 17)
+  {
+    DestroyEntity(World, (entity_id)i);
+  }
+
+  component_request VisitRequests[] = { { TEST_COMPONENT_Visit, REQUEST_Permission_R } };
+  archetype_request VisitRequest    = { VisitRequests, 1 };
+  for(int Run = 0; Run < 4; Run++)
+  {
+    memset((void*)g_VisitCounts, 0, sizeof(g_VisitCounts));
+    Memory::marker JobStart = TempAlloc->GetMarker();
+
+    job*    Jobs;
+    int32_t ChunkCount = PushECSChunkJobs(&Jobs, TempAlloc, World, VisitRequest, CountVisits);
+    TEST_CHECK(2 < ChunkCount);
+
+    job_counter* Counter = ExecuteECSJob(TempAlloc, World, VisitRequest, CountVisits);
+    WaitForCounter(Counter);
+    TempAlloc->FreeToMarker(JobStart);
+
+    for(int i = 0; i < ECS_ENTITY_MAX_COUNT; i++)
+    {
+      const bool Exists = DoesEntityExist(World, (entity_id)i);
+      TEST_CHECK(g_VisitCounts[i] == (Exists ? 1 : 0));
+    }
+  }
+
+  TempAlloc->FreeToMarker(WorldStart);
+}
+
+// Scheduler
+
+static volatile int32_t g_FinishedFirstWriterChunkCount;
+static volatile int32_t g_MinSeenFirstWriterChunkCount;
+
+ECS_JOB_FUNCTION(FirstWriter)
+{
+  test_visit* Visits = *(test_visit**)Components;
+  for(int i = 0; i < Count; i++)
+  {
+    Visits[i].Value = 10 * Visits[i].Value + 1;
+  }
+  AtomicAddInt32(&g_FinishedFirstWriterChunkCount, 1);
+}
+
+ECS_JOB_FUNCTION(SecondWriter)
+{
+  int32_t FinishedCount = AtomicReadInt32(&g_FinishedFirstWriterChunkCount);
+  int32_t SeenCount     = AtomicReadInt32(&g_MinSeenFirstWriterChunkCount);
+  while(FinishedCount < SeenCount)
+  {
+    SeenCount =
+      AtomicCompareExchangeInt32(&g_MinSeenFirstWriterChunkCount, FinishedCount, SeenCount);
+  }
+
+  test_visit* Visits = *(test_visit**)Components;
+  for(int i = 0; i < Count; i++)
+  {
+    Visits[i].Value = 10 * Visits[i].Value + 2;
+  }
+}
+
+// Reads the other component, so it may run next to both writers
+ECS_JOB_FUNCTION(TagReader)
+{
+  const test_tag* Tags = *(const test_tag**)Components;
+  for(int i = 0; i < Count; i++)
+  {
+    assert(Tags[i].Value == 0);
+  }
+}
+
+// Systems writing the same component have to run one after the other in registration order, on
+// every chunk and in every frame
+void
+TestConflictingSystemsRunInRegistrationOrder(Memory::stack_allocator* TempAlloc)
+{
+  Memory::marker WorldStart = TempAlloc->GetMarker();
+  ecs_world*     World      = PushTestWorld(TempAlloc);
+  for(int i = 0; i < ECS_ENTITY_MAX_COUNT; i++)
+  {
+    entity_id EntityID = CreateEntity(World);
+    AddComponent(World, EntityID, TEST_COMPONENT_Visit);
+    if(i % 2 == 0)
+    {
+      AddComponent(World, EntityID, TEST_COMPONENT_Tag);
+    }
+  }
+
+  component_request WriteRequests[] = { { TEST_COMPONENT_Visit, REQUEST_Permission_RW } };
+  component_request ReadRequests[]  = { { TEST_COMPONENT_Tag, REQUEST_Permission_R } };
+  archetype_request WriteRequest    = { WriteRequests, ArrayCount(WriteRequests) };
+  archetype_request ReadRequest     = { ReadRequests, ArrayCount(ReadRequests) };
+
+  ecs_system_scheduler Scheduler = {};
+  RegisterECSSystem(&Scheduler, "FirstWriter", WriteRequest, FirstWriter);
+  RegisterECSSystem(&Scheduler, "TagReader", ReadRequest, TagReader);
+  RegisterECSSystem(&Scheduler, "SecondWriter", WriteRequest, SecondWriter);
+  for(int Frame = 0; Frame < 100; Frame++)
+  {
+    for(int i = 0; i < ECS_ENTITY_MAX_COUNT; i++)
+    {
+      ((test_visit*)GetTestComponent(World, (entity_id)i, TEST_COMPONENT_Visit))->Value = 0;
+    }
+    g_FinishedFirstWriterChunkCount = 0;
+    g_MinSeenFirstWriterChunkCount  = INT32_MAX;
+
+    RunECSSystems(&Scheduler, TempAlloc, World);
+
+    TEST_CHECK(1 < Scheduler.Timings[0].ChunkCount);
+    TEST_CHECK(Scheduler.Timings[2].ChunkCount == Scheduler.Timings[0].ChunkCount);
+    TEST_CHECK(g_MinSeenFirstWriterChunkCount == Scheduler.Timings[0].ChunkCount);
+    TEST_CHECK(Scheduler.Timings[2].Wave == Scheduler.Timings[0].Wave + 1);
+    TEST_CHECK(Scheduler.Timings[1].Wave == 0);
+    for(int i = 0; i < ECS_ENTITY_MAX_COUNT; i++)
+    {
+      TEST_CHECK(((test_visit*)GetTestComponent(World, (entity_id)i, TEST_COMPONENT_Visit))
+                   ->Value == 12);
+    }
+  }
+
+  TempAlloc->FreeToMarker(WorldStart);
+}
+
+// Deferred commands
+
+#define TEST_DEFER_JOB_COUNT 8
+#define TEST_DEFER_EXISTING_ENTITY_COUNT 60
+#define TEST_DEFER_DESTROY_COUNT 2
+#define TEST_DEFER_TAG_COUNT 3
+#define TEST_DEFER_CREATE_COUNT 5
+// Tag values of the created entities start here, the existing ones keep 0
+#define TEST_DEFER_FIRST_TAG_VALUE 1000
+
+struct test_defer_job
+{
+  ecs_world* World;
+  int32_t    JobIndex;
+};
+
+static volatile int32_t g_StartedDeferJobCount;
+static volatile int32_t g_DeferJobThreadIndices[TEST_DEFER_JOB_COUNT];
+
+JOB_FUNCTION(RecordDeferredCommands)
+{
+  test_defer_job* Job   = (test_defer_job*)Data;
+  ecs_world*      World = Job->World;
+  g_DeferJobThreadIndices[Job->JobIndex] = GetJobThreadIndex();
+
+  // Holds the first job back until another thread has taken one as well
+  AtomicAddInt32(&g_StartedDeferJobCount, 1);
+  for(int i = 0; i < 100000000 && AtomicReadInt32(&g_StartedDeferJobCount) < 2; i++)
+  {
+  }
+
+  const int32_t FirstEntity = Job->JobIndex * (TEST_DEFER_DESTROY_COUNT + TEST_DEFER_TAG_COUNT);
+  for(int i = 0; i < TEST_DEFER_DESTROY_COUNT; i++)
+  {
+    DeferDestroyEntity(World, (entity_id)(FirstEntity + i));
+  }
+  for(int i = 0; i < TEST_DEFER_TAG_COUNT; i++)
+  {
+    DeferAddComponent(World, (entity_id)(FirstEntity + TEST_DEFER_DESTROY_COUNT + i),
+                      TEST_COMPONENT_Tag);
+  }
+  for(int i = 0; i < TEST_DEFER_CREATE_COUNT; i++)
+  {
+    test_tag Tag = { TEST_DEFER_FIRST_TAG_VALUE + Job->JobIndex * TEST_DEFER_CREATE_COUNT + i };
+    entity_id EntityID = DeferCreateEntity(World);
+    DeferAddComponent(World, EntityID, TEST_COMPONENT_Visit);
+    DeferAddComponent(World, EntityID, TEST_COMPONENT_Tag);
+    DeferSetComponent_(World, EntityID, &Tag, sizeof(Tag), TEST_COMPONENT_Tag);
+  }
+}
+
+// Commands recorded by jobs on different threads all have to be applied by the playback
+void
+TestDeferredCommandsFromJobs(Memory::stack_allocator* TempAlloc)
+{
+  Memory::marker WorldStart = TempAlloc->GetMarker();
+  ecs_world*     World      = PushTestWorld(TempAlloc);
+  for(int i = 0; i < TEST_DEFER_EXISTING_ENTITY_COUNT; i++)
+  {
+    entity_id EntityID = CreateEntity(World);
+    AddComponent(World, EntityID, TEST_COMPONENT_Visit);
+    ((test_visit*)GetTestComponent(World, EntityID, TEST_COMPONENT_Visit))->EntityID = EntityID;
+  }
+
+  test_defer_job Jobs[TEST_DEFER_JOB_COUNT];
+  job            JobDescs[TEST_DEFER_JOB_COUNT];
+  for(int j = 0; j < TEST_DEFER_JOB_COUNT; j++)
+  {
+    Jobs[j]     = { World, j };
+    JobDescs[j] = { RecordDeferredCommands, &Jobs[j] };
+  }
+  g_StartedDeferJobCount = 0;
+  job_counter Counter    = {};
+  KickJobs(&Counter, JobDescs, TEST_DEFER_JOB_COUNT);
+  WaitForCounter(&Counter);
+
+  int32_t ThreadMask = 0;
+  for(int j = 0; j < TEST_DEFER_JOB_COUNT; j++)
+  {
+    ThreadMask |= 1 << g_DeferJobThreadIndices[j];
+  }
+  TEST_CHECK((ThreadMask & (ThreadMask - 1)) != 0);
+
+  RunWorldCommandBuffer(World->Runtime, World);
+
+  for(int t = 0; t < JOB_SYSTEM_MAX_THREAD_COUNT; t++)
+  {
+    TEST_CHECK(World->CommandBuffers[t].Commands.Count == 0);
+  }
+
+  // The existing entities are checked by the ID they stored, created ones by their tag value
+  int32_t ExistingEntityCounts[TEST_DEFER_EXISTING_ENTITY_COUNT] = {};
+  int32_t CreatedEntityCounts[TEST_DEFER_JOB_COUNT * TEST_DEFER_CREATE_COUNT] = {};
+  for(int i = 0; i < World->Entities.Count; i++)
+  {
+    if(!DoesEntityExist(World, (entity_id)i))
+    {
+      continue;
+    }
+    TEST_CHECK(HasComponent(World, (entity_id)i, TEST_COMPONENT_Visit));
+    const test_visit* Visit =
+      (const test_visit*)GetTestComponent(World, (entity_id)i, TEST_COMPONENT_Visit);
+    const test_tag* Tag =
+      HasComponent(World, (entity_id)i, TEST_COMPONENT_Tag)
+        ? (const test_tag*)GetTestComponent(World, (entity_id)i, TEST_COMPONENT_Tag)
+        : NULL;
+    if(Tag && TEST_DEFER_FIRST_TAG_VALUE <= Tag->Value)
+    {
+      const int32_t CreatedIndex = Tag->Value - TEST_DEFER_FIRST_TAG_VALUE;
+      TEST_CHECK(Visit->EntityID == 0);
+      if(CreatedIndex < TEST_DEFER_JOB_COUNT * TEST_DEFER_CREATE_COUNT)
+      {
+        CreatedEntityCounts[CreatedIndex]++;
+      }
+      continue;
+    }
+
+    TEST_CHECK(Visit->EntityID == i);
+    ExistingEntityCounts[i]++;
+    const int32_t JobIndex = i / (TEST_DEFER_DESTROY_COUNT + TEST_DEFER_TAG_COUNT);
+    const int32_t Index    = i % (TEST_DEFER_DESTROY_COUNT + TEST_DEFER_TAG_COUNT);
+    const bool    IsTagged = (JobIndex < TEST_DEFER_JOB_COUNT && TEST_DEFER_DESTROY_COUNT <= Index);
+    TEST_CHECK(IsTagged == (Tag != NULL));
+    TEST_CHECK(!Tag || Tag->Value == 0);
+  }
+  for(int i = 0; i < TEST_DEFER_EXISTING_ENTITY_COUNT; i++)
+  {
+    const int32_t JobIndex    = i / (TEST_DEFER_DESTROY_COUNT + TEST_DEFER_TAG_COUNT);
+    const int32_t Index       = i % (TEST_DEFER_DESTROY_COUNT + TEST_DEFER_TAG_COUNT);
+    const bool    IsDestroyed =
+      (JobIndex < TEST_DEFER_JOB_COUNT && Index < TEST_DEFER_DESTROY_COUNT);
+    TEST_CHECK(ExistingEntityCounts[i] == (IsDestroyed ? 0 : 1));
+  }
+  for(int i = 0; i < TEST_DEFER_JOB_COUNT * TEST_DEFER_CREATE_COUNT; i++)
+  {
+    TEST_CHECK(CreatedEntityCounts[i] == 1);
+  }
+
+  TempAlloc->FreeToMarker(WorldStart);
+}
+
+int
+main(int ArgCount, char** Args)
+{
+  const uint32_t MemorySize = Mibibytes(8);
+  void*          Memory     = malloc(MemorySize);
+
+  Memory::stack_allocator Alloc;
+  Alloc.Create(Memory, MemorySize);
+
+  InitJobSystem(MaxInt32(3, Platform::GetLogicalCoreCount() - 1));
+  TestChunkJobsVisitEveryEntityOnce(&Alloc);
+  TestConflictingSystemsRunInRegistrationOrder(&Alloc);
+  TestDeferredCommandsFromJobs(&Alloc);
+  ShutdownJobSystem();
+
+  printf("%d failed checks\n", g_FailedCheckCount);
+  free(Memory);
+  return (g_FailedCheckCount == 0) ? 0 : 1;
+}
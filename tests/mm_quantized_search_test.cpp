@@ -0,0 +1,173 @@
+// Checks that motion sets large enough for the quantized feature blocks still pick the same frames
+// as the float blocks. Both controllers are built from the same features, the queries start from
+// existing frames and from near duplicates that the quantization can not tell apart.
+// Returns 1 and prints the first mismatches when the searches disagree.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+#include "motion_matching.h"
+#include "job_system.h"
+
+#define TEST_FRAME_COUNT (2 * MM_QUANTIZED_MIN_FRAME_COUNT + 37)
+#define TEST_ANIM_FRAME_COUNT 500
+#define TEST_QUERY_COUNT 2000
+#define TEST_BONE_COUNT 3
+
+float
+RandomFloat(float Min, float Max)
+{
+  return Min + (Max - Min) * (float(rand()) / float(RAND_MAX));
+}
+
+vec3
+RandomVec3(float Range)
+{
+  return { RandomFloat(-Range, Range), RandomFloat(-Range, Range), RandomFloat(-Range, Range) };
+}
+
+// Smooth random walks, every other frame of the second half is a copy of its predecessor moved by
+// much less than a quantization step
+void
+GenerateFeatures(float* OutFeatures, const mm_feature_layout& Layout)
+{
+  mm_frame_info Current = {};
+  for(int i = 0; i < TEST_FRAME_COUNT; i++)
+  {
+    if(i % TEST_ANIM_FRAME_COUNT == 0)
+    {
+      for(int b = 0; b < Layout.BoneCount; b++)
+      {
+        Current.BonePs[b] = RandomVec3(0.5f) + vec3{ 0, 1, 0 };
+        Current.BoneVs[b] = RandomVec3(2.0f);
+      }
+      for(int p = 0; p < Layout.PointCount; p++)
+      {
+        Current.TrajectoryPs[p]     = RandomVec3(float(p + 1) * 0.5f);
+        Current.TrajectoryPs[p].Y   = 0;
+        Current.TrajectoryAngles[p] = RandomFloat(-3.14f, 3.14f);
+      }
+    }
+    mm_frame_info Frame = Current;
+    if(TEST_FRAME_COUNT / 2 < i && i % 2 == 1)
+    {
+      Frame.BonePs[0].X += RandomFloat(-1e-6f, 1e-6f);
+    }
+    else
+    {
+      for(int b = 0; b < Layout.BoneCount; b++)
+      {
+        Current.BonePs[b] += RandomVec3(0.01f);
+        Current.BoneVs[b] += RandomVec3(0.05f);
+      }
+      for(int p = 0; p < Layout.PointCount; p++)
+      {
+        Current.TrajectoryPs[p] += RandomVec3(0.01f);
+        Current.TrajectoryPs[p].Y = 0;
+        Current.TrajectoryAngles[p] += RandomFloat(-0.02f, 0.02f);
+      }
+      Frame = Current;
+    }
+    GetFrameInfoFeatures(OutFeatures + i * Layout.RowCount, Frame, Layout);
+  }
+}
+
+mm_controller_data*
+CreateController(Memory::stack_allocator* Alloc, const float* Features, bool AllowQuantization)
+{
+  mm_controller_data* MMData = PushAlignedStruct(Alloc, mm_controller_data);
+  memset(MMData, 0, sizeof(mm_controller_data));
+  ResetMMParamsToDefault(&MMData->Params);
+  for(int b = 0; b < TEST_BONE_COUNT; b++)
+  {
+    MMData->Params.FixedParams.ComparisonBoneIndices.Push(b);
+  }
+  MMData->Layout     = GetFeatureLayout(MMData->Params.FixedParams);
+  MMData->FrameCount = TEST_FRAME_COUNT;
+
+  MMData->AnimFrameInfoRanges.Init(PushArray(Alloc, 1, mm_frame_info_range), 1);
+  MMData->AnimFrameInfoRanges[0]       = {};
+  MMData->AnimFrameInfoRanges[0].Start = 0;
+  MMData->AnimFrameInfoRanges[0].End   = TEST_FRAME_COUNT;
+
+  // BuildSearchData overwrites the features it is given
+  PushSearchData(Alloc, MMData, AllowQuantization);
+  Memory::marker FeaturesStart = Alloc->GetMarker();
+  const int32_t  FeatureCount  = TEST_FRAME_COUNT * MMData->Layout.RowCount;
+  float*         Scratch       = PushAlignedArray(Alloc, FeatureCount, float);
+  memcpy(Scratch, Features, FeatureCount * sizeof(float));
+  BuildSearchData(MMData, Scratch);
+  Alloc->FreeToMarker(FeaturesStart);
+  return MMData;
+}
+
+int
+main(int ArgCount, char** Args)
+{
+  const uint32_t MemorySize = Mibibytes(64);
+  void*          Memory     = malloc(MemorySize);
+
+  Memory::stack_allocator Alloc;
+  Alloc.Create(Memory, MemorySize);
+  srand(4321);
+
+  mm_params Params;
+  ResetMMParamsToDefault(&Params);
+  for(int b = 0; b < TEST_BONE_COUNT; b++)
+  {
+    Params.FixedParams.ComparisonBoneIndices.Push(b);
+  }
+  const mm_feature_layout Layout = GetFeatureLayout(Params.FixedParams);
+  float* Features = PushAlignedArray(&Alloc, TEST_FRAME_COUNT * Layout.RowCount, float);
+  GenerateFeatures(Features, Layout);
+
+  const mm_controller_data* QuantizedMMData = CreateController(&Alloc, Features, true);
+  const mm_controller_data* FloatMMData     = CreateController(&Alloc, Features, false);
+  assert(QuantizedMMData->QuantizedBlocks.IsValid() && FloatMMData->FeatureBlocks.IsValid());
+
+  InitJobSystem(0);
+  int32_t MismatchCount = 0;
+  for(int q = 0; q < TEST_QUERY_COUNT; q++)
+  {
+    // Exact copies of the near duplicates only differ below the quantization step
+    mm_frame_info Goal         = GetFrameInfo(Features + (rand() % TEST_FRAME_COUNT) *
+                                                      Layout.RowCount, Layout);
+    mm_frame_info MirroredGoal = GetFrameInfo(Features + (rand() % TEST_FRAME_COUNT) *
+                                                      Layout.RowCount, Layout);
+    if(q % 2 == 0)
+    {
+      Goal.BonePs[0] += RandomVec3(0.05f);
+      MirroredGoal.BoneVs[1] += RandomVec3(0.05f);
+    }
+
+    int32_t       AnimIndices[2];
+    float         LocalTimes[2];
+    bool          Mirrored[2];
+    float         Costs[2];
+    mm_frame_info BestMatch;
+    for(int d = 0; d < 2; d++)
+    {
+      Costs[d] = MotionMatchWithMirrors(&AnimIndices[d], &LocalTimes[d], &BestMatch, &Mirrored[d],
+                                        d == 0 ? QuantizedMMData : FloatMMData, Goal,
+                                        MirroredGoal);
+    }
+    if(AnimIndices[0] != AnimIndices[1] || LocalTimes[0] != LocalTimes[1] ||
+       Mirrored[0] != Mirrored[1] || Costs[0] != Costs[1])
+    {
+      if(MismatchCount < 10)
+      {
+        printf("query %d: quantized picked %d %f%s (cost %g), float picked %d %f%s (cost %g)\n", q,
+               AnimIndices[0], LocalTimes[0], Mirrored[0] ? " mirrored" : "", Costs[0],
+               AnimIndices[1], LocalTimes[1], Mirrored[1] ? " mirrored" : "", Costs[1]);
+      }
+      MismatchCount++;
+    }
+  }
+  ShutdownJobSystem();
+
+  printf("%d frames, %d queries, %d mismatches\n", TEST_FRAME_COUNT, TEST_QUERY_COUNT,
+         MismatchCount);
+  free(Memory);
+  return (MismatchCount == 0) ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Returns the value after the addition
+inline int32_t
+AtomicAddInt32(volatile int32_t* Value, int32_t Addend)
+{
+#if defined(_MSC_VER)
+  return (int32_t)_InterlockedExchangeAdd((volatile long*)Value, (long)Addend) + Addend;
+#else
+  return __sync_add_and_fetch(Value, Addend);
+#endif
+}
+
+// Returns the value stored before the exchange
+inline int32_t
+AtomicCompareExchangeInt32(volatile int32_t* Dest, int32_t Exchange, int32_t Comparand)
+{
+#if defined(_MSC_VER)
+  return (int32_t)_InterlockedCompareExchange((volatile long*)Dest, (long)Exchange,
+                                              (long)Comparand);
+#else
+  return __sync_val_compare_and_swap(Dest, Comparand, Exchange);
+#endif
+}
+
+// Full barrier read, writes made before another thread's atomic op are visible afterwards
+inline int32_t
+AtomicReadInt32(volatile int32_t* Value)
+{
+  return AtomicAddInt32(Value, 0);
+}
+
+inline void
+AtomicWriteInt32(volatile int32_t* Dest, int32_t Value)
+{
+#if defined(_MSC_VER)
+  _InterlockedExchange((volatile long*)Dest, (long)Value);
+#else
+  __atomic_store_n(Dest, Value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+inline void
+SpinPause()
+{
+#if defined(_MSC_VER)
+  _mm_pause();
+#else
+  __builtin_ia32_pause();
+#endif
+}
+
+struct spin_lock
+{
+  volatile int32_t Value;
+};
+
+inline void
+BeginSpinLock(spin_lock* Lock)
+{
+  while(AtomicCompareExchangeInt32(&Lock->Value, 1, 0) != 0)
+  {
+    SpinPause();
+  }
+}
+
+inline void
+EndSpinLock(spin_lock* Lock)
+{
+  AtomicWriteInt32(&Lock->Value, 0);
+}
+
+namespace Platform
+{
+#define THREAD_PROC(Name) void Name(void* Data)
+  typedef THREAD_PROC(thread_proc);
+
+  struct thread_handle
+  {
+    uintptr_t Value;
+  };
+
+  // Large enough to hold a sem_t or a HANDLE
+  struct semaphore
+  {
+    uint64_t Storage[4];
+  };
+
+  int32_t       GetLogicalCoreCount();
+  thread_handle CreateWorkerThread(thread_proc* Proc, void* Data);
+  void          JoinThread(thread_handle Thread);
+  void          YieldThread();
+
+  void InitSemaphore(semaphore* Semaphore, int32_t InitialCount);
+  void DestroySemaphore(semaphore* Semaphore);
+  void SignalSemaphore(semaphore* Semaphore, int32_t Count);
+  void WaitOnSemaphore(semaphore* Semaphore);
+}
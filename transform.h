@@ -27,3 +27,18 @@ inline transform IdentityTransform()
   NewTransform.S = vec3{1,1,1};
   return NewTransform;
 }
+
+// Rotations edited by hand or written by the physics drift away from unit length, degenerate ones
+// are reset to the identity
+inline void
+NormalizeTransformRotation(transform* Transform)
+{
+  if(Math::Length(Transform->R) <= 0.0001f)
+  {
+    Transform->R = Math::QuatIdent();
+  }
+  else
+  {
+    Math::Normalize(&Transform->R);
+  }
+}
@@ -25,9 +25,11 @@
 #include "material_upload.h"
 
 #include "dynamics.h"
+#include "anim_system.h"
 #include "gui_testing.h"
 
 #include "initialization.h"
+#include "ecs_systems.h"
 #include "edit_mode_interaction.h"
 #include "rendering.h"
 #include "post_processing.h"
@@ -53,6 +55,10 @@ GAME_UPDATE_AND_RENDER(GameUpdateAndRender)
     RegisterLoadInitialResources(GameState);
     InitializeECS(GameState->PersistentMemStack, &GameState->ECSRuntime, &GameState->ECSWorld,
                   Mibibytes(1));
+    GameState->ECSScheduler = {};
+    RegisterGameECSSystems(&GameState->ECSScheduler);
+    InitMMParamsAnimStorage(&GameState->MMEditor.ActiveProfile, GameState->PersistentMemStack,
+                            MM_PROFILE_EDITOR_ANIM_CAPACITY);
 
 		//TODO(Lukas) MOVE THIS WHRE IT'S MORE APPROPIATE
 		glEnable(GL_LINE_SMOOTH);
@@ -229,17 +235,23 @@ GAME_UPDATE_AND_RENDER(GameUpdateAndRender)
                              &MMEntityData.EntityIndices[FirstSplineControlledIndex],
                              ActiveSplineControlledCount, SplineSystem.Splines.Elements,
                              SplineSystem.Splines.Count, Entities);
+    GameState->MMSearchStats = {};
     MotionMatchGoals(MMEntityData.BlendStacks, MMEntityData.LastMatchedGoals,
-                     MMEntityData.LastMatchedTransforms, MMEntityData.AnimGoals,
+                     MMEntityData.LastMatchedTransforms, &GameState->MMSearchStats,
+                     &GameState->MMTelemetry, MMEntityData.AnimGoals,
                      MMEntityData.MirroredAnimGoals, MMEntityData.MMControllers,
-                     MMEntityData.AnimPlayerTimes, MMEntityData.EntityIndices,
-                     ActiveControllerCount, Entities);
-    DrawGoalFrameInfos(MMEntityData.AnimGoals, MMEntityData.EntityIndices, ActiveControllerCount,
-                       Entities, &MMDebug.CurrentGoal);
+                     MMEntityData.MMControllerRIDs, MMEntityData.AnimPlayerTimes,
+                     MMEntityData.EntityIndices, ActiveControllerCount, Entities,
+                     MMDebug.SearchFromContinuation);
+    MergeMMTelemetry(&GameState->MMTelemetry, Input->dt);
+    DrawGoalFrameInfos(MMEntityData.AnimGoals, MMEntityData.EntityIndices,
+                       MMEntityData.MMControllers, ActiveControllerCount, Entities,
+                       &MMDebug.CurrentGoal);
     DrawGoalFrameInfos(MMEntityData.LastMatchedGoals, MMEntityData.BlendStacks,
-                       MMEntityData.LastMatchedTransforms, ActiveControllerCount,
+                       MMEntityData.LastMatchedTransforms, MMEntityData.MMControllers,
+                       ActiveControllerCount,
                        &MMDebug.MatchedGoal, { 1, 1, 0 }, { 0, 1, 0 }, { 1, 0, 0 });
-    ComputeLocalRootMotion(MMEntityData.OutDeltaRootMotions, MMEntityData.Skeletons,
+    ComputeLocalRootMotion(MMEntityData.OutDeltaRootMotions, MMEntityData.MMControllers,
                            MMEntityData.BlendStacks, MMEntityData.AnimPlayerTimes,
                            ActiveControllerCount, Input->dt);
     if(MMDebug.ApplyRootMotion)
@@ -249,13 +261,13 @@ GAME_UPDATE_AND_RENDER(GameUpdateAndRender)
       DrawControlTrajectories(MMEntityData.Trajectories, MMEntityData.InputControllers,
                               MMEntityData.EntityIndices, ActiveControllerCount, Entities);
     AdvanceAnimPlayerTimes(MMEntityData.AnimPlayerTimes, ActiveControllerCount, Input->dt);
-    RemoveBlendedOutAnimsFromBlendStacks(MMEntityData.BlendStacks, MMEntityData.AnimPlayerTimes,
-                                         ActiveControllerCount);
     OverwriteSelectedMMEntity(MMEntityData.BlendStacks, MMEntityData.AnimPlayerTimes,
                               MMTimelineState, Entities, &MMEntityData, SelectedEntityIndex);
-    CopyMMAnimDataToAnimationPlayers(Entities, MMEntityData.BlendStacks,
-                                     MMEntityData.AnimPlayerTimes, MMEntityData.EntityIndices,
-                                     ActiveControllerCount);
+    UpdateBlendStackWeights(MMEntityData.BlendStacks, MMEntityData.AnimPlayerTimes,
+                            ActiveControllerCount);
+    RemoveBlendedOutAnimsFromBlendStacks(MMEntityData.BlendStacks, ActiveControllerCount);
+    BindBlendStacksToAnimationPlayers(Entities, MMEntityData.AnimPlayerTimes,
+                                      MMEntityData.EntityIndices, ActiveControllerCount);
 
     int FirstInactiveControllerIndex = ActiveControllerCount;
     int InactiveControllerCount      = MMEntityData.Count - ActiveControllerCount;
@@ -282,6 +294,12 @@ GAME_UPDATE_AND_RENDER(GameUpdateAndRender)
     }
   }
 
+  {
+    TIMED_BLOCK(ECSSystems);
+    RunECSSystems(&GameState->ECSScheduler, GameState->TemporaryMemStack, GameState->ECSWorld);
+    RunWorldCommandBuffer(GameState->ECSRuntime, GameState->ECSWorld);
+  }
+
   if(GameState->UpdatePhysics)
   {
     TIMED_BLOCK(Physics);
@@ -299,14 +317,7 @@ GAME_UPDATE_AND_RENDER(GameUpdateAndRender)
         // Copy rigid body from entity (Mainly needed when loading scenes)
         GameState->Physics.RigidBodies[i] = GameState->Entities[i].RigidBody;
 
-        if(FloatsEqualByThreshold(Math::Length(GameState->Entities[i].Transform.R), 0.0f, 0.0001f))
-        {
-          GameState->Entities[i].Transform.R = Math::QuatIdent();
-        }
-        else
-        {
-          Math::Normalize(&GameState->Entities[i].Transform.R);
-        }
+        NormalizeTransformRotation(&GameState->Entities[i].Transform);
 
         GameState->Physics.RigidBodies[i].q = GameState->Entities[i].Transform.R;
         GameState->Physics.RigidBodies[i].X = GameState->Entities[i].Transform.T;
@@ -579,12 +590,23 @@ GAME_UPDATE_AND_RENDER(GameUpdateAndRender)
 
   BEGIN_TIMED_BLOCK(AnimationSystem);
   // -----------ENTITY ANIMATION UPDATE-------------
-  for(int e = 0; e < GameState->EntityCount; e++)
+  Memory::marker AnimUpdateMarker = GameState->TemporaryMemStack->GetMarker();
   {
-    Anim::animation_player* Controller               = GameState->Entities[e].AnimPlayer;
-    mat4                    CurrentEntityModelMatrix = GetEntityModelMatrix(GameState, e);
-    if(Controller)
+    anim_player_update* PlayerUpdates =
+      PushArray(GameState->TemporaryMemStack, GameState->EntityCount, anim_player_update);
+    playback_info* PlaybackInfos =
+      PushArray(GameState->TemporaryMemStack, GameState->EntityCount, playback_info);
+    float   Proxydt           = Input->dt;
+    int32_t PlayerUpdateCount = 0;
+    for(int e = 0; e < GameState->EntityCount; e++)
     {
+      Anim::animation_player* Controller = GameState->Entities[e].AnimPlayer;
+      if(!Controller)
+      {
+        continue;
+      }
+
+      // Resources are looked up before the players are handed to the job threads
       for(int i = 0; i < Controller->AnimStateCount; i++)
       {
         if(Controller->AnimationIDs[i].Value > 0)
@@ -594,36 +616,109 @@ GAME_UPDATE_AND_RENDER(GameUpdateAndRender)
         }
       }
 
+      float CameraDistance =
+        Math::Length(GameState->Entities[e].Transform.T - GameState->Camera.Position);
+      Controller->LODState.LOD =
+        SelectAnimLOD(GameState->AnimLODSettings, Controller->LODState.LOD, CameraDistance);
+
+      anim_player_update* Update = &PlayerUpdates[PlayerUpdateCount++];
+      Update->Player             = Controller;
+      Update->BlendFuncUserData  = NULL;
+      Update->UpdatePeriod =
+        GameState->AnimLODSettings.UpdatePeriods[Controller->LODState.LOD];
+
       int MMEntityIndex = -1;
       if((MMEntityIndex = GetEntityMMDataIndex(e, &GameState->MMEntityData)) != -1)
       {
         mm_aos_entity_data MMEntity = GetAOSMMDataAtIndex(MMEntityIndex, &GameState->MMEntityData);
-        playback_info      PlaybackInfo = {};
-        PlaybackInfo.BlendStack         = MMEntity.BlendStack;
+        playback_info*     PlaybackInfo = &PlaybackInfos[e];
+        *PlaybackInfo                   = {};
+        PlaybackInfo->BlendStack        = MMEntity.BlendStack;
         if(MMEntity.MMControllerRID->Value > 0 && MMEntity.MMController)
         {
-          PlaybackInfo.MirrorInfo = &(*MMEntity.MMController)->Params.DynamicParams.MirrorInfo;
-          Anim::UpdatePlayer(Controller, Input->dt, Controller->BlendFunc, &PlaybackInfo);
+          const mm_controller_data* MMController = *MMEntity.MMController;
+          PlaybackInfo->MirrorInfo = &MMController->Params.DynamicParams.MirrorInfo;
+          PlaybackInfo->MirroredAnimations =
+            MMController->MirroredAnimations.IsValid() ? MMController->MirroredAnimations.Elements
+                                                       : NULL;
+          Update->BlendFuncUserData = PlaybackInfo;
         }
         else
         {
           assert(Controller->BlendFunc == NULL);
-          Anim::UpdatePlayer(Controller, Input->dt, Controller->BlendFunc);
         }
       }
+      else if(Controller->BlendFunc == BlendGraphBlendFunc)
+      {
+        // The graph samples at the player's time but leaves advancing it to the caller
+        blend_graph_preview* Preview = &GameState->BlendGraphPreview;
+        assert(Preview->Player == Controller);
+        Controller->GlobalTimeSec += Input->dt;
+        for(int c = 0; c < Preview->Graph.ClipCount; c++)
+        {
+          Preview->Graph.Clips[c].Animation = Controller->Animations[c];
+        }
+        Preview->Instance.Parameters[0] = Preview->BlendFactor;
+        Update->BlendFuncUserData       = &Preview->Instance;
+        Update->UpdatePeriod            = 1;
+      }
       else
       {
         //assert(Controller->BlendFunc == NULL);
-				float Proxydt = Input->dt;
-        Anim::UpdatePlayer(Controller, Input->dt, Controller->BlendFunc, &Proxydt);
+        Update->BlendFuncUserData = &Proxydt;
+        // Preview blend functions advance the time by the dt they are given
+        if(Controller->BlendFunc)
+        {
+          Update->UpdatePeriod = 1;
+        }
+      }
+    }
+    UpdateAnimPlayers(GameState->TemporaryMemStack, &GameState->AnimLODCounters, PlayerUpdates,
+                      PlayerUpdateCount, Input->dt);
+  }
+  GameState->TemporaryMemStack->FreeToMarker(AnimUpdateMarker);
+
+  for(int e = 0; e < GameState->EntityCount; e++)
+  {
+    Anim::animation_player* Controller               = GameState->Entities[e].AnimPlayer;
+    mat4                    CurrentEntityModelMatrix = GetEntityModelMatrix(GameState, e);
+    if(Controller)
+    {
+      // Motion matched players evaluate their blend stacks in place instead of animation states
+      static_assert(ANIM_PLAYER_MAX_ANIM_COUNT <= BLEND_STACK_MAX_CAPACITY, "");
+      const Anim::animation* Animations[BLEND_STACK_MAX_CAPACITY];
+      Anim::animation_state  States[BLEND_STACK_MAX_CAPACITY];
+      int32_t                AnimCount     = 0;
+      int32_t                MMEntityIndex = GetEntityMMDataIndex(e, &GameState->MMEntityData);
+      if(MMEntityIndex != -1)
+      {
+        const blend_stack& BlendStack = GameState->MMEntityData.BlendStacks[MMEntityIndex];
+        for(; AnimCount < BlendStack.Count; AnimCount++)
+        {
+          const blend_in_info Blend         = BlendStack[AnimCount];
+          Animations[AnimCount]             = Blend.Animation;
+          States[AnimCount]                 = {};
+          States[AnimCount].StartTimeSec    = Blend.GlobalAnimStartTime;
+          States[AnimCount].PlaybackRateSec = 1.0f;
+          States[AnimCount].Mirror          = Blend.Mirror;
+          States[AnimCount].Loop            = Blend.Loop;
+        }
+      }
+      else
+      {
+        for(; AnimCount < Controller->AnimStateCount; AnimCount++)
+        {
+          Animations[AnimCount] = Controller->Animations[AnimCount];
+          States[AnimCount]     = Controller->States[AnimCount];
+        }
       }
 
       // TODO(Lukas): remove most parts of this code as it is repeated multiple times in different
       // locations
-      for(int a = 0; a < Controller->AnimStateCount; a++)
+      for(int a = 0; a < AnimCount; a++)
       {
-        const Anim::animation*       CurrentAnimation = Controller->Animations[a];
-        const Anim::animation_state* CurrentState     = &Controller->States[a];
+        const Anim::animation*       CurrentAnimation = Animations[a];
+        const Anim::animation_state* CurrentState     = &States[a];
 
         assert(CurrentAnimation);
 
@@ -749,8 +844,7 @@ GAME_UPDATE_AND_RENDER(GameUpdateAndRender)
         }
       }
 
-      if(GetEntityMMDataIndex(e, &GameState->MMEntityData) != -1 ||
-         GameState->PreviewAnimationsInRootSpace)
+      if(MMEntityIndex != -1 || GameState->PreviewAnimationsInRootSpace)
       {
         mat4    Mat4Root;
         mat4    Mat4InvRoot;
@@ -767,6 +861,12 @@ GAME_UPDATE_AND_RENDER(GameUpdateAndRender)
           Controller->HierarchicalModelSpaceMatrices[b] =
             Math::MulMat4(Mat4InvRoot, Controller->HierarchicalModelSpaceMatrices[b]);
         }
+        if(Controller->SkinningMatrices)
+        {
+          Anim::ComputeSkinningMatrices(Controller->SkinningMatrices,
+                                        Controller->HierarchicalModelSpaceMatrices,
+                                        Controller->Skeleton->BoneCount);
+        }
       }
       if(GameState->DrawActorSkeletons)
       {
@@ -0,0 +1,84 @@
+#include <windows.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "../thread_primitives.h"
+
+struct win32_thread_start_info
+{
+  Platform::thread_proc* Proc;
+  void*                  Data;
+};
+
+static DWORD WINAPI
+Win32ThreadStart(LPVOID StartInfoPtr)
+{
+  win32_thread_start_info StartInfo = *(win32_thread_start_info*)StartInfoPtr;
+  delete(win32_thread_start_info*)StartInfoPtr;
+  StartInfo.Proc(StartInfo.Data);
+  return 0;
+}
+
+namespace Platform
+{
+  int32_t
+  GetLogicalCoreCount()
+  {
+    SYSTEM_INFO SystemInfo;
+    GetSystemInfo(&SystemInfo);
+    return (SystemInfo.dwNumberOfProcessors > 0) ? (int32_t)SystemInfo.dwNumberOfProcessors : 1;
+  }
+
+  thread_handle
+  CreateWorkerThread(thread_proc* Proc, void* Data)
+  {
+    win32_thread_start_info* StartInfo = new win32_thread_start_info;
+    StartInfo->Proc                    = Proc;
+    StartInfo->Data                    = Data;
+
+    HANDLE Thread = CreateThread(NULL, 0, Win32ThreadStart, StartInfo, 0, NULL);
+    assert(Thread);
+
+    thread_handle Result = { (uintptr_t)Thread };
+    return Result;
+  }
+
+  void
+  JoinThread(thread_handle Thread)
+  {
+    WaitForSingleObject((HANDLE)Thread.Value, INFINITE);
+    CloseHandle((HANDLE)Thread.Value);
+  }
+
+  void
+  YieldThread()
+  {
+    SwitchToThread();
+  }
+
+  void
+  InitSemaphore(semaphore* Semaphore, int32_t InitialCount)
+  {
+    HANDLE Handle = CreateSemaphoreEx(NULL, InitialCount, LONG_MAX, NULL, 0, SEMAPHORE_ALL_ACCESS);
+    assert(Handle);
+    *(HANDLE*)Semaphore->Storage = Handle;
+  }
+
+  void
+  DestroySemaphore(semaphore* Semaphore)
+  {
+    CloseHandle(*(HANDLE*)Semaphore->Storage);
+  }
+
+  void
+  SignalSemaphore(semaphore* Semaphore, int32_t Count)
+  {
+    ReleaseSemaphore(*(HANDLE*)Semaphore->Storage, Count, NULL);
+  }
+
+  void
+  WaitOnSemaphore(semaphore* Semaphore)
+  {
+    WaitForSingleObjectEx(*(HANDLE*)Semaphore->Storage, INFINITE, FALSE);
+  }
+}